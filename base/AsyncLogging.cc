@@ -0,0 +1,154 @@
+/**
+ * @brief
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/AsyncLogging.h"
+
+#include <cassert>
+#include <cstdio>
+
+#include "base/LogFile.h"
+#include "base/Timestamp.h"
+
+namespace web_server {
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t roll_size,
+                           int flush_interval,
+                           int num_buffers)
+    : flush_interval_(flush_interval),
+      running_(false),
+      basename_(basename),
+      roll_size_(roll_size),
+      thread_(std::bind(&AsyncLogging::thread_func, this), "Logging"),
+      latch_(1),
+      mutex_(),
+      cond_(mutex_),
+      current_buffer_(new Buffer),
+      dropped_messages_(0),
+      dropped_bytes_(0) {
+    assert(num_buffers >= 2);
+    current_buffer_->bzero();
+    // 当前缓冲之外的缓冲全部预先分配好，bzero让物理页在启动时就分配
+    for (int i = 1; i < num_buffers; ++i) {
+        BufferPtr buffer(new Buffer);
+        buffer->bzero();
+        free_buffers_.push_back(std::move(buffer));
+    }
+    buffers_.reserve(num_buffers);
+}
+
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void AsyncLogging::start() {
+    running_ = true;
+    thread_.start();
+    latch_.wait();
+}
+
+void AsyncLogging::stop() {
+    {
+    MutexLockGuard lock(mutex_);
+    running_ = false;
+    cond_.notify();
+    }
+    thread_.join();
+}
+
+/**
+ * @brief 前端写入，临界区内只有一次memcpy和偶尔的缓冲交换
+ * @param logline
+ * @param len
+ */
+void AsyncLogging::append(const char *logline, int len) {
+    MutexLockGuard lock(mutex_);
+    if (current_buffer_->avail() > len) {
+        current_buffer_->append(logline, len);
+        return;
+    }
+    if (free_buffers_.empty()) {
+        ++dropped_messages_;
+        dropped_bytes_ += len;
+        return;
+    }
+    buffers_.push_back(std::move(current_buffer_));
+    current_buffer_ = std::move(free_buffers_.back());
+    free_buffers_.pop_back();
+    current_buffer_->append(logline, len);
+    cond_.notify();
+}
+
+/**
+ * @brief 后端线程，交换出待写缓冲后在锁外写盘，写完归还缓冲
+ */
+void AsyncLogging::thread_func() {
+    assert(running_);
+    // 只有后端线程写入，不需要加锁；每次写入的都是整块缓冲，每次都检查滚动和fdatasync的时间
+    LogFile output(basename_, roll_size_, false, flush_interval_, 1);
+    latch_.count_down();
+
+    BufferVector buffers_to_write;
+    buffers_to_write.reserve(buffers_.capacity());
+    int64_t reported_dropped = 0;
+    bool keep_running = true;
+    while (keep_running) {
+        int64_t dropped = 0;
+        int64_t dropped_bytes = 0;
+        {
+        MutexLockGuard lock(mutex_);
+        // 在锁内读取running_，stop之后还会再完整地执行最后一轮
+        keep_running = running_;
+        if (buffers_.empty() && keep_running) {
+            cond_.wait_for_seconds(flush_interval_);
+        }
+        if (current_buffer_->length() > 0 && !free_buffers_.empty()) {
+            buffers_.push_back(std::move(current_buffer_));
+            current_buffer_ = std::move(free_buffers_.back());
+            free_buffers_.pop_back();
+        }
+        buffers_to_write.swap(buffers_);
+        dropped = dropped_messages_ - reported_dropped;
+        dropped_bytes = dropped_bytes_;
+        reported_dropped = dropped_messages_;
+        }
+
+        if (dropped > 0) {
+            char buf[256];
+            int n = snprintf(buf, sizeof buf,
+                             "Dropped %lld log messages at %s, %lld bytes dropped in total\n",
+                             static_cast<long long>(dropped),
+                             Timestamp::now().to_formatted_string().c_str(),
+                             static_cast<long long>(dropped_bytes));
+            output.append(buf, n);
+        }
+        for (const BufferPtr &buffer : buffers_to_write) {
+            output.append(buffer->data(), buffer->length());
+        }
+        if (!keep_running) {
+            // 最后一轮没有空闲缓冲可以交换时，当前缓冲直接在锁内写出
+            MutexLockGuard lock(mutex_);
+            output.append(current_buffer_->data(), current_buffer_->length());
+            current_buffer_->reset();
+        }
+        output.flush();
+
+        {
+        MutexLockGuard lock(mutex_);
+        for (BufferPtr &buffer : buffers_to_write) {
+            buffer->reset();
+            free_buffers_.push_back(std::move(buffer));
+        }
+        }
+        buffers_to_write.clear();
+    }
+}
+
+} // namespace web_server
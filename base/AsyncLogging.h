@@ -0,0 +1,95 @@
+/**
+ * @brief 异步日志后端
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_ASYNCLOGGING_H
+#define WEB_SERVER_BASE_ASYNCLOGGING_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "base/Mutex.h"
+#include "base/Condition.h"
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "base/LogStream.h"
+
+namespace web_server {
+
+/**
+ * @brief 多缓冲异步日志
+ * 前端线程只在短暂的临界区内把日志拷贝到当前缓冲中，写满后换上一块空闲缓冲；
+ * 后端线程把写满的缓冲写到磁盘，写完再把缓冲还回空闲队列，运行期间不再分配内存；
+ * 后端每隔flush_interval秒也会把未写满的当前缓冲取走并flush；
+ * 空闲缓冲耗尽（磁盘跟不上）时直接丢弃日志并计数，不会阻塞前端线程
+ *
+ * 使用时通过Logger::setOutput把输出函数指向append，后端写入按大小和按天滚动的LogFile
+ */
+class AsyncLogging : private Noncopyable {
+public:
+    /**
+     * @brief Construct a new Async Logging object
+     * @param basename 日志文件名前缀，见LogFile
+     * @param roll_size 单个日志文件的滚动大小
+     * @param flush_interval 后端定时flush的间隔，单位秒
+     * @param num_buffers 预分配的缓冲个数，每个大小为kLargeBuffer，最少为2
+     */
+    AsyncLogging(const std::string &basename,
+                 off_t roll_size,
+                 int flush_interval = 3,
+                 int num_buffers = 8);
+    ~AsyncLogging();
+
+    void append(const char *logline, int len);
+
+    void start();
+    void stop();
+
+    /**
+     * @brief 因缓冲耗尽被丢弃的日志条数
+     * @return int64_t
+     */
+    int64_t dropped_messages() const {
+        MutexLockGuard lock(mutex_);
+        return dropped_messages_;
+    }
+
+    int64_t dropped_bytes() const {
+        MutexLockGuard lock(mutex_);
+        return dropped_bytes_;
+    }
+
+private:
+    using Buffer = detail::FixedBuffer<detail::kLargeBuffer>;
+    using BufferPtr = std::unique_ptr<Buffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    const int flush_interval_;
+    std::atomic<bool> running_;
+    const std::string basename_;
+    const off_t roll_size_;
+    Thread thread_;
+    CountDownLatch latch_;
+    mutable MutexLock mutex_;
+    Condition cond_;
+    BufferPtr current_buffer_;          // 前端正在写入的缓冲
+    BufferVector buffers_;              // 已写满、等待后端写盘的缓冲
+    BufferVector free_buffers_;         // 空闲缓冲
+    int64_t dropped_messages_;
+    int64_t dropped_bytes_;
+
+    void thread_func();
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_ASYNCLOGGING_H
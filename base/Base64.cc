@@ -0,0 +1,90 @@
+/**
+ * @brief base64编解码
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/Base64.h"
+
+#include <cstdint>
+
+namespace web_server {
+
+namespace base64 {
+
+namespace {
+
+const char k_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int decode_char(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+' || c == '-') {
+        return 62;
+    } else if (c == '/' || c == '_') {
+        return 63;
+    }
+    return -1;
+}
+
+} // namespace
+
+std::string encode(const void *data, size_t len) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    std::string output;
+    output.reserve((len + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t group = (static_cast<uint32_t>(p[i]) << 16) | (static_cast<uint32_t>(p[i + 1]) << 8) | p[i + 2];
+        output.push_back(k_alphabet[group >> 18]);
+        output.push_back(k_alphabet[(group >> 12) & 0x3f]);
+        output.push_back(k_alphabet[(group >> 6) & 0x3f]);
+        output.push_back(k_alphabet[group & 0x3f]);
+    }
+    if (i < len) {
+        uint32_t group = static_cast<uint32_t>(p[i]) << 16;
+        if (i + 1 < len) {
+            group |= static_cast<uint32_t>(p[i + 1]) << 8;
+        }
+        output.push_back(k_alphabet[group >> 18]);
+        output.push_back(k_alphabet[(group >> 12) & 0x3f]);
+        output.push_back(i + 1 < len ? k_alphabet[(group >> 6) & 0x3f] : '=');
+        output.push_back('=');
+    }
+    return output;
+}
+
+bool decode(const char *data, size_t len, std::string *output) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t i = 0;
+    for (; i < len && data[i] != '='; ++i) {
+        int value = decode_char(data[i]);
+        if (value < 0) {
+            return false;
+        }
+        acc = (acc << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            output->push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    // 填充之后只能还是填充
+    for (; i < len; ++i) {
+        if (data[i] != '=') {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace base64
+
+} // namespace web_server
@@ -0,0 +1,39 @@
+/**
+ * @brief base64编解码
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_BASE64_H
+#define WEB_SERVER_BASE_BASE64_H
+
+#include <cstddef>
+#include <string>
+
+namespace web_server {
+
+namespace base64 {
+
+/**
+ * @brief 标准字母表（RFC 4648第4节）编码，带'='填充
+ */
+std::string encode(const void *data, size_t len);
+
+/**
+ * @brief 解码，同时接受标准字母表和URL安全字母表（'-'、'_'），结尾的'='可有可无
+ * 用于Sec-WebSocket-Key和HTTP2-Settings这类首部，不接受空白
+ * @return false 含有字母表以外的字符
+ */
+bool decode(const char *data, size_t len, std::string *output);
+
+inline bool decode(const std::string &input, std::string *output) {
+    return decode(input.data(), input.size(), output);
+}
+
+} // namespace base64
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_BASE64_H
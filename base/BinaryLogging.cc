@@ -0,0 +1,543 @@
+/**
+ * @brief 二进制日志：调用线程只拷贝原始参数，后端线程格式化后写入LogFile
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/BinaryLogging.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "base/LogFile.h"
+#include "base/LogStream.h"
+#include "base/NumberFormat.h"
+#include "base/Timestamp.h"
+
+namespace web_server {
+
+extern const char* LogLevelName[Logger::NUM_LOG_LEVELS];
+extern Logger::OutputFunc g_output;
+
+namespace detail {
+
+std::atomic<bool> g_binary_logging_running(false);
+
+namespace {
+
+const uint32_t k_wrap_marker = 0xffffffff;
+
+/**
+ * @brief 线程私有的单生产者单消费者环形缓冲
+ * head_只由生产线程写，tail_只由后端线程写，两者都是单调递增的字节计数；
+ * 缓冲尾部放不下一条完整记录时写入回绕标记，后端读到标记后跳到缓冲开头
+ */
+class StagingBuffer : private Noncopyable {
+public:
+    static const size_t k_size = BinaryLogging::k_staging_buffer_size;
+    static const size_t k_mask = k_size - 1;
+
+    StagingBuffer()
+        : head_(0),
+          pending_pad_(0),
+          cached_tail_(0),
+          tail_(0),
+          retired_(false) {
+        static_assert((k_size & k_mask) == 0, "staging buffer size must be a power of 2");
+        current_thread::tid();
+        tid_.assign(current_thread::tid_string(), current_thread::tid_string_length());
+        // 创建时就让物理页分配好，避免在写日志的路径上发生缺页
+        memset(data_, 0, sizeof data_);
+    }
+
+    char *reserve(size_t size) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(head & k_mask);
+        size_t pad = offset + size > k_size ? k_size - offset : 0;
+        uint64_t end = head + pad + size;
+        if (end - cached_tail_ > k_size) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (end - cached_tail_ > k_size) {
+                return nullptr;
+            }
+        }
+        if (pad > 0) {
+            uint32_t marker = k_wrap_marker;
+            memcpy(data_ + offset, &marker, sizeof marker);
+        }
+        pending_pad_ = pad;
+        return data_ + ((head + pad) & k_mask);
+    }
+
+    void commit(size_t size) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        head_.store(head + pending_pad_ + size, std::memory_order_release);
+    }
+
+    /**
+     * @brief 后端线程读取所有已提交的记录
+     * @param func 对每条记录调用func(const char *record)
+     * @return size_t 读取的记录数
+     */
+    template <typename Func>
+    size_t consume(Func func) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (tail != head) {
+            size_t offset = static_cast<size_t>(tail & k_mask);
+            const char *record = data_ + offset;
+            uint32_t site_id;
+            memcpy(&site_id, record, sizeof site_id);
+            if (site_id == k_wrap_marker) {
+                tail += k_size - offset;
+                continue;
+            }
+            LogRecordHeader header;
+            memcpy(&header, record, sizeof header);
+            func(record);
+            tail += header.size;
+            ++count;
+        }
+        tail_.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    bool empty() const {
+        return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+    }
+
+    void retire() {
+        retired_.store(true, std::memory_order_release);
+    }
+
+    bool retired() const {
+        return retired_.load(std::memory_order_acquire);
+    }
+
+    const std::string &tid() const {
+        return tid_;
+    }
+
+private:
+    static const size_t k_cache_line_size = 64;
+
+    // 生产者和后端各自写的字段之间、它们和数据区之间用整行填充隔开，避免伪共享；
+    // 缓冲用new创建，C++11的new不保证alignas(64)这样的对齐，所以不用alignas
+    std::atomic<uint64_t> head_;
+    size_t pending_pad_;
+    uint64_t cached_tail_;
+    char pad0_[k_cache_line_size];
+    std::atomic<uint64_t> tail_;
+    std::atomic<bool> retired_;
+    std::string tid_;
+    char pad1_[k_cache_line_size];
+    char data_[k_size];
+};
+
+MutexLock g_sites_mutex;
+std::vector<const LogSite *> g_sites;
+
+MutexLock g_buffers_mutex;
+std::vector<StagingBuffer *> g_buffers;
+// 后端线程没有启动或者已经join，这时退出的线程自己读空并释放缓冲；由g_buffers_mutex保护
+bool g_backend_stopped = true;
+
+// 环形缓冲只能有一个消费者：后端线程、stop之后的读空和生产者的补救输出都持有这把锁才读取
+MutexLock g_consume_mutex;
+
+std::atomic<int64_t> g_dropped_records(0);
+
+__thread StagingBuffer *t_staging_buffer = nullptr;
+pthread_once_t g_buffer_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t g_buffer_key;
+
+void output_buffer_directly(StagingBuffer *buffer);
+
+/**
+ * @brief 线程退出时只做标记，缓冲由后端线程读空后释放；没有后端线程时当场读空释放
+ */
+void retire_staging_buffer(void *arg) {
+    StagingBuffer *buffer = static_cast<StagingBuffer *>(arg);
+    MutexLockGuard lock(g_buffers_mutex);
+    if (!g_backend_stopped) {
+        buffer->retire();
+        return;
+    }
+    output_buffer_directly(buffer);
+    g_buffers.erase(std::remove(g_buffers.begin(), g_buffers.end(), buffer), g_buffers.end());
+    delete buffer;
+}
+
+void create_buffer_key() {
+    ::pthread_key_create(&g_buffer_key, retire_staging_buffer);
+}
+
+StagingBuffer *staging_buffer() {
+    if (unlikely(t_staging_buffer == nullptr)) {
+        t_staging_buffer = new StagingBuffer;
+        ::pthread_once(&g_buffer_key_once, create_buffer_key);
+        ::pthread_setspecific(g_buffer_key, t_staging_buffer);
+        MutexLockGuard lock(g_buffers_mutex);
+        g_buffers.push_back(t_staging_buffer);
+    }
+    return t_staging_buffer;
+}
+
+/**
+ * @brief 把记录格式化成与Logger一致的一行文本
+ * @param site 调用点
+ * @param record 记录
+ * @param micro_seconds 记录的时间
+ * @param tid 写入线程的tid字符串
+ * @param stream 输出
+ */
+void format_record(const LogSite &site,
+                   const char *record,
+                   int64_t micro_seconds,
+                   const std::string &tid,
+                   LogStream &stream) {
+    static __thread time_t t_last_second = 0;
+    static __thread char t_time[64];
+    time_t seconds = static_cast<time_t>(micro_seconds / Timestamp::k_micro_seconds_per_second);
+    if (seconds != t_last_second) {
+        t_last_second = seconds;
+        struct tm tm_time;
+        ::gmtime_r(&seconds, &tm_time);
+        number_format::format_date_time(t_time, tm_time);
+        t_time[number_format::k_date_time_size] = '\0';
+    }
+    char micros[8];
+    micros[0] = '.';
+    number_format::format_fixed_width(micros + 1,
+        static_cast<uint32_t>(micro_seconds % Timestamp::k_micro_seconds_per_second), 6);
+    micros[7] = ' ';
+    stream << t_time;
+    stream.append(micros, sizeof micros);
+    stream << tid << LogLevelName[site.level];
+
+    const char *p = record + sizeof(LogRecordHeader);
+    const uint8_t *type = site.arg_types;
+    const char *format = site.format;
+    // 按格式串输出，每个{}换成下一个参数；参数多于占位符时追加在末尾
+    while (*format || *type != k_arg_end) {
+        bool placeholder = format[0] == '{' && format[1] == '}';
+        if (*format && !placeholder) {
+            stream << *format++;
+            continue;
+        }
+        if (*type == k_arg_end) {
+            stream << *format++;
+            continue;
+        }
+        if (placeholder) {
+            format += 2;
+        } else {
+            stream << ' ';
+        }
+        switch (*type++) {
+        case k_arg_int: {
+            int64_t v;
+            memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            stream << static_cast<long long>(v);
+            break;
+        }
+        case k_arg_uint: {
+            uint64_t v;
+            memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            stream << static_cast<unsigned long long>(v);
+            break;
+        }
+        case k_arg_double: {
+            double v;
+            memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            stream << v;
+            break;
+        }
+        case k_arg_char:
+            stream << *p++;
+            break;
+        case k_arg_pointer: {
+            uint64_t v;
+            memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            stream << reinterpret_cast<const void *>(static_cast<uintptr_t>(v));
+            break;
+        }
+        case k_arg_string: {
+            uint32_t len;
+            memcpy(&len, p, sizeof len);
+            p += sizeof len;
+            stream.append(p, static_cast<int>(len));
+            p += len;
+            break;
+        }
+        default:
+            assert(false);
+        }
+    }
+
+    const char *basename = strrchr(site.file, '/');
+    stream << " - " << (basename ? basename + 1 : site.file) << ':' << site.line << '\n';
+}
+
+/**
+ * @brief 时间戳计数到微秒的换算，后端运行期间不断用更长的时间跨度修正频率
+ */
+class CycleClock {
+public:
+    CycleClock() {
+        base_cycles_ = read_cycles();
+        base_micros_ = Timestamp::now().micro_seconds_since_epoch();
+        current_thread::sleep_usec(10 * 1000);
+        recalibrate();
+    }
+
+    void recalibrate() {
+        uint64_t cycles = read_cycles();
+        int64_t micros = Timestamp::now().micro_seconds_since_epoch();
+        if (micros > base_micros_ && cycles > base_cycles_) {
+            cycles_per_micro_ = static_cast<double>(cycles - base_cycles_) /
+                                static_cast<double>(micros - base_micros_);
+        }
+    }
+
+    int64_t to_micros(uint64_t cycles) const {
+        double delta = static_cast<double>(static_cast<int64_t>(cycles - base_cycles_));
+        return base_micros_ + static_cast<int64_t>(delta / cycles_per_micro_);
+    }
+
+private:
+    uint64_t base_cycles_;
+    int64_t base_micros_;
+    double cycles_per_micro_ = 1.0;
+};
+
+/**
+ * @brief 后端线程已经停止或者即将停止时，把buffer中剩下的记录直接交给Logger的输出函数
+ * 记录中的时间戳计数需要后端的CycleClock换算，这里改用输出时的时间，与后端停止时相差很小
+ */
+void output_buffer_directly(StagingBuffer *buffer) {
+    MutexLockGuard lock(g_consume_mutex);
+    buffer->consume([buffer](const char *record) {
+        LogRecordHeader header;
+        memcpy(&header, record, sizeof header);
+        const LogSite *site = nullptr;
+        {
+        MutexLockGuard sites_lock(g_sites_mutex);
+        site = g_sites[header.site_id];
+        }
+        LogStream stream;
+        format_record(*site, record, Timestamp::now().micro_seconds_since_epoch(), buffer->tid(), stream);
+        g_output(stream.buffer().data(), stream.buffer().length());
+    });
+}
+
+} // namespace
+
+int register_log_site(LogSite *site, const uint8_t *arg_types) {
+    MutexLockGuard lock(g_sites_mutex);
+    int id = site->id.load(std::memory_order_relaxed);
+    if (id >= 0) {
+        return id;
+    }
+    site->arg_types = arg_types;
+    id = static_cast<int>(g_sites.size());
+    g_sites.push_back(site);
+    site->id.store(id, std::memory_order_release);
+    return id;
+}
+
+char *reserve_record(size_t size) {
+    char *record = staging_buffer()->reserve(size);
+    if (unlikely(record == nullptr)) {
+        g_dropped_records.fetch_add(1, std::memory_order_relaxed);
+    }
+    return record;
+}
+
+/**
+ * @brief 提交之后再检查一次后端是否在运行
+ * 生产者可能在stop之前看到后端在运行，却在后端最后一次读取之后才提交；
+ * 栅栏与stop中的栅栏配对，要么stop之后的读空能看到这条记录，要么这里能看到后端已经停止
+ */
+void commit_record(size_t size) {
+    t_staging_buffer->commit(size);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (unlikely(!g_binary_logging_running.load(std::memory_order_relaxed))) {
+        output_buffer_directly(t_staging_buffer);
+    }
+}
+
+void output_record_directly(const LogSite &site, const char *record) {
+    current_thread::tid();
+    std::string tid(current_thread::tid_string(), current_thread::tid_string_length());
+    LogStream stream;
+    format_record(site, record, Timestamp::now().micro_seconds_since_epoch(), tid, stream);
+    const LogStream::Buffer &buf(stream.buffer());
+    g_output(buf.data(), buf.length());
+}
+
+} // namespace detail
+
+BinaryLogging::BinaryLogging(const std::string &basename,
+                             off_t roll_size,
+                             int flush_interval)
+    : basename_(basename),
+      roll_size_(roll_size),
+      flush_interval_(flush_interval),
+      running_(false),
+      thread_(std::bind(&BinaryLogging::thread_func, this), "BinaryLogging"),
+      latch_(1),
+      mutex_(),
+      cond_(mutex_) {
+}
+
+BinaryLogging::~BinaryLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void BinaryLogging::start() {
+    assert(!detail::g_binary_logging_running);
+    running_ = true;
+    {
+    MutexLockGuard lock(detail::g_buffers_mutex);
+    detail::g_backend_stopped = false;
+    }
+    thread_.start();
+    latch_.wait();
+    detail::g_binary_logging_running = true;
+}
+
+/**
+ * @brief 先让新的日志走直接输出，后端再读空所有缓冲后退出
+ * 停止之前就开始写的记录可能在后端最后一次读取之后才提交，后端退出后再把它们直接输出
+ */
+void BinaryLogging::stop() {
+    detail::g_binary_logging_running = false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+    MutexLockGuard lock(mutex_);
+    running_ = false;
+    cond_.notify();
+    }
+    thread_.join();
+
+    MutexLockGuard lock(detail::g_buffers_mutex);
+    detail::g_backend_stopped = true;
+    auto &all = detail::g_buffers;
+    for (auto it = all.begin(); it != all.end(); ) {
+        // 与后端一样，先读取退出标记再读空，已退出线程的缓冲读空之后释放
+        bool retired = (*it)->retired();
+        detail::output_buffer_directly(*it);
+        if (retired) {
+            delete *it;
+            it = all.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int64_t BinaryLogging::dropped_records() {
+    return detail::g_dropped_records.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 后端线程轮询所有线程的环形缓冲，生产者不做任何通知，空闲时每毫秒轮询一次
+ */
+void BinaryLogging::thread_func() {
+    using detail::StagingBuffer;
+    LogFile output(basename_, roll_size_, false, flush_interval_, 1);
+    detail::CycleClock clock;
+    latch_.count_down();
+
+    std::vector<const detail::LogSite *> sites;
+    std::vector<StagingBuffer *> buffers;
+    std::string text;
+    text.reserve(1024 * 1024);
+    LogStream stream;
+    int64_t reported_dropped = 0;
+    Timestamp last_flush = Timestamp::now();
+    while (true) {
+        bool running = running_;
+        {
+        MutexLockGuard lock(detail::g_buffers_mutex);
+        buffers = detail::g_buffers;
+        }
+        clock.recalibrate();
+
+        size_t consumed = 0;
+        for (StagingBuffer *buffer : buffers) {
+            // 先读取退出标记再读空，读空之后不会再有新记录
+            bool retired = buffer->retired();
+            {
+            MutexLockGuard lock(detail::g_consume_mutex);
+            consumed += buffer->consume([&](const char *record) {
+                detail::LogRecordHeader header;
+                memcpy(&header, record, sizeof header);
+                if (header.site_id >= sites.size()) {
+                    MutexLockGuard lock(detail::g_sites_mutex);
+                    sites = detail::g_sites;
+                }
+                stream.resetBuffer();
+                detail::format_record(*sites[header.site_id], record,
+                                      clock.to_micros(header.timestamp), buffer->tid(), stream);
+                text.append(stream.buffer().data(), stream.buffer().length());
+                if (text.size() >= 1024 * 1024) {
+                    output.append(text.data(), static_cast<int>(text.size()));
+                    text.clear();
+                }
+            });
+            }
+            if (retired && buffer->empty()) {
+                MutexLockGuard lock(detail::g_buffers_mutex);
+                auto &all = detail::g_buffers;
+                all.erase(std::remove(all.begin(), all.end(), buffer), all.end());
+                delete buffer;
+            }
+        }
+
+        int64_t dropped = dropped_records();
+        if (dropped != reported_dropped) {
+            char buf[256];
+            int n = snprintf(buf, sizeof buf, "Dropped %lld binary log records at %s\n",
+                             static_cast<long long>(dropped - reported_dropped),
+                             Timestamp::now().to_formatted_string().c_str());
+            text.append(buf, n);
+            reported_dropped = dropped;
+        }
+        if (!text.empty()) {
+            output.append(text.data(), static_cast<int>(text.size()));
+            text.clear();
+        }
+
+        Timestamp now = Timestamp::now();
+        if (time_difference(now, last_flush) >= flush_interval_) {
+            output.flush();
+            last_flush = now;
+        }
+        if (!running && consumed == 0) {
+            break;
+        }
+        if (consumed == 0) {
+            MutexLockGuard lock(mutex_);
+            if (running_) {
+                cond_.wait_for_seconds(0.001);
+            }
+        }
+    }
+    output.flush();
+}
+
+} // namespace web_server
@@ -0,0 +1,382 @@
+/**
+ * @brief 延迟格式化的二进制日志
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_BINARYLOGGING_H
+#define WEB_SERVER_BASE_BINARYLOGGING_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "base/Mutex.h"
+#include "base/Condition.h"
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "base/CurrentThread.h"
+#include "base/Logging.h"
+
+namespace web_server {
+
+namespace detail {
+
+/**
+ * @brief 参数类型，和参数值一起决定解码方式
+ */
+enum LogArgType : uint8_t {
+    k_arg_end = 0,
+    k_arg_int,
+    k_arg_uint,
+    k_arg_double,
+    k_arg_char,
+    k_arg_pointer,
+    k_arg_string,
+};
+
+// 单个字符串参数最多记录的字节数，超出部分截断
+const uint32_t k_max_string_arg = 2048;
+
+/**
+ * @brief 一条日志记录的头部，后面紧跟编码后的参数，整条记录按8字节对齐
+ */
+struct LogRecordHeader {
+    uint32_t site_id;
+    uint32_t size;
+    uint64_t timestamp;
+};
+
+/**
+ * @brief 调用点的静态信息，每个BLOG_*调用点一个
+ * 构造函数是constexpr，函数内的static对象是常量初始化的，没有初始化守卫；
+ * 第一次输出时把参数类型连同文件、行号、格式串一起注册，之后记录中只保存注册得到的id
+ */
+struct LogSite {
+    constexpr LogSite(const char *file, int line, Logger::LogLevel level, const char *format)
+        : file(file), line(line), level(level), format(format), arg_types(nullptr), id(-1) {}
+
+    const char *file;
+    int line;
+    Logger::LogLevel level;
+    const char *format;
+    const uint8_t *arg_types;
+    std::atomic<int> id;
+};
+
+int register_log_site(LogSite *site, const uint8_t *arg_types);
+
+template <typename T, typename Enable = void>
+struct LogArgTraits;
+
+template <typename T>
+struct LogArgTraits<T, typename std::enable_if<std::is_integral<T>::value &&
+                                               std::is_signed<T>::value &&
+                                               !std::is_same<T, char>::value>::type> {
+    static const uint8_t k_type = k_arg_int;
+    static size_t size(T) {
+        return sizeof(int64_t);
+    }
+    static void encode(char *&p, T v) {
+        int64_t value = v;
+        memcpy(p, &value, sizeof value);
+        p += sizeof value;
+    }
+};
+
+template <typename T>
+struct LogArgTraits<T, typename std::enable_if<std::is_integral<T>::value &&
+                                               std::is_unsigned<T>::value &&
+                                               !std::is_same<T, bool>::value>::type> {
+    static const uint8_t k_type = k_arg_uint;
+    static size_t size(T) {
+        return sizeof(uint64_t);
+    }
+    static void encode(char *&p, T v) {
+        uint64_t value = v;
+        memcpy(p, &value, sizeof value);
+        p += sizeof value;
+    }
+};
+
+template <>
+struct LogArgTraits<bool> {
+    static const uint8_t k_type = k_arg_int;
+    static size_t size(bool) {
+        return sizeof(int64_t);
+    }
+    static void encode(char *&p, bool v) {
+        int64_t value = v ? 1 : 0;
+        memcpy(p, &value, sizeof value);
+        p += sizeof value;
+    }
+};
+
+template <>
+struct LogArgTraits<char> {
+    static const uint8_t k_type = k_arg_char;
+    static size_t size(char) {
+        return 1;
+    }
+    static void encode(char *&p, char v) {
+        *p++ = v;
+    }
+};
+
+template <typename T>
+struct LogArgTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static const uint8_t k_type = k_arg_double;
+    static size_t size(T) {
+        return sizeof(double);
+    }
+    static void encode(char *&p, T v) {
+        double value = static_cast<double>(v);
+        memcpy(p, &value, sizeof value);
+        p += sizeof value;
+    }
+};
+
+/**
+ * @brief 字符串参数，编码为4字节长度加内容
+ */
+struct LogStringArg {
+    static const uint8_t k_type = k_arg_string;
+    static uint32_t length(const char *s, size_t len) {
+        (void)s;
+        return len > k_max_string_arg ? k_max_string_arg : static_cast<uint32_t>(len);
+    }
+    static void encode(char *&p, const char *s, uint32_t len) {
+        memcpy(p, &len, sizeof len);
+        p += sizeof len;
+        memcpy(p, s, len);
+        p += len;
+    }
+};
+
+template <>
+struct LogArgTraits<const char *> : LogStringArg {
+    static size_t size(const char *s) {
+        return sizeof(uint32_t) + length(s, s ? strlen(s) : 0);
+    }
+    static void encode(char *&p, const char *s) {
+        if (!s) {
+            s = "(null)";
+        }
+        LogStringArg::encode(p, s, length(s, strlen(s)));
+    }
+};
+
+template <>
+struct LogArgTraits<char *> : LogArgTraits<const char *> {};
+
+template <>
+struct LogArgTraits<std::string> : LogStringArg {
+    static size_t size(const std::string &s) {
+        return sizeof(uint32_t) + length(s.data(), s.size());
+    }
+    static void encode(char *&p, const std::string &s) {
+        LogStringArg::encode(p, s.data(), length(s.data(), s.size()));
+    }
+};
+
+template <typename T>
+struct LogArgTraits<T *, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type> {
+    static const uint8_t k_type = k_arg_pointer;
+    static size_t size(const T *) {
+        return sizeof(uint64_t);
+    }
+    static void encode(char *&p, const T *v) {
+        uint64_t value = reinterpret_cast<uintptr_t>(v);
+        memcpy(p, &value, sizeof value);
+        p += sizeof value;
+    }
+};
+
+template <typename T>
+using LogArgTraitsOf = LogArgTraits<typename std::decay<T>::type>;
+
+/**
+ * @brief 一组参数类型对应的类型表，以k_arg_end结尾，每种参数组合只有一份
+ */
+template <typename... Args>
+struct LogArgTypeList {
+    static const uint8_t types[sizeof...(Args) + 1];
+};
+
+template <typename... Args>
+const uint8_t LogArgTypeList<Args...>::types[sizeof...(Args) + 1] = {
+    LogArgTraitsOf<Args>::k_type..., k_arg_end};
+
+inline size_t encoded_size() {
+    return 0;
+}
+
+template <typename T, typename... Rest>
+size_t encoded_size(const T &v, const Rest &...rest) {
+    return LogArgTraitsOf<T>::size(v) + encoded_size(rest...);
+}
+
+inline void encode_args(char *&) {
+}
+
+template <typename T, typename... Rest>
+void encode_args(char *&p, const T &v, const Rest &...rest) {
+    LogArgTraitsOf<T>::encode(p, v);
+    encode_args(p, rest...);
+}
+
+inline size_t record_size(size_t args_size) {
+    return (sizeof(LogRecordHeader) + args_size + 7) & ~static_cast<size_t>(7);
+}
+
+inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+extern std::atomic<bool> g_binary_logging_running;
+
+/**
+ * @brief 在当前线程的环形缓冲中预留一条记录的空间，缓冲满时返回nullptr
+ */
+char *reserve_record(size_t size);
+void commit_record(size_t size);
+
+/**
+ * @brief 后端没有运行时，把记录直接解码成文本交给Logger的输出函数
+ */
+void output_record_directly(const LogSite &site, const char *record);
+
+template <typename... Args>
+void write_record(char *record, int id, size_t size, uint64_t timestamp, const Args &...args) {
+    LogRecordHeader header;
+    header.site_id = static_cast<uint32_t>(id);
+    header.size = static_cast<uint32_t>(size);
+    header.timestamp = timestamp;
+    memcpy(record, &header, sizeof header);
+    char *p = record + sizeof header;
+    encode_args(p, args...);
+}
+
+template <typename... Args>
+__attribute__((noinline)) void binary_log_directly(LogSite &site, int id, size_t size, const Args &...args) {
+    char stack_buffer[512];
+    std::unique_ptr<char[]> heap_buffer;
+    char *record = stack_buffer;
+    if (size > sizeof stack_buffer) {
+        heap_buffer.reset(new char[size]);
+        record = heap_buffer.get();
+    }
+    write_record(record, id, size, 0, args...);
+    output_record_directly(site, record);
+}
+
+template <typename... Args>
+void binary_log(LogSite &site, const Args &...args) {
+    int id = site.id.load(std::memory_order_acquire);
+    if (unlikely(id < 0)) {
+        id = register_log_site(&site, LogArgTypeList<Args...>::types);
+    }
+    size_t size = record_size(encoded_size(args...));
+    if (unlikely(!g_binary_logging_running.load(std::memory_order_relaxed))) {
+        binary_log_directly(site, id, size, args...);
+        return;
+    }
+    char *record = reserve_record(size);
+    if (record) {
+        write_record(record, id, size, read_cycles(), args...);
+        commit_record(size);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief 二进制日志后端
+ * BLOG_*在调用线程上只把调用点id、时间戳计数和原始参数拷贝进线程私有的单生产者单消费者环形缓冲，
+ * 格式串用{}作为占位符，格式化全部由后端线程完成后写入LogFile；
+ * 环形缓冲写满时丢弃记录并计数，不会阻塞调用线程；
+ * 不同线程的日志各自有序，线程之间不保证按时间交错
+ *
+ * 后端没有运行时，BLOG_*在调用线程上直接格式化并交给Logger的输出函数，与LOG_*行为一致
+ */
+class BinaryLogging : private Noncopyable {
+public:
+    /**
+     * @brief Construct a new Binary Logging object
+     * @param basename 日志文件名前缀，见LogFile
+     * @param roll_size 单个日志文件的滚动大小
+     * @param flush_interval 定期flush的间隔，单位秒
+     */
+    BinaryLogging(const std::string &basename,
+                  off_t roll_size,
+                  int flush_interval = 3);
+    ~BinaryLogging();
+
+    /**
+     * @brief 启动后端线程，同一时间只能有一个BinaryLogging在运行
+     */
+    void start();
+
+    /**
+     * @brief 停止前会把所有线程缓冲中的记录写完
+     */
+    void stop();
+
+    /**
+     * @brief 因环形缓冲写满被丢弃的记录数
+     * @return int64_t
+     */
+    static int64_t dropped_records();
+
+    /**
+     * @brief 每个线程环形缓冲的大小
+     */
+    static const size_t k_staging_buffer_size = 1 << 20;
+
+private:
+    const std::string basename_;
+    const off_t roll_size_;
+    const int flush_interval_;
+    std::atomic<bool> running_;
+    Thread thread_;
+    CountDownLatch latch_;
+    MutexLock mutex_;
+    Condition cond_;
+
+    void thread_func();
+};
+
+} // namespace web_server
+
+#define WEB_SERVER_BINARY_LOG(level, format, ...) \
+    do { \
+        if (WEB_SERVER_LOG_ENABLED(level)) { \
+            static web_server::detail::LogSite blog_site_( \
+                __FILE__, __LINE__, web_server::Logger::level, format); \
+            web_server::detail::binary_log(blog_site_, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define BLOG_TRACE(format, ...) WEB_SERVER_BINARY_LOG(TRACE, format, ##__VA_ARGS__)
+#define BLOG_DEBUG(format, ...) WEB_SERVER_BINARY_LOG(DEBUG, format, ##__VA_ARGS__)
+#define BLOG_INFO(format, ...) WEB_SERVER_BINARY_LOG(INFO, format, ##__VA_ARGS__)
+#define BLOG_WARN(format, ...) WEB_SERVER_BINARY_LOG(WARN, format, ##__VA_ARGS__)
+#define BLOG_ERROR(format, ...) WEB_SERVER_BINARY_LOG(ERROR, format, ##__VA_ARGS__)
+
+#endif // WEB_SERVER_BASE_BINARYLOGGING_H
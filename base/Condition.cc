@@ -0,0 +1,37 @@
+/**
+ * @brief 
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ * 
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/Condition.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+
+namespace web_server {
+
+/**
+ * @brief pthread_cond_timedwait使用的是绝对时间，需要在当前时间的基础上加上等待时长
+ * @param seconds 
+ * @return true 
+ * @return false 
+ */
+bool Condition::wait_for_seconds(double seconds) {
+    struct timespec abstime;
+    clock_gettime(CLOCK_REALTIME, &abstime);
+
+    const int64_t k_nano_seconds_per_second = 1000000000;
+    int64_t nanoseconds = static_cast<int64_t>(seconds * k_nano_seconds_per_second);
+
+    abstime.tv_sec += static_cast<time_t>((abstime.tv_nsec + nanoseconds) / k_nano_seconds_per_second);
+    abstime.tv_nsec = static_cast<long>((abstime.tv_nsec + nanoseconds) % k_nano_seconds_per_second);
+
+    MutexLock::UnassignGuard ug(mutex_);
+    return ETIMEDOUT == pthread_cond_timedwait(&pcond_, mutex_.get_pthread_mutex(), &abstime);
+}
+
+} // namespace web_server
@@ -50,7 +50,13 @@ public:
         pthread_cond_broadcast(&pcond_);
     }
 
-    // bool wait_for_seconds(double seconds);
+    /**
+     * @brief 带超时的等待
+     * @param seconds 
+     * @return true 超时返回
+     * @return false 被通知唤醒
+     */
+    bool wait_for_seconds(double seconds);
 private:
     MutexLock &mutex_;
     pthread_cond_t pcond_;
@@ -0,0 +1,199 @@
+/**
+ * @brief
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/LogFile.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include "base/Logging.h"
+
+namespace web_server {
+
+namespace detail {
+
+/**
+ * @brief 只追加写的文件，由调用方保证同一时间只有一个线程写入
+ */
+class AppendFile : private Noncopyable {
+public:
+    explicit AppendFile(const std::string &filename)
+        : fp_(::fopen(filename.c_str(), "ae")),
+          written_bytes_(0) {
+        if (!fp_) {
+            fprintf(stderr, "AppendFile: open %s failed: %s\n",
+                    filename.c_str(), strerror_tl(errno));
+            abort();
+        }
+        ::setbuffer(fp_, buffer_, sizeof buffer_);
+    }
+
+    ~AppendFile() {
+        ::fclose(fp_);
+    }
+
+    void append(const char *logline, size_t len) {
+        size_t written = 0;
+        while (written != len) {
+            size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+            if (n == 0) {
+                // ferror只表示流出错，具体原因在errno中，fprintf之前先保存
+                int saved_errno = errno;
+                if (ferror(fp_)) {
+                    fprintf(stderr, "AppendFile::append() failed %s\n", strerror_tl(saved_errno));
+                }
+                break;
+            }
+            written += n;
+        }
+        written_bytes_ += written;
+    }
+
+    void flush() {
+        ::fflush(fp_);
+    }
+
+    void sync() {
+        ::fflush(fp_);
+        ::fdatasync(::fileno(fp_));
+    }
+
+    off_t written_bytes() const {
+        return written_bytes_;
+    }
+
+private:
+    FILE *fp_;
+    char buffer_[256 * 1024];
+    off_t written_bytes_;
+};
+
+} // namespace detail
+
+LogFile::LogFile(const std::string &basename,
+                 off_t roll_size,
+                 bool thread_safe,
+                 int flush_interval,
+                 int check_every_n)
+    : basename_(basename),
+      roll_size_(roll_size),
+      flush_interval_(flush_interval),
+      check_every_n_(check_every_n),
+      count_(0),
+      mutex_(thread_safe ? new MutexLock : nullptr),
+      start_of_period_(0),
+      last_roll_(0),
+      last_flush_(0) {
+    roll_file_locked();
+}
+
+LogFile::~LogFile() = default;
+
+void LogFile::append(const char *logline, int len) {
+    if (mutex_) {
+        MutexLockGuard lock(*mutex_);
+        append_unlocked(logline, len);
+    } else {
+        append_unlocked(logline, len);
+    }
+}
+
+/**
+ * @brief 只把用户态缓冲写入内核，fdatasync由append中的定期检查完成
+ */
+void LogFile::flush() {
+    if (mutex_) {
+        MutexLockGuard lock(*mutex_);
+        file_->flush();
+    } else {
+        file_->flush();
+    }
+}
+
+std::string LogFile::filename() const {
+    if (mutex_) {
+        MutexLockGuard lock(*mutex_);
+        return filename_;
+    }
+    return filename_;
+}
+
+void LogFile::append_unlocked(const char *logline, int len) {
+    file_->append(logline, len);
+    if (file_->written_bytes() > roll_size_) {
+        roll_file_locked();
+        return;
+    }
+    if (++count_ < check_every_n_) {
+        return;
+    }
+    count_ = 0;
+    time_t now = ::time(nullptr);
+    time_t this_period = now / k_roll_per_seconds * k_roll_per_seconds;
+    if (this_period != start_of_period_) {
+        roll_file_locked();
+    } else if (now - last_flush_ >= flush_interval_) {
+        last_flush_ = now;
+        file_->sync();
+    }
+}
+
+bool LogFile::roll_file() {
+    if (mutex_) {
+        MutexLockGuard lock(*mutex_);
+        return roll_file_locked();
+    }
+    return roll_file_locked();
+}
+
+bool LogFile::roll_file_locked() {
+    time_t now = ::time(nullptr);
+    if (now <= last_roll_) {
+        return false;
+    }
+    std::string filename = get_log_filename(basename_, now);
+    last_roll_ = now;
+    last_flush_ = now;
+    start_of_period_ = now / k_roll_per_seconds * k_roll_per_seconds;
+    if (file_) {
+        file_->sync();
+    }
+    file_.reset(new detail::AppendFile(filename));
+    filename_ = filename;
+    return true;
+}
+
+std::string LogFile::get_log_filename(const std::string &basename, time_t now) {
+    std::string filename;
+    filename.reserve(basename.size() + 64);
+    filename = basename;
+
+    char timebuf[32];
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof hostname) == 0) {
+        hostname[sizeof hostname - 1] = '\0';
+        filename += hostname;
+    } else {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
+
+} // namespace web_server
@@ -0,0 +1,92 @@
+/**
+ * @brief 滚动日志文件
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_LOGFILE_H
+#define WEB_SERVER_BASE_LOGFILE_H
+
+#include <sys/types.h>
+#include <ctime>
+
+#include <memory>
+#include <string>
+
+#include "base/Noncopyable.h"
+#include "base/Mutex.h"
+
+namespace web_server {
+
+namespace detail {
+class AppendFile;
+} // namespace detail
+
+/**
+ * @brief 日志文件，按大小和按天滚动
+ * 写入使用fwrite_unlocked加一块较大的用户态缓冲，不会每行都flush；
+ * 每写入check_every_n行检查一次时间，距离上次flush超过flush_interval秒时fflush并fdatasync
+ *
+ * 文件名为basename.YYYYmmdd-HHMMSS.hostname.pid.log
+ * 同步使用时通过Logger::setOutput/setFlush接入，异步使用时由AsyncLogging的后端线程写入
+ */
+class LogFile : private Noncopyable {
+public:
+    /**
+     * @brief Construct a new Log File object
+     * @param basename 日志文件名前缀，可以带目录
+     * @param roll_size 单个文件写入超过该字节数时滚动
+     * @param thread_safe 多个线程同时写入时为true，只有一个写入线程（如异步后端）时为false
+     * @param flush_interval 定期flush和fdatasync的间隔，单位秒
+     * @param check_every_n 每写入多少次检查一次时间
+     */
+    LogFile(const std::string &basename,
+            off_t roll_size,
+            bool thread_safe = true,
+            int flush_interval = 3,
+            int check_every_n = 1024);
+    ~LogFile();
+
+    void append(const char *logline, int len);
+    void flush();
+
+    /**
+     * @brief 关闭当前文件并以当前时间新建一个文件
+     * @return true 创建了新文件
+     * @return false 同一秒内已经滚动过，文件名会重复，不滚动
+     */
+    bool roll_file();
+
+    /**
+     * @brief 当前文件名
+     * @return std::string
+     */
+    std::string filename() const;
+
+private:
+    static const int k_roll_per_seconds = 60 * 60 * 24;
+
+    const std::string basename_;
+    const off_t roll_size_;
+    const int flush_interval_;
+    const int check_every_n_;
+    int count_;
+
+    std::unique_ptr<MutexLock> mutex_;
+    time_t start_of_period_;    // 当前文件所属的那一天的0点
+    time_t last_roll_;
+    time_t last_flush_;
+    std::string filename_;
+    std::unique_ptr<detail::AppendFile> file_;
+
+    void append_unlocked(const char *logline, int len);
+    // 调用方已经持有mutex_，或者不需要加锁
+    bool roll_file_locked();
+    static std::string get_log_filename(const std::string &basename, time_t now);
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_LOGFILE_H
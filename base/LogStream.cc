@@ -8,46 +8,32 @@
 
 #include "base/LogStream.h"
 
-#include <algorithm>
 #include <cstdio>
 #include <limits>
+#include <type_traits>
 
-namespace web_server {
+#include "base/NumberFormat.h"
 
-namespace detail {
+namespace web_server {
 
-const char digits[] = "9876543210123456789";
-const char* zero = digits + 9;
 
-template <typename T>
-size_t convert(char buf[], T value) {
-    T i = value;
-    char* p = buf;
-
-    do {
-        int lsd = static_cast<int>(i % 10);
-        i /= 10;
-        *p++ = zero[lsd];
-    } while (i != 0);
-
-    if (value < 0) {
-        *p++ = '-';
-    }
-    *p = '\0';
-    std::reverse(buf, p);
+namespace {
 
-    return p - buf;
+inline size_t format_integer(char* buf, long long v) {
+    return number_format::format_int(buf, v);
 }
 
-// template class FixedBuffer<kSmallBuffer>;
-// template class FixedBuffer<kLargeBuffer>;
+inline size_t format_integer(char* buf, unsigned long long v) {
+    return number_format::format_uint(buf, v);
+}
 
-} // namespace detail
+} // namespace
 
 template <typename T>
 void LogStream::formatInteger(T v) {
     if (buffer_.avail() >= kMaxNumericSize) {
-        size_t len = detail::convert(buffer_.current(), v);
+        using Wide = typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type;
+        size_t len = format_integer(buffer_.current(), static_cast<Wide>(v));
         buffer_.add(len);
     }
 }
@@ -92,9 +78,17 @@ LogStream& LogStream::operator<<(unsigned long long v) {
     return *this;
 }
 
+LogStream& LogStream::operator<<(const void* p) {
+    if (buffer_.avail() >= kMaxNumericSize) {
+        size_t len = number_format::format_pointer(buffer_.current(), p);
+        buffer_.add(len);
+    }
+    return *this;
+}
+
 LogStream& LogStream::operator<<(double v) {
     if (buffer_.avail() >= kMaxNumericSize) {
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
+        size_t len = number_format::format_double(buffer_.current(), v);
         buffer_.add(len);
     }
     return *this;
@@ -109,6 +103,8 @@ LogStream& LogStream::operator<<(long double v) {
 }
 
 void LogStream::staticCheck() {
+    static_assert(kMaxNumericSize >= static_cast<int>(number_format::k_max_double_size),
+                    "kMaxNumericSize is large enough");
     static_assert(kMaxNumericSize - 10 > std::numeric_limits<double>::digits10,
                     "kMaxNumericSize is large enough");
     static_assert(kMaxNumericSize - 10 > std::numeric_limits<long double>::digits10,
@@ -70,6 +70,8 @@ public:
     LogStream& operator<<(long long);
     LogStream& operator<<(unsigned long long);
 
+    LogStream& operator<<(const void*);
+
     LogStream& operator<<(float v) {
         *this << static_cast<double>(v);
         return *this;
@@ -14,6 +14,7 @@
 #include <cassert>
 
 #include "base/CurrentThread.h"
+#include "base/NumberFormat.h"
 #include "base/Timestamp.h"
 
 namespace web_server {
@@ -72,6 +73,7 @@ Logger::FlushFunc g_flush = defaultFlush;
 Logger::Impl::Impl(LogLevel level, int old_errno, const SourceFile &file, int line) 
     : time_(Timestamp::now()),
       stream_(),
+      suppressed_(0),
       level_(level),
       line_(line),
       basename_(file) {
@@ -88,19 +90,26 @@ void Logger::Impl::format_time() {
     int64_t micro_seconds_since_epoch = time_.micro_seconds_since_epoch();
     time_t seconds = static_cast<time_t>(micro_seconds_since_epoch / Timestamp::k_micro_seconds_per_second);
     int micro_seconds = static_cast<int>(micro_seconds_since_epoch % Timestamp::k_micro_seconds_per_second);
+    // 只缓存到秒，微秒部分每条日志都要重新写
     if (seconds != t_lastSecond) {
         t_lastSecond = seconds;
         struct tm tm_time;
         ::gmtime_r(&seconds, &tm_time);
-        int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d.%06d",
-            tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-            tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, micro_seconds);
-        assert(len == 24);
+        number_format::format_date_time(t_time, tm_time);
+        t_time[number_format::k_date_time_size] = '\0';
     }
-    stream_ << T(t_time, 24) << " ";
+    char micro[8];
+    micro[0] = '.';
+    number_format::format_fixed_width(micro + 1, static_cast<uint32_t>(micro_seconds), 6);
+    micro[7] = ' ';
+    stream_ << T(t_time, number_format::k_date_time_size);
+    stream_.append(micro, sizeof micro);
 }
 
 void Logger::Impl::finish() {
+    if (suppressed_ > 0) {
+        stream_ << " [" << suppressed_ << " similar messages suppressed]";
+    }
     stream_ << " - " << basename_ << ':' << line_ << '\n';
 }
 
@@ -9,6 +9,8 @@
 #ifndef WEB_SERVER_BASE_LOGGING_H
 #define WEB_SERVER_BASE_LOGGING_H
 
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 
 #include "base/Timestamp.h"
@@ -48,6 +50,13 @@ public:
         impl_.stream_ << func << ' ';
     };
     Logger(SourceFile file, int line, bool toAbort) : impl_(toAbort?FATAL:ERROR, errno, file, line) {};
+    /**
+     * @brief 限频日志使用，suppressed为上一次输出之后被跳过的次数，会附加在消息末尾
+     */
+    Logger(SourceFile file, int line, LogLevel level, int saved_errno, int64_t suppressed)
+        : impl_(level, saved_errno, file, line) {
+        impl_.suppressed_ = suppressed;
+    };
     ~Logger();
 
     LogStream &stream() {
@@ -72,6 +81,7 @@ private:
 
         Timestamp time_;
         LogStream stream_;
+        int64_t suppressed_;
         LogLevel level_;
         int line_;
         SourceFile basename_;
@@ -85,18 +95,130 @@ inline Logger::LogLevel Logger::log_level() {
     return g_logLevel;
 }
 
-#define LOG_TRACE if (web_server::Logger::log_level() <= web_server::Logger::TRACE) \
+/**
+ * 编译期最低日志级别，数值与Logger::LogLevel一致（0为TRACE，5为FATAL），由CMake设置；
+ * 低于该级别的日志语句条件恒为假，整条语句连同参数求值在编译期被去掉
+ */
+#ifndef WEB_SERVER_MIN_LOG_LEVEL
+#define WEB_SERVER_MIN_LOG_LEVEL 0
+#endif
+
+/**
+ * 运行期只有一次全局变量读取和一次比较，分支提示为不输出，日志代码被放到冷路径上
+ */
+#define WEB_SERVER_LOG_ENABLED(level) \
+    (WEB_SERVER_MIN_LOG_LEVEL <= web_server::Logger::level && \
+     __builtin_expect(web_server::Logger::log_level() <= web_server::Logger::level, 0))
+
+#define LOG_TRACE if (WEB_SERVER_LOG_ENABLED(TRACE)) \
     web_server::Logger(__FILE__, __LINE__, web_server::Logger::TRACE, __func__).stream()
-#define LOG_DEBUG if (web_server::Logger::log_level() <= web_server::Logger::DEBUG) \
+#define LOG_DEBUG if (WEB_SERVER_LOG_ENABLED(DEBUG)) \
     web_server::Logger(__FILE__, __LINE__, web_server::Logger::DEBUG, __func__).stream()
-#define LOG_INFO if (web_server::Logger::log_level() <= web_server::Logger::INFO) \
+#define LOG_INFO if (WEB_SERVER_LOG_ENABLED(INFO)) \
     web_server::Logger(__FILE__, __LINE__).stream()
-#define LOG_WARN web_server::Logger(__FILE__, __LINE__, web_server::Logger::WARN).stream()
-#define LOG_ERROR web_server::Logger(__FILE__, __LINE__, web_server::Logger::ERROR).stream()
+#define LOG_WARN if (WEB_SERVER_LOG_ENABLED(WARN)) \
+    web_server::Logger(__FILE__, __LINE__, web_server::Logger::WARN).stream()
+#define LOG_ERROR if (WEB_SERVER_LOG_ENABLED(ERROR)) \
+    web_server::Logger(__FILE__, __LINE__, web_server::Logger::ERROR).stream()
 #define LOG_FATAL web_server::Logger(__FILE__, __LINE__, web_server::Logger::FATAL).stream()
-#define LOG_SYSERR web_server::Logger(__FILE__, __LINE__, false).stream()
+#define LOG_SYSERR if (WEB_SERVER_LOG_ENABLED(ERROR)) \
+    web_server::Logger(__FILE__, __LINE__, false).stream()
 #define LOG_SYSFATAL web_server::Logger(__FILE__, __LINE__, true).stream()
 
+namespace detail {
+
+/**
+ * @brief 限频日志的判定结果，suppressed为上一次输出之后被跳过的次数
+ */
+struct LogRateDecision {
+    bool log;
+    int64_t suppressed;
+
+    explicit operator bool() const {
+        return log;
+    }
+};
+
+/**
+ * @brief 每个限频日志调用点一份的状态，只使用原子操作，多个线程同时调用也不加锁
+ */
+class LogRateState {
+public:
+    LogRateState() : count_(0), suppressed_(0), next_time_(0) {}
+
+    /**
+     * @brief 第1、n+1、2n+1...次调用时输出，n不大于0时按1处理，每次都输出
+     */
+    LogRateDecision every_n(int64_t n) {
+        if (n <= 1) {
+            return LogRateDecision{true, 0};
+        }
+        int64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (count % n != 0) {
+            return LogRateDecision{false, 0};
+        }
+        return LogRateDecision{true, count == 0 ? 0 : n - 1};
+    }
+
+    /**
+     * @brief 只有前n次调用输出
+     */
+    LogRateDecision first_n(int64_t n) {
+        if (count_.load(std::memory_order_relaxed) >= n) {
+            return LogRateDecision{false, 0};
+        }
+        return LogRateDecision{count_.fetch_add(1, std::memory_order_relaxed) < n, 0};
+    }
+
+    /**
+     * @brief 每seconds秒最多输出一次，多个线程同时到期时只有一个线程输出
+     */
+    LogRateDecision every_t(double seconds) {
+        int64_t now = Timestamp::now().micro_seconds_since_epoch();
+        int64_t next = next_time_.load(std::memory_order_relaxed);
+        if (now < next || !next_time_.compare_exchange_strong(
+                next, now + static_cast<int64_t>(seconds * Timestamp::k_micro_seconds_per_second),
+                std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return LogRateDecision{false, 0};
+        }
+        return LogRateDecision{true, suppressed_.exchange(0, std::memory_order_relaxed)};
+    }
+
+private:
+    std::atomic<int64_t> count_;
+    std::atomic<int64_t> suppressed_;
+    std::atomic<int64_t> next_time_;
+};
+
+} // namespace detail
+
+/**
+ * 每个调用点的状态放在一个立即调用的lambda里的static变量中。
+ * 宏展开为最多执行一次的for语句而不是嵌套的if，后面的else不会被宏吞掉，可以放在不带花括号的if/else里
+ */
+#define WEB_SERVER_LOG_RATE_STATE() \
+    ([]() -> web_server::detail::LogRateState & { \
+        static web_server::detail::LogRateState state; \
+        return state; \
+    }())
+
+#define WEB_SERVER_LOG_RATE_LIMITED(level, saved_errno, decide) \
+    for (web_server::detail::LogRateDecision web_server_log_decision_ = WEB_SERVER_LOG_ENABLED(level) ? \
+             WEB_SERVER_LOG_RATE_STATE().decide : web_server::detail::LogRateDecision{false, 0}; \
+         web_server_log_decision_.log; web_server_log_decision_.log = false) \
+        web_server::Logger(__FILE__, __LINE__, web_server::Logger::level, saved_errno, \
+                           web_server_log_decision_.suppressed).stream()
+
+/**
+ * 限频日志：LOG_EVERY_N每n次输出一次，LOG_FIRST_N只输出前n次，LOG_EVERY_T每seconds秒最多输出一次；
+ * 被跳过的次数附加在下一条输出的末尾
+ */
+#define LOG_EVERY_N(level, n) WEB_SERVER_LOG_RATE_LIMITED(level, 0, every_n(n))
+#define LOG_FIRST_N(level, n) WEB_SERVER_LOG_RATE_LIMITED(level, 0, first_n(n))
+#define LOG_EVERY_T(level, seconds) WEB_SERVER_LOG_RATE_LIMITED(level, 0, every_t(seconds))
+#define LOG_SYSERR_EVERY_T(seconds) WEB_SERVER_LOG_RATE_LIMITED(ERROR, errno, every_t(seconds))
+
 const char* strerror_tl(int saved_errno);
 
 #define CHECK_NOTNULL(val) \
@@ -0,0 +1,434 @@
+/**
+ * @brief 整数、十六进制和double的格式化，double使用Grisu2算法
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/NumberFormat.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace web_server {
+
+namespace number_format {
+
+namespace detail {
+
+const char k_digit_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+} // namespace detail
+
+namespace {
+
+const char k_hex_digits[] = "0123456789ABCDEF";
+
+/**
+ * @brief 以64位有效数字和二进制指数表示的浮点数 f * 2^e
+ */
+struct DiyFp {
+    static const int k_significand_size = 52;
+    static const int k_exponent_bias = 0x3FF + k_significand_size;
+    static const int k_min_exponent = -k_exponent_bias;
+    static const uint64_t k_exponent_mask = 0x7FF0000000000000ULL;
+    static const uint64_t k_significand_mask = 0x000FFFFFFFFFFFFFULL;
+    static const uint64_t k_hidden_bit = 0x0010000000000000ULL;
+
+    DiyFp() : f(0), e(0) {}
+    DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+    explicit DiyFp(double d) {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof bits);
+        int biased_e = static_cast<int>((bits & k_exponent_mask) >> k_significand_size);
+        uint64_t significand = bits & k_significand_mask;
+        if (biased_e != 0) {
+            f = significand + k_hidden_bit;
+            e = biased_e - k_exponent_bias;
+        } else {
+            f = significand;
+            e = k_min_exponent + 1;
+        }
+    }
+
+    DiyFp operator-(const DiyFp &rhs) const {
+        return DiyFp(f - rhs.f, e);
+    }
+
+    /**
+     * @brief 取128位乘积的高64位，按最高被舍弃位四舍五入
+     */
+    DiyFp operator*(const DiyFp &rhs) const {
+        unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+        uint64_t h = static_cast<uint64_t>(p >> 64);
+        uint64_t l = static_cast<uint64_t>(p);
+        if (l & (uint64_t(1) << 63)) {
+            ++h;
+        }
+        return DiyFp(h, e + rhs.e + 64);
+    }
+
+    DiyFp normalize() const {
+        int s = __builtin_clzll(f);
+        return DiyFp(f << s, e - s);
+    }
+
+    DiyFp normalize_boundary() const {
+        DiyFp res = *this;
+        while (!(res.f & (k_hidden_bit << 1))) {
+            res.f <<= 1;
+            res.e--;
+        }
+        res.f <<= (64 - k_significand_size - 2);
+        res.e = res.e - (64 - k_significand_size - 2);
+        return res;
+    }
+
+    /**
+     * @brief 与相邻两个double的中点，落在这个区间内的十进制数读回都是同一个double
+     */
+    void normalized_boundaries(DiyFp *minus, DiyFp *plus) const {
+        DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalize_boundary();
+        DiyFp mi = (f == k_hidden_bit) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+        mi.f <<= mi.e - pl.e;
+        mi.e = pl.e;
+        *plus = pl;
+        *minus = mi;
+    }
+
+    uint64_t f;
+    int e;
+};
+
+/**
+ * @brief 10^k的64位规格化近似值（就近舍入），k = -348 + 8 * i
+ */
+const uint64_t k_cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL,
+    0xbaaee17fa23ebf76ULL,
+    0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL,
+    0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL,
+    0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL,
+    0xd3515c2831559a83ULL,
+    0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL,
+    0xaecc49914078536dULL,
+    0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL,
+    0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL,
+    0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL,
+    0xc5dd44271ad3cdbaULL,
+    0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL,
+    0xa3ab66580d5fdaf6ULL,
+    0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL,
+    0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL,
+    0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL,
+    0xb94470938fa89bcfULL,
+    0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL,
+    0x993fe2c6d07b7facULL,
+    0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL,
+    0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL,
+    0xd1b71758e219652cULL,
+    0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL,
+    0xad78ebc5ac620000ULL,
+    0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL,
+    0x8f7e32ce7bea5c70ULL,
+    0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL,
+    0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL,
+    0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL,
+    0xa26da3999aef774aULL,
+    0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL,
+    0x865b86925b9bc5c2ULL,
+    0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL,
+    0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL,
+    0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL,
+    0x98165af37b2153dfULL,
+    0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL,
+    0xfb9b7cd9a4a7443cULL,
+    0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL,
+    0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL,
+    0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL,
+    0x8e679c2f5e44ff8fULL,
+    0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL,
+    0xeb96bf6ebadf77d9ULL,
+    0xaf87023b9bf0ee6bULL
+};
+
+const int16_t k_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+DiyFp get_cached_power(int e, int *K) {
+    // 选取使乘积的二进制指数落在[-60, -32]之间的10的幂
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = static_cast<int>(dk);
+    if (dk - k > 0.0) {
+        k++;
+    }
+    unsigned index = static_cast<unsigned>((k >> 3) + 1);
+    *K = -(-348 + static_cast<int>(index * 8));
+    return DiyFp(k_cached_powers_f[index], k_cached_powers_e[index]);
+}
+
+const uint64_t k_pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+void grisu_round(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+int count_decimal_digit32(uint32_t n) {
+    if (n < 10) return 1;
+    if (n < 100) return 2;
+    if (n < 1000) return 3;
+    if (n < 10000) return 4;
+    if (n < 100000) return 5;
+    if (n < 1000000) return 6;
+    if (n < 10000000) return 7;
+    if (n < 100000000) return 8;
+    if (n < 1000000000) return 9;
+    return 10;
+}
+
+void digit_gen(const DiyFp &W, const DiyFp &Mp, uint64_t delta, char *buffer, int *len, int *K) {
+    const DiyFp one(uint64_t(1) << -Mp.e, Mp.e);
+    const DiyFp wp_w = Mp - W;
+    uint32_t p1 = static_cast<uint32_t>(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = count_decimal_digit32(p1);
+    *len = 0;
+
+    // 整数部分
+    while (kappa > 0) {
+        uint32_t div = static_cast<uint32_t>(k_pow10[kappa - 1]);
+        uint32_t d = p1 / div;
+        p1 %= div;
+        if (d || *len) {
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        }
+        kappa--;
+        uint64_t tmp = (static_cast<uint64_t>(p1) << -one.e) + p2;
+        if (tmp <= delta) {
+            *K += kappa;
+            grisu_round(buffer, *len, delta, tmp, k_pow10[kappa] << -one.e, wp_w.f);
+            return;
+        }
+    }
+
+    // 小数部分
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = static_cast<char>(p2 >> -one.e);
+        if (d || *len) {
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            int index = -kappa;
+            grisu_round(buffer, *len, delta, p2, one.f, wp_w.f * (index < 20 ? k_pow10[index] : 0));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 得到能往返的十进制数字串，value = buffer * 10^K，不保证最短
+ */
+void grisu2(double value, char *buffer, int *length, int *K) {
+    const DiyFp v(value);
+    DiyFp w_m, w_p;
+    v.normalized_boundaries(&w_m, &w_p);
+
+    const DiyFp c_mk = get_cached_power(w_p.e, K);
+    const DiyFp W = v.normalize() * c_mk;
+    DiyFp Wp = w_p * c_mk;
+    DiyFp Wm = w_m * c_mk;
+    Wm.f++;
+    Wp.f--;
+    digit_gen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+size_t write_exponent(char *buf, int k) {
+    char *p = buf;
+    if (k < 0) {
+        *p++ = '-';
+        k = -k;
+    } else {
+        *p++ = '+';
+    }
+    return (p - buf) + format_uint(p, static_cast<uint64_t>(k));
+}
+
+/**
+ * @brief 把数字串digits[0, length)和指数k排版成最终形式
+ */
+size_t prettify(char *buf, const char *digits, int length, int k) {
+    // 数值为0.digits * 10^kk
+    const int kk = length + k;
+    if (0 <= k && kk <= 21) {
+        // 整数，如1234e7 -> 12340000000
+        memcpy(buf, digits, length);
+        memset(buf + length, '0', k);
+        return kk;
+    }
+    if (0 < kk && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memcpy(buf, digits, kk);
+        buf[kk] = '.';
+        memcpy(buf + kk + 1, digits + kk, length - kk);
+        return length + 1;
+    }
+    if (-6 < kk && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        const int offset = 2 - kk;
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', offset - 2);
+        memcpy(buf + offset, digits, length);
+        return length + offset;
+    }
+    // 科学计数法，1e30、1.234e-30
+    char *p = buf;
+    *p++ = digits[0];
+    if (length > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, length - 1);
+        p += length - 1;
+    }
+    *p++ = 'e';
+    p += write_exponent(p, kk - 1);
+    return p - buf;
+}
+
+} // namespace
+
+size_t format_hex(char *buf, uint64_t value) {
+    int digits = 1;
+    for (uint64_t v = value >> 4; v != 0; v >>= 4) {
+        ++digits;
+    }
+    char *p = buf + digits;
+    do {
+        *--p = k_hex_digits[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+    return static_cast<size_t>(digits);
+}
+
+size_t format_pointer(char *buf, const void *pointer) {
+    buf[0] = '0';
+    buf[1] = 'x';
+    return format_hex(buf + 2, reinterpret_cast<uintptr_t>(pointer)) + 2;
+}
+
+size_t format_double(char *buf, double value) {
+    if (std::isnan(value)) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    char *p = buf;
+    if (std::signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (std::isinf(value)) {
+        memcpy(p, "inf", 3);
+        return p - buf + 3;
+    }
+    if (value == 0) {
+        *p = '0';
+        return p - buf + 1;
+    }
+    char digits[24];
+    int length = 0;
+    int k = 0;
+    grisu2(value, digits, &length, &k);
+    assert(length > 0 && length <= 17);
+    return p - buf + prettify(p, digits, length, k);
+}
+
+void format_date_time(char *buf, const struct tm &tm_time) {
+    format_fixed_width(buf, tm_time.tm_year + 1900, 4);
+    format_fixed_width(buf + 4, tm_time.tm_mon + 1, 2);
+    format_fixed_width(buf + 6, tm_time.tm_mday, 2);
+    buf[8] = ' ';
+    format_fixed_width(buf + 9, tm_time.tm_hour, 2);
+    buf[11] = ':';
+    format_fixed_width(buf + 12, tm_time.tm_min, 2);
+    buf[14] = ':';
+    format_fixed_width(buf + 15, tm_time.tm_sec, 2);
+}
+
+} // namespace number_format
+
+} // namespace web_server
@@ -0,0 +1,128 @@
+/**
+ * @brief 数字格式化
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_NUMBERFORMAT_H
+#define WEB_SERVER_BASE_NUMBERFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace web_server {
+
+/**
+ * @brief LogStream、Timestamp和http序列化共用的数字格式化
+ * 所有函数都直接写入调用方提供的缓冲，不分配内存，不写结尾的'\0'，返回写入的字节数；
+ * 调用方需保证缓冲至少有对应k_max_*_size字节
+ */
+namespace number_format {
+
+const size_t k_max_int_size = 20;       // 包括负号
+const size_t k_max_hex_size = 16;
+const size_t k_max_pointer_size = 18;   // 包括0x
+const size_t k_max_double_size = 32;
+
+namespace detail {
+
+extern const char k_digit_pairs[200];
+
+inline int count_digits(uint64_t value) {
+    int digits = 1;
+    for (;;) {
+        if (value < 10) return digits;
+        if (value < 100) return digits + 1;
+        if (value < 1000) return digits + 2;
+        if (value < 10000) return digits + 3;
+        value /= 10000;
+        digits += 4;
+    }
+}
+
+/**
+ * @brief 从end向前写入value的十进制表示，每次处理两位
+ */
+inline void write_digits_backward(char *end, uint64_t value) {
+    while (value >= 100) {
+        unsigned index = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        end -= 2;
+        memcpy(end, k_digit_pairs + index, 2);
+    }
+    if (value >= 10) {
+        end -= 2;
+        memcpy(end, k_digit_pairs + value * 2, 2);
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+}
+
+} // namespace detail
+
+inline size_t format_uint(char *buf, uint64_t value) {
+    int digits = detail::count_digits(value);
+    detail::write_digits_backward(buf + digits, value);
+    return static_cast<size_t>(digits);
+}
+
+inline size_t format_int(char *buf, int64_t value) {
+    if (value < 0) {
+        *buf = '-';
+        // 先转为无符号再取负，INT64_MIN也不会溢出
+        return format_uint(buf + 1, 0 - static_cast<uint64_t>(value)) + 1;
+    }
+    return format_uint(buf, static_cast<uint64_t>(value));
+}
+
+/**
+ * @brief 定宽十进制，不足width位时前面补0，超出部分截掉高位
+ * @param buf
+ * @param value
+ * @param width
+ */
+inline void format_fixed_width(char *buf, uint32_t value, int width) {
+    char *p = buf + width;
+    while (p - buf >= 2) {
+        p -= 2;
+        memcpy(p, detail::k_digit_pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if (p != buf) {
+        *buf = static_cast<char>('0' + value % 10);
+    }
+}
+
+/**
+ * @brief 大写十六进制，不带前缀
+ */
+size_t format_hex(char *buf, uint64_t value);
+
+/**
+ * @brief 指针，格式为0x加大写十六进制
+ */
+size_t format_pointer(char *buf, const void *pointer);
+
+/**
+ * @brief 可往返的double格式化（Grisu2）
+ * 输出的数字串用strtod读回得到同一个double，通常是最短的，少数值会多出一位数字；
+ * 十进制指数在[-6, 21)内时使用普通小数形式，整数不带小数点，否则使用科学计数法，如1e+21、5e-324
+ * @return size_t 写入的字节数，不超过k_max_double_size
+ */
+size_t format_double(char *buf, double value);
+
+/**
+ * @brief 格式为YYYYmmdd HH:MM:SS，固定17字节
+ */
+const size_t k_date_time_size = 17;
+void format_date_time(char *buf, const struct tm &tm_time);
+
+} // namespace number_format
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_NUMBERFORMAT_H
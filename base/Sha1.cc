@@ -0,0 +1,118 @@
+/**
+ * @brief SHA-1摘要（RFC 3174）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/Sha1.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace web_server {
+
+namespace {
+
+inline uint32_t rotate_left(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+} // namespace
+
+Sha1::Sha1() : total_bytes_(0), block_size_(0) {
+    state_[0] = 0x67452301;
+    state_[1] = 0xefcdab89;
+    state_[2] = 0x98badcfe;
+    state_[3] = 0x10325476;
+    state_[4] = 0xc3d2e1f0;
+}
+
+void Sha1::update(const void *data, size_t len) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    total_bytes_ += len;
+    if (block_size_ > 0) {
+        size_t n = std::min(len, sizeof block_ - block_size_);
+        memcpy(block_ + block_size_, p, n);
+        block_size_ += n;
+        p += n;
+        len -= n;
+        if (block_size_ < sizeof block_) {
+            return;
+        }
+        process_block(block_);
+        block_size_ = 0;
+    }
+    for (; len >= sizeof block_; p += sizeof block_, len -= sizeof block_) {
+        process_block(p);
+    }
+    memcpy(block_, p, len);
+    block_size_ = len;
+}
+
+void Sha1::final(unsigned char *digest) {
+    uint64_t total_bits = total_bytes_ * 8;
+    // 填充一个0x80，再补0直到长度模64余56，最后是大端的总位数
+    unsigned char padding[72] = {0x80};
+    size_t pad = (block_size_ < 56 ? 56 : 120) - block_size_;
+    for (int i = 0; i < 8; ++i) {
+        padding[pad + i] = static_cast<unsigned char>(total_bits >> (56 - 8 * i));
+    }
+    update(padding, pad + 8);
+    for (int i = 0; i < 5; ++i) {
+        digest[4 * i] = static_cast<unsigned char>(state_[i] >> 24);
+        digest[4 * i + 1] = static_cast<unsigned char>(state_[i] >> 16);
+        digest[4 * i + 2] = static_cast<unsigned char>(state_[i] >> 8);
+        digest[4 * i + 3] = static_cast<unsigned char>(state_[i]);
+    }
+}
+
+std::string Sha1::digest(const void *data, size_t len) {
+    Sha1 sha1;
+    sha1.update(data, len);
+    unsigned char digest[k_digest_size];
+    sha1.final(digest);
+    return std::string(reinterpret_cast<const char *>(digest), sizeof digest);
+}
+
+void Sha1::process_block(const unsigned char *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+               (static_cast<uint32_t>(block[4 * i + 2]) << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; ++i) {
+        w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3], e = state_[4];
+    for (int i = 0; i < 80; ++i) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotate_left(b, 30);
+        b = a;
+        a = temp;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+}
+
+} // namespace web_server
@@ -0,0 +1,52 @@
+/**
+ * @brief SHA-1摘要（RFC 3174）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_SHA1_H
+#define WEB_SERVER_BASE_SHA1_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+/**
+ * @brief 增量计算SHA-1，只用于WebSocket握手这类协议要求的场合，不要用于安全相关的用途
+ */
+class Sha1 : private Noncopyable {
+public:
+    static const size_t k_digest_size = 20;
+
+    Sha1();
+
+    void update(const void *data, size_t len);
+
+    /**
+     * @brief 结束计算，写出20字节的摘要，之后不能再调用update
+     */
+    void final(unsigned char *digest);
+
+    /**
+     * @brief 一次计算data的摘要，返回20字节的二进制串
+     */
+    static std::string digest(const void *data, size_t len);
+
+private:
+    void process_block(const unsigned char *block);
+
+    uint32_t state_[5];
+    uint64_t total_bytes_;
+    unsigned char block_[64];
+    size_t block_size_;
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_SHA1_H
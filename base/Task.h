@@ -0,0 +1,92 @@
+/**
+ * @brief 仅可移动的任务封装，用于替代std::function在线程池中传递任务
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_TASK_H
+#define WEB_SERVER_BASE_TASK_H
+
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+namespace web_server {
+
+namespace detail {
+
+/**
+ * @brief 类型擦除的基类，任务对象本身只在堆上分配一次
+ */
+class TaskImplBase {
+public:
+    virtual ~TaskImplBase() {}
+    virtual void call() = 0;
+};
+
+template <typename F>
+class TaskImpl : public TaskImplBase {
+public:
+    explicit TaskImpl(F &&f) : f_(std::move(f)) {}
+    explicit TaskImpl(const F &f) : f_(f) {}
+    void call() override {
+        f_();
+    }
+private:
+    F f_;
+};
+
+} // namespace detail
+
+/**
+ * @brief 仅可移动的可调用对象
+ * 与std::function不同，不要求被封装对象可拷贝，也不会在传递过程中产生拷贝
+ * 可通过release/Task(TaskImplBase *)在无锁队列中以裸指针形式传递
+ */
+class Task {
+public:
+    Task() {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+        : impl_(new detail::TaskImpl<typename std::decay<F>::type>(std::forward<F>(f))) {}
+
+    explicit Task(detail::TaskImplBase *impl) : impl_(impl) {}
+
+    Task(Task &&other) noexcept : impl_(std::move(other.impl_)) {}
+
+    Task &operator=(Task &&other) noexcept {
+        impl_ = std::move(other.impl_);
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    explicit operator bool() const {
+        return impl_ != nullptr;
+    }
+
+    void operator()() {
+        impl_->call();
+    }
+
+    /**
+     * @brief 交出内部对象的所有权，调用者负责delete
+     * @return detail::TaskImplBase*
+     */
+    detail::TaskImplBase *release() {
+        return impl_.release();
+    }
+
+private:
+    std::unique_ptr<detail::TaskImplBase> impl_;
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_TASK_H
@@ -9,33 +9,36 @@
 #include "base/Timestamp.h"
 
 #include <sys/time.h>
-#include <cstdio>
 #include <string>
 
+#include "base/NumberFormat.h"
+
 namespace web_server {
 
 std::string Timestamp::to_string() const {
+    char buffer[number_format::k_max_int_size + 8];
     int64_t seconds = micro_seconds_since_epoch_ / k_micro_seconds_per_second;
     int64_t microseconds = micro_seconds_since_epoch_ % k_micro_seconds_per_second;
-    return std::to_string(seconds) + "." + std::to_string(microseconds);
+    size_t len = number_format::format_int(buffer, seconds);
+    buffer[len++] = '.';
+    number_format::format_fixed_width(buffer + len, static_cast<uint32_t>(microseconds), 6);
+    return std::string(buffer, len + 6);
 }
 
 std::string Timestamp::to_formatted_string(bool show_micro_seconds) const {
-    char buffer[64] = {0};
+    char buffer[number_format::k_date_time_size + 7];
     time_t seconds = static_cast<time_t>(micro_seconds_since_epoch_ / k_micro_seconds_per_second);
     struct tm tm_time;
     gmtime_r(&seconds, &tm_time);
+    number_format::format_date_time(buffer, tm_time);
+    size_t len = number_format::k_date_time_size;
     if (show_micro_seconds) {
-        int microseconds = static_cast<int>(micro_seconds_since_epoch_ / k_micro_seconds_per_second);
-        snprintf(buffer, sizeof(buffer), "%4d%02d%02d %02d:%02d:%02d.%06d",
-                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, microseconds);
-    } else {
-        snprintf(buffer, sizeof(buffer), "%4d%02d%02d %02d:%02d:%02d",
-                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+        int microseconds = static_cast<int>(micro_seconds_since_epoch_ % k_micro_seconds_per_second);
+        buffer[len++] = '.';
+        number_format::format_fixed_width(buffer + len, static_cast<uint32_t>(microseconds), 6);
+        len += 6;
     }
-    return buffer;
+    return std::string(buffer, len);
 }
 
 Timestamp Timestamp::now() {
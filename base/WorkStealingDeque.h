@@ -0,0 +1,181 @@
+/**
+ * @brief Chase-Lev工作窃取双端队列
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_WORKSTEALINGDEQUE_H
+#define WEB_SERVER_BASE_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+/**
+ * @brief 只有拥有者线程可以在底部push/pop，其他线程只能从顶部steal
+ * 参考Lê等人在C11内存模型下的实现（PPoPP'13），元素为裸指针，空时返回nullptr
+ * 扩容只由拥有者线程完成，旧数组保留到队列析构，避免窃取者访问已释放内存
+ */
+template <typename T>
+class WorkStealingDeque : private Noncopyable {
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024)
+        : top_(0),
+          bottom_(0),
+          array_(new Array(round_up(capacity))) {
+    }
+
+    ~WorkStealingDeque() {
+        delete array_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 仅拥有者线程调用
+     * @param item
+     */
+    void push(T *item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity() - 1) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 仅拥有者线程调用，从底部取出（LIFO，缓存友好）
+     * @return T* 队列为空时返回nullptr
+     */
+    T *pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        T *item = nullptr;
+        if (t <= b) {
+            item = a->get(b);
+            if (t == b) {
+                // 只剩最后一个元素，需要和窃取者竞争
+                if (!top_.compare_exchange_strong(t, t + 1,
+                                                  std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /**
+     * @brief 任意线程调用，从顶部窃取（FIFO）
+     * @return T* 队列为空或竞争失败时返回nullptr
+     */
+    T *steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        T *item = nullptr;
+        if (t < b) {
+            Array *a = array_.load(std::memory_order_acquire);
+            item = a->get(t);
+            if (!top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                return nullptr;
+            }
+        }
+        return item;
+    }
+
+    bool empty() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+
+    int64_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+private:
+    /**
+     * @brief 环形数组，容量为2的幂
+     */
+    class Array {
+    public:
+        explicit Array(int64_t capacity)
+            : capacity_(capacity),
+              mask_(capacity - 1),
+              slots_(new std::atomic<T *>[capacity]) {
+        }
+
+        int64_t capacity() const {
+            return capacity_;
+        }
+
+        void put(int64_t i, T *item) {
+            slots_[i & mask_].store(item, std::memory_order_relaxed);
+        }
+
+        T *get(int64_t i) const {
+            return slots_[i & mask_].load(std::memory_order_relaxed);
+        }
+
+    private:
+        int64_t capacity_;
+        int64_t mask_;
+        std::unique_ptr<std::atomic<T *>[]> slots_;
+    };
+
+    static int64_t round_up(int64_t n) {
+        int64_t capacity = 2;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    Array *grow(Array *old, int64_t t, int64_t b) {
+        Array *bigger = new Array(old->capacity() * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        retired_.push_back(std::unique_ptr<Array>(old));
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    static const size_t k_cache_line_size = 64;
+
+    // top_和bottom_分处不同缓存行，避免拥有者与窃取者之间的伪共享；
+    // 用填充拉开距离而不用alignas，C++11的new不保证超过基本对齐的对齐要求，队列可能随Worker在堆上创建
+    char pad0_[k_cache_line_size];
+    std::atomic<int64_t> top_;
+    char pad1_[k_cache_line_size - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom_;
+    char pad2_[k_cache_line_size - sizeof(std::atomic<int64_t>)];
+    std::atomic<Array *> array_;
+    std::vector<std::unique_ptr<Array>> retired_;
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_WORKSTEALINGDEQUE_H
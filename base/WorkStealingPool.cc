@@ -0,0 +1,327 @@
+/**
+ * @brief 工作窃取线程池：每个线程一个本地双端队列，外部提交的任务进入共享队列，空闲线程从其他线程窃取
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/WorkStealingPool.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace web_server {
+
+namespace {
+
+/**
+ * @brief 记录当前线程所属的worker，外部线程为nullptr
+ * Worker是私有类型，这里以void *保存
+ */
+__thread void *t_current_worker = nullptr;
+
+// 一次从注入队列搬运到本地队列的最大任务数
+const size_t k_max_inject_batch = 32;
+
+/**
+ * @brief 单核机器上自旋只会抢占提交线程的时间片，默认不自旋
+ * @return int
+ */
+int default_spin_rounds() {
+    return ::sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 64 : 0;
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+}
+
+} // namespace
+
+struct WorkStealingPool::Worker {
+    Worker(WorkStealingPool *owner, int idx)
+        : pool(owner),
+          index(idx),
+          seed(static_cast<uint32_t>(idx) * 2654435761u + 1) {}
+
+    /**
+     * @brief xorshift随机数，用于选择窃取目标
+     * @return uint32_t
+     */
+    uint32_t next_random() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    WorkStealingPool *pool;
+    int index;
+    uint32_t seed;
+    TaskDeque deque;
+};
+
+WorkStealingPool::WorkStealingPool(const std::string &name)
+    : name_(name),
+      running_(false),
+      spin_rounds_(default_spin_rounds()),
+      inject_size_(0),
+      wakeup_(sleep_mutex_),
+      num_sleeping_(0) {
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    if (running_) {
+        stop();
+    }
+}
+
+/**
+ * @brief 先创建所有worker再启动线程，保证窃取时workers_不会再发生变化
+ * @param num_threads
+ */
+void WorkStealingPool::start(int num_threads) {
+    assert(workers_.empty());
+    running_ = true;
+    workers_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(new Worker(this, i));
+    }
+    threads_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+        char id[32];
+        snprintf(id, sizeof id, "%d", i + 1);
+        threads_.emplace_back(new Thread(
+            std::bind(&WorkStealingPool::run_in_thread, this, workers_[i].get()), name_ + id));
+        threads_[i]->start();
+    }
+    if (num_threads == 0 && thread_init_callback_) {
+        thread_init_callback_();
+    }
+}
+
+/**
+ * @brief 停止后未执行的任务直接丢弃，与ThreadPool的行为一致
+ */
+void WorkStealingPool::stop() {
+    {
+    MutexLockGuard lock(sleep_mutex_);
+    running_ = false;
+    wakeup_.notify_all();
+    }
+    for (auto &thr : threads_) {
+        thr->join();
+    }
+    for (auto &worker : workers_) {
+        while (detail::TaskImplBase *impl = worker->deque.pop()) {
+            delete impl;
+        }
+    }
+    MutexLockGuard lock(inject_mutex_);
+    for (detail::TaskImplBase *impl : inject_queue_) {
+        delete impl;
+    }
+    inject_queue_.clear();
+    inject_size_ = 0;
+}
+
+/**
+ * @brief 没有工作线程或者已经stop时在调用线程中执行，提交的任务总会执行一次，
+ * 调用方为任务做的计数（如HttpServer的pending_requests_）不会因此失衡；
+ * stop之前已经入队但还没执行的任务仍按stop的约定丢弃
+ */
+void WorkStealingPool::run(Task task) {
+    if (workers_.empty() || !running_) {
+        task();
+        return;
+    }
+    Worker *worker = current_worker();
+    if (worker) {
+        worker->deque.push(task.release());
+    } else {
+        MutexLockGuard lock(inject_mutex_);
+        inject_queue_.push_back(task.release());
+        inject_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    notify(1);
+}
+
+void WorkStealingPool::run_batch(std::vector<Task> &tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    if (workers_.empty() || !running_) {
+        for (Task &task : tasks) {
+            task();
+        }
+        tasks.clear();
+        return;
+    }
+    Worker *worker = current_worker();
+    if (worker) {
+        for (Task &task : tasks) {
+            worker->deque.push(task.release());
+        }
+    } else {
+        MutexLockGuard lock(inject_mutex_);
+        for (Task &task : tasks) {
+            inject_queue_.push_back(task.release());
+        }
+        inject_size_.fetch_add(tasks.size(), std::memory_order_relaxed);
+    }
+    notify(tasks.size());
+    tasks.clear();
+}
+
+size_t WorkStealingPool::queue_size() const {
+    size_t size = inject_size_.load(std::memory_order_relaxed);
+    for (const auto &worker : workers_) {
+        size += static_cast<size_t>(worker->deque.size());
+    }
+    return size;
+}
+
+bool WorkStealingPool::is_in_pool_thread() const {
+    return current_worker() != nullptr;
+}
+
+WorkStealingPool::Worker *WorkStealingPool::current_worker() const {
+    Worker *worker = static_cast<Worker *>(t_current_worker);
+    return (worker && worker->pool == this) ? worker : nullptr;
+}
+
+void WorkStealingPool::run_in_thread(Worker *worker) {
+    t_current_worker = worker;
+    if (thread_init_callback_) {
+        thread_init_callback_();
+    }
+    while (running_) {
+        detail::TaskImplBase *impl = find_task(worker);
+        for (int i = 0; !impl && i < spin_rounds_ && running_; ++i) {
+            cpu_relax();
+            impl = find_task(worker);
+        }
+        if (impl) {
+            execute(impl);
+        } else {
+            park();
+        }
+    }
+    t_current_worker = nullptr;
+}
+
+detail::TaskImplBase *WorkStealingPool::find_task(Worker *worker) {
+    detail::TaskImplBase *impl = worker->deque.pop();
+    if (!impl) {
+        impl = take_from_inject_queue(worker);
+    }
+    if (!impl) {
+        impl = steal(worker);
+    }
+    return impl;
+}
+
+/**
+ * @brief 从注入队列中取一个任务执行，同时再搬运一批到本地队列
+ * 这样一次加锁可以摊薄到多个任务，搬运到本地的任务也可以被其他worker窃取
+ * @param worker
+ * @return detail::TaskImplBase*
+ */
+detail::TaskImplBase *WorkStealingPool::take_from_inject_queue(Worker *worker) {
+    if (inject_size_.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+    detail::TaskImplBase *impl = nullptr;
+    size_t moved = 0;
+    {
+    MutexLockGuard lock(inject_mutex_);
+    if (inject_queue_.empty()) {
+        return nullptr;
+    }
+    impl = inject_queue_.front();
+    inject_queue_.pop_front();
+    size_t share = inject_queue_.size() / workers_.size();
+    moved = std::min(share, k_max_inject_batch);
+    for (size_t i = 0; i < moved; ++i) {
+        worker->deque.push(inject_queue_.front());
+        inject_queue_.pop_front();
+    }
+    inject_size_.fetch_sub(moved + 1, std::memory_order_relaxed);
+    }
+    if (moved > 0) {
+        notify(1);
+    }
+    return impl;
+}
+
+detail::TaskImplBase *WorkStealingPool::steal(Worker *worker) {
+    size_t n = workers_.size();
+    if (n <= 1) {
+        return nullptr;
+    }
+    size_t start = worker->next_random() % n;
+    for (size_t i = 0; i < n; ++i) {
+        Worker *victim = workers_[(start + i) % n].get();
+        if (victim == worker) {
+            continue;
+        }
+        detail::TaskImplBase *impl = victim->deque.steal();
+        if (impl) {
+            return impl;
+        }
+    }
+    return nullptr;
+}
+
+bool WorkStealingPool::has_visible_task() const {
+    if (inject_size_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    for (const auto &worker : workers_) {
+        if (!worker->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 休眠前在持有锁的情况下登记并重新检查一遍任务
+ * 提交方在入队之后检查num_sleeping_，两边之间都有全内存屏障，不会丢失唤醒
+ */
+void WorkStealingPool::park() {
+    MutexLockGuard lock(sleep_mutex_);
+    num_sleeping_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (running_ && !has_visible_task()) {
+        wakeup_.wait();
+    }
+    num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void WorkStealingPool::notify(size_t count) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_sleeping_.load(std::memory_order_relaxed) > 0) {
+        MutexLockGuard lock(sleep_mutex_);
+        if (count > 1) {
+            wakeup_.notify_all();
+        } else {
+            wakeup_.notify();
+        }
+    }
+}
+
+void WorkStealingPool::execute(detail::TaskImplBase *impl) {
+    Task task(impl);
+    task();
+}
+
+} // namespace web_server
@@ -0,0 +1,124 @@
+/**
+ * @brief 基于工作窃取的任务调度线程池
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BASE_WORKSTEALINGPOOL_H
+#define WEB_SERVER_BASE_WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "base/Mutex.h"
+#include "base/Condition.h"
+#include "base/Thread.h"
+#include "base/Task.h"
+#include "base/WorkStealingDeque.h"
+
+namespace web_server {
+
+/**
+ * @brief 工作窃取线程池
+ * 每个工作线程拥有一个Chase-Lev双端队列，工作线程内提交的任务直接进入自己的队列，
+ * 外部线程提交的任务进入一个加锁的注入队列，run_batch一次加锁提交一批任务；
+ * 工作线程按 本地队列 -> 注入队列 -> 窃取其他线程 的顺序取任务，
+ * 都取不到时先自旋一段时间，仍然没有任务才在条件变量上休眠
+ */
+class WorkStealingPool : private Noncopyable {
+public:
+    using ThreadInitCallback = std::function<void()>;
+
+    explicit WorkStealingPool(const std::string &name = std::string("WorkStealingPool"));
+    ~WorkStealingPool();
+
+    void set_thread_init_callback(const ThreadInitCallback &cb) {
+        thread_init_callback_ = cb;
+    }
+
+    /**
+     * @brief 设置进入休眠之前的自旋轮数，0表示取不到任务立即休眠
+     * @param spin_rounds
+     */
+    void set_spin_rounds(int spin_rounds) {
+        spin_rounds_ = spin_rounds;
+    }
+
+    void start(int num_threads);
+    void stop();
+
+    /**
+     * @brief 提交一个任务，线程数为0或者已经stop时直接在调用线程执行
+     * @param task
+     */
+    void run(Task task);
+
+    /**
+     * @brief 批量提交任务，外部线程只加一次锁；与run一样，已经stop时在调用线程执行
+     * @param tasks 提交后被清空
+     */
+    void run_batch(std::vector<Task> &tasks);
+
+    const std::string &name() const {
+        return name_;
+    }
+
+    int num_threads() const {
+        return static_cast<int>(workers_.size());
+    }
+
+    /**
+     * @brief 已提交但还未被取走执行的任务数量，仅为近似值
+     * @return size_t
+     */
+    size_t queue_size() const;
+
+    /**
+     * @brief 判断当前线程是不是本线程池中的工作线程
+     * @return true
+     * @return false
+     */
+    bool is_in_pool_thread() const;
+
+private:
+    struct Worker;
+    using TaskDeque = WorkStealingDeque<detail::TaskImplBase>;
+
+    std::string name_;
+    ThreadInitCallback thread_init_callback_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::atomic<bool> running_;
+    int spin_rounds_;
+
+    // 外部线程提交任务使用的注入队列
+    mutable MutexLock inject_mutex_;
+    std::deque<detail::TaskImplBase *> inject_queue_;
+    std::atomic<size_t> inject_size_;
+
+    // 休眠相关，num_sleeping_用于让提交方在无人休眠时跳过加锁
+    MutexLock sleep_mutex_;
+    Condition wakeup_;
+    std::atomic<int> num_sleeping_;
+
+    void run_in_thread(Worker *worker);
+    detail::TaskImplBase *find_task(Worker *worker);
+    detail::TaskImplBase *take_from_inject_queue(Worker *worker);
+    detail::TaskImplBase *steal(Worker *worker);
+    bool has_visible_task() const;
+    void park();
+    void notify(size_t count);
+    Worker *current_worker() const;
+    static void execute(detail::TaskImplBase *impl);
+};
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BASE_WORKSTEALINGPOOL_H
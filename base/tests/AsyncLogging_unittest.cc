@@ -0,0 +1,131 @@
+/**
+ * @brief async logging test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/AsyncLogging.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+
+#include <glob.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using web_server::AsyncLogging;
+using web_server::Logger;
+using web_server::Timestamp;
+
+AsyncLogging *g_async_log = nullptr;
+
+void async_output(const char *msg, int len) {
+    g_async_log->append(msg, len);
+}
+
+std::string make_basename(const char *name) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "/tmp/%s_%d", name, ::getpid());
+    return buf;
+}
+
+/**
+ * @brief 找到basename对应的全部日志文件
+ */
+std::vector<std::string> find_log_files(const std::string &basename) {
+    std::vector<std::string> files;
+    std::string pattern = basename + ".*.log";
+    glob_t result;
+    if (::glob(pattern.c_str(), 0, nullptr, &result) == 0) {
+        for (size_t i = 0; i < result.gl_pathc; ++i) {
+            files.push_back(result.gl_pathv[i]);
+        }
+    }
+    ::globfree(&result);
+    return files;
+}
+
+/**
+ * @brief 统计文件中的行数，同时统计包含pattern的行数
+ */
+int count_lines(const std::string &filename, const char *pattern, int *matched) {
+    FILE *fp = ::fopen(filename.c_str(), "r");
+    assert(fp);
+    char line[1024];
+    int lines = 0;
+    *matched = 0;
+    while (::fgets(line, sizeof line, fp)) {
+        ++lines;
+        if (pattern && ::strstr(line, pattern)) {
+            ++*matched;
+        }
+    }
+    ::fclose(fp);
+    return lines;
+}
+
+void test_write_all() {
+    printf("test_write_all\n");
+    std::string basename = make_basename("async_logging_test");
+    const int k_lines = 100000;
+    {
+    AsyncLogging log(basename, 1024 * 1024 * 1024);
+    log.start();
+    g_async_log = &log;
+    Logger::setOutput(async_output);
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < k_lines; ++i) {
+        LOG_INFO << "async logging line " << i;
+    }
+    double seconds = web_server::time_difference(Timestamp::now(), start);
+    printf("%d lines, %.1f ns/line in front end\n", k_lines, seconds * 1e9 / k_lines);
+    log.stop();
+    assert(log.dropped_messages() == 0);
+    }
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 1);
+    int matched = 0;
+    int lines = count_lines(files[0], "async logging line", &matched);
+    assert(lines == k_lines);
+    assert(matched == k_lines);
+    ::unlink(files[0].c_str());
+}
+
+void test_drop() {
+    printf("test_drop\n");
+    std::string basename = make_basename("async_logging_drop");
+    AsyncLogging log(basename, 1024 * 1024 * 1024, 3, 2);
+    // 后端尚未启动，两块缓冲写满后的日志全部丢弃
+    char line[1000];
+    memset(line, 'x', sizeof line - 1);
+    line[sizeof line - 1] = '\n';
+    const int k_lines = 3 * web_server::detail::kLargeBuffer / static_cast<int>(sizeof line);
+    for (int i = 0; i < k_lines; ++i) {
+        log.append(line, sizeof line);
+    }
+    int64_t dropped = log.dropped_messages();
+    assert(dropped > 0);
+    assert(log.dropped_bytes() == dropped * static_cast<int64_t>(sizeof line));
+    log.start();
+    log.stop();
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 1);
+    int matched = 0;
+    int lines = count_lines(files[0], "Dropped", &matched);
+    assert(matched == 1);
+    assert(lines == k_lines - dropped + 1);
+    ::unlink(files[0].c_str());
+}
+
+int main() {
+    test_write_all();
+    test_drop();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @brief LOG_*与BLOG_*在调用线程上的耗时对比
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/AsyncLogging.h"
+#include "base/BinaryLogging.h"
+#include "base/Logging.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+using web_server::AsyncLogging;
+using web_server::BinaryLogging;
+using web_server::Logger;
+
+namespace {
+
+const off_t k_roll_size = 500 * 1000 * 1000;
+
+std::unique_ptr<AsyncLogging> g_async_log;
+
+void async_output(const char *msg, int len) {
+    g_async_log->append(msg, len);
+}
+
+int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 分批写入，一批记录能放进环形缓冲，批与批之间留时间给后端，避免测到的是缓冲写满后的丢弃路径
+ */
+template <typename Func>
+double measure(int total, Func func) {
+    const int k_batch = 8000;
+    int64_t elapsed = 0;
+    for (int done = 0; done < total; done += k_batch) {
+        int64_t start = now_ns();
+        for (int i = 0; i < k_batch; ++i) {
+            func(done + i);
+        }
+        elapsed += now_ns() - start;
+        ::usleep(20 * 1000);
+    }
+    return static_cast<double>(elapsed) / total;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int total = argc > 1 ? atoi(argv[1]) : 200000;
+    char basename[256];
+    snprintf(basename, sizeof basename, "/tmp/binary_logging_bench_%d", ::getpid());
+    std::string conn_name("HttpServer-0.0.0.0:80#42");
+    void *conn = &conn_name;
+
+    g_async_log.reset(new AsyncLogging(basename, k_roll_size));
+    g_async_log->start();
+    Logger::setOutput(async_output);
+    double async_ns = measure(total, [&](int i) {
+        LOG_INFO << "TcpConnection::ctor[" << conn_name << "] at " << conn << " fd=" << i
+                 << " ratio=" << 0.5;
+    });
+    g_async_log->stop();
+    g_async_log.reset();
+
+    BinaryLogging binary_log(basename, k_roll_size);
+    binary_log.start();
+    double binary_ns = measure(total, [&](int i) {
+        BLOG_INFO("TcpConnection::ctor[{}] at {} fd={} ratio={}", conn_name, conn, i, 0.5);
+    });
+    binary_log.stop();
+
+    printf("%-28s %10s\n", "logger", "ns/call");
+    printf("%-28s %10.1f\n", "LOG_INFO + AsyncLogging", async_ns);
+    printf("%-28s %10.1f\n", "BLOG_INFO + BinaryLogging", binary_ns);
+    printf("binary records dropped: %lld\n", static_cast<long long>(BinaryLogging::dropped_records()));
+
+    char cmd[512];
+    snprintf(cmd, sizeof cmd, "rm -f %s.*.log", basename);
+    return ::system(cmd) == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/**
+ * @brief binary logging test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/BinaryLogging.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+
+#include <glob.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using web_server::BinaryLogging;
+using web_server::Logger;
+using web_server::Thread;
+using web_server::Timestamp;
+
+// 后端停止之后各个线程直接输出，需要加锁
+web_server::MutexLock g_output_mutex;
+std::string g_output;
+
+void capture_output(const char *msg, int len) {
+    web_server::MutexLockGuard lock(g_output_mutex);
+    g_output.append(msg, len);
+}
+
+std::vector<std::string> find_log_files(const std::string &basename) {
+    std::vector<std::string> files;
+    std::string pattern = basename + ".*.log";
+    glob_t result;
+    if (::glob(pattern.c_str(), 0, nullptr, &result) == 0) {
+        for (size_t i = 0; i < result.gl_pathc; ++i) {
+            files.push_back(result.gl_pathv[i]);
+        }
+    }
+    ::globfree(&result);
+    return files;
+}
+
+/**
+ * @brief 后端未运行时直接格式化输出，检查各类参数的格式
+ */
+void test_direct_format() {
+    printf("test_direct_format\n");
+    Logger::setOutput(capture_output);
+    g_output.clear();
+    std::string name("conn-1");
+    unsigned short port = 8080;
+    BLOG_INFO("name={} fd={} port={} ok={} ch={} ratio={} ptr={} msg={}",
+              name, -3, port, true, 'x', 0.25,
+              reinterpret_cast<const void *>(0xbeef), "hello");
+    assert(g_output.find("INFO  name=conn-1 fd=-3 port=8080 ok=1 ch=x ratio=0.25 ptr=0xBEEF msg=hello - BinaryLogging_unittest.cc:")
+           != std::string::npos);
+    assert(g_output.back() == '\n');
+
+    // 参数多于占位符时追加在末尾，占位符多于参数时原样输出
+    g_output.clear();
+    BLOG_WARN("extra", 1, 2);
+    assert(g_output.find("WARN  extra 1 2 - ") != std::string::npos);
+    g_output.clear();
+    BLOG_WARN("missing {} {}", 7);
+    assert(g_output.find("missing 7 {} - ") != std::string::npos);
+
+    // 同一调用点多次调用只注册一次，参数值各不相同
+    g_output.clear();
+    for (int i = 0; i < 3; ++i) {
+        BLOG_INFO("loop {}", i);
+    }
+    assert(g_output.find("loop 0 ") != std::string::npos);
+    assert(g_output.find("loop 2 ") != std::string::npos);
+
+    // 低于运行期级别的不输出
+    g_output.clear();
+    BLOG_DEBUG("hidden {}", 1);
+    assert(g_output.empty());
+}
+
+/**
+ * @brief 多个线程写入后端，每个线程内的记录有序，丢弃的记录有计数
+ */
+void test_backend() {
+    printf("test_backend\n");
+    char basename[256];
+    snprintf(basename, sizeof basename, "/tmp/binary_logging_test_%d", ::getpid());
+    const int k_threads = 3;
+    const int k_lines = 20000;
+    int64_t dropped_before = BinaryLogging::dropped_records();
+    {
+    BinaryLogging log(basename, 1024 * 1024 * 1024);
+    log.start();
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < k_threads; ++t) {
+        threads.emplace_back(new Thread([t] {
+            for (int i = 0; i < k_lines; ++i) {
+                BLOG_INFO("binary line {} {} {}", t, i, std::string("payload"));
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    log.stop();
+    }
+    int64_t dropped = BinaryLogging::dropped_records() - dropped_before;
+
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 1);
+    FILE *fp = ::fopen(files[0].c_str(), "r");
+    assert(fp);
+    char line[1024];
+    int lines = 0;
+    int last[k_threads] = {-1, -1, -1};
+    std::string today = Timestamp::now().to_formatted_string().substr(0, 8);
+    while (::fgets(line, sizeof line, fp)) {
+        int t = 0;
+        int i = 0;
+        const char *msg = strstr(line, "binary line ");
+        if (!msg) {
+            assert(strstr(line, "Dropped"));
+            continue;
+        }
+        assert(sscanf(msg, "binary line %d %d payload", &t, &i) == 2);
+        assert(t >= 0 && t < k_threads);
+        assert(i > last[t]);
+        last[t] = i;
+        assert(strncmp(line, today.c_str(), 8) == 0);
+        ++lines;
+    }
+    ::fclose(fp);
+    printf("%d lines written, %lld dropped\n", lines, static_cast<long long>(dropped));
+    assert(lines + dropped == k_threads * k_lines);
+    ::unlink(files[0].c_str());
+}
+
+int count_lines(const std::string &text, const char *prefix) {
+    int lines = 0;
+    for (size_t pos = text.find(prefix); pos != std::string::npos; pos = text.find(prefix, pos + 1)) {
+        ++lines;
+    }
+    return lines;
+}
+
+/**
+ * @brief 线程一直在写时stop，每条记录要么由后端写进文件，要么直接输出，要么计入丢弃，不会丢失
+ */
+void test_stop_while_logging() {
+    printf("test_stop_while_logging\n");
+    char basename[256];
+    snprintf(basename, sizeof basename, "/tmp/binary_logging_stop_test_%d", ::getpid());
+    const int k_threads = 3;
+    const int k_lines = 50000;
+    Logger::setOutput(capture_output);
+    g_output.clear();
+    int64_t dropped_before = BinaryLogging::dropped_records();
+    {
+    BinaryLogging log(basename, 1024 * 1024 * 1024);
+    log.start();
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < k_threads; ++t) {
+        threads.emplace_back(new Thread([t] {
+            for (int i = 0; i < k_lines; ++i) {
+                BLOG_INFO("racing line {} {}", t, i);
+            }
+        }));
+        threads.back()->start();
+    }
+    ::usleep(2000);
+    log.stop();
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    }
+    int64_t dropped = BinaryLogging::dropped_records() - dropped_before;
+
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 1);
+    std::string written;
+    FILE *fp = ::fopen(files[0].c_str(), "r");
+    assert(fp);
+    char buf[65536];
+    size_t n;
+    while ((n = ::fread(buf, 1, sizeof buf, fp)) > 0) {
+        written.append(buf, n);
+    }
+    ::fclose(fp);
+    ::unlink(files[0].c_str());
+    int in_file = count_lines(written, "racing line ");
+    int direct = count_lines(g_output, "racing line ");
+    printf("%d lines in file, %d output directly, %lld dropped\n",
+           in_file, direct, static_cast<long long>(dropped));
+    assert(in_file + direct + dropped == k_threads * k_lines);
+}
+
+int main() {
+    test_direct_format();
+    test_backend();
+    test_stop_while_logging();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @brief base64 and sha1 test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/Base64.h"
+#include "base/Sha1.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+using namespace web_server;
+
+std::string hex(const std::string &s) {
+    static const char k_digits[] = "0123456789abcdef";
+    std::string out;
+    for (unsigned char c : s) {
+        out.push_back(k_digits[c >> 4]);
+        out.push_back(k_digits[c & 0xf]);
+    }
+    return out;
+}
+
+std::string decoded(const std::string &s) {
+    std::string out;
+    bool ok = base64::decode(s, &out);
+    assert(ok);
+    (void)ok;
+    return out;
+}
+
+void test_base64() {
+    printf("test_base64\n");
+    // RFC 4648第10节的测试向量
+    const char *vectors[][2] = {{"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+                                {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}};
+    for (const auto &v : vectors) {
+        std::string plain(v[0]);
+        assert(base64::encode(plain.data(), plain.size()) == v[1]);
+        assert(decoded(v[1]) == plain);
+    }
+    // 省略填充和URL安全字母表
+    assert(decoded("Zm9vYg") == "foob");
+    std::string binary("\xfb\xff\xbf", 3);
+    assert(base64::encode(binary.data(), binary.size()) == "+/+/");
+    assert(decoded("-_-_") == binary);
+    std::string out;
+    assert(!base64::decode("Zm9v YmFy", &out));
+    assert(!base64::decode("Zg==Zg==", &out));
+}
+
+void test_sha1() {
+    printf("test_sha1\n");
+    // RFC 3174和FIPS 180-2的测试向量
+    assert(hex(Sha1::digest("", 0)) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    assert(hex(Sha1::digest("abc", 3)) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    std::string two_blocks("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+    assert(hex(Sha1::digest(two_blocks.data(), two_blocks.size())) == "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+
+    // 分多次update，跨越分块边界
+    std::string million(1000000, 'a');
+    Sha1 sha1;
+    for (size_t i = 0; i < million.size(); i += 999) {
+        sha1.update(million.data() + i, std::min<size_t>(999, million.size() - i));
+    }
+    unsigned char digest[Sha1::k_digest_size];
+    sha1.final(digest);
+    assert(hex(std::string(reinterpret_cast<char *>(digest), sizeof digest)) ==
+           "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+
+    // RFC 6455第1.3节的握手示例
+    std::string key = std::string("dGhlIHNhbXBsZSBub25jZQ==") + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    std::string sha = Sha1::digest(key.data(), key.size());
+    assert(base64::encode(sha.data(), sha.size()) == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+int main() {
+    test_base64();
+    test_sha1();
+    printf("all tests passed\n");
+    return 0;
+}
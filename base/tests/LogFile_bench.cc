@@ -0,0 +1,108 @@
+/**
+ * @brief 日志写入吞吐量，单位行每秒
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/AsyncLogging.h"
+#include "base/LogFile.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using web_server::AsyncLogging;
+using web_server::LogFile;
+using web_server::Logger;
+using web_server::Thread;
+
+namespace {
+
+const off_t k_roll_size = 500 * 1000 * 1000;
+
+std::unique_ptr<LogFile> g_log_file;
+std::unique_ptr<AsyncLogging> g_async_log;
+FILE *g_null_file = nullptr;
+
+void null_output(const char *msg, int len) {
+    ::fwrite(msg, 1, len, g_null_file);
+}
+
+void log_file_output(const char *msg, int len) {
+    g_log_file->append(msg, len);
+}
+
+void async_output(const char *msg, int len) {
+    g_async_log->append(msg, len);
+}
+
+int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief num_threads个线程各写lines_per_thread行，返回总的行每秒
+ */
+double run(int num_threads, int lines_per_thread) {
+    std::vector<std::unique_ptr<Thread>> threads;
+    int64_t start = now_ns();
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(new Thread([lines_per_thread] {
+            for (int j = 0; j < lines_per_thread; ++j) {
+                LOG_INFO << "Hello 0123456789 abcdefghijklmnopqrstuvwxyz " << j;
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    double seconds = static_cast<double>(now_ns() - start) / 1e9;
+    return num_threads * lines_per_thread / seconds;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    char basename[256];
+    snprintf(basename, sizeof basename, "/tmp/logfile_bench_%d", ::getpid());
+
+    printf("%-24s %8s %14s\n", "sink", "threads", "lines/sec");
+    for (int threads : {1, 4}) {
+        int per_thread = lines / threads;
+
+        g_null_file = ::fopen("/dev/null", "w");
+        Logger::setOutput(null_output);
+        printf("%-24s %8d %14.0f\n", "fwrite /dev/null", threads, run(threads, per_thread));
+        ::fclose(g_null_file);
+
+        g_log_file.reset(new LogFile(basename, k_roll_size, threads > 1));
+        Logger::setOutput(log_file_output);
+        printf("%-24s %8d %14.0f\n", "LogFile", threads, run(threads, per_thread));
+        Logger::setOutput(null_output);
+        g_log_file.reset();
+
+        g_async_log.reset(new AsyncLogging(basename, k_roll_size));
+        g_async_log->start();
+        Logger::setOutput(async_output);
+        printf("%-24s %8d %14.0f\n", "AsyncLogging+LogFile", threads, run(threads, per_thread));
+        g_async_log->stop();
+        g_async_log.reset();
+    }
+
+    char cmd[512];
+    snprintf(cmd, sizeof cmd, "rm -f %s.*.log", basename);
+    return ::system(cmd) == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+/**
+ * @brief log file test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/LogFile.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+
+#include <glob.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+using web_server::LogFile;
+using web_server::Logger;
+using web_server::Thread;
+
+std::unique_ptr<LogFile> g_log_file;
+
+void output_func(const char *msg, int len) {
+    g_log_file->append(msg, len);
+}
+
+void flush_func() {
+    g_log_file->flush();
+}
+
+std::string make_basename(const char *name) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "/tmp/%s_%d", name, ::getpid());
+    return buf;
+}
+
+std::vector<std::string> find_log_files(const std::string &basename) {
+    std::vector<std::string> files;
+    std::string pattern = basename + ".*.log";
+    glob_t result;
+    if (::glob(pattern.c_str(), 0, nullptr, &result) == 0) {
+        for (size_t i = 0; i < result.gl_pathc; ++i) {
+            files.push_back(result.gl_pathv[i]);
+        }
+    }
+    ::globfree(&result);
+    return files;
+}
+
+/**
+ * @brief 统计行数，同时检查每一行是否完整
+ */
+int count_lines(const std::string &filename, const char *pattern) {
+    FILE *fp = ::fopen(filename.c_str(), "r");
+    assert(fp);
+    char line[1024];
+    int lines = 0;
+    while (::fgets(line, sizeof line, fp)) {
+        assert(::strstr(line, pattern));
+        assert(line[strlen(line) - 1] == '\n');
+        ++lines;
+    }
+    ::fclose(fp);
+    return lines;
+}
+
+void remove_files(const std::vector<std::string> &files) {
+    for (const std::string &file : files) {
+        ::unlink(file.c_str());
+    }
+}
+
+/**
+ * @brief 超过滚动大小后，同一秒内继续写当前文件，下一秒再写入时滚动
+ */
+void test_roll_by_size() {
+    printf("test_roll_by_size\n");
+    std::string basename = make_basename("logfile_roll");
+    std::string line(99, 'x');
+    line += '\n';
+    {
+    LogFile file(basename, 4096);
+    std::string first = file.filename();
+    for (int i = 0; i < 100; ++i) {
+        file.append(line.data(), static_cast<int>(line.size()));
+    }
+    assert(file.filename() == first);
+    time_t start = ::time(nullptr);
+    while (::time(nullptr) == start) {
+        ::usleep(10 * 1000);
+    }
+    file.append(line.data(), static_cast<int>(line.size()));
+    assert(file.filename() != first);
+    file.append(line.data(), static_cast<int>(line.size()));
+    }
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 2);
+    int lines = 0;
+    for (const std::string &file : files) {
+        lines += count_lines(file, "xxxx");
+    }
+    assert(lines == 102);
+    remove_files(files);
+}
+
+/**
+ * @brief 多个线程通过Logger同时写入，行不能交错
+ */
+void test_thread_safe() {
+    printf("test_thread_safe\n");
+    std::string basename = make_basename("logfile_threads");
+    const int k_threads = 4;
+    const int k_lines = 10000;
+    g_log_file.reset(new LogFile(basename, 1024 * 1024 * 1024));
+    Logger::setOutput(output_func);
+    Logger::setFlush(flush_func);
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < k_threads; ++i) {
+        threads.emplace_back(new Thread([] {
+            for (int j = 0; j < k_lines; ++j) {
+                LOG_INFO << "log file line " << j;
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    g_log_file.reset();
+    std::vector<std::string> files = find_log_files(basename);
+    assert(files.size() == 1);
+    assert(count_lines(files[0], "log file line") == k_threads * k_lines);
+    remove_files(files);
+}
+
+/**
+ * @brief 写入的同时在另一个线程中手动滚动，滚动要和append互斥，所有行都完整地落在某个文件中
+ */
+void test_roll_while_appending() {
+    printf("test_roll_while_appending\n");
+    std::string basename = make_basename("logfile_manual_roll");
+    const int k_threads = 2;
+    const int k_lines = 20000;
+    LogFile file(basename, 1024 * 1024 * 1024);
+    std::string line = "manual roll line\n";
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < k_threads; ++i) {
+        threads.emplace_back(new Thread([&file, &line] {
+            for (int j = 0; j < k_lines; ++j) {
+                file.append(line.data(), static_cast<int>(line.size()));
+                if (j % 1000 == 0) {
+                    ::usleep(1000);
+                }
+            }
+        }));
+        threads.back()->start();
+    }
+    // 同一秒内只能滚动一次，跨过一秒边界保证至少滚动一次
+    int rolls = 0;
+    time_t start = ::time(nullptr);
+    while (::time(nullptr) <= start + 1) {
+        if (file.roll_file()) {
+            ++rolls;
+        }
+        ::usleep(1000);
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    file.flush();
+    assert(rolls >= 1);
+    std::vector<std::string> files = find_log_files(basename);
+    assert(static_cast<int>(files.size()) == rolls + 1);
+    int lines = 0;
+    for (const std::string &name : files) {
+        lines += count_lines(name, "manual roll line");
+    }
+    assert(lines == k_threads * k_lines);
+    remove_files(files);
+}
+
+int main() {
+    test_roll_by_size();
+    test_thread_safe();
+    test_roll_while_appending();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * @brief 编译期和运行期日志级别的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+// 本测试固定按WARN编译，与CMake的设置无关
+#undef WEB_SERVER_MIN_LOG_LEVEL
+#define WEB_SERVER_MIN_LOG_LEVEL 3
+
+#include "base/Logging.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using web_server::Logger;
+
+web_server::MutexLock g_mutex;
+std::string g_output;
+int g_evaluated = 0;
+
+void capture_output(const char *msg, int len) {
+    web_server::MutexLockGuard lock(g_mutex);
+    g_output.append(msg, len);
+}
+
+int count_of(const std::string &text, const std::string &pattern) {
+    int count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+int side_effect() {
+    return ++g_evaluated;
+}
+
+void test_compile_time_level() {
+    printf("test_compile_time_level\n");
+    Logger::set_log_level(Logger::TRACE);
+    g_output.clear();
+    g_evaluated = 0;
+    LOG_TRACE << "trace " << side_effect();
+    LOG_DEBUG << "debug " << side_effect();
+    LOG_INFO << "info " << side_effect();
+    // 低于编译期级别的语句不输出，参数也不求值
+    assert(g_output.empty());
+    assert(g_evaluated == 0);
+    LOG_WARN << "warn " << side_effect();
+    assert(g_evaluated == 1);
+    assert(g_output.find("WARN") != std::string::npos);
+    assert(g_output.find("warn 1") != std::string::npos);
+}
+
+void test_runtime_level() {
+    printf("test_runtime_level\n");
+    Logger::set_log_level(Logger::ERROR);
+    g_output.clear();
+    g_evaluated = 0;
+    LOG_WARN << "warn " << side_effect();
+    assert(g_output.empty());
+    assert(g_evaluated == 0);
+    LOG_ERROR << "error " << side_effect();
+    assert(g_evaluated == 1);
+    assert(g_output.find("error 1") != std::string::npos);
+    // 宏展开为if语句，放在不带花括号的if/else中也要保持原来的语义
+    g_output.clear();
+    bool flag = false;
+    if (flag)
+        LOG_ERROR << "never";
+    assert(g_output.empty());
+}
+
+void test_pointer() {
+    printf("test_pointer\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    LOG_WARN << reinterpret_cast<const void *>(0x1234abcd);
+    assert(g_output.find("0x1234ABCD") != std::string::npos);
+}
+
+void test_every_n() {
+    printf("test_every_n\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    for (int i = 0; i < 10; ++i) {
+        LOG_EVERY_N(WARN, 3) << "every_n " << i;
+    }
+    // 第0、3、6、9次输出，后三条各附带跳过的2次
+    assert(count_of(g_output, "every_n ") == 4);
+    assert(g_output.find("every_n 9 [2 similar messages suppressed]") != std::string::npos);
+    assert(g_output.find("every_n 0 [") == std::string::npos);
+
+    g_output.clear();
+    for (int i = 0; i < 10; ++i) {
+        LOG_FIRST_N(ERROR, 2) << "first_n " << i;
+    }
+    assert(count_of(g_output, "first_n ") == 2);
+    assert(g_output.find("first_n 1") != std::string::npos);
+
+    // 低于运行期级别时不计数
+    g_output.clear();
+    Logger::set_log_level(Logger::ERROR);
+    for (int i = 0; i < 10; ++i) {
+        LOG_EVERY_N(WARN, 2) << "hidden " << i;
+    }
+    assert(g_output.empty());
+}
+
+/**
+ * @brief 宏放在不带花括号的if里时，后面的else属于外层的if
+ */
+void test_dangling_else() {
+    printf("test_dangling_else\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    bool condition = true;
+    int hits = 0;
+    for (int i = 0; i < 5; ++i) {
+        if (condition)
+            LOG_EVERY_N(ERROR, 100) << "dangling";
+        else
+            ++hits;
+    }
+    assert(hits == 0);
+    assert(count_of(g_output, "dangling") == 1);
+
+    condition = false;
+    for (int i = 0; i < 5; ++i) {
+        if (condition)
+            LOG_FIRST_N(ERROR, 1) << "dangling";
+        else
+            ++hits;
+    }
+    assert(hits == 5);
+
+    // 运行期级别关闭时同样不能吞掉else
+    Logger::set_log_level(Logger::FATAL);
+    condition = true;
+    for (int i = 0; i < 5; ++i) {
+        if (condition)
+            LOG_EVERY_T(ERROR, 1) << "dangling";
+        else
+            ++hits;
+    }
+    assert(hits == 5);
+    Logger::set_log_level(Logger::WARN);
+}
+
+/**
+ * @brief n不大于0时每次都输出，不会除零
+ */
+void test_every_n_non_positive() {
+    printf("test_every_n_non_positive\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    for (int i = 0; i < 3; ++i) {
+        LOG_EVERY_N(WARN, 0) << "zero";
+        LOG_EVERY_N(WARN, -5) << "negative";
+    }
+    assert(count_of(g_output, "zero") == 3);
+    assert(count_of(g_output, "negative") == 3);
+}
+
+void test_every_n_threads() {
+    printf("test_every_n_threads\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    const int k_threads = 4;
+    const int k_calls = 1000;
+    std::vector<std::unique_ptr<web_server::Thread>> threads;
+    for (int i = 0; i < k_threads; ++i) {
+        threads.emplace_back(new web_server::Thread([] {
+            for (int j = 0; j < k_calls; ++j) {
+                LOG_EVERY_N(WARN, 10) << "threads";
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    assert(count_of(g_output, "threads") == k_threads * k_calls / 10);
+}
+
+void test_every_t() {
+    printf("test_every_t\n");
+    Logger::set_log_level(Logger::WARN);
+    g_output.clear();
+    const int k_calls = 100;
+    for (int i = 0; i < k_calls; ++i) {
+        errno = EMFILE;
+        LOG_SYSERR_EVERY_T(0.02) << "every_t";
+        ::usleep(1000);
+    }
+    int lines = count_of(g_output, "every_t");
+    assert(lines >= 2 && lines < k_calls / 2);
+    assert(g_output.find("Too many open files") != std::string::npos);
+    // 输出的条数加上所有附带的跳过次数不超过总调用次数
+    int suppressed = 0;
+    for (size_t pos = g_output.find(" ["); pos != std::string::npos; pos = g_output.find(" [", pos + 1)) {
+        suppressed += atoi(g_output.c_str() + pos + 2);
+    }
+    assert(suppressed > 0);
+    assert(lines + suppressed <= k_calls);
+}
+
+int main() {
+    Logger::setOutput(capture_output);
+    test_compile_time_level();
+    test_runtime_level();
+    test_pointer();
+    test_every_n();
+    test_dangling_else();
+    test_every_n_non_positive();
+    test_every_n_threads();
+    test_every_t();
+    printf("all tests passed\n");
+    return 0;
+}
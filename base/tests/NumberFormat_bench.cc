@@ -0,0 +1,128 @@
+/**
+ * @brief number_format与snprintf/逐位转换的耗时对比
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/NumberFormat.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace nf = web_server::number_format;
+
+namespace {
+
+int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 原LogStream中的逐位转换，作为对照
+ */
+size_t convert_one_digit(char *buf, int64_t value) {
+    static const char digits[] = "9876543210123456789";
+    static const char *zero = digits + 9;
+    int64_t i = value;
+    char *p = buf;
+    do {
+        int lsd = static_cast<int>(i % 10);
+        i /= 10;
+        *p++ = zero[lsd];
+    } while (i != 0);
+    if (value < 0) {
+        *p++ = '-';
+    }
+    *p = '\0';
+    std::reverse(buf, p);
+    return p - buf;
+}
+
+// 防止结果被优化掉
+volatile size_t g_sink;
+
+template <typename Func>
+double measure(int iterations, Func func) {
+    int64_t start = now_ns();
+    size_t total = 0;
+    for (int i = 0; i < iterations; ++i) {
+        total += func(i);
+    }
+    g_sink = total;
+    return static_cast<double>(now_ns() - start) / iterations;
+}
+
+void report(const char *name, double baseline_ns, double fast_ns) {
+    printf("%-20s %12.1f %12.1f %8.2fx\n", name, baseline_ns, fast_ns, baseline_ns / fast_ns);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    char buf[64];
+
+    // 输入事先生成，避免把随机数的开销算进去
+    const int k_values = 1024;
+    int64_t ints[k_values];
+    double doubles[k_values];
+    srand(1);
+    for (int i = 0; i < k_values; ++i) {
+        ints[i] = (static_cast<int64_t>(rand()) << (i % 32)) - rand();
+        doubles[i] = static_cast<double>(rand()) / (rand() + 1) * (i % 7 + 1);
+    }
+    struct tm tm_time;
+    time_t seconds = ::time(nullptr);
+    ::gmtime_r(&seconds, &tm_time);
+
+    printf("%-20s %12s %12s %9s\n", "case", "baseline ns", "fast ns", "speedup");
+
+    report("int64",
+           measure(iterations, [&](int i) { return convert_one_digit(buf, ints[i % k_values]); }),
+           measure(iterations, [&](int i) { return nf::format_int(buf, ints[i % k_values]); }));
+
+    report("double",
+           measure(iterations, [&](int i) {
+               return static_cast<size_t>(snprintf(buf, sizeof buf, "%.17g", doubles[i % k_values]));
+           }),
+           measure(iterations, [&](int i) { return nf::format_double(buf, doubles[i % k_values]); }));
+
+    report("date_time.us",
+           measure(iterations, [&](int i) {
+               return static_cast<size_t>(snprintf(buf, sizeof buf, "%4d%02d%02d %02d:%02d:%02d.%06d",
+                   tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                   tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, i % 1000000));
+           }),
+           measure(iterations, [&](int i) {
+               nf::format_date_time(buf, tm_time);
+               buf[nf::k_date_time_size] = '.';
+               nf::format_fixed_width(buf + nf::k_date_time_size + 1, i % 1000000, 6);
+               return nf::k_date_time_size + 7;
+           }));
+
+    // HttpResponse::append_to_buffer中状态行和Content-Length的拼接
+    report("http status+length",
+           measure(iterations, [&](int i) {
+               int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", 200 + i % 3);
+               return n + static_cast<size_t>(snprintf(buf, sizeof buf, "Content-Length: %zd\r\n",
+                                                       static_cast<size_t>(i)));
+           }),
+           measure(iterations, [&](int i) {
+               memcpy(buf, "HTTP/1.1 ", 9);
+               size_t n = 9 + nf::format_int(buf + 9, 200 + i % 3);
+               buf[n++] = ' ';
+               memcpy(buf, "Content-Length: ", 16);
+               size_t m = 16 + nf::format_uint(buf + 16, static_cast<size_t>(i));
+               memcpy(buf + m, "\r\n", 2);
+               return n + m + 2;
+           }));
+    return 0;
+}
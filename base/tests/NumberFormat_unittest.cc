@@ -0,0 +1,156 @@
+/**
+ * @brief number format test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/NumberFormat.h"
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace nf = web_server::number_format;
+
+std::string int_string(int64_t v) {
+    char buf[nf::k_max_int_size];
+    return std::string(buf, nf::format_int(buf, v));
+}
+
+std::string uint_string(uint64_t v) {
+    char buf[nf::k_max_int_size];
+    return std::string(buf, nf::format_uint(buf, v));
+}
+
+std::string double_string(double v) {
+    char buf[nf::k_max_double_size];
+    size_t len = nf::format_double(buf, v);
+    assert(len <= nf::k_max_double_size);
+    return std::string(buf, len);
+}
+
+void test_integer() {
+    printf("test_integer\n");
+    char expect[32];
+    // 每个位数的边界
+    uint64_t v = 1;
+    for (int i = 0; i < 19; ++i, v *= 10) {
+        for (uint64_t x : {v - 1, v, v + 1}) {
+            snprintf(expect, sizeof expect, "%" PRIu64, x);
+            assert(uint_string(x) == expect);
+            snprintf(expect, sizeof expect, "%" PRId64, -static_cast<int64_t>(x));
+            assert(int_string(-static_cast<int64_t>(x)) == expect);
+        }
+    }
+    assert(uint_string(std::numeric_limits<uint64_t>::max()) == "18446744073709551615");
+    assert(int_string(std::numeric_limits<int64_t>::max()) == "9223372036854775807");
+    assert(int_string(std::numeric_limits<int64_t>::min()) == "-9223372036854775808");
+    srand(1);
+    for (int i = 0; i < 100000; ++i) {
+        int64_t x = (static_cast<int64_t>(rand()) << 33) ^ (static_cast<int64_t>(rand()) << 2) ^ rand();
+        snprintf(expect, sizeof expect, "%" PRId64, x);
+        assert(int_string(x) == expect);
+    }
+}
+
+void test_hex_and_fixed_width() {
+    printf("test_hex_and_fixed_width\n");
+    char buf[32];
+    assert(std::string(buf, nf::format_hex(buf, 0)) == "0");
+    assert(std::string(buf, nf::format_hex(buf, 0xABCDEF0123ULL)) == "ABCDEF0123");
+    assert(std::string(buf, nf::format_hex(buf, ~0ULL)) == "FFFFFFFFFFFFFFFF");
+    assert(std::string(buf, nf::format_pointer(buf, reinterpret_cast<void *>(0x7f00beef))) == "0x7F00BEEF");
+    assert(std::string(buf, nf::format_pointer(buf, nullptr)) == "0x0");
+
+    nf::format_fixed_width(buf, 7, 6);
+    assert(std::string(buf, 6) == "000007");
+    nf::format_fixed_width(buf, 123456, 6);
+    assert(std::string(buf, 6) == "123456");
+    nf::format_fixed_width(buf, 5, 1);
+    assert(std::string(buf, 1) == "5");
+    nf::format_fixed_width(buf, 2021, 4);
+    assert(std::string(buf, 4) == "2021");
+    nf::format_fixed_width(buf, 42, 3);
+    assert(std::string(buf, 3) == "042");
+
+    struct tm tm_time;
+    memset(&tm_time, 0, sizeof tm_time);
+    tm_time.tm_year = 2021 - 1900;
+    tm_time.tm_mon = 2;
+    tm_time.tm_mday = 9;
+    tm_time.tm_hour = 5;
+    tm_time.tm_min = 30;
+    tm_time.tm_sec = 7;
+    nf::format_date_time(buf, tm_time);
+    assert(std::string(buf, nf::k_date_time_size) == "20210309 05:30:07");
+}
+
+/**
+ * @brief 有效数字的个数，不计前导和末尾的0
+ */
+int significant_digits(const std::string &s) {
+    std::string digits;
+    for (char c : s) {
+        if (c == 'e') {
+            break;
+        }
+        if (c >= '0' && c <= '9') {
+            digits += c;
+        }
+    }
+    size_t first = digits.find_first_not_of('0');
+    size_t last = digits.find_last_not_of('0');
+    return first == std::string::npos ? 0 : static_cast<int>(last - first + 1);
+}
+
+void test_double() {
+    printf("test_double\n");
+    assert(double_string(0.0) == "0");
+    assert(double_string(-0.0) == "-0");
+    assert(double_string(1.0) == "1");
+    assert(double_string(-2.5) == "-2.5");
+    assert(double_string(0.1) == "0.1");
+    assert(double_string(0.1 + 0.2) == "0.30000000000000004");
+    assert(double_string(123.456) == "123.456");
+    assert(double_string(1e20) == "100000000000000000000");
+    assert(double_string(1e21) == "1e+21");
+    assert(double_string(1.5e300) == "1.5e+300");
+    assert(double_string(0.000001) == "0.000001");
+    assert(double_string(1.25e-7) == "1.25e-7");
+    assert(double_string(5e-324) == "5e-324");
+    assert(double_string(1.7976931348623157e308) == "1.7976931348623157e+308");
+    assert(double_string(2.2250738585072014e-308) == "2.2250738585072014e-308");
+    assert(double_string(std::numeric_limits<double>::infinity()) == "inf");
+    assert(double_string(-std::numeric_limits<double>::infinity()) == "-inf");
+    assert(double_string(std::numeric_limits<double>::quiet_NaN()) == "nan");
+
+    // 随机位模式，读回必须得到同一个double，有效数字不超过17位
+    srand(2);
+    for (int i = 0; i < 1000000; ++i) {
+        uint64_t bits = (static_cast<uint64_t>(rand()) << 42) ^
+                        (static_cast<uint64_t>(rand()) << 21) ^ static_cast<uint64_t>(rand());
+        double v;
+        memcpy(&v, &bits, sizeof v);
+        if (v != v || v - v != 0) {
+            continue;
+        }
+        std::string s = double_string(v);
+        double back = strtod(s.c_str(), nullptr);
+        assert(memcmp(&back, &v, sizeof v) == 0);
+        assert(significant_digits(s) <= 17);
+    }
+}
+
+int main() {
+    test_integer();
+    test_hex_and_fixed_width();
+    test_double();
+    printf("all tests passed\n");
+    return 0;
+}
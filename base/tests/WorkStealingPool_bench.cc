@@ -0,0 +1,153 @@
+/**
+ * @brief ThreadPool与WorkStealingPool的吞吐量、延迟对比
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ * 
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/ThreadPool.h"
+#include "base/WorkStealingPool.h"
+#include "base/CountDownLatch.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using web_server::CountDownLatch;
+using web_server::Task;
+using web_server::ThreadPool;
+using web_server::WorkStealingPool;
+
+namespace {
+
+int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 所有任务完成后由最后一个任务释放latch，避免每个任务都去竞争latch的锁
+ */
+struct Completion {
+    explicit Completion(int n) : remain(n), latch(1) {}
+    void done() {
+        if (remain.fetch_sub(1) == 1) {
+            latch.count_down();
+        }
+    }
+    std::atomic<int> remain;
+    CountDownLatch latch;
+};
+
+struct Result {
+    double tasks_per_sec;
+    double p50_us;
+    double p99_us;
+};
+
+double percentile(std::vector<int64_t> &v, double p) {
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1));
+    return v[idx] / 1000.0;
+}
+
+template <typename Pool, typename Submit>
+Result measure(Pool &pool, int num_tasks, int num_latency, Submit submit) {
+    Result result;
+    // 吞吐量：连续提交大量极小任务直到全部完成
+    {
+        Completion completion(num_tasks);
+        int64_t start = now_ns();
+        for (int i = 0; i < num_tasks; ++i) {
+            submit(pool, [&completion]() { completion.done(); });
+        }
+        completion.latch.wait();
+        int64_t elapsed = now_ns() - start;
+        result.tasks_per_sec = num_tasks * 1e9 / static_cast<double>(elapsed);
+    }
+    // 延迟：逐个提交，记录从提交到开始执行的时间
+    {
+        std::vector<int64_t> latencies(num_latency);
+        for (int i = 0; i < num_latency; ++i) {
+            Completion completion(1);
+            int64_t *slot = &latencies[i];
+            int64_t submit_time = now_ns();
+            submit(pool, [slot, submit_time, &completion]() {
+                *slot = now_ns() - submit_time;
+                completion.done();
+            });
+            completion.latch.wait();
+        }
+        result.p50_us = percentile(latencies, 0.50);
+        result.p99_us = percentile(latencies, 0.99);
+    }
+    return result;
+}
+
+struct SubmitToThreadPool {
+    template <typename F>
+    void operator()(ThreadPool &pool, const F &f) const {
+        pool.run(f);
+    }
+};
+
+struct SubmitToWorkStealingPool {
+    template <typename F>
+    void operator()(WorkStealingPool &pool, const F &f) const {
+        pool.run(Task(f));
+    }
+};
+
+/**
+ * @brief 每个任务再派生子任务的场景，只有工作窃取池能在本地队列上完成派生
+ */
+double measure_fanout(WorkStealingPool &pool, int num_roots, int fanout) {
+    Completion completion(num_roots * fanout);
+    int64_t start = now_ns();
+    std::vector<Task> roots;
+    for (int i = 0; i < num_roots; ++i) {
+        roots.push_back(Task([&pool, &completion, fanout]() {
+            for (int j = 0; j < fanout; ++j) {
+                pool.run(Task([&completion]() { completion.done(); }));
+            }
+        }));
+    }
+    pool.run_batch(roots);
+    completion.latch.wait();
+    int64_t elapsed = now_ns() - start;
+    return num_roots * fanout * 1e9 / static_cast<double>(elapsed);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int num_tasks = argc > 1 ? atoi(argv[1]) : 200000;
+    int num_latency = argc > 2 ? atoi(argv[2]) : 2000;
+    const int threads[] = {1, 2, 4, 8, 16, 32, 64};
+
+    printf("%8s %-18s %14s %10s %10s\n", "threads", "pool", "tasks/s", "p50(us)", "p99(us)");
+    for (int n : threads) {
+        {
+            ThreadPool pool("bench");
+            pool.start(n);
+            Result r = measure(pool, num_tasks, num_latency, SubmitToThreadPool());
+            printf("%8d %-18s %14.0f %10.2f %10.2f\n", n, "ThreadPool", r.tasks_per_sec, r.p50_us, r.p99_us);
+            pool.stop();
+        }
+        {
+            WorkStealingPool pool("bench");
+            pool.start(n);
+            Result r = measure(pool, num_tasks, num_latency, SubmitToWorkStealingPool());
+            printf("%8d %-18s %14.0f %10.2f %10.2f\n", n, "WorkStealingPool", r.tasks_per_sec, r.p50_us, r.p99_us);
+            double fanout = measure_fanout(pool, num_tasks / 100, 100);
+            printf("%8d %-18s %14.0f\n", n, "WSPool(fan-out)", fanout);
+            pool.stop();
+        }
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @brief work stealing pool test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ * 
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "base/WorkStealingPool.h"
+#include "base/CountDownLatch.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using web_server::CountDownLatch;
+using web_server::Task;
+using web_server::WorkStealingPool;
+using web_server::WorkStealingDeque;
+
+/**
+ * @brief 仅可移动的任务，持有unique_ptr
+ */
+struct MoveOnlyTask {
+    MoveOnlyTask(std::unique_ptr<int> v, std::atomic<int> *sum, CountDownLatch *latch)
+        : value(std::move(v)), sum(sum), latch(latch) {}
+    MoveOnlyTask(MoveOnlyTask &&) = default;
+
+    void operator()() {
+        sum->fetch_add(*value);
+        latch->count_down();
+    }
+
+    std::unique_ptr<int> value;
+    std::atomic<int> *sum;
+    CountDownLatch *latch;
+};
+
+void test_deque() {
+    printf("test_deque\n");
+    WorkStealingDeque<int> deque(2);
+    int values[100];
+    for (int i = 0; i < 100; ++i) {
+        values[i] = i;
+        deque.push(&values[i]);
+    }
+    assert(deque.size() == 100);
+    // 拥有者从底部取，窃取者从顶部取
+    int *popped = deque.pop();
+    assert(popped && *popped == 99);
+    int *stolen = deque.steal();
+    assert(stolen && *stolen == 0);
+    assert(deque.size() == 98);
+    while (deque.pop()) {
+    }
+    assert(deque.empty());
+    stolen = deque.steal();
+    assert(stolen == nullptr);
+    (void)popped;
+    (void)stolen;
+}
+
+void test_run(int num_threads) {
+    printf("test_run with %d threads\n", num_threads);
+    WorkStealingPool pool("TestPool");
+    pool.start(num_threads);
+    const int k_tasks = 10000;
+    std::atomic<int> sum(0);
+    CountDownLatch latch(k_tasks);
+    for (int i = 0; i < k_tasks; ++i) {
+        pool.run(MoveOnlyTask(std::unique_ptr<int>(new int(1)), &sum, &latch));
+    }
+    latch.wait();
+    assert(sum.load() == k_tasks);
+    pool.stop();
+}
+
+void test_batch_and_nested() {
+    printf("test_batch_and_nested\n");
+    WorkStealingPool pool("TestPool");
+    pool.start(4);
+    const int k_outer = 100;
+    const int k_inner = 50;
+    std::atomic<int> sum(0);
+    CountDownLatch latch(k_outer * k_inner);
+    std::vector<Task> tasks;
+    for (int i = 0; i < k_outer; ++i) {
+        // 每个外层任务在工作线程内部再提交一批任务，走本地队列
+        tasks.push_back(Task([&pool, &sum, &latch]() {
+            assert(pool.is_in_pool_thread());
+            std::vector<Task> inner;
+            for (int j = 0; j < k_inner; ++j) {
+                inner.push_back(Task(MoveOnlyTask(std::unique_ptr<int>(new int(2)), &sum, &latch)));
+            }
+            pool.run_batch(inner);
+            assert(inner.empty());
+        }));
+    }
+    pool.run_batch(tasks);
+    assert(tasks.empty());
+    assert(!pool.is_in_pool_thread());
+    latch.wait();
+    assert(sum.load() == 2 * k_outer * k_inner);
+}
+
+/**
+ * @brief stop之后提交的任务在调用线程中执行，不会被丢弃
+ */
+void test_run_after_stop() {
+    printf("test_run_after_stop\n");
+    WorkStealingPool pool("TestPool");
+    pool.start(2);
+    pool.stop();
+    std::atomic<int> sum(0);
+    CountDownLatch latch(3);
+    pool.run(MoveOnlyTask(std::unique_ptr<int>(new int(1)), &sum, &latch));
+    std::vector<Task> tasks;
+    tasks.push_back(Task(MoveOnlyTask(std::unique_ptr<int>(new int(2)), &sum, &latch)));
+    tasks.push_back(Task(MoveOnlyTask(std::unique_ptr<int>(new int(3)), &sum, &latch)));
+    pool.run_batch(tasks);
+    assert(tasks.empty());
+    assert(latch.get_count() == 0);
+    assert(sum.load() == 6);
+}
+
+int main() {
+    test_deque();
+    test_run(0);
+    test_run(1);
+    test_run(4);
+    test_batch_and_nested();
+    test_run_after_stop();
+    printf("test finish successful\n");
+}
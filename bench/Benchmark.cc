@@ -0,0 +1,340 @@
+/**
+ * @brief 微基准测试框架
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "bench/Benchmark.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include "base/Timestamp.h"
+
+namespace web_server {
+
+namespace bench {
+
+namespace {
+
+const int64_t k_max_iterations = 1000LL * 1000 * 1000;
+
+/**
+ * @brief 按纳秒数选择合适的单位
+ */
+std::string format_time(double ns) {
+    char buf[32];
+    if (ns < 1e3) {
+        snprintf(buf, sizeof buf, "%.2f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buf, sizeof buf, "%.2f us", ns / 1e3);
+    } else {
+        snprintf(buf, sizeof buf, "%.2f ms", ns / 1e6);
+    }
+    return buf;
+}
+
+std::string cpu_model() {
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (!file) {
+        return "unknown";
+    }
+    std::string model = "unknown";
+    char line[256];
+    while (fgets(line, sizeof line, file)) {
+        if (strncmp(line, "model name", 10) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                model = colon + 2;
+                model.erase(model.find_last_not_of("\r\n") + 1);
+            }
+            break;
+        }
+    }
+    fclose(file);
+    return model;
+}
+
+std::string escape_json(const std::string &value) {
+    std::string result;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            result.push_back('\\');
+            result.push_back(c);
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief 从pos开始查找"key":，返回值的起始位置，找不到时返回npos
+ */
+size_t find_value(const std::string &json, const char *key, size_t pos, size_t end) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t found = json.find(pattern, pos);
+    if (found == std::string::npos || found >= end) {
+        return std::string::npos;
+    }
+    return found + pattern.size();
+}
+
+} // namespace
+
+double BenchmarkResult::median() const {
+    if (samples.empty()) {
+        return 0;
+    }
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    size_t middle = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+double BenchmarkResult::mean() const {
+    if (samples.empty()) {
+        return 0;
+    }
+    double sum = 0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    return sum / samples.size();
+}
+
+double BenchmarkResult::stddev() const {
+    if (samples.size() < 2) {
+        return 0;
+    }
+    double m = mean();
+    double sum = 0;
+    for (double sample : samples) {
+        sum += (sample - m) * (sample - m);
+    }
+    return std::sqrt(sum / (samples.size() - 1));
+}
+
+double BenchmarkResult::min() const {
+    return samples.empty() ? 0 : *std::min_element(samples.begin(), samples.end());
+}
+
+double BenchmarkResult::max() const {
+    return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+}
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkOptions &options)
+    : options_(options) {}
+
+void BenchmarkRunner::add(const std::string &name, const BenchmarkFunction &function) {
+    entries_.push_back(Entry{name, function});
+}
+
+std::vector<std::string> BenchmarkRunner::names() const {
+    std::vector<std::string> names;
+    for (const Entry &entry : entries_) {
+        if (matches(entry)) {
+            names.push_back(entry.name);
+        }
+    }
+    return names;
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::run(const std::function<void(const BenchmarkResult &)> &progress) {
+    std::vector<BenchmarkResult> results;
+    for (const Entry &entry : entries_) {
+        if (!matches(entry)) {
+            continue;
+        }
+        results.push_back(run_one(entry));
+        if (progress) {
+            progress(results.back());
+        }
+    }
+    return results;
+}
+
+BenchmarkResult BenchmarkRunner::run_one(const Entry &entry) {
+    BenchmarkResult result;
+    result.name = entry.name;
+
+    // 迭代次数按耗时的比例放大，留40%的余量，避免在min_time附近反复倍增
+    const int64_t min_ns = static_cast<int64_t>(options_.min_time * 1e9);
+    int64_t iterations = 1;
+    while (true) {
+        BenchmarkState state(iterations);
+        state.start();
+        entry.function(state);
+        state.stop();
+        result.bytes_per_iteration = state.bytes_per_iteration();
+        int64_t elapsed = state.elapsed_ns();
+        if (elapsed >= min_ns || iterations >= k_max_iterations) {
+            break;
+        }
+        double multiplier = elapsed > min_ns / 10 ? 1.4 * min_ns / elapsed : 10;
+        iterations = std::min(k_max_iterations,
+                              std::max(iterations + 1, static_cast<int64_t>(iterations * multiplier)));
+    }
+    result.iterations = iterations;
+
+    for (int i = 0; i < options_.warmup + options_.repetitions; ++i) {
+        BenchmarkState state(iterations);
+        state.start();
+        entry.function(state);
+        state.stop();
+        if (i >= options_.warmup) {
+            result.samples.push_back(static_cast<double>(state.elapsed_ns()) / iterations);
+        }
+    }
+    return result;
+}
+
+std::string BenchmarkRunner::format(const BenchmarkResult &result) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "%-40s %12s %11s %6.2f%% %12lld", result.name.c_str(),
+             format_time(result.median()).c_str(), format_time(result.min()).c_str(), result.cv() * 100,
+             static_cast<long long>(result.iterations));
+    std::string line(buf);
+    if (result.bytes_per_iteration > 0) {
+        snprintf(buf, sizeof buf, " %10.1f MB/s", result.bytes_per_second() / (1024 * 1024));
+        line.append(buf);
+    }
+    return line;
+}
+
+std::string BenchmarkRunner::to_json(const std::vector<BenchmarkResult> &results, const BenchmarkOptions &options) {
+    char host[256] = "unknown";
+    ::gethostname(host, sizeof host);
+    host[sizeof host - 1] = '\0';
+#ifdef __OPTIMIZE__
+    const bool optimized = true;
+#else
+    const bool optimized = false;
+#endif
+#ifdef NDEBUG
+    const bool assertions = false;
+#else
+    const bool assertions = true;
+#endif
+
+    std::string output;
+    char buf[512];
+    snprintf(buf, sizeof buf, "{\"context\":{\"date\":\"%s\",\"host\":\"%s\",\"cpu\":\"%s\",\"cpus\":%ld,"
+             "\"optimized\":%s,\"assertions\":%s,\"min_time\":%.3f,\"repetitions\":%d,\"warmup\":%d},\n",
+             Timestamp::now().to_formatted_string(false).c_str(), escape_json(host).c_str(),
+             escape_json(cpu_model()).c_str(), sysconf(_SC_NPROCESSORS_ONLN), optimized ? "true" : "false",
+             assertions ? "true" : "false", options.min_time, options.repetitions, options.warmup);
+    output.append(buf);
+    output.append("\"unit\":\"ns\",\"benchmarks\":[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult &result = results[i];
+        snprintf(buf, sizeof buf, "{\"name\":\"%s\",\"iterations\":%lld,\"bytes_per_iteration\":%lld,"
+                 "\"median\":%.3f,\"mean\":%.3f,\"stddev\":%.3f,\"min\":%.3f,\"max\":%.3f,\"cv\":%.5f,"
+                 "\"bytes_per_second\":%.0f,\"samples\":[",
+                 escape_json(result.name).c_str(), static_cast<long long>(result.iterations),
+                 static_cast<long long>(result.bytes_per_iteration), result.median(), result.mean(),
+                 result.stddev(), result.min(), result.max(), result.cv(), result.bytes_per_second());
+        output.append(buf);
+        for (size_t j = 0; j < result.samples.size(); ++j) {
+            snprintf(buf, sizeof buf, "%s%.3f", j ? "," : "", result.samples[j]);
+            output.append(buf);
+        }
+        output.append(i + 1 < results.size() ? "]},\n" : "]}\n");
+    }
+    output.append("]}\n");
+    return output;
+}
+
+bool BenchmarkRunner::from_json(const std::string &json, std::vector<BenchmarkResult> *results) {
+    results->clear();
+    size_t pos = json.find("\"benchmarks\":[");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    const std::string name_key = "{\"name\":\"";
+    while ((pos = json.find(name_key, pos)) != std::string::npos) {
+        size_t name_start = pos + name_key.size();
+        size_t name_end = json.find('"', name_start);
+        size_t end = json.find('}', name_start);
+        if (name_end == std::string::npos || end == std::string::npos) {
+            return false;
+        }
+        BenchmarkResult result;
+        result.name = json.substr(name_start, name_end - name_start);
+        size_t value = find_value(json, "iterations", name_end, end);
+        size_t bytes = find_value(json, "bytes_per_iteration", name_end, end);
+        size_t samples = find_value(json, "samples", name_end, end);
+        if (value == std::string::npos || bytes == std::string::npos || samples == std::string::npos ||
+            json[samples] != '[') {
+            return false;
+        }
+        result.iterations = strtoll(json.c_str() + value, nullptr, 10);
+        result.bytes_per_iteration = strtoll(json.c_str() + bytes, nullptr, 10);
+        const char *p = json.c_str() + samples + 1;
+        while (*p != ']') {
+            char *next = nullptr;
+            double sample = strtod(p, &next);
+            if (next == p) {
+                return false;
+            }
+            result.samples.push_back(sample);
+            p = *next == ',' ? next + 1 : next;
+        }
+        results->push_back(result);
+        pos = end;
+    }
+    return true;
+}
+
+std::string BenchmarkRunner::compare(const std::vector<BenchmarkResult> &baseline,
+                                     const std::vector<BenchmarkResult> &current, double threshold) {
+    std::map<std::string, const BenchmarkResult *> base;
+    for (const BenchmarkResult &result : baseline) {
+        base[result.name] = &result;
+    }
+    std::string output;
+    char buf[256];
+    snprintf(buf, sizeof buf, "%-40s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    output.append(buf);
+    for (const BenchmarkResult &result : current) {
+        auto it = base.find(result.name);
+        if (it == base.end()) {
+            snprintf(buf, sizeof buf, "%-40s %12s %12s %9s  new\n", result.name.c_str(), "-",
+                     format_time(result.median()).c_str(), "-");
+            output.append(buf);
+            continue;
+        }
+        const BenchmarkResult &old = *it->second;
+        double change = old.median() > 0 ? result.median() / old.median() - 1 : 0;
+        // 两次运行各自的离散程度也是变化的下限，噪声范围内的差别不算回退
+        double noise = std::max(threshold, 2 * std::max(old.cv(), result.cv()));
+        const char *verdict = "";
+        if (change > noise) {
+            verdict = "  slower";
+        } else if (change < -noise) {
+            verdict = "  faster";
+        }
+        snprintf(buf, sizeof buf, "%-40s %12s %12s %+8.2f%%%s\n", result.name.c_str(),
+                 format_time(old.median()).c_str(), format_time(result.median()).c_str(), change * 100, verdict);
+        output.append(buf);
+        base.erase(it);
+    }
+    for (const auto &item : base) {
+        snprintf(buf, sizeof buf, "%-40s %12s %12s %9s  removed\n", item.first.c_str(),
+                 format_time(item.second->median()).c_str(), "-", "-");
+        output.append(buf);
+    }
+    return output;
+}
+
+} // namespace bench
+
+} // namespace web_server
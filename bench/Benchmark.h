@@ -0,0 +1,210 @@
+/**
+ * @brief 微基准测试框架：自动确定迭代次数，重复采样给出中位数和离散程度，结果可以输出为JSON并和基线比较
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BENCH_BENCHMARK_H
+#define WEB_SERVER_BENCH_BENCHMARK_H
+
+#include <time.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+namespace bench {
+
+/**
+ * @brief 阻止编译器把没有副作用的计算优化掉
+ */
+template <typename T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief 要求编译器认为所有内存都可能被读写，写入不会被合并或者删除
+ */
+inline void clobber_memory() {
+    asm volatile("" : : : "memory");
+}
+
+inline int64_t monotonic_ns() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 一次采样的状态，基准函数执行iterations()次被测操作；
+ * 每次迭代都要做的准备工作可以放在pause_timing和resume_timing之间，不计入耗时
+ */
+class BenchmarkState : private Noncopyable {
+public:
+    explicit BenchmarkState(int64_t iterations)
+        : iterations_(iterations),
+          bytes_per_iteration_(0),
+          start_ns_(0),
+          elapsed_ns_(0),
+          running_(false) {}
+
+    int64_t iterations() const {
+        return iterations_;
+    }
+
+    void pause_timing() {
+        elapsed_ns_ += monotonic_ns() - start_ns_;
+        running_ = false;
+    }
+
+    void resume_timing() {
+        running_ = true;
+        start_ns_ = monotonic_ns();
+    }
+
+    /**
+     * @brief 每次迭代处理的字节数，设置之后报告吞吐量
+     */
+    void set_bytes_per_iteration(int64_t bytes) {
+        bytes_per_iteration_ = bytes;
+    }
+
+    int64_t bytes_per_iteration() const {
+        return bytes_per_iteration_;
+    }
+
+    /**
+     * @brief 开始计时，由BenchmarkRunner在调用基准函数之前调用
+     */
+    void start() {
+        elapsed_ns_ = 0;
+        resume_timing();
+    }
+
+    void stop() {
+        if (running_) {
+            pause_timing();
+        }
+    }
+
+    int64_t elapsed_ns() const {
+        return elapsed_ns_;
+    }
+
+private:
+    const int64_t iterations_;
+    int64_t bytes_per_iteration_;
+    int64_t start_ns_;
+    int64_t elapsed_ns_;
+    bool running_;
+};
+
+typedef std::function<void(BenchmarkState &)> BenchmarkFunction;
+
+struct BenchmarkOptions {
+    double min_time = 0.1;                      // 每次采样至少运行的秒数，迭代次数据此确定
+    int repetitions = 10;                       // 计入统计的采样次数
+    int warmup = 1;                             // 正式采样之前丢弃的采样次数
+    std::string filter;                         // 只运行名字包含该子串的基准
+};
+
+struct BenchmarkResult {
+    std::string name;
+    int64_t iterations = 0;                     // 每次采样的迭代次数
+    int64_t bytes_per_iteration = 0;
+    std::vector<double> samples;                // 每次采样的纳秒每次迭代
+
+    double median() const;
+
+    double mean() const;
+
+    double stddev() const;
+
+    double min() const;
+
+    double max() const;
+
+    /**
+     * @brief 变异系数stddev / mean，用来判断结果是否稳定
+     */
+    double cv() const {
+        double m = mean();
+        return m > 0 ? stddev() / m : 0;
+    }
+
+    /**
+     * @brief 按中位数计算的吞吐量，字节每秒，没有设置字节数时为0
+     */
+    double bytes_per_second() const {
+        double m = median();
+        return m > 0 ? bytes_per_iteration * 1e9 / m : 0;
+    }
+};
+
+/**
+ * @brief 依次运行注册的基准：先把迭代次数倍增到单次采样超过min_time，
+ * 再用这个迭代次数丢弃warmup次采样后采样repetitions次；统计以中位数为准，不受偶发干扰的影响
+ */
+class BenchmarkRunner : private Noncopyable {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions &options);
+
+    void add(const std::string &name, const BenchmarkFunction &function);
+
+    /**
+     * @brief 名字匹配过滤条件的基准
+     */
+    std::vector<std::string> names() const;
+
+    /**
+     * @brief 运行名字匹配的基准，每完成一个调用一次progress（可以为空）
+     */
+    std::vector<BenchmarkResult> run(const std::function<void(const BenchmarkResult &)> &progress = nullptr);
+
+    /**
+     * @brief 单个基准的一行文本报告
+     */
+    static std::string format(const BenchmarkResult &result);
+
+    static std::string to_json(const std::vector<BenchmarkResult> &results, const BenchmarkOptions &options);
+
+    /**
+     * @brief 读取to_json写出的结果，只保留名字、迭代次数和统计量，不是通用的JSON解析
+     */
+    static bool from_json(const std::string &json, std::vector<BenchmarkResult> *results);
+
+    /**
+     * @brief 和基线逐个比较中位数，变化超过threshold且超过两边的噪声时标出变快或者变慢
+     */
+    static std::string compare(const std::vector<BenchmarkResult> &baseline,
+                               const std::vector<BenchmarkResult> &current, double threshold = 0.05);
+
+private:
+    struct Entry {
+        std::string name;
+        BenchmarkFunction function;
+    };
+
+    bool matches(const Entry &entry) const {
+        return options_.filter.empty() || entry.name.find(options_.filter) != std::string::npos;
+    }
+
+    BenchmarkResult run_one(const Entry &entry);
+
+    const BenchmarkOptions options_;
+    std::vector<Entry> entries_;
+};
+
+} // namespace bench
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BENCH_BENCHMARK_H
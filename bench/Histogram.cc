@@ -0,0 +1,156 @@
+/**
+ * @brief HDR直方图
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "bench/Histogram.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace web_server {
+
+namespace bench {
+
+Histogram::Histogram(int64_t highest_trackable, int significant_digits)
+    : highest_trackable_(highest_trackable),
+      significant_digits_(significant_digits),
+      total_count_(0),
+      min_value_(std::numeric_limits<int64_t>::max()),
+      max_value_(0),
+      sum_(0),
+      sum_of_squares_(0) {
+    assert(significant_digits >= 1 && significant_digits <= 5);
+    assert(highest_trackable >= 2);
+    // 第一个桶要能以1为精度表示[0, 2 * 10^digits)
+    int64_t single_unit_limit = 2;
+    for (int i = 0; i < significant_digits; ++i) {
+        single_unit_limit *= 10;
+    }
+    int sub_bucket_count_magnitude = 0;
+    while ((int64_t(1) << sub_bucket_count_magnitude) < single_unit_limit) {
+        ++sub_bucket_count_magnitude;
+    }
+    sub_bucket_half_count_magnitude_ = sub_bucket_count_magnitude - 1;
+    int64_t sub_bucket_count = int64_t(1) << sub_bucket_count_magnitude;
+    sub_bucket_half_count_ = sub_bucket_count / 2;
+    sub_bucket_mask_ = sub_bucket_count - 1;
+
+    int bucket_count = 1;
+    int64_t smallest_untrackable = sub_bucket_count;
+    while (smallest_untrackable <= highest_trackable) {
+        ++bucket_count;
+        if (smallest_untrackable > std::numeric_limits<int64_t>::max() / 2) {
+            break;
+        }
+        smallest_untrackable <<= 1;
+    }
+    counts_.assign(static_cast<size_t>((bucket_count + 1) * sub_bucket_half_count_), 0);
+}
+
+void Histogram::record(int64_t value, int64_t count) {
+    value = std::max<int64_t>(0, std::min(value, highest_trackable_));
+    counts_[counts_index(value)] += count;
+    total_count_ += count;
+    min_value_ = std::min(min_value_, value);
+    max_value_ = std::max(max_value_, value);
+    sum_ += static_cast<double>(value) * count;
+    sum_of_squares_ += static_cast<double>(value) * value * count;
+}
+
+void Histogram::add(const Histogram &other) {
+    assert(highest_trackable_ == other.highest_trackable_ && significant_digits_ == other.significant_digits_);
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+    min_value_ = std::min(min_value_, other.min_value_);
+    max_value_ = std::max(max_value_, other.max_value_);
+    sum_ += other.sum_;
+    sum_of_squares_ += other.sum_of_squares_;
+}
+
+void Histogram::reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    min_value_ = std::numeric_limits<int64_t>::max();
+    max_value_ = 0;
+    sum_ = 0;
+    sum_of_squares_ = 0;
+}
+
+int64_t Histogram::min() const {
+    return total_count_ == 0 ? 0 : min_value_;
+}
+
+int64_t Histogram::max() const {
+    return max_value_;
+}
+
+double Histogram::mean() const {
+    return total_count_ == 0 ? 0 : sum_ / total_count_;
+}
+
+double Histogram::stddev() const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    double m = mean();
+    double variance = sum_of_squares_ / total_count_ - m * m;
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+int64_t Histogram::value_at_percentile(double percentile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    percentile = std::max(0.0, std::min(percentile, 100.0));
+    int64_t target = static_cast<int64_t>(percentile / 100 * total_count_ + 0.5);
+    target = std::max<int64_t>(target, 1);
+    int64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return std::min(highest_equivalent_value(value_from_index(i)), max_value_);
+        }
+    }
+    return max_value_;
+}
+
+/**
+ * @brief 值所在的桶由最高位决定，桶内按右移之后的值线性分成子桶；
+ * 除第一个桶外，每个桶只用上半部分子桶，下半部分与前一个桶重合
+ */
+size_t Histogram::counts_index(int64_t value) const {
+    int pow2_ceiling = 64 - __builtin_clzll(static_cast<uint64_t>(value | sub_bucket_mask_));
+    int bucket_index = pow2_ceiling - (sub_bucket_half_count_magnitude_ + 1);
+    int64_t sub_bucket_index = value >> bucket_index;
+    return static_cast<size_t>((static_cast<int64_t>(bucket_index + 1) << sub_bucket_half_count_magnitude_) +
+                               (sub_bucket_index - sub_bucket_half_count_));
+}
+
+int64_t Histogram::value_from_index(size_t index) const {
+    int bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    int64_t sub_bucket_index = static_cast<int64_t>(index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket_index < 0) {
+        sub_bucket_index -= sub_bucket_half_count_;
+        bucket_index = 0;
+    }
+    return sub_bucket_index << bucket_index;
+}
+
+int64_t Histogram::highest_equivalent_value(int64_t value) const {
+    int pow2_ceiling = 64 - __builtin_clzll(static_cast<uint64_t>(value | sub_bucket_mask_));
+    int bucket_index = pow2_ceiling - (sub_bucket_half_count_magnitude_ + 1);
+    int64_t lowest = (value >> bucket_index) << bucket_index;
+    return lowest + (int64_t(1) << bucket_index) - 1;
+}
+
+} // namespace bench
+
+} // namespace web_server
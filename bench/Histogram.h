@@ -0,0 +1,91 @@
+/**
+ * @brief HDR直方图：在固定的有效数字精度下记录很大范围的数值，记录和合并都是O(1)/O(桶数)
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BENCH_HISTOGRAM_H
+#define WEB_SERVER_BENCH_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "base/Copyable.h"
+
+namespace web_server {
+
+namespace bench {
+
+/**
+ * @brief 按HdrHistogram的布局分桶：第一个桶线性覆盖[0, 2 * 10^digits)，之后每个桶的范围翻倍、
+ * 桶内的线性子桶数不变，因此任何数值的记录误差都不超过10^-digits；
+ * 不加锁，每个线程各自记录，结束后用add合并
+ */
+class Histogram : public Copyable {
+public:
+    /**
+     * @param highest_trackable 能区分的最大值，更大的值按该值记录
+     * @param significant_digits 有效数字位数，1到5
+     */
+    explicit Histogram(int64_t highest_trackable = 3600LL * 1000 * 1000, int significant_digits = 3);
+
+    /**
+     * @brief 记录一个非负值，负值按0记录
+     */
+    void record(int64_t value) {
+        record(value, 1);
+    }
+
+    void record(int64_t value, int64_t count);
+
+    /**
+     * @brief 合并另一个直方图，两者的参数必须相同
+     */
+    void add(const Histogram &other);
+
+    void reset();
+
+    int64_t count() const {
+        return total_count_;
+    }
+
+    int64_t min() const;
+
+    int64_t max() const;
+
+    double mean() const;
+
+    double stddev() const;
+
+    /**
+     * @brief 至少percentile%的记录不大于返回值，返回值是所在子桶的上界
+     * @param percentile 0到100
+     */
+    int64_t value_at_percentile(double percentile) const;
+
+private:
+    size_t counts_index(int64_t value) const;
+    int64_t value_from_index(size_t index) const;
+    int64_t highest_equivalent_value(int64_t value) const;
+
+    int64_t highest_trackable_;
+    int significant_digits_;
+    int sub_bucket_half_count_magnitude_;
+    int64_t sub_bucket_half_count_;
+    int64_t sub_bucket_mask_;
+    std::vector<int64_t> counts_;
+    int64_t total_count_;
+    int64_t min_value_;
+    int64_t max_value_;
+    double sum_;                            // 精确的和与平方和，平均值和标准差不受分桶精度影响
+    double sum_of_squares_;
+};
+
+} // namespace bench
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BENCH_HISTOGRAM_H
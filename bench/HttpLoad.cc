@@ -0,0 +1,150 @@
+/**
+ * @brief http压测工具，代替webbench：keep-alive、流水线、闭环和固定速率开环、HDR延迟分布、JSON输出
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <getopt.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "base/Logging.h"
+#include "bench/LoadGenerator.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::bench;
+
+namespace {
+
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [options] http://IP:port/path\n"
+            "  -t threads      IO线程数，默认1\n"
+            "  -c connections  连接数，默认10\n"
+            "  -d seconds      计时时长，默认10\n"
+            "  -w seconds      预热时长，不计入结果，默认0\n"
+            "  -R rate         所有连接合计的请求速率（每秒），开环压测；默认闭环\n"
+            "  -p depth        每个连接的流水线深度，默认1\n"
+            "  -C              每个请求新建连接（Connection: close）\n"
+            "  -m method       请求方法，默认GET\n"
+            "  -H header       附加请求首部，例如-H 'Accept: */*'，可以重复\n"
+            "  -b body         请求体\n"
+            "  -j file         把JSON格式的结果写到文件，-表示标准输出\n",
+            program);
+}
+
+/**
+ * @brief 解析http://IP:port/path，只支持数字形式的IPv4地址
+ */
+bool parse_url(const std::string &url, std::string *ip, uint16_t *port, std::string *path) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+    size_t host_start = scheme.size();
+    size_t slash = url.find('/', host_start);
+    std::string host = url.substr(host_start, slash == std::string::npos ? std::string::npos : slash - host_start);
+    *path = slash == std::string::npos ? "/" : url.substr(slash);
+    size_t colon = host.find(':');
+    *ip = host.substr(0, colon);
+    int value = colon == std::string::npos ? 80 : atoi(host.c_str() + colon + 1);
+    if (ip->empty() || value <= 0 || value > 65535) {
+        return false;
+    }
+    *port = static_cast<uint16_t>(value);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    std::string json_file;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:c:d:w:R:p:Cm:H:b:j:h")) != -1) {
+        switch (opt) {
+        case 't':
+            options.threads = atoi(optarg);
+            break;
+        case 'c':
+            options.connections = atoi(optarg);
+            break;
+        case 'd':
+            options.duration = atof(optarg);
+            break;
+        case 'w':
+            options.warmup = atof(optarg);
+            break;
+        case 'R':
+            options.rate = atof(optarg);
+            break;
+        case 'p':
+            options.pipeline = atoi(optarg);
+            break;
+        case 'C':
+            options.keep_alive = false;
+            break;
+        case 'm':
+            options.method = optarg;
+            break;
+        case 'H':
+            options.headers.push_back(optarg);
+            break;
+        case 'b':
+            options.body = optarg;
+            break;
+        case 'j':
+            json_file = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    std::string ip;
+    uint16_t port = 0;
+    if (optind + 1 != argc || !parse_url(argv[optind], &ip, &port, &options.path)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (options.threads < 0 || options.connections <= 0 || options.pipeline <= 0 || options.duration <= 0 ||
+        options.rate < 0 || options.warmup < 0) {
+        fprintf(stderr, "invalid option value\n");
+        return 1;
+    }
+    if (!options.keep_alive && options.pipeline > 1) {
+        fprintf(stderr, "pipelining requires keep-alive connections\n");
+        return 1;
+    }
+
+    // 连接失败等情况由结果中的计数报告，不需要逐条日志
+    Logger::set_log_level(Logger::ERROR);
+    net::EventLoop loop;
+    LoadGenerator generator(&loop, net::InetAddress(ip, port), options);
+    printf("%s %s, %d threads, %d connections, pipeline %d, %s\n", options.method.c_str(), argv[optind],
+           options.threads, options.connections, options.pipeline,
+           options.rate > 0 ? ("open loop " + std::to_string(options.rate) + " requests/sec").c_str() : "closed loop");
+    LoadResult result = generator.run();
+    printf("%s", result.to_string().c_str());
+
+    if (!json_file.empty()) {
+        std::string json = result.to_json(options);
+        if (json_file == "-") {
+            fputs(json.c_str(), stdout);
+        } else {
+            FILE *file = fopen(json_file.c_str(), "w");
+            if (!file) {
+                perror(json_file.c_str());
+                return 1;
+            }
+            fputs(json.c_str(), file);
+            fclose(file);
+        }
+    }
+    return 0;
+}
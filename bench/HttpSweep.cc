@@ -0,0 +1,151 @@
+/**
+ * @brief 回环端到端扫描工具：按IO线程数、连接数和流水线深度测量吞吐量、延迟和每个请求的CPU时间，用来选择set_thread_num
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <getopt.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "base/Logging.h"
+#include "bench/Sweep.h"
+
+using namespace web_server;
+using namespace web_server::bench;
+
+namespace {
+
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -t list         服务端IO线程数，例如0,1,2,4或者0-8，默认0,1,2,4\n"
+            "  -c list         连接数，默认100\n"
+            "  -p list         流水线深度，默认1\n"
+            "  -T threads      压测客户端的IO线程数，默认1\n"
+            "  -d seconds      每个组合计时的时长，默认3\n"
+            "  -w seconds      每个组合的预热时长，默认1\n"
+            "  -W workers      服务端计算线程数，默认0\n"
+            "  -s bytes        响应体字节数，默认13\n"
+            "  -u us           回调中忙等的微秒数，默认0\n"
+            "  -P port         监听127.0.0.1上的端口，默认18047\n"
+            "  -S cpus         服务端线程绑定的CPU，例如0-3\n"
+            "  -C cpus         压测客户端线程绑定的CPU，例如4-7\n"
+            "  -j file         把JSON格式的结果写到文件，-表示标准输出\n",
+            program);
+}
+
+bool parse_list(const char *name, const char *text, std::vector<int> *values) {
+    if (!parse_int_list(text, values)) {
+        fprintf(stderr, "invalid %s list: %s\n", name, text);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    SweepOptions options;
+    std::string json_file;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:c:p:T:d:w:W:s:u:P:S:C:j:h")) != -1) {
+        bool ok = true;
+        switch (opt) {
+        case 't':
+            ok = parse_list("thread", optarg, &options.threads);
+            break;
+        case 'c':
+            ok = parse_list("connection", optarg, &options.connections);
+            break;
+        case 'p':
+            ok = parse_list("pipeline", optarg, &options.pipeline);
+            break;
+        case 'T':
+            options.client_threads = atoi(optarg);
+            break;
+        case 'd':
+            options.duration = atof(optarg);
+            break;
+        case 'w':
+            options.warmup = atof(optarg);
+            break;
+        case 'W':
+            options.workers = atoi(optarg);
+            break;
+        case 's':
+            options.body_size = static_cast<size_t>(atol(optarg));
+            break;
+        case 'u':
+            options.work_us = atoi(optarg);
+            break;
+        case 'P':
+            options.port = static_cast<uint16_t>(atoi(optarg));
+            break;
+        case 'S':
+            ok = parse_list("server CPU", optarg, &options.server_cpus);
+            break;
+        case 'C':
+            ok = parse_list("client CPU", optarg, &options.client_cpus);
+            break;
+        case 'j':
+            json_file = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            return 1;
+        }
+    }
+    if (optind != argc || options.client_threads < 0 || options.duration <= 0 || options.warmup < 0 ||
+        options.workers < 0 || options.work_us < 0 || options.port == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (int pipeline : options.pipeline) {
+        if (pipeline == 0) {
+            fprintf(stderr, "pipeline depth must be positive\n");
+            return 1;
+        }
+    }
+    for (int connections : options.connections) {
+        if (connections == 0) {
+            fprintf(stderr, "connection count must be positive\n");
+            return 1;
+        }
+    }
+
+    // 每个组合结束时客户端直接断开连接，服务端的连接错误日志不说明问题，客户端的错误计入errors一栏
+    Logger::set_log_level(Logger::FATAL);
+    // 表格输出到stderr，-j -时标准输出只有JSON
+    FILE *out = json_file == "-" ? stderr : stdout;
+    fprintf(out, "%s\n", Sweep::header().c_str());
+    Sweep sweep(options);
+    std::vector<SweepPoint> points = sweep.run([out](const SweepPoint &point) {
+        fprintf(out, "%s\n", Sweep::format(point).c_str());
+        fflush(out);
+    });
+    fprintf(out, "\n%s", Sweep::summary(points).c_str());
+
+    if (!json_file.empty()) {
+        std::string json = Sweep::to_json(points, options);
+        if (json_file == "-") {
+            fputs(json.c_str(), stdout);
+        } else {
+            FILE *file = fopen(json_file.c_str(), "w");
+            if (!file) {
+                perror(json_file.c_str());
+                return 1;
+            }
+            fputs(json.c_str(), file);
+            fclose(file);
+        }
+    }
+    return 0;
+}
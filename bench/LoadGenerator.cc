@@ -0,0 +1,539 @@
+/**
+ * @brief 基于EventLoopThreadPool和TcpClient的http压测客户端
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "bench/LoadGenerator.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <deque>
+
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "http/HttpResponseParser.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpClient.h"
+#include "net/TcpConnection.h"
+
+namespace web_server {
+
+namespace bench {
+
+using namespace web_server::net;
+
+namespace {
+
+const double k_reconnect_delay = 0.1;
+const double k_percentiles[] = {50, 75, 90, 99, 99.9, 99.99};
+
+int64_t now_us() {
+    return Timestamp::now().micro_seconds_since_epoch();
+}
+
+void append_format(std::string *output, const char *format, double value) {
+    char buf[64];
+    snprintf(buf, sizeof buf, format, value);
+    output->append(buf);
+}
+
+void append_histogram_json(std::string *output, const char *name, const Histogram &histogram) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "\"%s\":{\"count\":%lld,\"min\":%lld,\"mean\":%.1f,\"stddev\":%.1f,\"max\":%lld,"
+             "\"percentiles\":{", name, static_cast<long long>(histogram.count()),
+             static_cast<long long>(histogram.min()), histogram.mean(), histogram.stddev(),
+             static_cast<long long>(histogram.max()));
+    output->append(buf);
+    bool first = true;
+    for (double percentile : k_percentiles) {
+        snprintf(buf, sizeof buf, "%s\"%g\":%lld", first ? "" : ",", percentile,
+                 static_cast<long long>(histogram.value_at_percentile(percentile)));
+        output->append(buf);
+        first = false;
+    }
+    output->append("}}");
+}
+
+void append_histogram_text(std::string *output, const char *name, const Histogram &histogram) {
+    char buf[256];
+    snprintf(buf, sizeof buf, "%-13s min %.3f  mean %.3f  stddev %.3f  max %.3f\n", name,
+             histogram.min() / 1000.0, histogram.mean() / 1000.0, histogram.stddev() / 1000.0,
+             histogram.max() / 1000.0);
+    output->append(buf);
+    output->append("              ");
+    for (double percentile : k_percentiles) {
+        snprintf(buf, sizeof buf, " p%g %.3f ", percentile, histogram.value_at_percentile(percentile) / 1000.0);
+        output->append(buf);
+    }
+    output->append("\n");
+}
+
+/**
+ * @brief JSON字符串中需要转义的字符
+ */
+std::string escape_json(const std::string &value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", c);
+            escaped += buf;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+void LoadResult::add(const LoadResult &other) {
+    requests += other.requests;
+    bytes += other.bytes;
+    connect_errors += other.connect_errors;
+    read_errors += other.read_errors;
+    bad_responses += other.bad_responses;
+    backlog += other.backlog;
+    elapsed = std::max(elapsed, other.elapsed);
+    for (const auto &item : other.status_codes) {
+        status_codes[item.first] += item.second;
+    }
+    latency.add(other.latency);
+    service_time.add(other.service_time);
+}
+
+std::string LoadResult::to_string() const {
+    std::string output;
+    char buf[256];
+    snprintf(buf, sizeof buf, "%lld requests in %.2fs, %.2f requests/sec, %.2f MB/sec\n",
+             static_cast<long long>(requests), elapsed, requests_per_second(),
+             elapsed > 0 ? bytes / elapsed / (1024 * 1024) : 0);
+    output.append(buf);
+    snprintf(buf, sizeof buf, "errors: connect %lld, read %lld, bad response %lld, backlog %lld\n",
+             static_cast<long long>(connect_errors), static_cast<long long>(read_errors),
+             static_cast<long long>(bad_responses), static_cast<long long>(backlog));
+    output.append(buf);
+    output.append("status:");
+    for (const auto &item : status_codes) {
+        snprintf(buf, sizeof buf, " %d=%lld", item.first, static_cast<long long>(item.second));
+        output.append(buf);
+    }
+    output.append("\n");
+    append_histogram_text(&output, "latency(ms)", latency);
+    append_histogram_text(&output, "service(ms)", service_time);
+    return output;
+}
+
+std::string LoadResult::to_json(const LoadOptions &options) const {
+    std::string output;
+    char buf[256];
+    snprintf(buf, sizeof buf, "{\"config\":{\"method\":\"%s\",\"path\":\"",
+             escape_json(options.method).c_str());
+    output.append(buf);
+    output.append(escape_json(options.path));
+    snprintf(buf, sizeof buf, "\",\"threads\":%d,\"connections\":%d,\"pipeline\":%d,\"keep_alive\":%s,",
+             options.threads, options.connections, options.pipeline, options.keep_alive ? "true" : "false");
+    output.append(buf);
+    append_format(&output, "\"rate\":%.3f,", options.rate);
+    append_format(&output, "\"duration\":%.3f,", options.duration);
+    append_format(&output, "\"warmup\":%.3f},", options.warmup);
+    snprintf(buf, sizeof buf, "\"requests\":%lld,\"bytes\":%lld,", static_cast<long long>(requests),
+             static_cast<long long>(bytes));
+    output.append(buf);
+    append_format(&output, "\"elapsed\":%.6f,", elapsed);
+    append_format(&output, "\"requests_per_second\":%.3f,", requests_per_second());
+    snprintf(buf, sizeof buf, "\"errors\":{\"connect\":%lld,\"read\":%lld,\"bad_response\":%lld},\"backlog\":%lld,",
+             static_cast<long long>(connect_errors), static_cast<long long>(read_errors),
+             static_cast<long long>(bad_responses), static_cast<long long>(backlog));
+    output.append(buf);
+    output.append("\"status\":{");
+    bool first = true;
+    for (const auto &item : status_codes) {
+        snprintf(buf, sizeof buf, "%s\"%d\":%lld", first ? "" : ",", item.first, static_cast<long long>(item.second));
+        output.append(buf);
+        first = false;
+    }
+    output.append("},\"unit\":\"us\",");
+    append_histogram_json(&output, "latency", latency);
+    output.append(",");
+    append_histogram_json(&output, "service_time", service_time);
+    output.append("}\n");
+    return output;
+}
+
+/**
+ * @brief 一个loop中的连接，start之后所有成员只在该loop线程中访问
+ */
+class LoadGenerator::Worker : private Noncopyable {
+public:
+    Worker(LoadGenerator *owner, EventLoop *loop, int index)
+        : owner_(owner),
+          loop_(loop),
+          index_(index),
+          running_(false),
+          measure_us_(0),
+          end_us_(0) {}
+
+    EventLoop *loop() const {
+        return loop_;
+    }
+
+    const LoadResult &result() const {
+        return result_;
+    }
+
+    /**
+     * @brief 在start之前分配连接
+     * @param first_intended 开环时该连接第一个请求的计划时间相对开始时间的偏移，微秒
+     */
+    void add_connection(double first_intended) {
+        std::unique_ptr<Connection> conn(new Connection);
+        conn->index = static_cast<int>(connections_.size());
+        conn->next_intended = first_intended;
+        connections_.push_back(std::move(conn));
+    }
+
+    void start(int64_t start_us, int64_t measure_us, int64_t end_us) {
+        loop_->assert_in_loop_thread();
+        running_ = true;
+        measure_us_ = measure_us;
+        end_us_ = end_us;
+        for (const std::unique_ptr<Connection> &conn : connections_) {
+            conn->next_intended += static_cast<double>(start_us);
+            connect(conn.get());
+            if (owner_->options_.rate > 0) {
+                schedule(conn.get());
+            }
+        }
+    }
+
+    /**
+     * @brief 停止发送并断开全部连接，之后不会再有回调访问Worker
+     */
+    void stop() {
+        loop_->assert_in_loop_thread();
+        running_ = false;
+        for (const std::unique_ptr<Connection> &conn : connections_) {
+            loop_->cancel(conn->timer);
+            loop_->cancel(conn->retry_timer);
+            result_.backlog += static_cast<int64_t>(conn->scheduled.size());
+            conn->conn.reset();
+            release_tcp_client(&conn->client);
+        }
+    }
+
+private:
+    struct Pending {
+        int64_t intended;       // 计划发送的时间，闭环时等于实际发送的时间
+        int64_t sent;
+    };
+
+    struct Connection {
+        int index = 0;
+        int next_conn_ID = 1;
+        std::shared_ptr<TcpClient> client;  // 建立连接期间和连接存在期间非空
+        TcpConnectionPtr conn;
+        bool closing = false;               // 收到了不能保持连接的响应，等待断开
+        http::HttpResponseParser parser;
+        http::HttpBodyReader body;
+        std::deque<Pending> inflight;
+        std::deque<int64_t> scheduled;      // 开环时已到计划时间、还没有发出的请求
+        double next_intended = 0;           // 开环时下一个请求的计划时间，微秒
+        int64_t connect_start = 0;          // 不保持连接时，闭环的延迟从开始建立连接算起
+        TimerID timer;                      // 开环时的下一次计划
+        TimerID retry_timer;
+    };
+
+    bool measuring(int64_t intended, int64_t now) const {
+        return intended >= measure_us_ && now <= end_us_;
+    }
+
+    void connect(Connection *conn) {
+        char buf[48];
+        snprintf(buf, sizeof buf, "load-%d-%d#%d", index_, conn->index, conn->next_conn_ID++);
+        conn->client = std::make_shared<TcpClient>(loop_, owner_->server_addr_, buf);
+        conn->closing = false;
+        conn->connect_start = now_us();
+        conn->client->set_connection_callback(std::bind(&Worker::on_connection, this, conn, _1));
+        conn->client->set_message_callback(std::bind(&Worker::on_message, this, conn, _1, _2));
+        conn->client->set_connect_error_callback([this, conn](int) {
+            ++result_.connect_errors;
+            drop(conn);
+            reconnect_later(conn);
+        });
+        conn->client->connect();
+    }
+
+    void drop(Connection *conn) {
+        conn->conn.reset();
+        conn->parser.reset();
+        release_tcp_client(&conn->client);
+    }
+
+    void reconnect_later(Connection *conn) {
+        if (!running_) {
+            return;
+        }
+        // 开环时连不上的这段时间计划的请求照样排队
+        conn->retry_timer = loop_->run_after(k_reconnect_delay, [this, conn]() {
+            if (running_ && !conn->client) {
+                connect(conn);
+            }
+        });
+    }
+
+    /**
+     * @brief 开环：把到了计划时间的请求排进队列，再为下一个请求定时
+     */
+    void schedule(Connection *conn) {
+        if (!running_) {
+            return;
+        }
+        double interval = owner_->options_.connections / owner_->options_.rate * 1000 * 1000;
+        int64_t now = now_us();
+        while (conn->next_intended <= static_cast<double>(now)) {
+            conn->scheduled.push_back(static_cast<int64_t>(conn->next_intended));
+            conn->next_intended += interval;
+        }
+        send_ready(conn);
+        conn->timer = loop_->run_at(Timestamp(static_cast<int64_t>(conn->next_intended)),
+                                    std::bind(&Worker::schedule, this, conn));
+    }
+
+    /**
+     * @brief 在途请求不足pipeline时发送，闭环时立即发送，开环时发送排队的请求
+     */
+    void send_ready(Connection *conn) {
+        if (!running_ || !conn->conn || conn->closing) {
+            return;
+        }
+        const LoadOptions &options = owner_->options_;
+        size_t depth = options.keep_alive ? static_cast<size_t>(options.pipeline) : 1;
+        int64_t now = now_us();
+        size_t n = 0;
+        while (conn->inflight.size() + n < depth && (options.rate <= 0 || n < conn->scheduled.size())) {
+            ++n;
+        }
+        if (n == 0) {
+            return;
+        }
+        // 流水线的请求一次写出
+        std::string batch;
+        batch.reserve(owner_->request_.size() * n);
+        for (size_t i = 0; i < n; ++i) {
+            int64_t intended = options.keep_alive ? now : conn->connect_start;
+            if (options.rate > 0) {
+                intended = conn->scheduled.front();
+                conn->scheduled.pop_front();
+            }
+            conn->inflight.push_back(Pending{intended, now});
+            batch.append(owner_->request_);
+        }
+        conn->conn->send(batch);
+    }
+
+    void complete(Connection *conn, int64_t now) {
+        Pending pending = conn->inflight.front();
+        conn->inflight.pop_front();
+        if (measuring(pending.intended, now)) {
+            ++result_.requests;
+            ++result_.status_codes[conn->parser.status_code()];
+            result_.latency.record(now - pending.intended);
+            result_.service_time.record(now - pending.sent);
+        }
+    }
+
+    void on_connection(Connection *conn, const TcpConnectionPtr &tcp_conn) {
+        if (tcp_conn->connected()) {
+            conn->conn = tcp_conn;
+            tcp_conn->set_tcp_no_delay(true);
+            conn->parser.reset();
+            send_ready(conn);
+            return;
+        }
+        // 读到连接关闭为止的响应到这里才完整
+        if (!conn->inflight.empty() && conn->parser.head_done() &&
+            conn->body.mode() == http::HttpBodyReader::k_until_close) {
+            complete(conn, now_us());
+        }
+        if (running_ && !conn->closing) {
+            result_.read_errors += static_cast<int64_t>(conn->inflight.size());
+        }
+        requeue(conn);
+        drop(conn);
+        if (running_) {
+            connect(conn);
+        }
+    }
+
+    /**
+     * @brief 连接断开时没有收到响应的请求：开环时按原来的计划时间重新排队，闭环时直接丢弃
+     */
+    void requeue(Connection *conn) {
+        if (owner_->options_.rate > 0) {
+            for (auto it = conn->inflight.rbegin(); it != conn->inflight.rend(); ++it) {
+                conn->scheduled.push_front(it->intended);
+            }
+        }
+        conn->inflight.clear();
+    }
+
+    void on_message(Connection *conn, const TcpConnectionPtr &tcp_conn, Buffer *buf) {
+        if (conn->conn != tcp_conn) {
+            buf->retrieve_all();
+            return;
+        }
+        int64_t now = now_us();
+        if (now >= measure_us_ && now <= end_us_) {
+            result_.bytes += static_cast<int64_t>(buf->readable_bytes());
+        }
+        bool head = owner_->options_.method == "HEAD";
+        while (buf->readable_bytes() > 0 && !conn->closing) {
+            if (conn->inflight.empty()) {
+                bad_response(conn, buf);
+                return;
+            }
+            if (!conn->parser.head_done()) {
+                if (!conn->parser.parse_head(buf)) {
+                    bad_response(conn, buf);
+                    return;
+                }
+                if (!conn->parser.head_done()) {
+                    return;
+                }
+                if (conn->parser.status_code() < 200) {
+                    conn->parser.reset();
+                    continue;
+                }
+                if (!conn->parser.init_body(head, &conn->body)) {
+                    bad_response(conn, buf);
+                    return;
+                }
+            }
+            buf->retrieve(conn->body.feed(buf->peek(), buf->readable_bytes()));
+            if (conn->body.error()) {
+                bad_response(conn, buf);
+                return;
+            }
+            if (!conn->body.done()) {
+                return;
+            }
+            complete(conn, now);
+            bool keep_alive = conn->parser.keep_alive();
+            conn->parser.reset();
+            if (!keep_alive) {
+                // 服务端会关闭连接，主动关闭让TIME_WAIT留在客户端
+                conn->closing = true;
+                buf->retrieve_all();
+                tcp_conn->force_close();
+                return;
+            }
+        }
+        send_ready(conn);
+    }
+
+    void bad_response(Connection *conn, Buffer *buf) {
+        ++result_.bad_responses;
+        buf->retrieve_all();
+        conn->closing = true;
+        conn->inflight.clear();
+        conn->conn->force_close();
+    }
+
+    LoadGenerator *owner_;
+    EventLoop *loop_;
+    const int index_;
+    bool running_;
+    int64_t measure_us_;
+    int64_t end_us_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    LoadResult result_;
+};
+
+LoadGenerator::LoadGenerator(EventLoop *base_loop, const InetAddress &server_addr, const LoadOptions &options)
+    : base_loop_(base_loop),
+      server_addr_(server_addr),
+      options_(options) {
+    assert(options_.connections > 0 && options_.pipeline > 0 && options_.threads >= 0);
+    bool has_host = false;
+    request_ = options_.method + " " + options_.path + " HTTP/1.1\r\n";
+    for (const std::string &header : options_.headers) {
+        has_host = has_host || strncasecmp(header.c_str(), "Host:", 5) == 0;
+        request_ += header + "\r\n";
+    }
+    if (!has_host) {
+        request_ += "Host: " + server_addr_.to_IP_port() + "\r\n";
+    }
+    if (!options_.keep_alive) {
+        request_ += "Connection: close\r\n";
+    }
+    if (!options_.body.empty() || options_.method == "POST" || options_.method == "PUT") {
+        request_ += "Content-Length: " + std::to_string(options_.body.size()) + "\r\n";
+    }
+    request_ += "\r\n";
+    request_ += options_.body;
+}
+
+LoadGenerator::~LoadGenerator() = default;
+
+LoadResult LoadGenerator::run() {
+    base_loop_->assert_in_loop_thread();
+    EventLoopThreadPool pool(base_loop_, "load");
+    pool.set_thread_num(options_.threads);
+    pool.start();
+    std::vector<EventLoop *> loops = pool.get_all_loops();
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < loops.size(); ++i) {
+        workers.emplace_back(new Worker(this, loops[i], static_cast<int>(i)));
+    }
+    // 开环时各连接的计划时间错开，合起来是均匀的请求流
+    double interval = options_.rate > 0 ? options_.connections / options_.rate * 1000 * 1000 : 0;
+    for (int i = 0; i < options_.connections; ++i) {
+        workers[i % workers.size()]->add_connection(interval * i / options_.connections);
+    }
+
+    int64_t start_us = now_us();
+    int64_t measure_us = start_us + static_cast<int64_t>(options_.warmup * 1000 * 1000);
+    int64_t end_us = measure_us + static_cast<int64_t>(options_.duration * 1000 * 1000);
+    for (const std::unique_ptr<Worker> &worker : workers) {
+        worker->loop()->run_in_loop(std::bind(&Worker::start, worker.get(), start_us, measure_us, end_us));
+    }
+    base_loop_->run_after(options_.warmup + options_.duration, [this]() { base_loop_->quit(); });
+    base_loop_->loop();
+
+    LoadResult result;
+    for (const std::unique_ptr<Worker> &worker : workers) {
+        if (worker->loop()->is_in_loop_thread()) {
+            worker->stop();
+        } else {
+            CountDownLatch latch(1);
+            Worker *w = worker.get();
+            worker->loop()->run_in_loop([w, &latch]() {
+                w->stop();
+                latch.count_down();
+            });
+            latch.wait();
+        }
+        result.add(worker->result());
+    }
+    result.elapsed = static_cast<double>(std::min(now_us(), end_us) - measure_us) / (1000 * 1000);
+    // 连接都在base loop中时，关闭连接的回调排在base loop的队列里，执行完再返回
+    base_loop_->run_after(0, [this]() { base_loop_->quit(); });
+    base_loop_->loop();
+    return result;
+}
+
+} // namespace bench
+
+} // namespace web_server
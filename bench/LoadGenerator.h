@@ -0,0 +1,103 @@
+/**
+ * @brief 基于EventLoopThreadPool和TcpClient的http压测客户端
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BENCH_LOADGENERATOR_H
+#define WEB_SERVER_BENCH_LOADGENERATOR_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "bench/Histogram.h"
+#include "net/InetAddress.h"
+
+namespace web_server {
+
+namespace net {
+class EventLoop;
+} // namespace net
+
+namespace bench {
+
+struct LoadOptions {
+    std::string method = "GET";
+    std::string path = "/";
+    std::vector<std::string> headers;           // "Name: value"，没有Host时使用服务端地址
+    std::string body;
+    int threads = 1;                            // IO线程数，为0时所有连接都在调用run的线程中
+    int connections = 10;
+    int pipeline = 1;                           // 每个连接上同时在途的请求数
+    bool keep_alive = true;                     // 为false时每个请求都新建连接，不能和流水线同时使用
+    double rate = 0;                            // 所有连接合计的请求速率，每秒，为0时闭环压测
+    double duration = 10.0;                     // 秒
+    double warmup = 0;                          // 开始计数之前的预热时间，秒
+};
+
+struct LoadResult {
+    int64_t requests = 0;                       // 计时期间完成的请求
+    int64_t bytes = 0;                          // 计时期间读到的字节数
+    int64_t connect_errors = 0;
+    int64_t read_errors = 0;                    // 收到完整响应之前连接断开
+    int64_t bad_responses = 0;
+    int64_t backlog = 0;                        // 开环压测结束时还没有发出的请求
+    double elapsed = 0;                         // 计时的时长，秒
+    std::map<int, int64_t> status_codes;
+    Histogram latency;                          // 开环时从计划发送的时间算起，已修正协调遗漏
+    Histogram service_time;                     // 从实际写出请求算起
+
+    double requests_per_second() const {
+        return elapsed > 0 ? requests / elapsed : 0;
+    }
+
+    void add(const LoadResult &other);
+
+    /**
+     * @brief 文本格式的报告，时间单位为毫秒
+     */
+    std::string to_string() const;
+
+    /**
+     * @brief JSON格式的报告，时间单位为微秒
+     */
+    std::string to_json(const LoadOptions &options) const;
+};
+
+/**
+ * @brief 在每个IO loop中建立一组连接并持续发送请求，所有连接的状态只在所属loop线程中访问
+ * 闭环模式下每个连接收到一个响应就发下一个请求；开环模式下按固定速率计划请求，
+ * 连接上在途的请求已满时计划的请求排队，延迟从计划时间算起，
+ * 这样服务端变慢时排队的时间也计入延迟，不会因为少发请求而掩盖（coordinated omission）；
+ * 不保持连接时闭环的延迟包括建立连接的时间
+ */
+class LoadGenerator : private Noncopyable {
+public:
+    LoadGenerator(net::EventLoop *base_loop, const net::InetAddress &server_addr, const LoadOptions &options);
+    ~LoadGenerator();
+
+    /**
+     * @brief 在base loop线程中调用，运行base loop直到压测结束，返回合并的结果
+     */
+    LoadResult run();
+
+private:
+    class Worker;
+
+    net::EventLoop *base_loop_;
+    const net::InetAddress server_addr_;
+    const LoadOptions options_;
+    std::string request_;                       // 序列化之后的请求
+};
+
+} // namespace bench
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BENCH_LOADGENERATOR_H
@@ -0,0 +1,334 @@
+/**
+ * @brief 回环端到端扫描
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "bench/Sweep.h"
+
+#include <dirent.h>
+#include <sched.h>
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "bench/Benchmark.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "net/EventLoop.h"
+
+namespace web_server {
+
+namespace bench {
+
+using namespace web_server::http;
+using namespace web_server::net;
+
+namespace {
+
+// 服务端所有线程的名字都以此开头：服务端线程本身、IO线程sweep0...和计算线程sweepWorker0...
+const char k_server_name[] = "sweep";
+
+double timespec_seconds(const struct timespec &ts) {
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double process_cpu_seconds() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return timespec_seconds(ts);
+}
+
+/**
+ * @brief 进程内名字以k_server_name开头的线程的CPU时间之和
+ * 线程的CPU时钟按内核的编码由tid得到（和pthread_getcpuclockid相同），不需要在线程内部登记
+ */
+double server_cpu_seconds() {
+    DIR *dir = ::opendir("/proc/self/task");
+    if (!dir) {
+        return 0;
+    }
+    double total = 0;
+    struct dirent *entry = nullptr;
+    while ((entry = ::readdir(dir)) != nullptr) {
+        pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+        if (tid <= 0) {
+            continue;
+        }
+        char path[64];
+        snprintf(path, sizeof path, "/proc/self/task/%d/comm", tid);
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            continue;
+        }
+        char comm[32] = {0};
+        bool is_server = fgets(comm, sizeof comm, file) && strncmp(comm, k_server_name, strlen(k_server_name)) == 0;
+        fclose(file);
+        struct timespec ts;
+        clockid_t clock = static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6);
+        if (is_server && ::clock_gettime(clock, &ts) == 0) {
+            total += timespec_seconds(ts);
+        }
+    }
+    ::closedir(dir);
+    return total;
+}
+
+bool set_affinity(const std::vector<int> &cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return ::sched_setaffinity(0, sizeof set, &set) == 0;
+}
+
+std::string join(const std::vector<int> &values) {
+    std::string result;
+    for (size_t i = 0; i < values.size(); ++i) {
+        result += (i ? "," : "") + std::to_string(values[i]);
+    }
+    return result;
+}
+
+} // namespace
+
+/**
+ * @brief 在单独的线程中运行HttpServer，IO线程和计算线程都由这个线程创建，继承它的CPU绑定
+ */
+class Sweep::ServerThread : private Noncopyable {
+public:
+    ServerThread(const SweepOptions &options, int threads)
+        : options_(options),
+          threads_(threads),
+          body_(options.body_size, 'x'),
+          thread_(std::bind(&ServerThread::thread_func, this), k_server_name),
+          started_(1),
+          loop_(nullptr) {}
+
+    ~ServerThread() {
+        if (loop_) {
+            loop_->quit();
+            thread_.join();
+        }
+    }
+
+    void start() {
+        thread_.start();
+        started_.wait();
+    }
+
+private:
+    void thread_func() {
+        if (!options_.server_cpus.empty()) {
+            set_affinity(options_.server_cpus);
+        }
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress("127.0.0.1", options_.port), k_server_name);
+        server.set_http_callback(std::bind(&ServerThread::handle, this, _1, _2));
+        server.set_thread_num(threads_);
+        if (options_.workers > 0) {
+            server.set_worker_thread_num(options_.workers);
+        }
+        server.start();
+        loop_ = &loop;
+        started_.count_down();
+        loop.loop();
+    }
+
+    void handle(const HttpRequest &, HttpResponse *resp) {
+        if (options_.work_us > 0) {
+            int64_t deadline = monotonic_ns() + options_.work_us * 1000LL;
+            while (monotonic_ns() < deadline) {
+            }
+        }
+        resp->set_status_code(HttpResponse::k_200_ok);
+        resp->set_status_message("OK");
+        resp->set_content_type("text/plain");
+        resp->set_body(body_);
+    }
+
+    const SweepOptions &options_;
+    const int threads_;
+    const std::string body_;
+    Thread thread_;
+    CountDownLatch started_;
+    EventLoop *loop_;
+};
+
+Sweep::Sweep(const SweepOptions &options)
+    : options_(options) {}
+
+std::vector<SweepPoint> Sweep::run(const std::function<void(const SweepPoint &)> &progress) {
+    // 调用线程之后创建的压测线程继承这里的绑定，结束时恢复
+    cpu_set_t saved;
+    bool pinned = !options_.client_cpus.empty() && ::sched_getaffinity(0, sizeof saved, &saved) == 0 &&
+                  set_affinity(options_.client_cpus);
+
+    std::vector<SweepPoint> points;
+    for (int threads : options_.threads) {
+        ServerThread server(options_, threads);
+        server.start();
+        for (int connections : options_.connections) {
+            for (int pipeline : options_.pipeline) {
+                points.push_back(run_point(threads, connections, pipeline));
+                if (progress) {
+                    progress(points.back());
+                }
+            }
+        }
+    }
+
+    if (pinned) {
+        ::sched_setaffinity(0, sizeof saved, &saved);
+    }
+    return points;
+}
+
+SweepPoint Sweep::run_point(int threads, int connections, int pipeline) {
+    LoadOptions load;
+    load.threads = options_.client_threads;
+    load.connections = connections;
+    load.pipeline = pipeline;
+    InetAddress server_addr("127.0.0.1", options_.port);
+
+    // 预热单独运行，之后的CPU时间只覆盖计时的部分和建立连接
+    if (options_.warmup > 0) {
+        load.duration = options_.warmup;
+        EventLoop loop;
+        LoadGenerator(&loop, server_addr, load).run();
+    }
+
+    SweepPoint point;
+    point.threads = threads;
+    point.connections = connections;
+    point.pipeline = pipeline;
+    load.duration = options_.duration;
+    double server_start = server_cpu_seconds();
+    double process_start = process_cpu_seconds();
+    {
+        EventLoop loop;
+        point.result = LoadGenerator(&loop, server_addr, load).run();
+    }
+    point.server_cpu = server_cpu_seconds() - server_start;
+    point.client_cpu = process_cpu_seconds() - process_start - point.server_cpu;
+    return point;
+}
+
+std::string Sweep::header() {
+    char buf[256];
+    snprintf(buf, sizeof buf, "%7s %11s %8s %12s %9s %9s %10s %10s %7s", "threads", "connections", "pipeline",
+             "requests/s", "p50(ms)", "p99(ms)", "server(us)", "client(us)", "errors");
+    return buf;
+}
+
+std::string Sweep::format(const SweepPoint &point) {
+    const LoadResult &result = point.result;
+    char buf[256];
+    snprintf(buf, sizeof buf, "%7d %11d %8d %12.0f %9.3f %9.3f %10.2f %10.2f %7lld", point.threads,
+             point.connections, point.pipeline, result.requests_per_second(),
+             result.latency.value_at_percentile(50) / 1000.0, result.latency.value_at_percentile(99) / 1000.0,
+             point.server_cpu_per_request(), point.client_cpu_per_request(),
+             static_cast<long long>(result.connect_errors + result.read_errors + result.bad_responses));
+    return buf;
+}
+
+std::string Sweep::summary(const std::vector<SweepPoint> &points) {
+    // (连接数, 流水线深度)按第一次出现的顺序输出
+    std::vector<std::pair<int, int>> order;
+    std::map<std::pair<int, int>, const SweepPoint *> best;
+    for (const SweepPoint &point : points) {
+        std::pair<int, int> key(point.connections, point.pipeline);
+        auto it = best.find(key);
+        if (it == best.end()) {
+            order.push_back(key);
+            best[key] = &point;
+        } else if (point.result.requests_per_second() > it->second->result.requests_per_second()) {
+            it->second = &point;
+        }
+    }
+    std::string output;
+    char buf[256];
+    for (const auto &key : order) {
+        const SweepPoint &point = *best[key];
+        snprintf(buf, sizeof buf, "connections=%d pipeline=%d: best set_thread_num(%d), %.0f requests/s, "
+                 "p99 %.3f ms, %.2f us server CPU per request\n", key.first, key.second, point.threads,
+                 point.result.requests_per_second(), point.result.latency.value_at_percentile(99) / 1000.0,
+                 point.server_cpu_per_request());
+        output.append(buf);
+    }
+    return output;
+}
+
+std::string Sweep::to_json(const std::vector<SweepPoint> &points, const SweepOptions &options) {
+    std::string output;
+    char buf[512];
+    snprintf(buf, sizeof buf, "{\"config\":{\"client_threads\":%d,\"duration\":%.3f,\"warmup\":%.3f,\"workers\":%d,"
+             "\"body_size\":%zu,\"work_us\":%d,\"server_cpus\":[%s],\"client_cpus\":[%s]},\n",
+             options.client_threads, options.duration, options.warmup, options.workers, options.body_size,
+             options.work_us, join(options.server_cpus).c_str(), join(options.client_cpus).c_str());
+    output.append(buf);
+    output.append("\"unit\":\"us\",\"results\":[\n");
+    for (size_t i = 0; i < points.size(); ++i) {
+        const SweepPoint &point = points[i];
+        const LoadResult &result = point.result;
+        snprintf(buf, sizeof buf, "{\"threads\":%d,\"connections\":%d,\"pipeline\":%d,\"requests\":%lld,"
+                 "\"requests_per_second\":%.3f,\"latency\":{\"50\":%lld,\"99\":%lld,\"99.9\":%lld,\"max\":%lld},"
+                 "\"server_cpu_per_request\":%.3f,\"client_cpu_per_request\":%.3f,"
+                 "\"errors\":{\"connect\":%lld,\"read\":%lld,\"bad_response\":%lld}}%s\n",
+                 point.threads, point.connections, point.pipeline, static_cast<long long>(result.requests),
+                 result.requests_per_second(), static_cast<long long>(result.latency.value_at_percentile(50)),
+                 static_cast<long long>(result.latency.value_at_percentile(99)),
+                 static_cast<long long>(result.latency.value_at_percentile(99.9)),
+                 static_cast<long long>(result.latency.max()), point.server_cpu_per_request(),
+                 point.client_cpu_per_request(), static_cast<long long>(result.connect_errors),
+                 static_cast<long long>(result.read_errors), static_cast<long long>(result.bad_responses),
+                 i + 1 < points.size() ? "," : "");
+        output.append(buf);
+    }
+    output.append("]}\n");
+    return output;
+}
+
+bool parse_int_list(const std::string &text, std::vector<int> *values) {
+    values->clear();
+    const char *p = text.c_str();
+    while (*p) {
+        char *end = nullptr;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+        }
+        for (long value = first; value <= last; ++value) {
+            values->push_back(static_cast<int>(value));
+        }
+        if (*end == ',') {
+            ++end;
+        } else if (*end != '\0') {
+            return false;
+        }
+        p = end;
+    }
+    return !values->empty();
+}
+
+} // namespace bench
+
+} // namespace web_server
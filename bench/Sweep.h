@@ -0,0 +1,104 @@
+/**
+ * @brief 在本机回环上启动HttpServer，按IO线程数、连接数和流水线深度扫描吞吐量、延迟和每个请求的CPU时间
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_BENCH_SWEEP_H
+#define WEB_SERVER_BENCH_SWEEP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "bench/LoadGenerator.h"
+
+namespace web_server {
+
+namespace bench {
+
+struct SweepOptions {
+    std::vector<int> threads = {0, 1, 2, 4};    // 依次尝试的服务端IO线程数，每个值重启一次服务端
+    std::vector<int> connections = {100};
+    std::vector<int> pipeline = {1};
+    int client_threads = 1;                     // 压测客户端的IO线程数
+    double duration = 3.0;                      // 每个组合计时的秒数
+    double warmup = 1.0;                        // 每个组合计时之前的预热秒数，CPU时间不计入
+    int workers = 0;                            // 服务端计算线程数，大于0时回调在计算线程池中执行
+    size_t body_size = 13;                      // 响应体字节数
+    int work_us = 0;                            // 回调中忙等的微秒数，模拟业务逻辑
+    uint16_t port = 18047;
+    std::vector<int> server_cpus;               // 服务端线程绑定的CPU，为空时不绑定
+    std::vector<int> client_cpus;               // 压测客户端线程绑定的CPU，为空时不绑定
+};
+
+struct SweepPoint {
+    int threads = 0;
+    int connections = 0;
+    int pipeline = 0;
+    LoadResult result;
+    double server_cpu = 0;                      // 计时期间服务端所有线程的CPU时间，秒
+    double client_cpu = 0;                      // 计时期间进程内其余线程（压测客户端）的CPU时间，秒
+
+    /**
+     * @brief 每个请求的服务端CPU时间，微秒
+     */
+    double server_cpu_per_request() const {
+        return result.requests > 0 ? server_cpu * 1e6 / result.requests : 0;
+    }
+
+    double client_cpu_per_request() const {
+        return result.requests > 0 ? client_cpu * 1e6 / result.requests : 0;
+    }
+};
+
+/**
+ * @brief 服务端和压测客户端在同一个进程中，各自的CPU时间按线程的CPU时钟分开统计；
+ * 两者共用CPU时吞吐量受客户端影响，调整IO线程数时最好用server_cpus和client_cpus把两边分开
+ */
+class Sweep : private Noncopyable {
+public:
+    explicit Sweep(const SweepOptions &options);
+
+    /**
+     * @brief 在调用线程中依次运行所有组合，每完成一个调用一次progress（可以为空）
+     */
+    std::vector<SweepPoint> run(const std::function<void(const SweepPoint &)> &progress = nullptr);
+
+    static std::string header();
+
+    /**
+     * @brief 单个组合的一行文本报告，时间单位为毫秒，CPU时间单位为微秒每请求
+     */
+    static std::string format(const SweepPoint &point);
+
+    /**
+     * @brief 每个连接数和流水线深度下吞吐量最高的IO线程数
+     */
+    static std::string summary(const std::vector<SweepPoint> &points);
+
+    static std::string to_json(const std::vector<SweepPoint> &points, const SweepOptions &options);
+
+private:
+    class ServerThread;
+
+    SweepPoint run_point(int threads, int connections, int pipeline);
+
+    const SweepOptions options_;
+};
+
+/**
+ * @brief 解析"0-3,6"形式的列表，失败时返回false
+ */
+bool parse_int_list(const std::string &text, std::vector<int> *values);
+
+} // namespace bench
+
+} // namespace web_server
+
+#endif // WEB_SERVER_BENCH_SWEEP_H
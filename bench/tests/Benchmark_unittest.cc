@@ -0,0 +1,200 @@
+/**
+ * @brief 微基准框架的迭代次数标定、暂停计时、过滤、JSON读写和基线比较测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench/Benchmark.h"
+
+using namespace web_server::bench;
+
+namespace {
+
+BenchmarkOptions quick_options() {
+    BenchmarkOptions options;
+    options.min_time = 0.01;
+    options.repetitions = 5;
+    options.warmup = 1;
+    return options;
+}
+
+void spin(int64_t ns) {
+    int64_t deadline = monotonic_ns() + ns;
+    while (monotonic_ns() < deadline) {
+    }
+}
+
+/**
+ * @brief 只检查不受机器负载影响的性质：迭代次数从1开始增长，标定结束后预热和采样都用同一个次数；
+ * 每次迭代至少自旋1us，中位数只有下界
+ */
+void test_calibration() {
+    printf("test_calibration\n");
+    BenchmarkRunner runner(quick_options());
+    std::vector<int64_t> calls;
+    runner.add("spin/1us", [&calls](BenchmarkState &state) {
+        calls.push_back(state.iterations());
+        for (int64_t i = 0; i < state.iterations(); ++i) {
+            spin(1000);
+        }
+        state.set_bytes_per_iteration(100);
+    });
+    std::vector<BenchmarkResult> results = runner.run();
+    assert(results.size() == 1);
+    const BenchmarkResult &result = results[0];
+    assert(result.name == "spin/1us");
+    assert(result.samples.size() == 5);
+    assert(result.median() >= 1000);
+    assert(result.min() <= result.median() && result.median() <= result.max());
+    assert(std::fabs(result.bytes_per_second() - 100 * 1e9 / result.median()) < 1);
+
+    // 标定若干次，加上1次预热和5次采样
+    assert(calls.size() > 6);
+    assert(calls.front() == 1);
+    size_t calibration = calls.size() - 6;
+    for (size_t i = 1; i < calibration; ++i) {
+        assert(calls[i] > calls[i - 1]);
+    }
+    assert(calls[calibration - 1] == result.iterations);
+    for (size_t i = calibration; i < calls.size(); ++i) {
+        assert(calls[i] == result.iterations);
+    }
+}
+
+/**
+ * @brief 暂停期间的自旋比计时部分长80倍，计入与否相差悬殊，只按宽松的比例比较；
+ * 机器繁忙时计时部分被抢占的概率与它所占的时间成正比，比例的下降与负载大致成正比
+ */
+void test_pause_timing() {
+    printf("test_pause_timing\n");
+    BenchmarkOptions options = quick_options();
+    options.min_time = 0.0005;
+    BenchmarkRunner runner(options);
+    runner.add("paused", [](BenchmarkState &state) {
+        for (int64_t i = 0; i < state.iterations(); ++i) {
+            state.pause_timing();
+            spin(20000);
+            state.resume_timing();
+            spin(250);
+        }
+    });
+    runner.add("unpaused", [](BenchmarkState &state) {
+        for (int64_t i = 0; i < state.iterations(); ++i) {
+            spin(20000);
+            spin(250);
+        }
+    });
+    std::vector<BenchmarkResult> results = runner.run();
+    assert(results.size() == 2);
+    assert(results[0].min() >= 250 && results[1].min() >= 20250);
+    // 最快的一次采样最不容易被抢占
+    assert(results[0].min() * 4 < results[1].min());
+}
+
+void test_filter() {
+    printf("test_filter\n");
+    BenchmarkOptions options = quick_options();
+    options.filter = "http/";
+    BenchmarkRunner runner(options);
+    int ran = 0;
+    auto function = [&ran](BenchmarkState &state) {
+        ++ran;
+        spin(state.iterations() * 100);
+    };
+    runner.add("buffer/append", function);
+    runner.add("http/parse", function);
+    runner.add("http/response", function);
+    std::vector<std::string> names = runner.names();
+    assert(names.size() == 2 && names[0] == "http/parse" && names[1] == "http/response");
+    int progress = 0;
+    std::vector<BenchmarkResult> results = runner.run([&progress](const BenchmarkResult &) {
+        ++progress;
+    });
+    assert(results.size() == 2 && progress == 2);
+    assert(ran > 0);
+    assert(!BenchmarkRunner::format(results[0]).empty());
+}
+
+BenchmarkResult make_result(const std::string &name, std::vector<double> samples) {
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = 1000;
+    result.bytes_per_iteration = 64;
+    result.samples = samples;
+    return result;
+}
+
+void test_json_round_trip() {
+    printf("test_json_round_trip\n");
+    std::vector<BenchmarkResult> results;
+    results.push_back(make_result("buffer/append_retrieve/64", {10.5, 11, 10.25}));
+    results.push_back(make_result("http/parse/minimal", {200, 210, 190, 205}));
+    std::string json = BenchmarkRunner::to_json(results, quick_options());
+    assert(json.find("\"context\":{") != std::string::npos);
+    assert(json.find("\"optimized\":") != std::string::npos);
+    assert(json.find("\"median\":202.500") != std::string::npos);
+
+    std::vector<BenchmarkResult> parsed;
+    assert(BenchmarkRunner::from_json(json, &parsed));
+    assert(parsed.size() == 2);
+    assert(parsed[0].name == "buffer/append_retrieve/64");
+    assert(parsed[0].iterations == 1000 && parsed[0].bytes_per_iteration == 64);
+    assert(parsed[0].samples.size() == 3 && parsed[0].samples[2] == 10.25);
+    assert(parsed[1].median() == 202.5);
+
+    assert(!BenchmarkRunner::from_json("{\"benchmarks\":[{\"name\":\"x\"}]}", &parsed));
+    assert(!BenchmarkRunner::from_json("not json", &parsed));
+}
+
+void test_compare() {
+    printf("test_compare\n");
+    std::vector<BenchmarkResult> baseline;
+    baseline.push_back(make_result("same", {100, 101, 99}));
+    baseline.push_back(make_result("slower", {100, 101, 99}));
+    baseline.push_back(make_result("faster", {100, 101, 99}));
+    baseline.push_back(make_result("noisy", {100, 150, 60}));
+    baseline.push_back(make_result("removed", {100}));
+    std::vector<BenchmarkResult> current;
+    current.push_back(make_result("same", {102, 101, 103}));
+    current.push_back(make_result("slower", {120, 121, 119}));
+    current.push_back(make_result("faster", {80, 81, 79}));
+    current.push_back(make_result("noisy", {120, 121, 119}));
+    current.push_back(make_result("added", {100}));
+    std::string report = BenchmarkRunner::compare(baseline, current);
+
+    auto line_of = [&report](const std::string &name) {
+        size_t start = report.find("\n" + name + " ");
+        assert(start != std::string::npos);
+        return report.substr(start + 1, report.find('\n', start + 1) - start - 1);
+    };
+    assert(line_of("same").find("slower") == std::string::npos);
+    assert(line_of("same").find("faster") == std::string::npos);
+    assert(line_of("slower").find("+20.00%  slower") != std::string::npos);
+    assert(line_of("faster").find("-20.00%  faster") != std::string::npos);
+    // 基线本身的离散程度超过20%，不判为变慢
+    assert(line_of("noisy").find("slower") == std::string::npos);
+    assert(line_of("added").find("new") != std::string::npos);
+    assert(line_of("removed").find("removed") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    test_calibration();
+    test_pause_timing();
+    test_filter();
+    test_json_round_trip();
+    test_compare();
+    printf("all tests passed\n");
+    return 0;
+}
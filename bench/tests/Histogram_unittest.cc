@@ -0,0 +1,114 @@
+/**
+ * @brief HDR直方图的精度、百分位数和合并测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench/Histogram.h"
+
+using namespace web_server::bench;
+
+namespace {
+
+/**
+ * @brief 3位有效数字时相对误差不超过千分之一
+ */
+bool close_enough(int64_t actual, int64_t expected) {
+    return std::abs(static_cast<double>(actual - expected)) <= expected * 0.001 + 1;
+}
+
+void test_empty() {
+    printf("test_empty\n");
+    Histogram histogram;
+    assert(histogram.count() == 0);
+    assert(histogram.min() == 0 && histogram.max() == 0);
+    assert(histogram.value_at_percentile(99) == 0);
+    assert(histogram.mean() == 0 && histogram.stddev() == 0);
+}
+
+void test_linear() {
+    printf("test_linear\n");
+    Histogram histogram;
+    // 1到1000000各记录一次
+    for (int64_t value = 1; value <= 1000000; ++value) {
+        histogram.record(value);
+    }
+    assert(histogram.count() == 1000000);
+    assert(histogram.min() == 1 && histogram.max() == 1000000);
+    assert(close_enough(histogram.value_at_percentile(50), 500000));
+    assert(close_enough(histogram.value_at_percentile(90), 900000));
+    assert(close_enough(histogram.value_at_percentile(99), 990000));
+    assert(close_enough(histogram.value_at_percentile(99.99), 999900));
+    assert(histogram.value_at_percentile(100) == 1000000);
+    assert(std::abs(histogram.mean() - 500000.5) < 1e-6);
+    assert(std::abs(histogram.stddev() - 288675.13) < 1);
+}
+
+void test_small_values_exact() {
+    printf("test_small_values_exact\n");
+    Histogram histogram;
+    // 第一个桶内以1为精度
+    for (int64_t value = 0; value < 2000; ++value) {
+        histogram.record(value);
+    }
+    assert(histogram.value_at_percentile(50) == 999);
+    assert(histogram.value_at_percentile(100) == 1999);
+}
+
+void test_tail() {
+    printf("test_tail\n");
+    Histogram histogram;
+    // 9999个100us加一个1s：p99.99仍是100us，最大值是1s
+    histogram.record(100, 9999);
+    histogram.record(1000000);
+    assert(histogram.value_at_percentile(99.99) == 100);
+    assert(histogram.value_at_percentile(99.999) == 1000000);
+    assert(histogram.max() == 1000000);
+}
+
+void test_clamp() {
+    printf("test_clamp\n");
+    Histogram histogram(1000 * 1000, 2);
+    histogram.record(-5);
+    histogram.record(5000 * 1000);
+    assert(histogram.min() == 0);
+    assert(histogram.max() == 1000 * 1000);
+    assert(close_enough(histogram.value_at_percentile(100), 1000 * 1000));
+}
+
+void test_add() {
+    printf("test_add\n");
+    Histogram a;
+    Histogram b;
+    for (int64_t value = 1; value <= 1000; ++value) {
+        a.record(value);
+        b.record(value + 1000);
+    }
+    a.add(b);
+    assert(a.count() == 2000);
+    assert(a.min() == 1 && a.max() == 2000);
+    assert(close_enough(a.value_at_percentile(50), 1000));
+    assert(close_enough(a.value_at_percentile(75), 1500));
+    a.reset();
+    assert(a.count() == 0 && a.value_at_percentile(50) == 0);
+}
+
+} // namespace
+
+int main() {
+    test_empty();
+    test_linear();
+    test_small_values_exact();
+    test_tail();
+    test_clamp();
+    test_add();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @brief 压测客户端在闭环、流水线、开环和短连接模式下对本地HttpServer的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "bench/LoadGenerator.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::bench;
+using namespace web_server::http;
+using namespace web_server::net;
+
+namespace {
+
+const uint16_t k_port = 19546;
+const uint16_t k_down_port = 19547;
+
+std::atomic<int> g_slow_ms(0);      // 回调在服务端IO线程中读取
+
+void handler(const HttpRequest &req, HttpResponse *resp) {
+    if (g_slow_ms.load() > 0 && req.path() == "/slow") {
+        ::usleep(g_slow_ms.load() * 1000);
+    }
+    resp->set_status_code(req.path() == "/missing" ? HttpResponse::k_404_not_found : HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body("hello");
+}
+
+LoadResult run(const LoadOptions &options, uint16_t port = k_port) {
+    EventLoop loop;
+    LoadGenerator generator(&loop, InetAddress("127.0.0.1", port), options);
+    return generator.run();
+}
+
+void test_closed_loop() {
+    printf("test_closed_loop\n");
+    LoadOptions options;
+    options.threads = 2;
+    options.connections = 4;
+    options.duration = 0.3;
+    LoadResult result = run(options);
+    assert(result.requests > 0);
+    assert(result.status_codes[200] == result.requests);
+    assert(result.latency.count() == result.requests);
+    assert(result.read_errors == 0 && result.bad_responses == 0 && result.connect_errors == 0);
+    assert(result.elapsed > 0.25 && result.elapsed < 0.35);
+    assert(result.bytes > 0);
+
+    std::string json = result.to_json(options);
+    assert(json.find("\"requests\":" + std::to_string(result.requests)) != std::string::npos);
+    assert(json.find("\"99.99\":") != std::string::npos);
+    assert(json.find("\"status\":{\"200\":") != std::string::npos);
+    assert(!result.to_string().empty());
+}
+
+void test_pipeline() {
+    printf("test_pipeline\n");
+    LoadOptions options;
+    options.threads = 0;
+    options.connections = 2;
+    options.pipeline = 8;
+    options.duration = 0.3;
+    options.path = "/missing";
+    LoadResult result = run(options);
+    assert(result.requests > 0);
+    assert(result.status_codes[404] == result.requests);
+    assert(result.bad_responses == 0);
+}
+
+void test_close() {
+    printf("test_close\n");
+    LoadOptions options;
+    options.connections = 2;
+    options.keep_alive = false;
+    options.duration = 0.3;
+    LoadResult result = run(options);
+    assert(result.requests > 0);
+    assert(result.read_errors == 0 && result.bad_responses == 0);
+}
+
+/**
+ * @brief 服务端每个请求耗时10ms，单连接闭环最多100个每秒；按200个每秒的速率开环时，
+ * 排队的时间计入延迟，延迟随时间增长，而实际服务时间仍在10ms左右
+ */
+void test_open_loop() {
+    printf("test_open_loop\n");
+    g_slow_ms = 10;
+    LoadOptions options;
+    options.connections = 1;
+    options.rate = 200;
+    options.duration = 0.5;
+    options.path = "/slow";
+    LoadResult result = run(options);
+    g_slow_ms = 0;
+    assert(result.requests > 20 && result.requests < 60);
+    assert(result.backlog > 20);
+    assert(result.service_time.value_at_percentile(50) < 50 * 1000);
+    assert(result.latency.value_at_percentile(99) > 100 * 1000);
+
+    // 服务端跟得上时两种延迟接近，没有积压
+    options.rate = 50;
+    options.path = "/";
+    result = run(options);
+    assert(result.requests >= 20 && result.requests <= 30);
+    assert(result.backlog == 0);
+}
+
+void test_unreachable() {
+    printf("test_unreachable\n");
+    LoadOptions options;
+    options.connections = 2;
+    options.duration = 0.3;
+    LoadResult result = run(options, k_down_port);
+    assert(result.requests == 0);
+    assert(result.connect_errors > 0);
+}
+
+} // namespace
+
+int main() {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "load");
+        server.set_http_callback(handler);
+        server.set_thread_num(2);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_closed_loop();
+    test_pipeline();
+    test_close();
+    test_open_loop();
+    test_unreachable();
+
+    server_loop->quit();
+    server_thread.join();
+    printf("all tests passed\n");
+    return 0;
+}
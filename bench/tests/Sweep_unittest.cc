@@ -0,0 +1,85 @@
+/**
+ * @brief 回环扫描的组合遍历、CPU时间统计、汇总和列表解析测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench/Sweep.h"
+
+using namespace web_server::bench;
+
+namespace {
+
+const uint16_t k_port = 19548;
+
+void test_parse_int_list() {
+    printf("test_parse_int_list\n");
+    std::vector<int> values;
+    assert(parse_int_list("0,1,2,4", &values));
+    assert((values == std::vector<int>{0, 1, 2, 4}));
+    assert(parse_int_list("0-3,8", &values));
+    assert((values == std::vector<int>{0, 1, 2, 3, 8}));
+    assert(parse_int_list("16", &values));
+    assert((values == std::vector<int>{16}));
+    assert(!parse_int_list("", &values));
+    assert(!parse_int_list("a", &values));
+    assert(!parse_int_list("3-1", &values));
+    assert(!parse_int_list("1;2", &values));
+    assert(!parse_int_list("-1", &values));
+}
+
+void test_sweep() {
+    printf("test_sweep\n");
+    SweepOptions options;
+    options.threads = {0, 1};
+    options.connections = {2};
+    options.pipeline = {1, 4};
+    options.duration = 0.2;
+    options.warmup = 0.05;
+    options.body_size = 100;
+    options.work_us = 50;
+    options.port = k_port;
+    Sweep sweep(options);
+    int progress = 0;
+    std::vector<SweepPoint> points = sweep.run([&progress](const SweepPoint &) {
+        ++progress;
+    });
+    assert(points.size() == 4 && progress == 4);
+    assert(points[0].threads == 0 && points[0].pipeline == 1);
+    assert(points[1].threads == 0 && points[1].pipeline == 4);
+    assert(points[3].threads == 1 && points[3].connections == 2 && points[3].pipeline == 4);
+    for (const SweepPoint &point : points) {
+        assert(point.result.requests > 0);
+        assert(point.result.status_codes.at(200) == point.result.requests);
+        assert(point.result.read_errors == 0 && point.result.bad_responses == 0);
+        // 回调忙等50us，服务端每个请求的CPU时间不会少太多；客户端的CPU时间不包括服务端
+        assert(point.server_cpu_per_request() > 20);
+        assert(point.client_cpu > -0.01);
+        assert(!Sweep::format(point).empty());
+    }
+
+    std::string summary = Sweep::summary(points);
+    assert(summary.find("connections=2 pipeline=1: best set_thread_num(") == 0);
+    assert(summary.find("connections=2 pipeline=4: best set_thread_num(") != std::string::npos);
+
+    std::string json = Sweep::to_json(points, options);
+    assert(json.find("\"work_us\":50") != std::string::npos);
+    assert(json.find("{\"threads\":1,\"connections\":2,\"pipeline\":4,") != std::string::npos);
+    assert(json.find("\"server_cpu_per_request\":") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    test_parse_int_list();
+    test_sweep();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,410 @@
+/**
+ * @brief 响应压缩
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Compression.h"
+
+#include <strings.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <map>
+
+#include "base/Logging.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+const int k_window_bits = 15;
+const int k_gzip_window_bits = 15 + 16;     // 加16时zlib写出gzip头和尾
+const int k_mem_level = 8;
+const size_t k_stream_chunk = 16 * 1024;
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+boost::string_ref trim(boost::string_ref s) {
+    while (!s.empty() && is_space(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && is_space(s.back())) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+bool equals_ignore_case(boost::string_ref lhs, const char *rhs) {
+    size_t len = strlen(rhs);
+    return lhs.size() == len && ::strncasecmp(lhs.data(), rhs, len) == 0;
+}
+
+/**
+ * @brief 解析qvalue，以千分之一为单位，非法时返回-1
+ */
+int parse_qvalue(boost::string_ref s) {
+    if (s.empty() || (s[0] != '0' && s[0] != '1')) {
+        return -1;
+    }
+    int value = (s[0] - '0') * 1000;
+    if (s.size() == 1) {
+        return value;
+    }
+    if (s[1] != '.' || s.size() > 5) {
+        return -1;
+    }
+    int scale = 100;
+    for (size_t i = 2; i < s.size(); ++i) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        value += (s[i] - '0') * scale;
+        scale /= 10;
+    }
+    return value > 1000 ? -1 : value;
+}
+
+int window_bits(ContentCoding coding) {
+    assert(coding == k_gzip || coding == k_deflate);
+    return coding == k_gzip ? k_gzip_window_bits : k_window_bits;
+}
+
+void init_stream(z_stream *stream, ContentCoding coding, int level) {
+    memset(stream, 0, sizeof *stream);
+    int ret = ::deflateInit2(stream, level, Z_DEFLATED, window_bits(coding), k_mem_level, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) {
+        LOG_FATAL << "deflateInit2 failed: " << ret;
+    }
+}
+
+/**
+ * @brief 压缩版本的ETag：在引号内加上编码名，如"abc" -> "abc-gzip"
+ */
+std::string variant_etag(const std::string &etag, ContentCoding coding) {
+    if (etag.size() < 2 || etag.back() != '"') {
+        return etag;
+    }
+    std::string result(etag, 0, etag.size() - 1);
+    result += '-';
+    result += coding_name(coding);
+    result += '"';
+    return result;
+}
+
+std::string original_etag(const std::string &etag, ContentCoding coding) {
+    size_t suffix = strlen(coding_name(coding)) + 2;
+    if (etag.size() < suffix + 1) {
+        return etag;
+    }
+    return etag.substr(0, etag.size() - suffix) + '"';
+}
+
+void add_vary(HttpResponse *resp) {
+    std::string vary = resp->get_header("Vary");
+    if (vary.empty()) {
+        resp->add_header("Vary", "Accept-Encoding");
+    } else if (vary.find("Accept-Encoding") == std::string::npos && vary != "*") {
+        resp->add_header("Vary", vary + ", Accept-Encoding");
+    }
+}
+
+} // namespace
+
+const char *coding_name(ContentCoding coding) {
+    switch (coding) {
+        case k_gzip:
+            return "gzip";
+        case k_deflate:
+            return "deflate";
+        case k_identity:
+            break;
+    }
+    return "identity";
+}
+
+ContentCoding negotiate_coding(boost::string_ref accept_encoding) {
+    int gzip_q = -1;
+    int deflate_q = -1;
+    int star_q = -1;
+    while (!accept_encoding.empty()) {
+        size_t comma = accept_encoding.find(',');
+        boost::string_ref item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == boost::string_ref::npos ? boost::string_ref() : accept_encoding.substr(comma + 1);
+
+        size_t semicolon = item.find(';');
+        boost::string_ref name = trim(item.substr(0, semicolon));
+        int q = 1000;
+        if (semicolon != boost::string_ref::npos) {
+            boost::string_ref param = trim(item.substr(semicolon + 1));
+            if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = parse_qvalue(trim(param.substr(2)));
+            }
+            if (q < 0) {
+                continue;
+            }
+        }
+        if (equals_ignore_case(name, "gzip") || equals_ignore_case(name, "x-gzip")) {
+            gzip_q = q;
+        } else if (equals_ignore_case(name, "deflate")) {
+            deflate_q = q;
+        } else if (name == "*") {
+            star_q = q;
+        }
+    }
+    if (gzip_q < 0) {
+        gzip_q = star_q;
+    }
+    if (deflate_q < 0) {
+        deflate_q = star_q;
+    }
+    if (gzip_q > 0 && gzip_q >= deflate_q) {
+        return k_gzip;
+    }
+    return deflate_q > 0 ? k_deflate : k_identity;
+}
+
+bool is_compressible_type(boost::string_ref content_type) {
+    if (content_type.starts_with("text/")) {
+        return true;
+    }
+    size_t end = content_type.find(';');
+    boost::string_ref type = content_type.substr(0, end);
+    return type.find("json") != boost::string_ref::npos ||
+           type.find("javascript") != boost::string_ref::npos ||
+           type.find("xml") != boost::string_ref::npos ||
+           type == "application/wasm" ||
+           type == "font/ttf" ||
+           type == "font/otf";
+}
+
+std::string compress_all(ContentCoding coding, int level, const char *data, size_t len) {
+    z_stream stream;
+    init_stream(&stream, coding, level);
+    std::string output;
+    output.resize(::deflateBound(&stream, static_cast<uLong>(len)));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = static_cast<uInt>(len);
+    stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    int ret = ::deflate(&stream, Z_FINISH);
+    assert(ret == Z_STREAM_END);
+    (void)ret;
+    output.resize(stream.total_out);
+    ::deflateEnd(&stream);
+    return output;
+}
+
+Compressor::Compressor(ContentCoding coding, int level) : stream_(new z_stream) {
+    init_stream(stream_.get(), coding, level);
+}
+
+Compressor::~Compressor() {
+    ::deflateEnd(stream_.get());
+}
+
+void Compressor::compress(const char *data, size_t len, bool finish, net::Buffer *output) {
+    if (len == 0 && !finish) {
+        // 没有新数据时再次冲刷什么也不会输出
+        return;
+    }
+    z_stream *stream = stream_.get();
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream->avail_in = static_cast<uInt>(len);
+    int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+    do {
+        output->ensure_writable_bytes(k_stream_chunk);
+        stream->next_out = reinterpret_cast<Bytef *>(output->begin_write());
+        stream->avail_out = static_cast<uInt>(output->writable_bytes());
+        int ret = ::deflate(stream, flush);
+        assert(ret != Z_STREAM_ERROR);
+        (void)ret;
+        output->has_written(reinterpret_cast<char *>(stream->next_out) - output->begin_write());
+    } while (stream->avail_out == 0);
+    assert(stream->avail_in == 0);
+}
+
+CompressionCache::Value CompressionCache::get(const std::string &key) {
+    MutexLockGuard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return Value();
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->value;
+}
+
+void CompressionCache::put(const std::string &key, const Value &value) {
+    size_t size = key.size() + value->size();
+    if (size > max_bytes_) {
+        return;
+    }
+    MutexLockGuard lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        // 并发未命中时可能被压缩了两次，保留先放入的结果
+        return;
+    }
+    lru_.push_front(Entry{key, value});
+    index_[key] = lru_.begin();
+    bytes_ += size;
+    while (bytes_ > max_bytes_) {
+        Entry &victim = lru_.back();
+        bytes_ -= victim.key.size() + victim.value->size();
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+}
+
+size_t CompressionCache::bytes() const {
+    MutexLockGuard lock(mutex_);
+    return bytes_;
+}
+
+ResponseCompressor::ResponseCompressor(const CompressionOptions &options)
+    : options_(options),
+      cache_(options.cache_bytes) {
+}
+
+ContentCoding ResponseCompressor::prepare(const HttpRequest &req, HttpResponse *resp) const {
+    if (resp->status_code() != HttpResponse::k_200_ok ||
+        (req.method() != HttpRequest::k_get && req.method() != HttpRequest::k_head)) {
+        return k_identity;
+    }
+    int64_t min_size = resp->compress_min_size() >= 0 ? resp->compress_min_size() : options_.min_size;
+    int64_t size = resp->streaming() ? resp->content_length() : resp->body_size();
+    if ((size >= 0 && size < min_size) || (resp->has_file_body() && size > options_.max_file_size)) {
+        return k_identity;
+    }
+    if (!resp->get_header("Content-Encoding").empty() ||
+        !is_compressible_type(resp->get_header("Content-Type"))) {
+        return k_identity;
+    }
+    // 可压缩的响应都带上Vary，避免中间缓存把压缩版本发给不支持的客户端
+    add_vary(resp);
+
+    if (req.find_header("Range")) {
+        return k_identity;
+    }
+    const std::string *accept = req.find_header("Accept-Encoding");
+    if (!accept) {
+        return k_identity;
+    }
+    ContentCoding coding = negotiate_coding(*accept);
+    if (coding != k_identity) {
+        std::string etag = resp->get_header("ETag");
+        if (!etag.empty()) {
+            resp->add_header("ETag", variant_etag(etag, coding));
+        }
+    }
+    return coding;
+}
+
+void ResponseCompressor::encode(ContentCoding coding, const HttpRequest &req, HttpResponse *resp) {
+    assert(coding != k_identity);
+    if (resp->streaming()) {
+        encode_stream(coding, resp);
+        resp->add_header("Content-Encoding", coding_name(coding));
+        return;
+    }
+
+    std::string etag = resp->get_header("ETag");
+    std::string key;
+    if (options_.cache_bytes > 0 && !etag.empty()) {
+        key.reserve(req.path().size() + etag.size() + 2);
+        key += static_cast<char>('0' + coding);
+        key += req.path();
+        key += '\n';
+        key += etag;
+    }
+    CompressionCache::Value value = key.empty() ? CompressionCache::Value() : cache_.get(key);
+    if (!value) {
+        if (resp->has_file_body()) {
+            std::string content;
+            if (!read_file(*resp, &content)) {
+                // 读文件失败，退回到sendfile发送原始内容
+                resp->add_header("ETag", original_etag(etag, coding));
+                return;
+            }
+            value = std::make_shared<const std::string>(
+                compress_all(coding, options_.level, content.data(), content.size()));
+        } else {
+            const std::string &body = resp->body();
+            value = std::make_shared<const std::string>(
+                compress_all(coding, options_.level, body.data(), body.size()));
+        }
+        if (!key.empty()) {
+            cache_.put(key, value);
+        }
+    }
+    resp->clear_body_file();
+    resp->set_body(*value);
+    resp->add_header("Content-Encoding", coding_name(coding));
+}
+
+bool ResponseCompressor::read_file(const HttpResponse &resp, std::string *content) const {
+    content->resize(static_cast<size_t>(resp.content_length()));
+    size_t done = 0;
+    while (done < content->size()) {
+        ssize_t n = ::pread(resp.file_fd(), &(*content)[done], content->size() - done,
+                            resp.file_offset() + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOG_SYSERR << "ResponseCompressor::read_file fd " << resp.file_fd();
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief 包装原有的生产函数，每批数据压缩后交给HttpServer，长度未知，改用chunked编码
+ * 压缩器可能把一批输入全部留在内部，这时继续向原生产函数要数据，
+ * 只有原生产函数本身没有数据时才空手返回，让HttpServer暂停生产
+ */
+void ResponseCompressor::encode_stream(ContentCoding coding, HttpResponse *resp) const {
+    HttpResponse::BodyStream source = resp->body_stream();
+    std::shared_ptr<Compressor> compressor = std::make_shared<Compressor>(coding, options_.level);
+    std::shared_ptr<net::Buffer> input = std::make_shared<net::Buffer>();
+    resp->set_body_stream([source, compressor, input](net::Buffer *output) {
+        bool more = true;
+        bool produced = true;
+        while (more && produced && output->readable_bytes() == 0) {
+            more = source(input.get());
+            produced = input->readable_bytes() > 0;
+            compressor->compress(input->peek(), input->readable_bytes(), !more, output);
+            input->retrieve_all();
+        }
+        return more;
+    });
+}
+
+Router::Handler with_compress_min_size(const Router::Handler &handler, int64_t min_size) {
+    int64_t value = min_size < 0 ? INT64_MAX : min_size;
+    return [handler, value](const HttpRequest &req, const RouteParams &params, HttpResponse *resp) {
+        resp->set_compress_min_size(value);
+        handler(req, params, resp);
+    };
+}
+
+} // namespace http
+
+} // namespace web_server
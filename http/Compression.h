@@ -0,0 +1,169 @@
+/**
+ * @brief 响应压缩
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_COMPRESSION_H
+#define WEB_SERVER_HTTP_COMPRESSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "base/Mutex.h"
+#include "base/Noncopyable.h"
+#include "http/Router.h"
+
+typedef struct z_stream_s z_stream;
+
+namespace web_server {
+
+namespace net {
+class Buffer;
+} // namespace net
+
+namespace http {
+
+class HttpRequest;
+class HttpResponse;
+
+enum ContentCoding {
+    k_identity,
+    k_gzip,
+    k_deflate
+};
+
+/**
+ * @brief Content-Encoding中的名字
+ */
+const char *coding_name(ContentCoding coding);
+
+/**
+ * @brief 按Accept-Encoding的q值选择编码，q相同时优先gzip，都不接受时返回k_identity
+ */
+ContentCoding negotiate_coding(boost::string_ref accept_encoding);
+
+/**
+ * @brief 文本类的Content-Type才值得压缩，图片、视频、压缩包等已经压缩过
+ */
+bool is_compressible_type(boost::string_ref content_type);
+
+/**
+ * @brief 一次性压缩data
+ * @param coding k_gzip或k_deflate
+ * @param level zlib压缩级别
+ */
+std::string compress_all(ContentCoding coding, int level, const char *data, size_t len);
+
+/**
+ * @brief zlib压缩流，用于长度未知的流式响应体
+ * 每次调用compress都把已输入的数据全部冲刷出来，对端可以边收边解压
+ */
+class Compressor : private Noncopyable {
+public:
+    Compressor(ContentCoding coding, int level);
+    ~Compressor();
+
+    /**
+     * @brief 压缩data并追加到output
+     * @param finish 为true时写出压缩流的结尾，之后不能再调用
+     */
+    void compress(const char *data, size_t len, bool finish, net::Buffer *output);
+
+private:
+    std::unique_ptr<z_stream> stream_;
+};
+
+/**
+ * @brief 压缩结果的缓存，以编码、路径和ETag为键，按总字节数做LRU淘汰
+ * ETag变了键就变了，旧的结果自然被淘汰，同一个版本的资源只压缩一次
+ */
+class CompressionCache : private Noncopyable {
+public:
+    using Value = std::shared_ptr<const std::string>;
+
+    explicit CompressionCache(size_t max_bytes) : max_bytes_(max_bytes), bytes_(0), hits_(0), misses_(0) {}
+
+    Value get(const std::string &key);
+    void put(const std::string &key, const Value &value);
+
+    size_t bytes() const;
+
+    int64_t hits() const {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    int64_t misses() const {
+        return misses_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        Value value;
+    };
+    using EntryList = std::list<Entry>;
+
+    const size_t max_bytes_;
+    mutable MutexLock mutex_;
+    EntryList lru_;                                                     // 最近使用的在前
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    size_t bytes_;
+    std::atomic<int64_t> hits_;
+    std::atomic<int64_t> misses_;
+};
+
+struct CompressionOptions {
+    int64_t min_size = 1024;                        // 默认阈值，响应体小于该值时不压缩
+    int level = 6;                                  // zlib压缩级别
+    size_t cache_bytes = 32 * 1024 * 1024;          // 压缩结果缓存的容量，0表示不缓存
+    int64_t max_file_size = 8 * 1024 * 1024;        // 超过该大小的文件不压缩，仍用sendfile发送
+};
+
+/**
+ * @brief HttpServer使用的响应压缩，分两步：
+ * prepare在条件请求处理之前判断是否压缩，加上Vary并把ETag改成压缩版本的ETag，
+ * 这样304不需要真正压缩；encode对最终仍为200的响应做压缩，带ETag的响应体和文件命中缓存时直接复用。
+ * Range请求不压缩，由条件请求处理截取原始内容。
+ * 两步都在HttpServer::handle_request中执行，开启卸载模式时运行在计算线程，不阻塞IO线程；
+ * 流式响应体在IO线程中随生产随压缩。多线程并发调用是安全的
+ */
+class ResponseCompressor : private Noncopyable {
+public:
+    explicit ResponseCompressor(const CompressionOptions &options);
+
+    ContentCoding prepare(const HttpRequest &req, HttpResponse *resp) const;
+    void encode(ContentCoding coding, const HttpRequest &req, HttpResponse *resp);
+
+    const CompressionCache &cache() const {
+        return cache_;
+    }
+
+private:
+    bool read_file(const HttpResponse &resp, std::string *content) const;
+    void encode_stream(ContentCoding coding, HttpResponse *resp) const;
+
+    CompressionOptions options_;
+    CompressionCache cache_;
+};
+
+/**
+ * @brief 为一条路由单独设置压缩阈值，注册时包装处理函数，
+ * 例如给/api/下的通配路由注册with_compress_min_size(api_handler, 256)
+ * @param min_size 小于0时不压缩该路由的响应
+ */
+Router::Handler with_compress_min_size(const Router::Handler &handler, int64_t min_size);
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_COMPRESSION_H
@@ -0,0 +1,276 @@
+/**
+ * @brief 静态文件的fd与元数据缓存
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/FileCache.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <functional>
+
+#include "base/Logging.h"
+#include "http/StaticFile.h"
+#include "net/Channel.h"
+#include "net/EventLoop.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+// 目录中文件被修改、替换、删除，以及目录本身被删除或移走
+const uint32_t k_watch_mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                              IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+std::string dir_of(const std::string &path) {
+    size_t pos = path.rfind('/');
+    if (pos == std::string::npos) {
+        return ".";
+    }
+    return pos == 0 ? std::string("/") : path.substr(0, pos);
+}
+
+std::string join_path(const std::string &dir, const char *name) {
+    return dir == "/" ? dir + name : dir + "/" + name;
+}
+
+} // namespace
+
+FileCache::FileCache(net::EventLoop *loop, size_t max_open_files, int num_shards)
+    : loop_(loop),
+      max_open_files_(std::max<size_t>(max_open_files, 1)),
+      shard_capacity_(max_open_files_ / std::min<size_t>(std::max(num_shards, 1), max_open_files_)),
+      hits_(0),
+      misses_(0),
+      inotify_fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+    loop_->assert_in_loop_thread();
+    if (inotify_fd_ < 0) {
+        LOG_SYSFATAL << "FileCache::FileCache inotify_init1";
+    }
+    size_t shards = max_open_files_ / shard_capacity_;
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.emplace_back(new Shard);
+    }
+    inotify_channel_.reset(new net::Channel(loop_, inotify_fd_));
+    inotify_channel_->set_read_callback(std::bind(&FileCache::handle_read, this));
+    inotify_channel_->enable_reading();
+}
+
+FileCache::~FileCache() {
+    loop_->assert_in_loop_thread();
+    inotify_channel_->disable_all();
+    inotify_channel_->remove();
+    ::close(inotify_fd_);
+}
+
+FileCache::Shard &FileCache::shard_of(const std::string &path) {
+    return *shards_[std::hash<std::string>()(path) % shards_.size()];
+}
+
+std::shared_ptr<StaticFile> FileCache::open(const std::string &path, int *saved_errno) {
+    Shard &shard = shard_of(path);
+    {
+    MutexLockGuard lock(shard.mutex);
+    auto it = shard.index.find(path);
+    if (it != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second->file;
+    }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+
+    // 先登记再监视目录、打开文件：打开之后的修改一定会产生事件，但事件可能在加入缓存之前
+    // 就被处理，那时invalidate找不到这一项，只能通过登记的generation发现，这次的结果不缓存
+    uint64_t generation;
+    {
+    MutexLockGuard lock(shard.mutex);
+    Opening &opening = shard.opening.emplace(path, Opening{0, 0}).first->second;
+    ++opening.refs;
+    generation = opening.generation;
+    }
+    std::string dir = dir_of(path);
+    bool watched = add_watch(dir);
+    std::shared_ptr<StaticFile> file = StaticFile::open(path, saved_errno);
+
+    bool inserted = false;
+    std::vector<std::string> evicted;
+    {
+    MutexLockGuard lock(shard.mutex);
+    auto opening = shard.opening.find(path);
+    bool invalidated = opening->second.generation != generation;
+    if (--opening->second.refs == 0) {
+        shard.opening.erase(opening);
+    }
+    if (file && watched && !invalidated && shard.index.find(path) == shard.index.end()) {
+        shard.lru.push_front(Entry{path, file});
+        shard.index[path] = shard.lru.begin();
+        inserted = true;
+        evict_if_needed(&shard, &evicted);
+    }
+    }
+    if (watched && !inserted) {
+        release_watch(dir);
+    }
+    for (const std::string &old_path : evicted) {
+        release_watch(dir_of(old_path));
+    }
+    return file;
+}
+
+void FileCache::evict_if_needed(Shard *shard, std::vector<std::string> *evicted) {
+    while (shard->lru.size() > shard_capacity_) {
+        Entry &victim = shard->lru.back();
+        shard->index.erase(victim.path);
+        evicted->push_back(std::move(victim.path));
+        shard->lru.pop_back();
+    }
+}
+
+void FileCache::invalidate(const std::string &path) {
+    Shard &shard = shard_of(path);
+    {
+    MutexLockGuard lock(shard.mutex);
+    auto opening = shard.opening.find(path);
+    if (opening != shard.opening.end()) {
+        ++opening->second.generation;
+    }
+    auto it = shard.index.find(path);
+    if (it == shard.index.end()) {
+        return;
+    }
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    }
+    release_watch(dir_of(path));
+}
+
+void FileCache::invalidate_dir(const std::string &dir) {
+    std::vector<std::string> removed;
+    for (auto &shard : shards_) {
+        MutexLockGuard lock(shard->mutex);
+        for (auto &opening : shard->opening) {
+            if (dir.empty() || dir_of(opening.first) == dir) {
+                ++opening.second.generation;
+            }
+        }
+        for (auto it = shard->lru.begin(); it != shard->lru.end();) {
+            if (dir.empty() || dir_of(it->path) == dir) {
+                shard->index.erase(it->path);
+                removed.push_back(std::move(it->path));
+                it = shard->lru.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const std::string &path : removed) {
+        release_watch(dir_of(path));
+    }
+}
+
+size_t FileCache::size() const {
+    size_t total = 0;
+    for (const auto &shard : shards_) {
+        MutexLockGuard lock(shard->mutex);
+        total += shard->lru.size();
+    }
+    return total;
+}
+
+/**
+ * @brief 增加目录的引用，第一次引用时添加inotify监视
+ * @return false 无法监视，此时不缓存该目录中的文件
+ */
+bool FileCache::add_watch(const std::string &dir) {
+    MutexLockGuard lock(watch_mutex_);
+    auto it = dir_watches_.find(dir);
+    if (it != dir_watches_.end()) {
+        ++watches_[it->second].refs;
+        return true;
+    }
+    int wd = ::inotify_add_watch(inotify_fd_, dir.c_str(), k_watch_mask);
+    if (wd < 0) {
+        LOG_SYSERR_EVERY_T(10) << "FileCache::add_watch " << dir;
+        return false;
+    }
+    if (watches_.find(wd) != watches_.end()) {
+        // 同一个目录的另一种写法，事件只能对应到一个路径上，不缓存
+        return false;
+    }
+    watches_[wd] = Watch{dir, 1};
+    dir_watches_[dir] = wd;
+    return true;
+}
+
+void FileCache::release_watch(const std::string &dir) {
+    MutexLockGuard lock(watch_mutex_);
+    auto it = dir_watches_.find(dir);
+    if (it == dir_watches_.end()) {
+        return;
+    }
+    int wd = it->second;
+    auto watch = watches_.find(wd);
+    assert(watch != watches_.end());
+    if (--watch->second.refs == 0) {
+        ::inotify_rm_watch(inotify_fd_, wd);
+        watches_.erase(watch);
+        dir_watches_.erase(it);
+    }
+}
+
+void FileCache::handle_read() {
+    loop_->assert_in_loop_thread();
+    alignas(struct inotify_event) char buf[4096];
+    while (true) {
+        ssize_t n = ::read(inotify_fd_, buf, sizeof buf);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN) {
+                LOG_SYSERR << "FileCache::handle_read";
+            }
+            break;
+        }
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 丢失了事件，无法知道哪些文件变了，全部失效
+                LOG_WARN << "FileCache::handle_read inotify queue overflow";
+                invalidate_dir(std::string());
+                continue;
+            }
+            std::string dir;
+            {
+            MutexLockGuard lock(watch_mutex_);
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end()) {
+                continue;
+            }
+            dir = it->second.dir;
+            if (event->mask & IN_IGNORED) {
+                dir_watches_.erase(dir);
+                watches_.erase(it);
+            }
+            }
+            if (event->len > 0) {
+                invalidate(join_path(dir, event->name));
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
+                invalidate_dir(dir);
+            }
+        }
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,124 @@
+/**
+ * @brief 静态文件的fd与元数据缓存
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_FILECACHE_H
+#define WEB_SERVER_HTTP_FILECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/Mutex.h"
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+namespace net {
+class Channel;
+class EventLoop;
+} // namespace net
+
+namespace http {
+
+class StaticFile;
+
+/**
+ * @brief 缓存打开的StaticFile：fd、stat结果、MIME类型以及预先生成的ETag和Last-Modified
+ * 按路径的哈希分成多个分片，每个分片一把锁和一条LRU链表，IO线程和计算线程都可以并发调用open；
+ * 缓存的文件总数不超过max_open_files，淘汰的文件在最后一个引用它的响应发送完后关闭。
+ *
+ * 每个缓存了文件的目录有一个inotify监视，inotify的fd作为Channel注册在loop上，
+ * 目录中的文件被修改、替换或删除时在loop线程中使对应的项失效。
+ * 事件是异步处理的，文件修改后到事件被处理之前仍可能返回旧的项；不存在的文件不缓存。
+ * 必须在loop线程中构造和析构，并且先于loop析构
+ */
+class FileCache : private Noncopyable {
+public:
+    FileCache(net::EventLoop *loop, size_t max_open_files = 1024, int num_shards = 8);
+    ~FileCache();
+
+    /**
+     * @brief 取得path对应的文件，未命中时打开并加入缓存
+     * @param path
+     * @param saved_errno 失败时的errno
+     * @return std::shared_ptr<StaticFile> 失败时返回空指针
+     */
+    std::shared_ptr<StaticFile> open(const std::string &path, int *saved_errno);
+
+    /**
+     * @brief 使path对应的项失效，正在打开path的调用这次不缓存打开的结果
+     */
+    void invalidate(const std::string &path);
+
+    size_t size() const;
+
+    int64_t hits() const {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    int64_t misses() const {
+        return misses_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        std::string path;
+        std::shared_ptr<StaticFile> file;
+    };
+    using EntryList = std::list<Entry>;
+
+    /**
+     * @brief 正在打开、还没有加入缓存的路径；打开期间的失效使generation增加，这次打开的结果不再缓存
+     */
+    struct Opening {
+        int refs;
+        uint64_t generation;
+    };
+
+    struct Shard {
+        mutable MutexLock mutex;
+        EntryList lru;                                                  // 最近使用的在前
+        std::unordered_map<std::string, EntryList::iterator> index;
+        std::unordered_map<std::string, Opening> opening;
+    };
+
+    struct Watch {
+        std::string dir;
+        int refs;
+    };
+
+    Shard &shard_of(const std::string &path);
+    void evict_if_needed(Shard *shard, std::vector<std::string> *evicted);
+    bool add_watch(const std::string &dir);
+    void release_watch(const std::string &dir);
+    void invalidate_dir(const std::string &dir);
+    void handle_read();
+
+    net::EventLoop *loop_;
+    const size_t max_open_files_;
+    const size_t shard_capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<int64_t> hits_;
+    std::atomic<int64_t> misses_;
+
+    const int inotify_fd_;
+    std::unique_ptr<net::Channel> inotify_channel_;
+    MutexLock watch_mutex_;
+    std::unordered_map<int, Watch> watches_;                           // wd -> 目录
+    std::unordered_map<std::string, int> dir_watches_;                 // 目录 -> wd
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_FILECACHE_H
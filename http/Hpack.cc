@@ -0,0 +1,480 @@
+/**
+ * @brief HPACK头部压缩（RFC 7541）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Hpack.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace web_server {
+
+namespace http {
+
+namespace hpack {
+
+namespace {
+
+const Header k_static_table[k_static_table_size] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+const int k_num_symbols = 257;
+const int k_eos = 256;
+const int k_max_code_bits = 30;
+
+/**
+ * @brief RFC 7541附录B中各符号的码长，码字由build_codes按规范Huffman码重建
+ */
+const uint8_t k_code_lengths[k_num_symbols] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+/**
+ * @brief 规范Huffman码表，编码按符号查码字，解码逐位累积码字后按码长查符号
+ */
+struct HuffmanTable {
+    HuffmanCode codes[k_num_symbols];
+    uint32_t first_code[k_max_code_bits + 1];   // 每种码长的第一个码字
+    uint16_t count[k_max_code_bits + 1];        // 每种码长的符号数
+    uint16_t offset[k_max_code_bits + 1];       // 每种码长的第一个符号在symbols中的位置
+    uint16_t symbols[k_num_symbols];            // 按码长、符号值排序的符号
+
+    HuffmanTable() {
+        std::fill(count, count + k_max_code_bits + 1, 0);
+        for (int sym = 0; sym < k_num_symbols; ++sym) {
+            ++count[k_code_lengths[sym]];
+        }
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (int bits = 1; bits <= k_max_code_bits; ++bits) {
+            code <<= 1;
+            first_code[bits] = code;
+            offset[bits] = index;
+            code += count[bits];
+            index = static_cast<uint16_t>(index + count[bits]);
+        }
+        uint32_t next[k_max_code_bits + 1];
+        std::copy(first_code, first_code + k_max_code_bits + 1, next);
+        uint16_t filled[k_max_code_bits + 1];
+        std::fill(filled, filled + k_max_code_bits + 1, 0);
+        for (int sym = 0; sym < k_num_symbols; ++sym) {
+            int bits = k_code_lengths[sym];
+            codes[sym].code = next[bits]++;
+            codes[sym].bits = static_cast<uint8_t>(bits);
+            symbols[offset[bits] + filled[bits]++] = static_cast<uint16_t>(sym);
+        }
+    }
+};
+
+const HuffmanTable &huffman_table() {
+    static const HuffmanTable table;
+    return table;
+}
+
+/**
+ * @brief 不加入动态表的字段，每个响应的值都不同，加入后只会挤掉有用的条目
+ */
+bool should_index(boost::string_ref name) {
+    return name != "content-length" && name != "date" && name != "etag" && name != "last-modified" &&
+           name != "set-cookie" && name != "content-range" && name != ":path" && name != "age" &&
+           name != "expires" && name != "location";
+}
+
+/**
+ * @brief 敏感字段编码为永不索引，中间代理也不能压缩它们
+ */
+bool is_sensitive(boost::string_ref name) {
+    return name == "authorization" || name == "proxy-authorization" || name == "cookie";
+}
+
+} // namespace
+
+const Header &static_entry(size_t index) {
+    assert(index >= 1 && index <= k_static_table_size);
+    return k_static_table[index - 1];
+}
+
+const HuffmanCode &huffman_code(int sym) {
+    assert(sym >= 0 && sym < k_num_symbols);
+    return huffman_table().codes[sym];
+}
+
+size_t huffman_encoded_length(boost::string_ref data) {
+    const HuffmanTable &table = huffman_table();
+    size_t bits = 0;
+    for (char c : data) {
+        bits += table.codes[static_cast<unsigned char>(c)].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(boost::string_ref data, std::string *output) {
+    const HuffmanTable &table = huffman_table();
+    uint64_t acc = 0;
+    int bits = 0;
+    for (char c : data) {
+        const HuffmanCode &code = table.codes[static_cast<unsigned char>(c)];
+        acc = (acc << code.bits) | code.code;
+        bits += code.bits;
+        while (bits >= 8) {
+            bits -= 8;
+            output->push_back(static_cast<char>(acc >> bits));
+        }
+        acc &= (1ULL << bits) - 1;
+    }
+    if (bits > 0) {
+        // 用EOS的高位（全1）填充到字节边界
+        acc = (acc << (8 - bits)) | ((1U << (8 - bits)) - 1);
+        output->push_back(static_cast<char>(acc));
+    }
+}
+
+bool huffman_decode(boost::string_ref data, std::string *output) {
+    const HuffmanTable &table = huffman_table();
+    uint32_t code = 0;
+    int bits = 0;
+    for (char c : data) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        for (int i = 7; i >= 0; --i) {
+            code = (code << 1) | ((byte >> i) & 1);
+            ++bits;
+            uint32_t delta = code - table.first_code[bits];
+            if (code >= table.first_code[bits] && delta < table.count[bits]) {
+                int sym = table.symbols[table.offset[bits] + delta];
+                if (sym == k_eos) {
+                    return false;
+                }
+                output->push_back(static_cast<char>(sym));
+                code = 0;
+                bits = 0;
+            } else if (bits == k_max_code_bits) {
+                return false;
+            }
+        }
+    }
+    // 剩余的填充必须是EOS的前缀，且不超过7位
+    return bits <= 7 && code == (1U << bits) - 1;
+}
+
+void encode_integer(uint64_t value, int prefix_bits, uint8_t first_byte, std::string *output) {
+    uint64_t max_prefix = (1U << prefix_bits) - 1;
+    if (value < max_prefix) {
+        output->push_back(static_cast<char>(first_byte | value));
+        return;
+    }
+    output->push_back(static_cast<char>(first_byte | max_prefix));
+    value -= max_prefix;
+    while (value >= 128) {
+        output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output->push_back(static_cast<char>(value));
+}
+
+bool decode_integer(boost::string_ref *data, int prefix_bits, uint64_t *value) {
+    if (data->empty()) {
+        return false;
+    }
+    uint64_t max_prefix = (1U << prefix_bits) - 1;
+    uint64_t result = static_cast<unsigned char>((*data)[0]) & max_prefix;
+    size_t pos = 1;
+    if (result == max_prefix) {
+        int shift = 0;
+        while (true) {
+            if (pos >= data->size() || shift > 28) {
+                return false;
+            }
+            unsigned char byte = static_cast<unsigned char>((*data)[pos++]);
+            result += static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (result > 0xffffffffULL) {
+            return false;
+        }
+    }
+    data->remove_prefix(pos);
+    *value = result;
+    return true;
+}
+
+void DynamicTable::add(const std::string &name, const std::string &value) {
+    size_t entry_size = name.size() + value.size() + k_entry_overhead;
+    if (entry_size > max_size_) {
+        // 比整张表还大的条目使表清空，本身也不加入
+        evict(0);
+        return;
+    }
+    evict(max_size_ - entry_size);
+    entries_.emplace_front(name, value);
+    size_ += entry_size;
+}
+
+void DynamicTable::set_max_size(size_t max_size) {
+    max_size_ = max_size;
+    evict(max_size);
+}
+
+void DynamicTable::evict(size_t target) {
+    while (size_ > target) {
+        const Header &oldest = entries_.back();
+        size_ -= oldest.first.size() + oldest.second.size() + k_entry_overhead;
+        entries_.pop_back();
+    }
+}
+
+bool Decoder::lookup(uint64_t index, Header *header) const {
+    if (index == 0) {
+        return false;
+    }
+    if (index <= k_static_table_size) {
+        *header = k_static_table[index - 1];
+        return true;
+    }
+    index -= k_static_table_size + 1;
+    if (index >= table_.count()) {
+        return false;
+    }
+    *header = table_.at(index);
+    return true;
+}
+
+bool Decoder::decode_string(boost::string_ref *data, std::string *output) {
+    if (data->empty()) {
+        return false;
+    }
+    bool huffman = static_cast<unsigned char>((*data)[0]) & 0x80;
+    uint64_t length = 0;
+    if (!decode_integer(data, 7, &length) || length > data->size()) {
+        return false;
+    }
+    boost::string_ref s = data->substr(0, length);
+    data->remove_prefix(length);
+    output->clear();
+    if (huffman) {
+        return huffman_decode(s, output);
+    }
+    output->assign(s.data(), s.size());
+    return true;
+}
+
+bool Decoder::decode(boost::string_ref block, HeaderList *headers) {
+    size_t list_size = 0;
+    bool header_seen = false;
+    while (!block.empty()) {
+        unsigned char byte = static_cast<unsigned char>(block[0]);
+        Header header;
+        uint64_t index = 0;
+        if (byte & 0x80) {
+            // 索引字段
+            if (!decode_integer(&block, 7, &index) || !lookup(index, &header)) {
+                return false;
+            }
+        } else if ((byte & 0xe0) == 0x20) {
+            // 动态表大小更新只能出现在头部块开头
+            uint64_t size = 0;
+            if (header_seen || !decode_integer(&block, 5, &size) || size > max_table_size_) {
+                return false;
+            }
+            table_.set_max_size(size);
+            continue;
+        } else {
+            // 字面量：0x40加入动态表，0x00不加入，0x10永不索引
+            bool indexing = byte & 0x40;
+            int prefix_bits = indexing ? 6 : 4;
+            if (!decode_integer(&block, prefix_bits, &index)) {
+                return false;
+            }
+            if (index == 0) {
+                if (!decode_string(&block, &header.first)) {
+                    return false;
+                }
+            } else {
+                Header name;
+                if (!lookup(index, &name)) {
+                    return false;
+                }
+                header.first.swap(name.first);
+            }
+            if (!decode_string(&block, &header.second)) {
+                return false;
+            }
+            if (indexing) {
+                table_.add(header.first, header.second);
+            }
+        }
+        header_seen = true;
+        list_size += header.first.size() + header.second.size() + k_entry_overhead;
+        if (list_size > max_header_list_size_) {
+            return false;
+        }
+        headers->push_back(std::move(header));
+    }
+    return true;
+}
+
+void Encoder::set_max_table_size(size_t max_size) {
+    if (max_size != table_.max_size()) {
+        table_.set_max_size(max_size);
+        pending_size_update_ = true;
+    }
+}
+
+void Encoder::encode_string(boost::string_ref s, std::string *output) const {
+    size_t huffman_length = huffman_encoded_length(s);
+    if (huffman_length < s.size()) {
+        encode_integer(huffman_length, 7, 0x80, output);
+        huffman_encode(s, output);
+    } else {
+        encode_integer(s.size(), 7, 0, output);
+        output->append(s.data(), s.size());
+    }
+}
+
+size_t Encoder::find(boost::string_ref name, boost::string_ref value, size_t *name_index) const {
+    *name_index = 0;
+    for (size_t i = 0; i < k_static_table_size; ++i) {
+        const Header &entry = k_static_table[i];
+        if (entry.first == name) {
+            if (entry.second == value) {
+                return i + 1;
+            }
+            if (*name_index == 0) {
+                *name_index = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < table_.count(); ++i) {
+        const Header &entry = table_.at(i);
+        if (entry.first == name) {
+            if (entry.second == value) {
+                return k_static_table_size + 1 + i;
+            }
+            if (*name_index == 0) {
+                *name_index = k_static_table_size + 1 + i;
+            }
+        }
+    }
+    return 0;
+}
+
+void Encoder::encode(boost::string_ref name, boost::string_ref value, std::string *output) {
+    if (pending_size_update_) {
+        encode_integer(table_.max_size(), 5, 0x20, output);
+        pending_size_update_ = false;
+    }
+    size_t name_index = 0;
+    size_t index = find(name, value, &name_index);
+    if (index != 0) {
+        encode_integer(index, 7, 0x80, output);
+        return;
+    }
+    bool indexing = should_index(name) && !is_sensitive(name);
+    if (indexing) {
+        encode_integer(name_index, 6, 0x40, output);
+    } else {
+        encode_integer(name_index, 4, is_sensitive(name) ? 0x10 : 0, output);
+    }
+    if (name_index == 0) {
+        encode_string(name, output);
+    }
+    encode_string(value, output);
+    if (indexing) {
+        table_.add(std::string(name.data(), name.size()), std::string(value.data(), value.size()));
+    }
+}
+
+void Encoder::encode(const HeaderList &headers, std::string *output) {
+    for (const Header &header : headers) {
+        encode(header.first, header.second, output);
+    }
+}
+
+} // namespace hpack
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,192 @@
+/**
+ * @brief HPACK头部压缩（RFC 7541）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HPACK_H
+#define WEB_SERVER_HTTP_HPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace web_server {
+
+namespace http {
+
+namespace hpack {
+
+using Header = std::pair<std::string, std::string>;
+using HeaderList = std::vector<Header>;
+
+/**
+ * @brief 静态表的条目数，索引1到61
+ */
+const size_t k_static_table_size = 61;
+/**
+ * @brief 每个动态表条目在名字和值之外额外计入的字节数
+ */
+const size_t k_entry_overhead = 32;
+const size_t k_default_table_size = 4096;
+
+/**
+ * @brief 静态表中的第index项，index从1开始
+ */
+const Header &static_entry(size_t index);
+
+/**
+ * @brief Huffman编码的码字，码长保存在低位对齐的code中
+ * 码表是规范Huffman码：码长相同的符号按符号值递增分配连续的码字，因此只需要码长就能重建整张表
+ */
+struct HuffmanCode {
+    uint32_t code;
+    uint8_t bits;
+};
+
+/**
+ * @brief 符号sym的码字，sym为0到256，256为EOS
+ */
+const HuffmanCode &huffman_code(int sym);
+
+/**
+ * @brief data经过Huffman编码后的字节数
+ */
+size_t huffman_encoded_length(boost::string_ref data);
+
+void huffman_encode(boost::string_ref data, std::string *output);
+
+/**
+ * @brief Huffman解码，遇到EOS、超过7位或者不全为1的填充时失败
+ */
+bool huffman_decode(boost::string_ref data, std::string *output);
+
+/**
+ * @brief 按prefix_bits位前缀编码整数，first_byte为前缀之外的高位标志
+ */
+void encode_integer(uint64_t value, int prefix_bits, uint8_t first_byte, std::string *output);
+
+/**
+ * @brief 解码整数
+ * @param data 输入，成功时前进到整数之后
+ * @return false 数据不完整或者超过32位
+ */
+bool decode_integer(boost::string_ref *data, int prefix_bits, uint64_t *value);
+
+/**
+ * @brief 编码器和解码器各自的动态表，先进先出，超过容量时从最旧的条目开始淘汰
+ */
+class DynamicTable {
+public:
+    explicit DynamicTable(size_t max_size = k_default_table_size) : size_(0), max_size_(max_size) {}
+
+    void add(const std::string &name, const std::string &value);
+    void set_max_size(size_t max_size);
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t max_size() const {
+        return max_size_;
+    }
+
+    size_t count() const {
+        return entries_.size();
+    }
+
+    /**
+     * @brief 第index项，0为最新加入的条目
+     */
+    const Header &at(size_t index) const {
+        return entries_[index];
+    }
+
+private:
+    void evict(size_t target);
+
+    std::deque<Header> entries_;    // 最新的在前
+    size_t size_;
+    size_t max_size_;
+};
+
+/**
+ * @brief 头部块解码器，连接上的所有头部块按到达顺序依次解码，共享一个动态表
+ */
+class Decoder {
+public:
+    /**
+     * @param max_table_size 我方通告的SETTINGS_HEADER_TABLE_SIZE，对端的表大小更新不能超过该值
+     * @param max_header_list_size 解码后头部列表的上限，按名字、值加32字节计算
+     */
+    explicit Decoder(size_t max_table_size = k_default_table_size, size_t max_header_list_size = 64 * 1024)
+        : table_(max_table_size),
+          max_table_size_(max_table_size),
+          max_header_list_size_(max_header_list_size) {}
+
+    /**
+     * @brief 解码一个完整的头部块
+     * @return false 压缩错误，连接必须以COMPRESSION_ERROR关闭
+     */
+    bool decode(boost::string_ref block, HeaderList *headers);
+
+    const DynamicTable &table() const {
+        return table_;
+    }
+
+private:
+    bool lookup(uint64_t index, Header *header) const;
+    bool decode_string(boost::string_ref *data, std::string *output);
+
+    DynamicTable table_;
+    size_t max_table_size_;
+    size_t max_header_list_size_;
+};
+
+/**
+ * @brief 头部块编码器
+ * 与静态表或动态表完全匹配的字段编码为索引，否则编码为字面量并加入动态表；
+ * 每次请求都不同的字段（content-length、date等）不加入动态表，避免把有用的条目挤出去。
+ * 字符串在Huffman编码更短时使用Huffman编码
+ */
+class Encoder {
+public:
+    explicit Encoder(size_t max_table_size = k_default_table_size) : table_(max_table_size), pending_size_update_(false) {}
+
+    /**
+     * @brief 对端通过SETTINGS_HEADER_TABLE_SIZE调整了表大小，在下一个头部块的开头通知对端
+     */
+    void set_max_table_size(size_t max_size);
+
+    void encode(boost::string_ref name, boost::string_ref value, std::string *output);
+    void encode(const HeaderList &headers, std::string *output);
+
+    const DynamicTable &table() const {
+        return table_;
+    }
+
+private:
+    void encode_string(boost::string_ref s, std::string *output) const;
+    /**
+     * @brief 查找完全匹配的索引，找不到时name_index为名字匹配的索引，都为0表示没有
+     */
+    size_t find(boost::string_ref name, boost::string_ref value, size_t *name_index) const;
+
+    DynamicTable table_;
+    bool pending_size_update_;
+};
+
+} // namespace hpack
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HPACK_H
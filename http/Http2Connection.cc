@@ -0,0 +1,792 @@
+/**
+ * @brief 一个HTTP/2连接上的协议状态
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Http2Connection.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "base/Base64.h"
+#include "base/Logging.h"
+#include "http/StreamSignal.h"
+#include "net/EventLoop.h"
+#include "net/TcpConnection.h"
+
+namespace web_server {
+
+namespace http {
+
+using namespace http2;
+using net::TcpConnectionPtr;
+
+namespace {
+
+const char k_upgrade_response[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+
+/**
+ * @brief HTTP/2的首部名都是小写，转换成"Accept-Encoding"这样的写法，
+ * 处理函数按HTTP/1.1中的习惯查找首部，不需要区分协议
+ */
+std::string canonical_name(const std::string &name) {
+    std::string result(name);
+    bool upper = true;
+    for (char &c : result) {
+        if (upper && c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+        upper = c == '-';
+    }
+    return result;
+}
+
+std::string lower_name(const std::string &name) {
+    std::string result(name);
+    for (char &c : result) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief HTTP/2中禁止出现的逐跳首部
+ */
+bool is_connection_header(const std::string &name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+/**
+ * @brief 由解码后的头部列表构造请求
+ * @return false 请求格式错误，流以PROTOCOL_ERROR重置；未知方法不算格式错误，由调用者回复400
+ */
+bool build_request(const hpack::HeaderList &headers, HttpRequest *req) {
+    bool regular_seen = false;
+    bool has_method = false;
+    bool has_path = false;
+    bool has_scheme = false;
+    std::string authority;
+    std::map<std::string, std::string> fields;
+    for (const hpack::Header &header : headers) {
+        const std::string &name = header.first;
+        const std::string &value = header.second;
+        if (name.empty()) {
+            return false;
+        }
+        if (name[0] == ':') {
+            if (regular_seen) {
+                return false;
+            }
+            if (name == ":method" && !has_method) {
+                has_method = true;
+                req->set_method(value.data(), value.data() + value.size());
+            } else if (name == ":path" && !has_path && !value.empty()) {
+                has_path = true;
+                size_t question = value.find('?');
+                if (question == std::string::npos) {
+                    req->set_path(value.data(), value.data() + value.size());
+                } else {
+                    req->set_path(value.data(), value.data() + question);
+                    req->set_query(value.data() + question, value.data() + value.size());
+                }
+            } else if (name == ":scheme" && !has_scheme) {
+                has_scheme = true;
+            } else if (name == ":authority" && authority.empty()) {
+                authority = value;
+            } else {
+                return false;
+            }
+            continue;
+        }
+        regular_seen = true;
+        if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+            is_connection_header(name) || (name == "te" && value != "trailers")) {
+            return false;
+        }
+        std::string field = canonical_name(name);
+        auto it = fields.find(field);
+        if (it == fields.end()) {
+            fields.insert(std::make_pair(field, value));
+        } else {
+            // 拆开发送的Cookie用"; "拼接，其余重复的首部用", "拼接
+            it->second += name == "cookie" ? "; " : ", ";
+            it->second += value;
+        }
+    }
+    if (!has_method || !has_path || !has_scheme) {
+        return false;
+    }
+    if (!authority.empty() && fields.find("Host") == fields.end()) {
+        fields.insert(std::make_pair("Host", authority));
+    }
+    for (const auto &field : fields) {
+        req->add_header(field.first, field.second);
+    }
+    req->set_version(HttpRequest::k_http2);
+    return true;
+}
+
+} // namespace
+
+Http2Connection::Http2Connection(const RequestCallback &cb)
+    : request_callback_(cb),
+      preface_received_(false),
+      settings_received_(false),
+      closed_(false),
+      goaway_received_(false),
+      last_stream_id_(0),
+      header_stream_id_(0),
+      header_end_stream_(false),
+      header_error_(k_no_error),
+      peer_initial_window_(k_default_window_size),
+      peer_max_frame_size_(k_default_max_frame_size),
+      send_window_(k_default_window_size),
+      recv_window_(k_default_window_size),
+      recv_consumed_(0),
+      awaiting_write_(false),
+      retry_pending_(false) {}
+
+Http2Connection::~Http2Connection() {
+    for (auto &entry : streams_) {
+        if (entry.second.stream_signal) {
+            entry.second.stream_signal->cancel();
+        }
+    }
+}
+
+void Http2Connection::start(const TcpConnectionPtr &conn) {
+    std::vector<Setting> settings = {
+        {k_settings_max_concurrent_streams, k_max_concurrent_streams},
+        {k_settings_max_header_list_size, 64 * 1024},
+    };
+    append_settings(&output_, settings);
+    send_output(conn);
+}
+
+bool Http2Connection::start_upgrade(const TcpConnectionPtr &conn,
+                                    const std::string &settings,
+                                    const HttpRequest &req) {
+    std::string payload;
+    std::vector<Setting> peer_settings;
+    if (!base64::decode(settings, &payload) || !parse_settings(payload, &peer_settings) ||
+        apply_settings(peer_settings) != k_no_error) {
+        return false;
+    }
+    conn->send(k_upgrade_response, sizeof k_upgrade_response - 1);
+    start(conn);
+
+    // 升级请求是流1，请求已经完整，直接交给回调
+    last_stream_id_ = 1;
+    Stream &stream = streams_.insert(std::make_pair(1u, Stream(peer_initial_window_))).first->second;
+    stream.headers_received = true;
+    stream.request = req;
+    stream.request.set_version(HttpRequest::k_http2);
+    dispatch(conn, 1);
+    return true;
+}
+
+bool Http2Connection::on_data(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receive_time) {
+    if (closed_) {
+        buf->retrieve_all();
+        return false;
+    }
+    receive_time_ = receive_time;
+    if (!preface_received_) {
+        size_t n = std::min(buf->readable_bytes(), k_client_preface_length);
+        if (memcmp(buf->peek(), k_client_preface, n) != 0) {
+            buf->retrieve_all();
+            return connection_error(conn, k_protocol_error, "invalid connection preface");
+        }
+        if (n < k_client_preface_length) {
+            return true;
+        }
+        buf->retrieve(k_client_preface_length);
+        preface_received_ = true;
+    }
+
+    bool ok = true;
+    while (ok && buf->readable_bytes() >= k_frame_header_length) {
+        FrameHeader header;
+        parse_frame_header(buf->peek(), &header);
+        if (header.length > k_default_max_frame_size) {
+            ok = connection_error(conn, k_frame_size_error, "frame exceeds SETTINGS_MAX_FRAME_SIZE");
+            break;
+        }
+        if (buf->readable_bytes() < k_frame_header_length + header.length) {
+            break;
+        }
+        ok = handle_frame(conn, header, boost::string_ref(buf->peek() + k_frame_header_length, header.length));
+        buf->retrieve(k_frame_header_length + header.length);
+    }
+    if (!ok) {
+        buf->retrieve_all();
+        return false;
+    }
+    // 请求体被丢弃，连接窗口每次读完都补满
+    if (recv_consumed_ > 0) {
+        append_window_update(&output_, 0, recv_consumed_);
+        recv_window_ += recv_consumed_;
+        recv_consumed_ = 0;
+    }
+    flush(conn);
+    return true;
+}
+
+bool Http2Connection::handle_frame(const TcpConnectionPtr &conn,
+                                   const FrameHeader &header,
+                                   boost::string_ref payload) {
+    if (header_stream_id_ != 0 && header.type != k_continuation) {
+        return connection_error(conn, k_protocol_error, "header block interrupted");
+    }
+    if (!settings_received_ && header.type != k_settings) {
+        return connection_error(conn, k_protocol_error, "first frame is not SETTINGS");
+    }
+    switch (header.type) {
+        case k_data:
+            return handle_data(conn, header, payload);
+        case k_headers:
+            return handle_headers(conn, header, payload);
+        case k_priority:
+            if (header.stream_id == 0) {
+                return connection_error(conn, k_protocol_error, "PRIORITY on stream 0");
+            }
+            if (header.length != 5) {
+                reset_stream(header.stream_id, k_frame_size_error);
+            }
+            return true;
+        case k_rst_stream:
+            if (header.stream_id == 0 || header.stream_id > last_stream_id_) {
+                return connection_error(conn, k_protocol_error, "RST_STREAM on idle stream");
+            }
+            if (header.length != 4) {
+                return connection_error(conn, k_frame_size_error, "bad RST_STREAM length");
+            }
+            {
+                auto it = streams_.find(header.stream_id);
+                if (it != streams_.end()) {
+                    erase_stream(it);
+                }
+            }
+            return true;
+        case k_settings:
+            return handle_settings(conn, header, payload);
+        case k_push_promise:
+            return connection_error(conn, k_protocol_error, "PUSH_PROMISE from client");
+        case k_ping:
+            if (header.stream_id != 0) {
+                return connection_error(conn, k_protocol_error, "PING on a stream");
+            }
+            if (header.length != 8) {
+                return connection_error(conn, k_frame_size_error, "bad PING length");
+            }
+            if (!(header.flags & k_flag_ack)) {
+                append_ping_ack(&output_, payload);
+            }
+            return true;
+        case k_goaway:
+            if (header.stream_id != 0) {
+                return connection_error(conn, k_protocol_error, "GOAWAY on a stream");
+            }
+            // 处理完已经收到的流再关闭
+            goaway_received_ = true;
+            return true;
+        case k_window_update:
+            return handle_window_update(conn, header, payload);
+        case k_continuation:
+            return handle_continuation(conn, header, payload);
+        default:
+            // 未知类型的帧必须忽略
+            return true;
+    }
+}
+
+bool Http2Connection::handle_data(const TcpConnectionPtr &conn,
+                                  const FrameHeader &header,
+                                  boost::string_ref payload) {
+    if (header.stream_id == 0) {
+        return connection_error(conn, k_protocol_error, "DATA on stream 0");
+    }
+    if (!strip_padding(header.flags, 0, &payload)) {
+        return connection_error(conn, k_protocol_error, "bad DATA padding");
+    }
+    // 填充也计入流量控制
+    recv_window_ -= header.length;
+    if (recv_window_ < 0) {
+        return connection_error(conn, k_flow_control_error, "connection receive window exceeded");
+    }
+    recv_consumed_ += header.length;
+
+    auto it = streams_.find(header.stream_id);
+    if (it == streams_.end() || !it->second.headers_received || it->second.request_done) {
+        if (header.stream_id > last_stream_id_) {
+            return connection_error(conn, k_protocol_error, "DATA on idle stream");
+        }
+        reset_stream(header.stream_id, k_stream_closed);
+        return true;
+    }
+    // 不支持请求体，数据直接丢弃，流窗口立即补回
+    if (header.flags & k_flag_end_stream) {
+        dispatch(conn, header.stream_id);
+    } else if (header.length > 0) {
+        append_window_update(&output_, header.stream_id, header.length);
+    }
+    return true;
+}
+
+bool Http2Connection::handle_headers(const TcpConnectionPtr &conn,
+                                     const FrameHeader &header,
+                                     boost::string_ref payload) {
+    uint32_t id = header.stream_id;
+    if (id == 0 || id % 2 == 0) {
+        return connection_error(conn, k_protocol_error, "HEADERS on invalid stream");
+    }
+    if (!strip_padding(header.flags, (header.flags & k_flag_priority) ? 5 : 0, &payload)) {
+        return connection_error(conn, k_protocol_error, "bad HEADERS padding");
+    }
+
+    header_error_ = k_no_error;
+    auto it = streams_.find(id);
+    if (it != streams_.end()) {
+        // 同一个流上的第二个头部块是trailer，必须结束请求
+        if (it->second.request_done) {
+            header_error_ = k_stream_closed;
+        } else if (!(header.flags & k_flag_end_stream)) {
+            header_error_ = k_protocol_error;
+        }
+    } else if (id <= last_stream_id_) {
+        return connection_error(conn, k_stream_closed, "HEADERS on closed stream");
+    } else {
+        last_stream_id_ = id;
+        if (goaway_received_ || streams_.size() >= k_max_concurrent_streams) {
+            // 头部块仍然要解码，保持HPACK动态表同步
+            header_error_ = k_refused_stream;
+        } else {
+            streams_.insert(std::make_pair(id, Stream(peer_initial_window_)));
+        }
+    }
+    header_stream_id_ = id;
+    header_end_stream_ = header.flags & k_flag_end_stream;
+    header_block_.assign(payload.data(), payload.size());
+    if (header.flags & k_flag_end_headers) {
+        return end_header_block(conn);
+    }
+    return true;
+}
+
+bool Http2Connection::handle_continuation(const TcpConnectionPtr &conn,
+                                          const FrameHeader &header,
+                                          boost::string_ref payload) {
+    if (header_stream_id_ == 0 || header.stream_id != header_stream_id_) {
+        return connection_error(conn, k_protocol_error, "unexpected CONTINUATION");
+    }
+    if (header_block_.size() + payload.size() > k_max_header_block_size) {
+        return connection_error(conn, k_enhance_your_calm, "header block too large");
+    }
+    header_block_.append(payload.data(), payload.size());
+    if (header.flags & k_flag_end_headers) {
+        return end_header_block(conn);
+    }
+    return true;
+}
+
+bool Http2Connection::end_header_block(const TcpConnectionPtr &conn) {
+    uint32_t id = header_stream_id_;
+    header_stream_id_ = 0;
+    hpack::HeaderList headers;
+    bool decoded = decoder_.decode(header_block_, &headers);
+    header_block_.clear();
+    if (!decoded) {
+        return connection_error(conn, k_compression_error, "HPACK decoding failed");
+    }
+    if (header_error_ != k_no_error) {
+        reset_stream(id, header_error_);
+        return true;
+    }
+
+    auto it = streams_.find(id);
+    assert(it != streams_.end());
+    Stream &stream = it->second;
+    if (!stream.headers_received) {
+        stream.headers_received = true;
+        if (!build_request(headers, &stream.request)) {
+            reset_stream(id, k_protocol_error);
+            return true;
+        }
+        stream.request.set_receive_time(receive_time_);
+    }
+    if (header_end_stream_) {
+        dispatch(conn, id);
+    }
+    return true;
+}
+
+bool Http2Connection::handle_settings(const TcpConnectionPtr &conn,
+                                      const FrameHeader &header,
+                                      boost::string_ref payload) {
+    if (header.stream_id != 0) {
+        return connection_error(conn, k_protocol_error, "SETTINGS on a stream");
+    }
+    if (header.flags & k_flag_ack) {
+        if (header.length != 0) {
+            return connection_error(conn, k_frame_size_error, "SETTINGS ACK with payload");
+        }
+        return true;
+    }
+    std::vector<Setting> settings;
+    if (!parse_settings(payload, &settings)) {
+        return connection_error(conn, k_frame_size_error, "bad SETTINGS length");
+    }
+    ErrorCode error = apply_settings(settings);
+    if (error != k_no_error) {
+        return connection_error(conn, error, "invalid SETTINGS value");
+    }
+    settings_received_ = true;
+    append_settings_ack(&output_);
+    return true;
+}
+
+ErrorCode Http2Connection::apply_settings(const std::vector<Setting> &settings) {
+    for (const Setting &setting : settings) {
+        switch (setting.id) {
+            case k_settings_header_table_size:
+                // 编码器的表不超过默认大小，对端允许得更大也不多占内存
+                encoder_.set_max_table_size(std::min<size_t>(setting.value, hpack::k_default_table_size));
+                break;
+            case k_settings_enable_push:
+                if (setting.value > 1) {
+                    return k_protocol_error;
+                }
+                break;
+            case k_settings_initial_window_size: {
+                if (setting.value > k_max_window_size) {
+                    return k_flow_control_error;
+                }
+                // 新的初始窗口对所有已有的流按差值生效
+                int64_t delta = static_cast<int64_t>(setting.value) - peer_initial_window_;
+                peer_initial_window_ = setting.value;
+                for (auto &item : streams_) {
+                    item.second.send_window += delta;
+                    if (item.second.send_window > k_max_window_size) {
+                        return k_flow_control_error;
+                    }
+                }
+                break;
+            }
+            case k_settings_max_frame_size:
+                if (setting.value < k_default_max_frame_size || setting.value > k_max_max_frame_size) {
+                    return k_protocol_error;
+                }
+                peer_max_frame_size_ = setting.value;
+                break;
+            default:
+                // 最大并发流数等限制的是服务端推送，这里用不到；未知的设置必须忽略
+                break;
+        }
+    }
+    return k_no_error;
+}
+
+bool Http2Connection::handle_window_update(const TcpConnectionPtr &conn,
+                                           const FrameHeader &header,
+                                           boost::string_ref payload) {
+    if (header.length != 4) {
+        return connection_error(conn, k_frame_size_error, "bad WINDOW_UPDATE length");
+    }
+    uint32_t increment = read_uint32(payload.data()) & 0x7fffffff;
+    if (header.stream_id == 0) {
+        if (increment == 0) {
+            return connection_error(conn, k_protocol_error, "zero WINDOW_UPDATE increment");
+        }
+        send_window_ += increment;
+        if (send_window_ > k_max_window_size) {
+            return connection_error(conn, k_flow_control_error, "connection send window overflow");
+        }
+        return true;
+    }
+    auto it = streams_.find(header.stream_id);
+    if (it == streams_.end()) {
+        if (header.stream_id > last_stream_id_) {
+            return connection_error(conn, k_protocol_error, "WINDOW_UPDATE on idle stream");
+        }
+        return true;
+    }
+    if (increment == 0) {
+        reset_stream(header.stream_id, k_protocol_error);
+        return true;
+    }
+    it->second.send_window += increment;
+    if (it->second.send_window > k_max_window_size) {
+        reset_stream(header.stream_id, k_flow_control_error);
+    }
+    return true;
+}
+
+void Http2Connection::dispatch(const TcpConnectionPtr &conn, uint32_t stream_id) {
+    auto it = streams_.find(stream_id);
+    assert(it != streams_.end());
+    it->second.request_done = true;
+    HttpRequest req;
+    req.swap(it->second.request);
+    if (req.method() == HttpRequest::k_invalid) {
+        HttpResponse response(false);
+        response.set_status_code(HttpResponse::k_400_bad_request);
+        response.set_status_message("Bad Request");
+        send_response(conn, stream_id, response);
+        return;
+    }
+    // 回调可能直接发送响应，之后不能再使用it
+    request_callback_(conn, stream_id, req);
+}
+
+void Http2Connection::reset_stream(uint32_t stream_id, ErrorCode error) {
+    append_rst_stream(&output_, stream_id, error);
+    auto it = streams_.find(stream_id);
+    if (it != streams_.end()) {
+        erase_stream(it);
+    }
+}
+
+bool Http2Connection::connection_error(const TcpConnectionPtr &conn, ErrorCode error, const char *reason) {
+    LOG_DEBUG << "Http2Connection [" << conn->name() << "] connection error " << static_cast<int>(error) << ": " << reason;
+    append_goaway(&output_, last_stream_id_, error);
+    send_output(conn);
+    conn->shutdown();
+    closed_ = true;
+    while (!streams_.empty()) {
+        erase_stream(streams_.begin());
+    }
+    return false;
+}
+
+void Http2Connection::send_response(const TcpConnectionPtr &conn,
+                                    uint32_t stream_id,
+                                    const HttpResponse &response) {
+    auto it = streams_.find(stream_id);
+    if (closed_ || it == streams_.end() || it->second.response_started) {
+        return;
+    }
+    Stream &stream = it->second;
+    stream.response_started = true;
+
+    std::string block;
+    encoder_.encode(":status", std::to_string(static_cast<int>(response.status_code())), &block);
+    for (const auto &header : response.headers()) {
+        std::string name = lower_name(header.first);
+        if (!is_connection_header(name) && name != "content-length") {
+            encoder_.encode(name, header.second, &block);
+        }
+    }
+    bool not_modified = response.status_code() == HttpResponse::k_304_not_modified;
+    int64_t length = response.streaming() ? response.content_length() : response.body_size();
+    if (length >= 0 && !not_modified) {
+        encoder_.encode("content-length", std::to_string(length), &block);
+    }
+    bool has_body = !response.head_only() && !not_modified && length != 0;
+    append_header_block(&output_, stream_id, block, !has_body, peer_max_frame_size_);
+    if (!has_body) {
+        finish_stream(it);
+        flush(conn);
+        return;
+    }
+
+    if (response.has_file_body()) {
+        stream.file_holder = response.file_holder();
+        if (response.file_parts().empty()) {
+            stream.segments.push_back(Segment{std::string(), response.file_fd(), response.file_offset(),
+                                              static_cast<size_t>(response.content_length())});
+        } else {
+            for (const HttpResponse::FilePart &part : response.file_parts()) {
+                stream.segments.push_back(Segment{part.header, -1, 0, part.header.size()});
+                stream.segments.push_back(Segment{std::string(), response.file_fd(), part.offset, part.length});
+            }
+            const std::string &tail = response.file_parts_tail();
+            stream.segments.push_back(Segment{tail, -1, 0, tail.size()});
+        }
+        stream.body_done = true;
+    } else if (response.streaming()) {
+        stream.body_stream = response.body_stream();
+        stream.stream_signal = response.stream_signal();
+        stream.stream_remaining = response.content_length();
+    } else {
+        stream.segments.push_back(Segment{response.body(), -1, 0, response.body().size()});
+        stream.body_done = true;
+    }
+    flush(conn);
+}
+
+void Http2Connection::on_write_complete(const TcpConnectionPtr &conn) {
+    awaiting_write_ = false;
+    flush(conn);
+}
+
+/**
+ * @brief 按轮转方式发送各个流的DATA帧，每轮每个流最多一帧，
+ * 受连接窗口、流窗口和对端最大帧长限制，一批写满后等写完成再继续
+ */
+void Http2Connection::flush(const TcpConnectionPtr &conn) {
+    if (closed_) {
+        return;
+    }
+    size_t written = 0;
+    // Upgrade之后，客户端的前言和SETTINGS到达之前不发送DATA：
+    // 有的客户端在处理完101之前只能缓存很少的后续数据
+    bool progress = !awaiting_write_ && settings_received_;
+    while (progress && written < k_flush_batch_size && send_window_ > 0) {
+        progress = false;
+        for (auto it = streams_.begin(); it != streams_.end() && send_window_ > 0 &&
+                                         written < k_flush_batch_size;) {
+            auto next = std::next(it);
+            Stream &stream = it->second;
+            if (!stream.response_started) {
+                it = next;
+                continue;
+            }
+            if (stream.segments.empty() && !stream.body_done && !produce(conn, &stream)) {
+                // 流式响应体比Content-Length短，对端无法判断结束，只能重置
+                reset_stream(it->first, k_internal_error);
+                it = next;
+                continue;
+            }
+            if (stream.segments.empty() && stream.body_done) {
+                append_frame_header(&output_, 0, k_data, k_flag_end_stream, it->first);
+                finish_stream(it);
+            } else if (!stream.segments.empty() && stream.send_window > 0) {
+                size_t len = std::min<int64_t>({static_cast<int64_t>(stream.segments.front().length),
+                                                stream.send_window, send_window_,
+                                                static_cast<int64_t>(peer_max_frame_size_)});
+                written += len;
+                progress = true;
+                if (write_data(conn, it->first, &stream, len)) {
+                    finish_stream(it);
+                }
+            }
+            it = next;
+        }
+    }
+    if (written >= k_flush_batch_size) {
+        awaiting_write_ = true;
+    }
+    send_output(conn);
+    if (goaway_received_ && streams_.empty()) {
+        closed_ = true;
+        conn->shutdown();
+    }
+}
+
+/**
+ * @brief 向流式响应体要一段数据
+ * @return false 数据比声明的Content-Length短
+ */
+bool Http2Connection::produce(const TcpConnectionPtr &conn, Stream *stream) {
+    if (!stream->body_stream) {
+        return true;
+    }
+    Buffer piece;
+    bool more = stream->body_stream(&piece);
+    size_t len = piece.readable_bytes();
+    if (stream->stream_remaining >= 0) {
+        if (static_cast<int64_t>(len) > stream->stream_remaining) {
+            LOG_ERROR << "Http2Connection [" << conn->name() << "] body stream exceeds Content-Length by "
+                      << static_cast<int64_t>(len) - stream->stream_remaining;
+            len = static_cast<size_t>(stream->stream_remaining);
+            more = false;
+        }
+        stream->stream_remaining -= static_cast<int64_t>(len);
+    }
+    if (len > 0) {
+        stream->segments.push_back(Segment{std::string(piece.peek(), len), -1, 0, len});
+    }
+    if (!more) {
+        stream->body_stream = HttpResponse::BodyStream();
+        if (stream->stream_signal) {
+            stream->stream_signal->cancel();
+            stream->stream_signal.reset();
+        }
+        stream->body_done = true;
+        if (stream->stream_remaining > 0) {
+            LOG_ERROR << "Http2Connection [" << conn->name() << "] body stream ended "
+                      << stream->stream_remaining << " bytes short of Content-Length";
+            return false;
+        }
+    } else if (len == 0 && (stream->stream_signal || !retry_pending_)) {
+        // 生产者暂时没有数据，由生产者唤醒；没有唤醒函数的流共用一次定时重试
+        std::weak_ptr<Http2Connection> weak_self(shared_from_this());
+        std::weak_ptr<net::TcpConnection> weak_conn(conn);
+        bool retry = !stream->stream_signal;
+        retry_pending_ = retry_pending_ || retry;
+        StreamSignal::schedule(conn->get_loop(), stream->stream_signal, [weak_self, weak_conn, retry]() {
+            std::shared_ptr<Http2Connection> self = weak_self.lock();
+            TcpConnectionPtr guard = weak_conn.lock();
+            if (!self || !guard) {
+                return;
+            }
+            if (retry) {
+                self->retry_pending_ = false;
+            }
+            if (!guard->disconnected()) {
+                self->flush(guard);
+            }
+        });
+    }
+    return true;
+}
+
+/**
+ * @brief 发送当前段的前len字节
+ * @return true 这是响应体的最后一帧，已带上END_STREAM
+ */
+bool Http2Connection::write_data(const TcpConnectionPtr &conn, uint32_t stream_id, Stream *stream, size_t len) {
+    Segment &segment = stream->segments.front();
+    bool last = len == segment.length && stream->segments.size() == 1 && stream->body_done;
+    append_frame_header(&output_, static_cast<uint32_t>(len), k_data, last ? k_flag_end_stream : 0, stream_id);
+    if (segment.fd >= 0) {
+        // 帧头先写出，负载由sendfile发送，TcpConnection保证两者的顺序
+        send_output(conn);
+        conn->send_file(segment.fd, segment.offset, len, stream->file_holder);
+    } else {
+        output_.append(segment.data.data() + segment.offset, len);
+    }
+    segment.offset += static_cast<off_t>(len);
+    segment.length -= len;
+    stream->send_window -= static_cast<int64_t>(len);
+    send_window_ -= static_cast<int64_t>(len);
+    if (segment.length == 0) {
+        stream->segments.pop_front();
+    }
+    return last;
+}
+
+/**
+ * @brief 响应已经结束，请求还在发送请求体时以NO_ERROR重置，通知对端不必再发
+ */
+void Http2Connection::finish_stream(StreamMap::iterator it) {
+    if (!it->second.request_done) {
+        append_rst_stream(&output_, it->first, k_no_error);
+    }
+    erase_stream(it);
+}
+
+void Http2Connection::erase_stream(StreamMap::iterator it) {
+    if (it->second.stream_signal) {
+        it->second.stream_signal->cancel();
+    }
+    streams_.erase(it);
+}
+
+void Http2Connection::send_output(const TcpConnectionPtr &conn) {
+    if (output_.readable_bytes() > 0) {
+        conn->send(output_.peek(), output_.readable_bytes());
+        output_.retrieve_all();
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
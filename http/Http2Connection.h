@@ -0,0 +1,207 @@
+/**
+ * @brief 一个HTTP/2连接上的协议状态
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTP2CONNECTION_H
+#define WEB_SERVER_HTTP_HTTP2CONNECTION_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "base/Timestamp.h"
+#include "http/Hpack.h"
+#include "http/Http2Frame.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "net/Buffer.h"
+#include "net/Callbacks.h"
+
+namespace web_server {
+
+namespace http {
+
+/**
+ * @brief 明文HTTP/2（h2c）的服务端连接
+ * 负责帧的收发、HPACK、流的状态和两级流量控制。请求头部块接收完整（请求体结束）后
+ * 通过RequestCallback交给HttpServer，同一连接上的多个流可以同时在处理中，
+ * 响应由send_response按流发回，各个流的DATA帧按轮转方式共享连接窗口。
+ * 输出不会无限积压：每次最多写出k_flush_batch_size字节的DATA，等连接写完后再继续。
+ * 对象保存在HttpSession中，方法都以连接为参数，避免与TcpConnection互相持有；
+ * 所有方法都在连接所属的IO线程中调用
+ */
+class Http2Connection : private Noncopyable,
+                        public std::enable_shared_from_this<Http2Connection> {
+public:
+    /**
+     * @brief 收到一个完整的请求
+     * @param conn
+     * @param stream_id 发送响应时使用
+     * @param req
+     */
+    using RequestCallback = std::function<void(const net::TcpConnectionPtr &, uint32_t, const HttpRequest &)>;
+
+    explicit Http2Connection(const RequestCallback &cb);
+    ~Http2Connection();
+
+    /**
+     * @brief 通过prior knowledge建立连接，发送服务端的SETTINGS，随后等待客户端前言
+     */
+    void start(const net::TcpConnectionPtr &conn);
+
+    /**
+     * @brief 通过HTTP/1.1 Upgrade建立连接，HTTP2-Settings有效时发出101响应和服务端的SETTINGS
+     * 升级请求成为流1，处于半关闭（远端）状态，交给回调处理，其响应通过HTTP/2发送
+     * @param settings HTTP2-Settings首部中base64url编码的SETTINGS负载
+     * @return false HTTP2-Settings无效，什么都没有发送，调用者应当按HTTP/1.1继续处理
+     */
+    bool start_upgrade(const net::TcpConnectionPtr &conn, const std::string &settings, const HttpRequest &req);
+
+    /**
+     * @brief 处理收到的数据
+     * @return false 发生连接错误，已经发送GOAWAY并关闭连接
+     */
+    bool on_data(const net::TcpConnectionPtr &conn, net::Buffer *buf, Timestamp receive_time);
+
+    /**
+     * @brief 发送stream_id上的响应，流已经被重置时丢弃
+     * 连接相关的首部（Connection、Transfer-Encoding等）不会发送，close_connection被忽略
+     */
+    void send_response(const net::TcpConnectionPtr &conn, uint32_t stream_id, const HttpResponse &response);
+
+    /**
+     * @brief 连接的输出缓冲写完，继续发送DATA
+     */
+    void on_write_complete(const net::TcpConnectionPtr &conn);
+
+    /**
+     * @brief 同时处理中的流
+     */
+    size_t stream_count() const {
+        return streams_.size();
+    }
+
+    /**
+     * @brief 同一时刻一个连接上最多处理的流，超过的新流被REFUSED_STREAM拒绝，
+     * 相当于HTTP/1.1中对流水线请求的背压
+     */
+    static const uint32_t k_max_concurrent_streams = 128;
+    /**
+     * @brief 每次写完成之后最多写出的DATA字节数
+     */
+    static const size_t k_flush_batch_size = 64 * 1024;
+    /**
+     * @brief 跨CONTINUATION累积的头部块上限
+     */
+    static const size_t k_max_header_block_size = 256 * 1024;
+
+private:
+    /**
+     * @brief 响应体的一段，内存中的数据或文件中的一个区间
+     */
+    struct Segment {
+        std::string data;
+        int fd;
+        off_t offset;
+        size_t length;
+    };
+
+    struct Stream {
+        explicit Stream(int64_t window)
+            : send_window(window),
+              headers_received(false),
+              request_done(false),
+              response_started(false),
+              body_done(false),
+              stream_remaining(-1) {}
+
+        int64_t send_window;
+        bool headers_received;
+        bool request_done;                  // 收到了对端的END_STREAM，请求已经交给回调
+        bool response_started;              // 响应头已经发出
+        bool body_done;                     // 响应体已经全部进入segments
+        HttpRequest request;
+        std::deque<Segment> segments;       // 待发送的响应体
+        std::shared_ptr<void> file_holder;
+        HttpResponse::BodyStream body_stream;
+        std::shared_ptr<StreamSignal> stream_signal;
+        int64_t stream_remaining;           // 长度已知的流式响应体还剩多少字节
+    };
+
+    using StreamMap = std::map<uint32_t, Stream>;
+
+    bool handle_frame(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header, boost::string_ref payload);
+    bool handle_data(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header, boost::string_ref payload);
+    bool handle_headers(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header,
+                        boost::string_ref payload);
+    bool handle_continuation(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header,
+                             boost::string_ref payload);
+    bool handle_settings(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header,
+                         boost::string_ref payload);
+    bool handle_window_update(const net::TcpConnectionPtr &conn, const http2::FrameHeader &header,
+                              boost::string_ref payload);
+    http2::ErrorCode apply_settings(const std::vector<http2::Setting> &settings);
+    bool end_header_block(const net::TcpConnectionPtr &conn);
+    void dispatch(const net::TcpConnectionPtr &conn, uint32_t stream_id);
+
+    /**
+     * @brief 流级别的错误，只重置这一个流
+     */
+    void reset_stream(uint32_t stream_id, http2::ErrorCode error);
+    /**
+     * @brief 连接级别的错误，发送GOAWAY后关闭连接
+     */
+    bool connection_error(const net::TcpConnectionPtr &conn, http2::ErrorCode error, const char *reason);
+
+    void flush(const net::TcpConnectionPtr &conn);
+    bool produce(const net::TcpConnectionPtr &conn, Stream *stream);
+    bool write_data(const net::TcpConnectionPtr &conn, uint32_t stream_id, Stream *stream, size_t len);
+    void finish_stream(StreamMap::iterator it);
+    /**
+     * @brief 移除一个流，等待中的流式响应体不再唤醒这个连接
+     */
+    void erase_stream(StreamMap::iterator it);
+    void send_output(const net::TcpConnectionPtr &conn);
+
+    RequestCallback request_callback_;
+    bool preface_received_;
+    bool settings_received_;
+    bool closed_;
+    bool goaway_received_;
+    hpack::Decoder decoder_;
+    hpack::Encoder encoder_;
+    StreamMap streams_;
+    uint32_t last_stream_id_;
+    // 正在接收的头部块
+    uint32_t header_stream_id_;
+    bool header_end_stream_;
+    http2::ErrorCode header_error_;                     // 头部块解码之后要以该错误重置流
+    std::string header_block_;
+    // 对端的设置
+    int64_t peer_initial_window_;
+    uint32_t peer_max_frame_size_;
+    // 流量控制
+    int64_t send_window_;
+    int64_t recv_window_;
+    uint32_t recv_consumed_;
+    // 输出
+    net::Buffer output_;
+    bool awaiting_write_;                               // 本批DATA已经写满，等待写完成
+    bool retry_pending_;                                // 没有唤醒函数的流式响应体暂时没有数据，已安排重试
+    Timestamp receive_time_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTP2CONNECTION_H
@@ -0,0 +1,127 @@
+/**
+ * @brief HTTP/2帧的编解码（RFC 7540第4、6节）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Http2Frame.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace http2 {
+
+void parse_frame_header(const char *data, FrameHeader *header) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    header->length = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    header->type = p[3];
+    header->flags = p[4];
+    header->stream_id = read_uint32(data + 5) & 0x7fffffff;
+}
+
+void append_frame_header(net::Buffer *output, uint32_t length, uint8_t type, uint8_t flags, uint32_t stream_id) {
+    assert(length <= k_max_max_frame_size);
+    char buf[k_frame_header_length] = {
+        static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length),
+        static_cast<char>(type), static_cast<char>(flags),
+        static_cast<char>(stream_id >> 24), static_cast<char>(stream_id >> 16),
+        static_cast<char>(stream_id >> 8), static_cast<char>(stream_id)};
+    output->append(buf, sizeof buf);
+}
+
+void append_settings(net::Buffer *output, const std::vector<Setting> &settings) {
+    append_frame_header(output, static_cast<uint32_t>(settings.size() * 6), k_settings, 0, 0);
+    for (const Setting &setting : settings) {
+        output->append_int16(static_cast<int16_t>(setting.id));
+        output->append_int32(static_cast<int32_t>(setting.value));
+    }
+}
+
+void append_settings_ack(net::Buffer *output) {
+    append_frame_header(output, 0, k_settings, k_flag_ack, 0);
+}
+
+void append_ping_ack(net::Buffer *output, boost::string_ref opaque) {
+    assert(opaque.size() == 8);
+    append_frame_header(output, 8, k_ping, k_flag_ack, 0);
+    output->append(opaque.data(), opaque.size());
+}
+
+void append_window_update(net::Buffer *output, uint32_t stream_id, uint32_t increment) {
+    append_frame_header(output, 4, k_window_update, 0, stream_id);
+    output->append_int32(static_cast<int32_t>(increment));
+}
+
+void append_rst_stream(net::Buffer *output, uint32_t stream_id, ErrorCode error) {
+    append_frame_header(output, 4, k_rst_stream, 0, stream_id);
+    output->append_int32(static_cast<int32_t>(error));
+}
+
+void append_goaway(net::Buffer *output, uint32_t last_stream_id, ErrorCode error) {
+    append_frame_header(output, 8, k_goaway, 0, 0);
+    output->append_int32(static_cast<int32_t>(last_stream_id));
+    output->append_int32(static_cast<int32_t>(error));
+}
+
+void append_header_block(net::Buffer *output,
+                         uint32_t stream_id,
+                         boost::string_ref block,
+                         bool end_stream,
+                         uint32_t max_frame_size) {
+    uint8_t type = k_headers;
+    uint8_t flags = end_stream ? k_flag_end_stream : 0;
+    do {
+        size_t len = std::min<size_t>(block.size(), max_frame_size);
+        if (len == block.size()) {
+            flags |= k_flag_end_headers;
+        }
+        append_frame_header(output, static_cast<uint32_t>(len), type, flags, stream_id);
+        output->append(block.data(), len);
+        block.remove_prefix(len);
+        type = k_continuation;
+        flags = 0;
+    } while (!block.empty());
+}
+
+bool parse_settings(boost::string_ref payload, std::vector<Setting> *settings) {
+    if (payload.size() % 6 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < payload.size(); i += 6) {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(payload.data() + i);
+        Setting setting = {static_cast<uint16_t>((p[0] << 8) | p[1]), read_uint32(payload.data() + i + 2)};
+        settings->push_back(setting);
+    }
+    return true;
+}
+
+bool strip_padding(uint8_t flags, size_t skip, boost::string_ref *payload) {
+    size_t pad = 0;
+    if (flags & k_flag_padded) {
+        if (payload->empty()) {
+            return false;
+        }
+        pad = static_cast<unsigned char>((*payload)[0]);
+        payload->remove_prefix(1);
+    }
+    if (payload->size() < skip + pad) {
+        return false;
+    }
+    payload->remove_prefix(skip);
+    payload->remove_suffix(pad);
+    return true;
+}
+
+} // namespace http2
+
+} // namespace http
+
+} // namespace web_server
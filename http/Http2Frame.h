@@ -0,0 +1,152 @@
+/**
+ * @brief HTTP/2帧的编解码（RFC 7540第4、6节）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTP2FRAME_H
+#define WEB_SERVER_HTTP_HTTP2FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace web_server {
+
+namespace net {
+class Buffer;
+} // namespace net
+
+namespace http {
+
+namespace http2 {
+
+/**
+ * @brief 客户端连接前言，prior knowledge和Upgrade两种方式都以它开始
+ */
+const char k_client_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t k_client_preface_length = sizeof k_client_preface - 1;
+
+const size_t k_frame_header_length = 9;
+const uint32_t k_default_window_size = 65535;
+const uint32_t k_max_window_size = 0x7fffffff;
+const uint32_t k_default_max_frame_size = 16384;
+const uint32_t k_max_max_frame_size = 16777215;
+
+enum FrameType : uint8_t {
+    k_data = 0x0,
+    k_headers = 0x1,
+    k_priority = 0x2,
+    k_rst_stream = 0x3,
+    k_settings = 0x4,
+    k_push_promise = 0x5,
+    k_ping = 0x6,
+    k_goaway = 0x7,
+    k_window_update = 0x8,
+    k_continuation = 0x9
+};
+
+enum FrameFlag : uint8_t {
+    k_flag_end_stream = 0x1,
+    k_flag_ack = 0x1,
+    k_flag_end_headers = 0x4,
+    k_flag_padded = 0x8,
+    k_flag_priority = 0x20
+};
+
+enum SettingsId : uint16_t {
+    k_settings_header_table_size = 0x1,
+    k_settings_enable_push = 0x2,
+    k_settings_max_concurrent_streams = 0x3,
+    k_settings_initial_window_size = 0x4,
+    k_settings_max_frame_size = 0x5,
+    k_settings_max_header_list_size = 0x6
+};
+
+enum ErrorCode : uint32_t {
+    k_no_error = 0x0,
+    k_protocol_error = 0x1,
+    k_internal_error = 0x2,
+    k_flow_control_error = 0x3,
+    k_settings_timeout = 0x4,
+    k_stream_closed = 0x5,
+    k_frame_size_error = 0x6,
+    k_refused_stream = 0x7,
+    k_cancel = 0x8,
+    k_compression_error = 0x9,
+    k_connect_error = 0xa,
+    k_enhance_your_calm = 0xb,
+    k_inadequate_security = 0xc,
+    k_http_1_1_required = 0xd
+};
+
+struct FrameHeader {
+    uint32_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream_id;
+};
+
+struct Setting {
+    uint16_t id;
+    uint32_t value;
+};
+
+inline uint32_t read_uint32(const char *data) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+/**
+ * @brief 解析data开头的9字节帧头，流标识的保留位被清掉
+ */
+void parse_frame_header(const char *data, FrameHeader *header);
+
+void append_frame_header(net::Buffer *output, uint32_t length, uint8_t type, uint8_t flags, uint32_t stream_id);
+
+void append_settings(net::Buffer *output, const std::vector<Setting> &settings);
+
+void append_settings_ack(net::Buffer *output);
+
+void append_ping_ack(net::Buffer *output, boost::string_ref opaque);
+
+void append_window_update(net::Buffer *output, uint32_t stream_id, uint32_t increment);
+
+void append_rst_stream(net::Buffer *output, uint32_t stream_id, ErrorCode error);
+
+void append_goaway(net::Buffer *output, uint32_t last_stream_id, ErrorCode error);
+
+/**
+ * @brief 把头部块切成一个HEADERS帧和若干CONTINUATION帧
+ */
+void append_header_block(net::Buffer *output,
+                         uint32_t stream_id,
+                         boost::string_ref block,
+                         bool end_stream,
+                         uint32_t max_frame_size);
+
+/**
+ * @brief 解析SETTINGS帧的负载
+ * @return false 长度不是6的倍数
+ */
+bool parse_settings(boost::string_ref payload, std::vector<Setting> *settings);
+
+/**
+ * @brief 去掉PADDED标志带来的填充长度字节和填充
+ * @param skip PADDED之后还要跳过的字节数，如HEADERS的优先级字段
+ * @return false 填充长度超过了负载，属于PROTOCOL_ERROR
+ */
+bool strip_padding(uint8_t flags, size_t skip, boost::string_ref *payload);
+
+} // namespace http2
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTP2FRAME_H
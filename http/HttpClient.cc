@@ -0,0 +1,336 @@
+/**
+ * @brief 异步http客户端：keep-alive复用连接，可选流水线，每个请求单独超时
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/HttpClient.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "base/Logging.h"
+#include "net/EventLoop.h"
+#include "net/TcpConnection.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+/**
+ * @brief 幂等的方法可以安全地重发，也可以放进流水线（RFC 7231第4.2.2节）
+ */
+bool is_idempotent(const std::string &method) {
+    static const char *const k_idempotent[] = {"GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE"};
+    for (const char *name : k_idempotent) {
+        if (method == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::string HttpClientResponse::get_header(const char *field) const {
+    const std::string *value = find_header(headers, field);
+    return value ? *value : std::string();
+}
+
+HttpClient::HttpClient(net::EventLoop *loop,
+                       const net::InetAddress &server_addr,
+                       const std::string &name,
+                       const HttpClientOptions &options)
+    : loop_(loop),
+      server_addr_(server_addr),
+      name_(name),
+      options_(options),
+      next_conn_ID_(1) {
+    assert(options_.max_pipeline > 0);
+}
+
+HttpClient::~HttpClient() {
+    loop_->assert_in_loop_thread();
+    loop_->cancel(connect_timer_);
+    for (const CallPtr &call : queued_) {
+        loop_->cancel(call->timer);
+    }
+    for (const CallPtr &call : inflight_) {
+        loop_->cancel(call->timer);
+    }
+    net::release_tcp_client(&client_);
+}
+
+void HttpClient::request(const HttpClientRequest &req, const ResponseCallback &cb) {
+    CallPtr call = std::make_shared<Call>();
+    call->head = req.method == "HEAD";
+    call->idempotent = is_idempotent(req.method);
+    call->timeout = req.timeout != 0 ? req.timeout : options_.request_timeout;
+    call->cb = cb;
+
+    bool has_host = false;
+    std::string &wire = call->wire;
+    wire.reserve(req.method.size() + req.path.size() + req.body.size() + 128);
+    wire.append(req.method);
+    wire.append(" ");
+    wire.append(req.path);
+    wire.append(" HTTP/1.1\r\n");
+    for (const auto &header : req.headers) {
+        if (strcasecmp(header.first.c_str(), "Content-Length") == 0) {
+            continue;
+        }
+        has_host = has_host || strcasecmp(header.first.c_str(), "Host") == 0;
+        wire.append(header.first);
+        wire.append(": ");
+        wire.append(header.second);
+        wire.append("\r\n");
+    }
+    if (!has_host) {
+        wire.append("Host: " + server_addr_.to_IP_port() + "\r\n");
+    }
+    // 没有请求体的POST/PUT也要带长度，否则服务端无法确定请求的边界
+    if (!req.body.empty() || req.method == "POST" || req.method == "PUT") {
+        char buf[48];
+        snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", req.body.size());
+        wire.append(buf);
+    }
+    wire.append("\r\n");
+    wire.append(req.body);
+
+    loop_->run_in_loop(std::bind(&HttpClient::request_in_loop, this, call));
+}
+
+void HttpClient::get(const std::string &path, const ResponseCallback &cb) {
+    HttpClientRequest req;
+    req.path = path;
+    request(req, cb);
+}
+
+void HttpClient::request_in_loop(const CallPtr &call) {
+    loop_->assert_in_loop_thread();
+    if (call->timeout > 0) {
+        std::weak_ptr<Call> weak(call);
+        call->timer = loop_->run_after(call->timeout, std::bind(&HttpClient::on_timeout, this, weak));
+    }
+    queued_.push_back(call);
+    dispatch();
+}
+
+/**
+ * @brief 把排队的请求发到连接上，在途请求数不超过max_pipeline，没有连接时先建立连接
+ */
+void HttpClient::dispatch() {
+    if (queued_.empty()) {
+        return;
+    }
+    if (!conn_) {
+        if (!client_) {
+            connect();
+        }
+        return;
+    }
+    while (!queued_.empty() && inflight_.size() < options_.max_pipeline) {
+        // 非幂等的请求失败后无法重试，不和其他请求挤在同一个流水线里
+        if (!inflight_.empty() && (!queued_.front()->idempotent || !inflight_.back()->idempotent)) {
+            break;
+        }
+        CallPtr call = queued_.front();
+        queued_.pop_front();
+        inflight_.push_back(call);
+        conn_->send(call->wire);
+    }
+}
+
+void HttpClient::connect() {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%d", next_conn_ID_++);
+    client_ = std::make_shared<net::TcpClient>(loop_, server_addr_, name_ + buf);
+    client_->set_connection_callback(std::bind(&HttpClient::on_connection, this, _1));
+    client_->set_message_callback(std::bind(&HttpClient::on_message, this, _1, _2));
+    client_->set_connect_error_callback([this](int) {
+        on_connect_failed();
+    });
+    connect_timer_ = loop_->run_after(options_.connect_timeout, [this]() {
+        LOG_WARN << "HttpClient[" << name_ << "] connect to " << server_addr_.to_IP_port() << " timed out";
+        on_connect_failed();
+    });
+    client_->connect();
+}
+
+/**
+ * @brief 放弃当前连接，在途请求中没有收到响应数据的幂等请求排回队首重试一次，其余失败
+ */
+void HttpClient::drop_connection() {
+    loop_->cancel(connect_timer_);
+    conn_.reset();
+    net::release_tcp_client(&client_);
+    parser_.reset();
+
+    std::deque<CallPtr> inflight;
+    inflight.swap(inflight_);
+    std::vector<CallPtr> failed;
+    for (auto it = inflight.rbegin(); it != inflight.rend(); ++it) {
+        const CallPtr &call = *it;
+        if (call->idempotent && !call->received && !call->retried) {
+            call->retried = true;
+            queued_.push_front(call);
+        } else {
+            failed.push_back(call);
+        }
+    }
+    // 先排好重试的请求再回调，回调中提交的新请求排在它们之后
+    for (auto it = failed.rbegin(); it != failed.rend(); ++it) {
+        finish(*it, HttpClientResponse::k_connection_closed);
+    }
+}
+
+void HttpClient::finish(const CallPtr &call, HttpClientResponse::Error error) {
+    loop_->cancel(call->timer);
+    call->response.error = error;
+    ResponseCallback cb;
+    cb.swap(call->cb);
+    if (cb) {
+        cb(call->response);
+    }
+}
+
+/**
+ * @brief 响应无法解析，连接上之后的数据也无法对齐，放弃连接
+ */
+void HttpClient::fail_response(const CallPtr &call) {
+    LOG_WARN << "HttpClient[" << name_ << "] bad response from " << server_addr_.to_IP_port();
+    inflight_.pop_front();
+    drop_connection();
+    finish(call, HttpClientResponse::k_bad_response);
+    dispatch();
+}
+
+void HttpClient::on_connection(const net::TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+        loop_->cancel(connect_timer_);
+        conn_ = conn;
+        conn->set_tcp_no_delay(true);
+        parser_.reset();
+        dispatch();
+        return;
+    }
+    // 服务端关闭了连接，读到关闭为止的响应到这里才完整
+    CallPtr done;
+    if (!inflight_.empty() && parser_.head_done() && body_.mode() == HttpBodyReader::k_until_close) {
+        done = inflight_.front();
+        inflight_.pop_front();
+    }
+    drop_connection();
+    if (done) {
+        finish(done, HttpClientResponse::k_ok);
+    }
+    dispatch();
+}
+
+void HttpClient::on_message(const net::TcpConnectionPtr &conn, net::Buffer *buf) {
+    while (conn_ == conn) {
+        if (inflight_.empty()) {
+            if (buf->readable_bytes() > 0) {
+                LOG_WARN << "HttpClient[" << name_ << "] unexpected " << buf->readable_bytes()
+                         << " bytes from " << server_addr_.to_IP_port();
+                buf->retrieve_all();
+                drop_connection();
+                dispatch();
+            }
+            return;
+        }
+        CallPtr call = inflight_.front();
+        if (!parser_.head_done()) {
+            if (buf->readable_bytes() == 0) {
+                return;
+            }
+            call->received = true;
+            if (!parser_.parse_head(buf)) {
+                fail_response(call);
+                return;
+            }
+            if (!parser_.head_done()) {
+                return;
+            }
+            // 1xx是中间响应，之后还有最终响应
+            if (parser_.status_code() < 200) {
+                parser_.reset();
+                continue;
+            }
+            if (!parser_.init_body(call->head, &body_)) {
+                fail_response(call);
+                return;
+            }
+            call->response.status_code = parser_.status_code();
+            call->response.status_message = parser_.status_message();
+            call->response.headers = parser_.headers();
+        }
+        size_t n = body_.feed(buf->peek(), buf->readable_bytes(), &call->response.body);
+        buf->retrieve(n);
+        if (body_.error() || call->response.body.size() > options_.max_body_size) {
+            fail_response(call);
+            return;
+        }
+        if (!body_.done()) {
+            return;
+        }
+        bool keep_alive = parser_.keep_alive();
+        parser_.reset();
+        inflight_.pop_front();
+        if (!keep_alive) {
+            // 服务端不会再处理这个连接上之后的请求，它们在新连接上重发
+            buf->retrieve_all();
+            drop_connection();
+        }
+        finish(call, HttpClientResponse::k_ok);
+        dispatch();
+    }
+}
+
+/**
+ * @brief 连接失败时服务端多半不可用，排队的请求都立即失败，而不是反复重连
+ */
+void HttpClient::on_connect_failed() {
+    LOG_WARN << "HttpClient[" << name_ << "] failed to connect to " << server_addr_.to_IP_port();
+    loop_->cancel(connect_timer_);
+    net::release_tcp_client(&client_);
+    std::deque<CallPtr> queued;
+    queued.swap(queued_);
+    for (const CallPtr &call : queued) {
+        finish(call, HttpClientResponse::k_connect_failed);
+    }
+}
+
+/**
+ * @brief 在途请求超时后连接上的响应无法再对齐，放弃连接，之后的请求按断开处理
+ */
+void HttpClient::on_timeout(const std::weak_ptr<Call> &weak) {
+    CallPtr call = weak.lock();
+    if (!call) {
+        return;
+    }
+    auto it = std::find(queued_.begin(), queued_.end(), call);
+    if (it != queued_.end()) {
+        queued_.erase(it);
+    } else {
+        it = std::find(inflight_.begin(), inflight_.end(), call);
+        if (it == inflight_.end()) {
+            return;
+        }
+        inflight_.erase(it);
+        drop_connection();
+    }
+    finish(call, HttpClientResponse::k_timeout);
+    dispatch();
+}
+
+} // namespace http
+
+} // namespace web_server
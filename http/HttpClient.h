@@ -0,0 +1,157 @@
+/**
+ * @brief 异步http客户端：keep-alive复用连接，可选流水线，每个请求单独超时
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTPCLIENT_H
+#define WEB_SERVER_HTTP_HTTPCLIENT_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/Copyable.h"
+#include "base/Noncopyable.h"
+#include "http/HttpResponseParser.h"
+#include "net/InetAddress.h"
+#include "net/TcpClient.h"
+#include "net/TimerID.h"
+
+namespace web_server {
+
+namespace http {
+
+struct HttpClientOptions {
+    size_t max_pipeline = 1;                    // 连接上同时在途的请求数，1表示收到响应之后才发下一个请求
+    double connect_timeout = 3.0;               // 秒
+    double request_timeout = 30.0;              // 从提交请求到收到完整响应，秒，不大于0时不限
+    size_t max_body_size = 64 * 1024 * 1024;    // 响应体上限，超过时按响应无效处理
+};
+
+struct HttpClientRequest : public Copyable {
+    using Header = std::pair<std::string, std::string>;
+
+    std::string method = "GET";
+    std::string path = "/";
+    std::vector<Header> headers;    // 没有Host时使用服务端地址，Content-Length由body决定
+    std::string body;
+    double timeout = 0;             // 秒，为0时使用HttpClientOptions::request_timeout，小于0时不限
+};
+
+struct HttpClientResponse : public Copyable {
+    enum Error {
+        k_ok,
+        k_connect_failed,           // 连接失败或连接超时
+        k_timeout,                  // 请求超时
+        k_connection_closed,        // 收到完整响应之前连接断开
+        k_bad_response              // 响应格式错误或响应体过大
+    };
+
+    Error error = k_ok;
+    int status_code = 0;
+    std::string status_message;
+    std::vector<HttpResponseParser::Header> headers;
+    std::string body;
+
+    /**
+     * @brief 查找首部，不区分大小写，多个同名首部时返回第一个
+     */
+    std::string get_header(const char *field) const;
+};
+
+/**
+ * @brief 到一个服务端的http/1.1客户端，持有一个连接，所有状态只在所属loop线程中访问
+ * 请求按提交顺序发送，响应按顺序对应；连接断开后在下一个请求到来时重新建立。
+ * max_pipeline大于1时不等响应就继续发送，非幂等的请求（例如POST）前后都不流水线；
+ * 连接断开时还没有收到任何响应数据的幂等请求在新连接上重试一次
+ */
+class HttpClient : private Noncopyable {
+public:
+    using ResponseCallback = std::function<void(const HttpClientResponse &)>;
+
+    HttpClient(net::EventLoop *loop,
+               const net::InetAddress &server_addr,
+               const std::string &name,
+               const HttpClientOptions &options = HttpClientOptions());
+    /**
+     * @brief 在loop线程中析构，未完成的请求不再回调；不能在响应回调中析构
+     */
+    ~HttpClient();
+
+    /**
+     * @brief 提交一个请求，可以在任意线程中调用，cb在loop线程中执行，析构之前每个请求恰好回调一次
+     */
+    void request(const HttpClientRequest &req, const ResponseCallback &cb);
+
+    void get(const std::string &path, const ResponseCallback &cb);
+
+    /**
+     * @brief 还没有完成的请求数，包括排队和在途的，在loop线程中调用
+     */
+    size_t pending() const {
+        return queued_.size() + inflight_.size();
+    }
+
+    bool connected() const {
+        return conn_ && conn_->connected();
+    }
+
+    net::EventLoop *get_loop() const {
+        return loop_;
+    }
+
+    const std::string &name() const {
+        return name_;
+    }
+
+private:
+    struct Call {
+        std::string wire;               // 序列化之后的请求
+        bool head = false;
+        bool idempotent = false;
+        bool received = false;          // 已经收到属于该请求的响应数据
+        bool retried = false;
+        double timeout = 0;
+        net::TimerID timer;
+        ResponseCallback cb;
+        HttpClientResponse response;
+    };
+    using CallPtr = std::shared_ptr<Call>;
+
+    void request_in_loop(const CallPtr &call);
+    void dispatch();
+    void connect();
+    void drop_connection();
+    void finish(const CallPtr &call, HttpClientResponse::Error error);
+    void fail_response(const CallPtr &call);
+    void on_connection(const net::TcpConnectionPtr &conn);
+    void on_message(const net::TcpConnectionPtr &conn, net::Buffer *buf);
+    void on_connect_failed();
+    void on_timeout(const std::weak_ptr<Call> &weak);
+
+    net::EventLoop *loop_;
+    const net::InetAddress server_addr_;
+    const std::string name_;
+    const HttpClientOptions options_;
+    int next_conn_ID_;
+    std::shared_ptr<net::TcpClient> client_;    // 建立连接期间和连接存在期间非空
+    net::TcpConnectionPtr conn_;
+    net::TimerID connect_timer_;
+    HttpResponseParser parser_;                 // 解析inflight_中第一个请求的响应
+    HttpBodyReader body_;
+    std::deque<CallPtr> queued_;                // 还没有发送
+    std::deque<CallPtr> inflight_;              // 已经发送，等待响应
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTPCLIENT_H
@@ -0,0 +1,301 @@
+/**
+ * @brief 条件请求与Range请求
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/HttpConditional.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "http/HttpRequest.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+// 超过18位的数字可能溢出int64_t，这样的区间按语法错误处理
+const size_t k_max_digits = 18;
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+boost::string_ref trim(boost::string_ref s) {
+    while (!s.empty() && is_space(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && is_space(s.back())) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+bool parse_number(boost::string_ref s, int64_t *result) {
+    if (s.empty() || s.size() > k_max_digits) {
+        return false;
+    }
+    int64_t value = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    *result = value;
+    return true;
+}
+
+/**
+ * @brief 解析一个byte-range-spec
+ * @return int 1为可满足，0为语法正确但不可满足，-1为语法错误
+ */
+int parse_range_spec(boost::string_ref spec, int64_t size, ByteRange *range) {
+    size_t dash = spec.find('-');
+    if (dash == boost::string_ref::npos) {
+        return -1;
+    }
+    boost::string_ref first_str = spec.substr(0, dash);
+    boost::string_ref last_str = spec.substr(dash + 1);
+    if (first_str.empty()) {
+        // 后缀区间：最后suffix个字节
+        int64_t suffix = 0;
+        if (!parse_number(last_str, &suffix)) {
+            return -1;
+        }
+        if (suffix == 0 || size == 0) {
+            return 0;
+        }
+        range->offset = size > suffix ? size - suffix : 0;
+        range->length = size - range->offset;
+        return 1;
+    }
+    int64_t first = 0;
+    if (!parse_number(first_str, &first)) {
+        return -1;
+    }
+    int64_t last = size - 1;
+    if (!last_str.empty()) {
+        if (!parse_number(last_str, &last) || last < first) {
+            return -1;
+        }
+    }
+    if (first >= size) {
+        return 0;
+    }
+    last = std::min(last, size - 1);
+    range->offset = first;
+    range->length = last - first + 1;
+    return 1;
+}
+
+/**
+ * @brief 有区间重叠或相邻时按起点排序并合并，防止用大量重叠区间放大响应
+ */
+void coalesce_ranges(std::vector<ByteRange> *ranges) {
+    std::vector<ByteRange> sorted(*ranges);
+    std::sort(sorted.begin(), sorted.end(), [](const ByteRange &lhs, const ByteRange &rhs) {
+        return lhs.offset < rhs.offset;
+    });
+    bool overlapped = false;
+    std::vector<ByteRange> merged;
+    for (const ByteRange &range : sorted) {
+        if (!merged.empty() && range.offset <= merged.back().offset + merged.back().length) {
+            ByteRange &back = merged.back();
+            back.length = std::max(back.offset + back.length, range.offset + range.length) - back.offset;
+            overlapped = true;
+        } else {
+            merged.push_back(range);
+        }
+    }
+    if (overlapped) {
+        ranges->swap(merged);
+    }
+}
+
+/**
+ * @brief If-Range仍然有效时才处理Range：实体标签做强比较，日期必须与Last-Modified完全一致
+ */
+bool if_range_matches(boost::string_ref value, const HttpResponse &resp) {
+    value = trim(value);
+    if (value.starts_with("W/")) {
+        return false;
+    }
+    if (value.starts_with("\"")) {
+        std::string etag = resp.get_header("ETag");
+        return !etag.empty() && value == etag;
+    }
+    std::string last_modified = resp.get_header("Last-Modified");
+    return !last_modified.empty() && value == last_modified;
+}
+
+bool modified_since(const std::string &last_modified, const std::string &since) {
+    if (last_modified.empty()) {
+        return true;
+    }
+    // 浏览器一般原样回送Last-Modified，相等时不必解析日期
+    if (last_modified == since) {
+        return false;
+    }
+    time_t last_modified_time = 0;
+    time_t since_time = 0;
+    if (!parse_http_date(last_modified, &last_modified_time) || !parse_http_date(since, &since_time)) {
+        return true;
+    }
+    return last_modified_time > since_time;
+}
+
+} // namespace
+
+RangeResult parse_range(boost::string_ref value, int64_t size, std::vector<ByteRange> *ranges) {
+    ranges->clear();
+    value = trim(value);
+    if (value.size() < 6 || ::strncasecmp(value.data(), "bytes=", 6) != 0) {
+        return k_range_ignored;
+    }
+    value.remove_prefix(6);
+
+    size_t specs = 0;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        boost::string_ref spec = trim(value.substr(0, comma));
+        value = comma == boost::string_ref::npos ? boost::string_ref() : value.substr(comma + 1);
+        if (spec.empty()) {
+            continue;
+        }
+        if (++specs > k_max_ranges) {
+            ranges->clear();
+            return k_range_ignored;
+        }
+        ByteRange range;
+        int ret = parse_range_spec(spec, size, &range);
+        if (ret < 0) {
+            ranges->clear();
+            return k_range_ignored;
+        }
+        if (ret > 0) {
+            ranges->push_back(range);
+        }
+    }
+    if (specs == 0) {
+        return k_range_ignored;
+    }
+    if (ranges->empty()) {
+        return k_range_unsatisfiable;
+    }
+    if (ranges->size() > 1) {
+        coalesce_ranges(ranges);
+    }
+    return k_range_satisfiable;
+}
+
+bool etag_matches(boost::string_ref list, boost::string_ref etag) {
+    list = trim(list);
+    if (list == "*") {
+        return true;
+    }
+    if (etag.starts_with("W/")) {
+        etag.remove_prefix(2);
+    }
+    if (etag.empty()) {
+        return false;
+    }
+    while (!list.empty()) {
+        char c = list.front();
+        if (c == ',' || is_space(c)) {
+            list.remove_prefix(1);
+            continue;
+        }
+        if (list.starts_with("W/")) {
+            list.remove_prefix(2);
+        }
+        if (list.empty() || list.front() != '"') {
+            return false;
+        }
+        size_t end = list.substr(1).find('"');
+        if (end == boost::string_ref::npos) {
+            return false;
+        }
+        end += 1;
+        if (list.substr(0, end + 1) == etag) {
+            return true;
+        }
+        list.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+bool parse_http_date(boost::string_ref value, time_t *result) {
+    char buf[64];
+    if (value.size() >= sizeof buf) {
+        return false;
+    }
+    memcpy(buf, value.data(), value.size());
+    buf[value.size()] = '\0';
+    struct tm tm_time;
+    memset(&tm_time, 0, sizeof tm_time);
+    const char *end = ::strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+    if (end == nullptr || *end != '\0') {
+        return false;
+    }
+    *result = ::timegm(&tm_time);
+    return true;
+}
+
+void evaluate_conditional(const HttpRequest &req, HttpResponse *resp) {
+    if (resp->status_code() != HttpResponse::k_200_ok) {
+        return;
+    }
+    HttpRequest::Method method = req.method();
+    if (method != HttpRequest::k_get && method != HttpRequest::k_head) {
+        return;
+    }
+
+    const std::string *if_none_match = req.find_header("If-None-Match");
+    if (if_none_match) {
+        if (etag_matches(*if_none_match, resp->get_header("ETag"))) {
+            resp->set_not_modified();
+            return;
+        }
+    } else {
+        // 有If-None-Match时忽略If-Modified-Since
+        const std::string *if_modified_since = req.find_header("If-Modified-Since");
+        if (if_modified_since && !modified_since(resp->get_header("Last-Modified"), *if_modified_since)) {
+            resp->set_not_modified();
+            return;
+        }
+    }
+
+    const std::string *range = req.find_header("Range");
+    if (!range || method != HttpRequest::k_get || resp->streaming()) {
+        return;
+    }
+    const std::string *if_range = req.find_header("If-Range");
+    if (if_range && !if_range_matches(*if_range, *resp)) {
+        return;
+    }
+    std::vector<ByteRange> ranges;
+    switch (parse_range(*range, resp->body_size(), &ranges)) {
+        case k_range_satisfiable:
+            resp->set_partial_content(ranges);
+            break;
+        case k_range_unsatisfiable:
+            resp->set_range_not_satisfiable();
+            break;
+        case k_range_ignored:
+            break;
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
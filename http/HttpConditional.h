@@ -0,0 +1,69 @@
+/**
+ * @brief 条件请求与Range请求
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTPCONDITIONAL_H
+#define WEB_SERVER_HTTP_HTTPCONDITIONAL_H
+
+#include <ctime>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "http/HttpResponse.h"
+
+namespace web_server {
+
+namespace http {
+
+class HttpRequest;
+
+enum RangeResult {
+    k_range_ignored,            // 语法错误、不是bytes单位或区间过多，按完整响应处理
+    k_range_satisfiable,        // ranges中为要发送的区间
+    k_range_unsatisfiable       // 没有一个区间落在响应体之内，返回416
+};
+
+/**
+ * @brief 一个Range首部最多接受的区间数，超过时忽略Range
+ */
+const size_t k_max_ranges = 16;
+
+/**
+ * @brief 解析Range首部，如bytes=0-99,200-,-50
+ * 超出size的部分被截掉；有区间重叠时按起点排序并合并，否则保持请求中的顺序
+ * @param value Range首部的值
+ * @param size 完整响应体的长度
+ * @param ranges 输出的区间
+ * @return RangeResult
+ */
+RangeResult parse_range(boost::string_ref value, int64_t size, std::vector<ByteRange> *ranges);
+
+/**
+ * @brief If-None-Match中的实体标签列表是否与etag弱匹配，*匹配任意etag
+ */
+bool etag_matches(boost::string_ref list, boost::string_ref etag);
+
+/**
+ * @brief 解析IMF-fixdate格式的HTTP日期，如Sun, 06 Nov 1994 08:49:37 GMT
+ */
+bool parse_http_date(boost::string_ref value, time_t *result);
+
+/**
+ * @brief 按请求的条件首部和Range首部改写handler生成的响应，由HttpServer在回调之后调用
+ * 只处理GET和HEAD的200响应：If-None-Match与ETag匹配，或者没有If-None-Match时
+ * Last-Modified不晚于If-Modified-Since，改为只有响应头的304；
+ * 否则GET请求带有Range且If-Range（如果有）仍然有效时，改为206或416。
+ * 流式响应体长度未知，不处理Range
+ */
+void evaluate_conditional(const HttpRequest &req, HttpResponse *resp);
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTPCONDITIONAL_H
@@ -29,7 +29,13 @@ bool HttpContext::parse_request(Buffer *buf, Timestamp receive_time) {
         if (state_ == k_expect_request_line) {
             // 解析请求行
             const char *crlf = buf->find_CRLF(); // 查找"r\n"
-            if (crlf) {
+            size_t line_length = crlf ? static_cast<size_t>(crlf - buf->peek()) : buf->readable_bytes();
+            if (line_length > limits_.max_request_line) {
+                // 请求行过长，不必等它结束
+                error_ = k_request_line_too_long;
+                is_ok = false;
+                has_more = false;
+            } else if (crlf) {
                 // 查找成功，当前请求行完整，进行请求行解析
                 is_ok = process_request_line(buf->peek(), crlf);
                 if (is_ok) {
@@ -41,6 +47,7 @@ bool HttpContext::parse_request(Buffer *buf, Timestamp receive_time) {
                     state_ = k_expect_headers;
                 } else {
                     // 请求行解析失败
+                    error_ = k_bad_request;
                     has_more = false;
                 }
             } else {
@@ -50,18 +57,32 @@ bool HttpContext::parse_request(Buffer *buf, Timestamp receive_time) {
         } else if (state_ == k_expect_headers) {
             // 解析请求头 查找"r\n"
             const char *crlf = buf->find_CRLF();
-            if (crlf) {
+            // 未完成的首部行也计入，慢速发送的超长首部在到达上限时就被拒绝
+            size_t line_bytes = crlf ? static_cast<size_t>(crlf - buf->peek()) + 2 : buf->readable_bytes();
+            if (header_bytes_ + line_bytes > limits_.max_header_bytes) {
+                error_ = k_header_too_large;
+                is_ok = false;
+                has_more = false;
+            } else if (crlf) {
                 // 查找成功，当前有一行完整的数据 查找":"
                 const char *colon = std::find(buf->peek(), crlf, ':');
-                if (colon != crlf) {
-                    request_.add_header(buf->peek(), colon, crlf);
-                } else {
-                    // 空行（"r\n"），请求头结束
-                    state_ = k_got_all;
+                if (colon != crlf && header_count_ >= limits_.max_header_count) {
+                    error_ = k_header_too_large;
+                    is_ok = false;
                     has_more = false;
+                } else {
+                    if (colon != crlf) {
+                        request_.add_header(buf->peek(), colon, crlf);
+                        ++header_count_;
+                    } else {
+                        // 空行（"r\n"），请求头结束
+                        state_ = k_got_all;
+                        has_more = false;
+                    }
+                    header_bytes_ += line_bytes;
+                    // 更新 Buffer
+                    buf->retrieve_until(crlf + 2);
                 }
-                // 更新 Buffer
-                buf->retrieve_until(crlf + 2);
             } else {
                 has_more = false;
             }
@@ -9,6 +9,8 @@
 #ifndef WEB_SERVER_HTTP_HTTPCONTEXT_H
 #define WEB_SERVER_HTTP_HTTPCONTEXT_H
 
+#include <cstddef>
+
 #include "base/Copyable.h"
 #include "http/HttpRequest.h"
 #include "net/Buffer.h"
@@ -19,6 +21,16 @@ namespace http {
 
 using web_server::net::Buffer;
 
+/**
+ * @brief 请求头的大小限制，防止慢速或恶意的客户端用不完整的请求占住内存
+ */
+struct RequestLimits {
+    size_t max_request_line = 8 * 1024;     // 请求行的字节数上限，超过时返回414
+    size_t max_header_count = 100;          // 首部个数上限，超过时返回431
+    size_t max_header_bytes = 64 * 1024;    // 全部首部的字节数上限，超过时返回431
+    double header_timeout = 10.0;           // 从连接建立或请求开始到请求头完整的时间上限，秒，超时返回408，不大于0时不限
+};
+
 /**
  * @brief 负责解析http请求的工作
  * 
@@ -32,11 +44,22 @@ public:
         k_got_all,                  // 解析完成
     };
 
+    enum ParseError {
+        k_no_error,
+        k_bad_request,              // 请求行格式错误
+        k_request_line_too_long,    // 请求行超过max_request_line
+        k_header_too_large          // 首部个数或字节数超过上限
+    };
+
     /**
      * @brief Construct a new Http Context object
      * 初始从解析请求行或状态行开始
      */
-    HttpContext() :state_(k_expect_request_line) {}
+    HttpContext()
+        : state_(k_expect_request_line),
+          error_(k_no_error),
+          header_count_(0),
+          header_bytes_(0) {}
 
     /**
      * @brief 解析buffer中的数据，将数据保存到request中
@@ -44,20 +67,45 @@ public:
      * @param buf 
      * @param receive_time 
      * @return true 
-     * @return false 
+     * @return false 请求无效或超过限制，原因见error()
      */
     bool parse_request(Buffer *buf, Timestamp receive_time);
 
+    ParseError error() const {
+        return error_;
+    }
+
+    /**
+     * @brief 设置请求头的大小限制，reset之后仍然有效
+     */
+    void set_limits(const RequestLimits &limits) {
+        limits_ = limits;
+    }
+
+    const RequestLimits &limits() const {
+        return limits_;
+    }
+
     bool got_all() const {
         return state_ == k_got_all;
     }
 
+    /**
+     * @brief 还没有读到新请求的请求行，HttpServer在此时检查HTTP/2的连接前言
+     */
+    bool expect_request_line() const {
+        return state_ == k_expect_request_line;
+    }
+
     /**
      * @brief 清空HttpRequest对象
      * 
      */
     void reset() {
         state_ = k_expect_request_line;
+        error_ = k_no_error;
+        header_count_ = 0;
+        header_bytes_ = 0;
         HttpRequest dummy;
         request_.swap(dummy);
     }
@@ -72,6 +120,10 @@ public:
 
 private:
     HttpRequestParseState state_;
+    ParseError error_;
+    RequestLimits limits_;
+    size_t header_count_;
+    size_t header_bytes_;           // 已经解析的首部行，包括CRLF
     HttpRequest request_;
 
     bool process_request_line(const char *begin, const char *end);
@@ -0,0 +1,50 @@
+/**
+ * @brief 首部的查找和首部值的token匹配，名称和token都不区分大小写
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/HttpHeaders.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+} // namespace
+
+bool header_has_token(const std::string &value, const char *token) {
+    size_t token_len = strlen(token);
+    const char *p = value.data();
+    const char *end = p + value.size();
+    while (p < end) {
+        const char *comma = std::find(p, end, ',');
+        const char *b = p;
+        const char *e = comma;
+        while (b < e && is_space(*b)) {
+            ++b;
+        }
+        while (e > b && is_space(*(e - 1))) {
+            --e;
+        }
+        if (static_cast<size_t>(e - b) == token_len && strncasecmp(b, token, token_len) == 0) {
+            return true;
+        }
+        p = comma == end ? end : comma + 1;
+    }
+    return false;
+}
+
+} // namespace http
+
+} // namespace web_server
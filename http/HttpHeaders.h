@@ -0,0 +1,43 @@
+/**
+ * @brief 首部的查找和首部值的token匹配，名称和token都不区分大小写
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTPHEADERS_H
+#define WEB_SERVER_HTTP_HTTPHEADERS_H
+
+#include <strings.h>
+
+#include <string>
+
+namespace web_server {
+
+namespace http {
+
+/**
+ * @brief 在(名称, 值)的序列中按名称查找首部，首部名称按原样的大小写保存
+ * @return 没有该首部时返回nullptr，用来区分没有和值为空
+ */
+template <typename Headers>
+const std::string *find_header(const Headers &headers, const char *field) {
+    for (const auto &header : headers) {
+        if (::strcasecmp(header.first.c_str(), field) == 0) {
+            return &header.second;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 逗号分隔的首部值中是否有token，例如Connection: keep-alive, Upgrade
+ */
+bool header_has_token(const std::string &value, const char *token);
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTPHEADERS_H
@@ -16,6 +16,7 @@
 #include <cassert>
 
 #include "base/Timestamp.h"
+#include "http/HttpHeaders.h"
 
 namespace web_server {
 
@@ -29,7 +30,7 @@ namespace http {
 class HttpRequest : public Copyable {
 public:
     enum Method {k_invalid, k_get, k_post, k_head, k_put, k_delete};
-    enum Version {k_unknown, k_http10, k_http11};
+    enum Version {k_unknown, k_http10, k_http11, k_http2};
 
     HttpRequest() : method_(k_invalid), version_(k_unknown) {}
 
@@ -145,18 +146,37 @@ public:
     }
 
     /**
-     * @brief Get the header object
-     * 根据提供的field值查询请求字段的内容
+     * @brief 直接添加已经解析好的首部，HTTP/2请求使用
      * @param field 
-     * @return std::string 
+     * @param value 
      */
-    std::string get_header(const std::string &field) const {
-        std::string value;
+    void add_header(const std::string &field, const std::string &value) {
+        headers_[field] = value;
+    }
+
+    /**
+     * @brief 按名称查找首部，不区分大小写，首部名称按客户端发送的原样保存
+     * 先按原样查找，客户端通常使用标准写法
+     * @param field 
+     * @return const std::string* 没有该首部时返回nullptr
+     */
+    const std::string *find_header(const std::string &field) const {
         auto it = headers_.find(field);
         if (it != headers_.end()) {
-            value = it->second;
+            return &it->second;
         }
-        return value;
+        return http::find_header(headers_, field.c_str());
+    }
+
+    /**
+     * @brief Get the header object
+     * 根据提供的field值查询请求字段的内容，不区分大小写，没有该首部时返回空字符串
+     * @param field 
+     * @return std::string 
+     */
+    std::string get_header(const std::string &field) const {
+        const std::string *value = find_header(field);
+        return value ? *value : std::string();
     }
 
     const std::map<std::string, std::string> &headers() const {
@@ -8,24 +8,178 @@
 
 #include "http/HttpResponse.h"
 
+#include <cassert>
+#include <cstring>
+
+#include "base/CurrentThread.h"
+#include "base/NumberFormat.h"
+#include "base/Timestamp.h"
+#include "http/StreamSignal.h"
+
 namespace web_server {
 
 namespace http {
 
+namespace {
+
+void append_content_length(Buffer *output, uint64_t length) {
+    char buf[48];
+    memcpy(buf, "Content-Length: ", 16);
+    size_t len = 16 + number_format::format_uint(buf + 16, length);
+    memcpy(buf + len, "\r\n", 2);
+    output->append(buf, len + 2);
+}
+
+/**
+ * @brief 追加"bytes first-last/total"
+ */
+void append_content_range(std::string *output, int64_t offset, int64_t length, int64_t total) {
+    char buf[6 + 3 * number_format::k_max_int_size];
+    size_t len = 0;
+    memcpy(buf, "bytes ", 6);
+    len += 6;
+    len += number_format::format_int(buf + len, offset);
+    buf[len++] = '-';
+    len += number_format::format_int(buf + len, offset + length - 1);
+    buf[len++] = '/';
+    len += number_format::format_int(buf + len, total);
+    output->append(buf, len);
+}
+
+/**
+ * @brief 生成multipart分隔符，每个线程一个xorshift序列，不需要加锁
+ */
+std::string make_boundary() {
+    static __thread uint64_t state = 0;
+    if (state == 0) {
+        state = static_cast<uint64_t>(Timestamp::now().micro_seconds_since_epoch()) ^
+                (static_cast<uint64_t>(current_thread::tid()) << 32) ^ 0x9E3779B97F4A7C15ULL;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    char buf[number_format::k_max_hex_size];
+    return std::string(buf, number_format::format_hex(buf, state));
+}
+
+} // namespace
+
+std::function<void()> HttpResponse::stream_resumer() {
+    if (!stream_signal_) {
+        stream_signal_ = std::make_shared<StreamSignal>();
+    }
+    std::shared_ptr<StreamSignal> signal(stream_signal_);
+    return [signal]() {
+        signal->notify();
+    };
+}
+
+void HttpResponse::set_not_modified() {
+    status_code_ = k_304_not_modified;
+    status_message_ = "Not Modified";
+    headers_.erase("Content-Type");
+    body_.clear();
+    body_stream_ = BodyStream();
+    clear_body_file();
+}
+
+void HttpResponse::set_partial_content(const std::vector<ByteRange> &ranges) {
+    assert(!ranges.empty() && !streaming() && file_parts_.empty());
+    int64_t total = body_size();
+    status_code_ = k_206_partial_content;
+    status_message_ = "Partial Content";
+
+    if (ranges.size() == 1) {
+        const ByteRange &range = ranges.front();
+        std::string content_range;
+        append_content_range(&content_range, range.offset, range.length, total);
+        headers_["Content-Range"] = content_range;
+        if (has_file_body()) {
+            file_offset_ += static_cast<off_t>(range.offset);
+            content_length_ = range.length;
+        } else {
+            body_ = body_.substr(static_cast<size_t>(range.offset), static_cast<size_t>(range.length));
+        }
+        return;
+    }
+
+    std::string content_type = get_header("Content-Type");
+    std::string boundary = make_boundary();
+    headers_["Content-Type"] = "multipart/byteranges; boundary=" + boundary;
+    std::string body;
+    int64_t length = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const ByteRange &range = ranges[i];
+        std::string header(i == 0 ? "--" : "\r\n--");
+        header += boundary;
+        header += "\r\n";
+        if (!content_type.empty()) {
+            header += "Content-Type: ";
+            header += content_type;
+            header += "\r\n";
+        }
+        header += "Content-Range: ";
+        append_content_range(&header, range.offset, range.length, total);
+        header += "\r\n\r\n";
+        length += static_cast<int64_t>(header.size()) + range.length;
+        if (has_file_body()) {
+            file_parts_.push_back(FilePart{std::move(header), file_offset_ + static_cast<off_t>(range.offset),
+                                           static_cast<size_t>(range.length)});
+        } else {
+            body += header;
+            body.append(body_, static_cast<size_t>(range.offset), static_cast<size_t>(range.length));
+        }
+    }
+    std::string tail = "\r\n--" + boundary + "--\r\n";
+    if (has_file_body()) {
+        file_parts_tail_ = tail;
+        content_length_ = length + static_cast<int64_t>(tail.size());
+    } else {
+        body += tail;
+        body_.swap(body);
+    }
+}
+
+void HttpResponse::set_range_not_satisfiable() {
+    int64_t total = body_size();
+    std::string content_range("bytes */");
+    char buf[number_format::k_max_int_size];
+    content_range.append(buf, number_format::format_int(buf, total));
+    status_code_ = k_416_range_not_satisfiable;
+    status_message_ = "Range Not Satisfiable";
+    headers_["Content-Range"] = content_range;
+    headers_.erase("Content-Type");
+    body_.clear();
+    clear_body_file();
+}
+
 void HttpResponse::append_to_buffer(Buffer *output) const {
     char buf[32];
-    snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", status_code_);
-    output->append(buf);
+    memcpy(buf, "HTTP/1.1 ", 9);
+    size_t len = 9 + number_format::format_int(buf + 9, status_code_);
+    buf[len++] = ' ';
+    output->append(buf, len);
     output->append(status_message_);
     output->append("\r\n");
 
-    if (close_connection_) {
-
+    if (status_code_ == k_304_not_modified) {
+        // 304没有响应体，也不能带Content-Length: 0
+        output->append(close_connection_ ? "Connection: close\r\n" : "Connection: Keep-Alive\r\n");
+    } else if (has_file_body()) {
+        append_content_length(output, static_cast<uint64_t>(content_length_));
+        output->append(close_connection_ ? "Connection: close\r\n" : "Connection: Keep-Alive\r\n");
+    } else if (streaming()) {
+        if (content_length_ >= 0) {
+            append_content_length(output, static_cast<uint64_t>(content_length_));
+        } else if (chunked()) {
+            output->append("Transfer-Encoding: chunked\r\n");
+        }
+        output->append(close_connection_ ? "Connection: close\r\n" : "Connection: Keep-Alive\r\n");
+    } else if (close_connection_ && !head_only_) {
         output->append("Connection: close\r\n");
     } else {
-        snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
-        output->append(buf);
-        output->append("Connection: Keep-Alive\r\n");
+        append_content_length(output, body_.size());
+        output->append(close_connection_ ? "Connection: close\r\n" : "Connection: Keep-Alive\r\n");
     }
 
     for (const auto &header : headers_) {
@@ -36,7 +190,9 @@ void HttpResponse::append_to_buffer(Buffer *output) const {
     }
 
     output->append("\r\n");
-    output->append(body_);
+    if (!streaming() && !has_file_body() && !head_only_ && status_code_ != k_304_not_modified) {
+        output->append(body_);
+    }
 }
 
 } // namespace http
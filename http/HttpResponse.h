@@ -9,8 +9,14 @@
 #ifndef WEB_SERVER_HTTP_HTTPRESPONSE_H
 #define WEB_SERVER_HTTP_HTTPRESPONSE_H
 
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/Copyable.h"
 #include "net/Buffer.h"
@@ -21,6 +27,17 @@ namespace http {
 
 using web_server::net::Buffer;
 
+struct CachedResponse;
+class StreamSignal;
+
+/**
+ * @brief 响应体中的一个字节区间[offset, offset + length)
+ */
+struct ByteRange {
+    int64_t offset;
+    int64_t length;
+};
+
 /**
  * @brief 负责管理http响应报文中的信息
  * 
@@ -30,20 +47,57 @@ public:
     enum HttpStatusCode {
         k_unknown,
         k_200_ok = 200,
+        k_206_partial_content = 206,
         k_301_moved_permanently = 301,
+        k_304_not_modified = 304,
         k_400_bad_request = 400,
-        k_404_not_found = 404
+        k_403_forbidden = 403,
+        k_404_not_found = 404,
+        k_405_method_not_allowed = 405,
+        k_408_request_timeout = 408,
+        k_414_uri_too_long = 414,
+        k_416_range_not_satisfiable = 416,
+        k_431_request_header_fields_too_large = 431,
+        k_502_bad_gateway = 502,
+        k_503_service_unavailable = 503,
+        k_504_gateway_timeout = 504
     };
 
+    /**
+     * @brief 多区间文件响应中的一段：先发送header，再从文件offset处sendfile发送length字节
+     */
+    struct FilePart {
+        std::string header;
+        off_t offset;
+        size_t length;
+    };
+
+    /**
+     * @brief 流式响应体的生产函数，在连接所属的IO线程中按需调用
+     * 每次调用向output追加下一段数据，返回false表示数据已经全部给出（本次追加的数据仍会发送）；
+     * 暂时没有数据时返回true且不追加：取得过stream_resumer()的响应暂停到调用它为止，
+     * 否则IO线程隔StreamSignal::k_retry_interval秒再调用
+     */
+    using BodyStream = std::function<bool(Buffer *output)>;
+
     explicit HttpResponse(bool close) 
     : status_code_(k_unknown),
-      close_connection_(close) {
+      close_connection_(close),
+      head_only_(false),
+      content_length_(-1),
+      file_fd_(-1),
+      file_offset_(0),
+      compress_min_size_(-1) {
     }
 
     void set_status_code(HttpStatusCode code) {
         status_code_ = code;
     }
 
+    HttpStatusCode status_code() const {
+        return status_code_;
+    }
+
     void set_status_message(const std::string &message) {
         status_message_ = message;
     }
@@ -56,6 +110,18 @@ public:
         return close_connection_;
     }
 
+    /**
+     * @brief 响应HEAD请求，只发送响应头，Content-Length等仍按完整响应体计算
+     * 由HttpServer在调用回调之前设置
+     */
+    void set_head_only(bool on) {
+        head_only_ = on;
+    }
+
+    bool head_only() const {
+        return head_only_;
+    }
+
     void set_content_type(const std::string &content_type) {
         add_header("Content-Type", content_type);
     }
@@ -64,13 +130,175 @@ public:
         headers_[key] = value;
     }
 
+    std::string get_header(const std::string &key) const {
+        auto it = headers_.find(key);
+        return it == headers_.end() ? std::string() : it->second;
+    }
+
+    void remove_header(const std::string &key) {
+        headers_.erase(key);
+    }
+
+    const std::map<std::string, std::string> &headers() const {
+        return headers_;
+    }
+
     void set_body(const std::string &body) {
         body_ = body;
     }
+
+    const std::string &body() const {
+        return body_;
+    }
+
+    /**
+     * @brief 以流的方式发送响应体，代替set_body
+     * 长度已知时使用Content-Length；长度未知且保持连接时使用chunked编码，
+     * 长度未知且关闭连接时直接写出数据，以关闭连接表示结束
+     * @param stream
+     * @param content_length 响应体总长度，-1表示未知
+     */
+    void set_body_stream(const BodyStream &stream, int64_t content_length = -1) {
+        body_stream_ = stream;
+        content_length_ = content_length;
+    }
+
+    bool streaming() const {
+        return static_cast<bool>(body_stream_);
+    }
+
+    /**
+     * @brief 取得流式响应体的唤醒函数，生产者暂时没有数据时保存它，数据就绪后调用
+     * 可以在任意线程调用，可以调用多次；响应结束或连接关闭之后调用没有作用
+     */
+    std::function<void()> stream_resumer();
+
+    const std::shared_ptr<StreamSignal> &stream_signal() const {
+        return stream_signal_;
+    }
+
+    const BodyStream &body_stream() const {
+        return body_stream_;
+    }
+
+    int64_t content_length() const {
+        return content_length_;
+    }
+
+    bool chunked() const {
+        return streaming() && content_length_ < 0 && !close_connection_;
+    }
+
+    /**
+     * @brief 响应体为文件中[offset, offset + length)的内容，由TcpConnection::send_file零拷贝发送
+     * @param fd
+     * @param offset
+     * @param length
+     * @param holder 发送完成之前保持fd打开
+     */
+    void set_body_file(int fd, off_t offset, size_t length, const std::shared_ptr<void> &holder) {
+        file_fd_ = fd;
+        file_offset_ = offset;
+        content_length_ = static_cast<int64_t>(length);
+        file_holder_ = holder;
+    }
+
+    /**
+     * @brief 去掉文件响应体，改用set_body设置的内容
+     */
+    void clear_body_file() {
+        file_fd_ = -1;
+        file_offset_ = 0;
+        content_length_ = -1;
+        file_holder_.reset();
+        file_parts_.clear();
+        file_parts_tail_.clear();
+    }
+
+    bool has_file_body() const {
+        return file_fd_ >= 0;
+    }
+
+    int file_fd() const {
+        return file_fd_;
+    }
+
+    off_t file_offset() const {
+        return file_offset_;
+    }
+
+    const std::shared_ptr<void> &file_holder() const {
+        return file_holder_;
+    }
+
+    /**
+     * @brief 多区间文件响应的各段，为空时整个文件区间一次发送
+     */
+    const std::vector<FilePart> &file_parts() const {
+        return file_parts_;
+    }
+
+    /**
+     * @brief 多区间文件响应最后的结束分隔符
+     */
+    const std::string &file_parts_tail() const {
+        return file_parts_tail_;
+    }
+
+    /**
+     * @brief 完整响应体的长度，流式响应返回-1
+     */
+    int64_t body_size() const {
+        if (has_file_body()) {
+            return content_length_;
+        }
+        return streaming() ? -1 : static_cast<int64_t>(body_.size());
+    }
+
+    /**
+     * @brief 响应体不小于该值时才压缩，-1表示使用HttpServer的默认值，INT64_MAX表示不压缩
+     */
+    void set_compress_min_size(int64_t size) {
+        compress_min_size_ = size;
+    }
+
+    int64_t compress_min_size() const {
+        return compress_min_size_;
+    }
+
+    /**
+     * @brief 改为304响应，丢弃响应体，保留ETag等校验首部
+     */
+    void set_not_modified();
+
+    /**
+     * @brief 改为206响应，只发送ranges中的区间
+     * 单个区间直接截取响应体并加上Content-Range；多个区间使用multipart/byteranges，
+     * 文件响应体的每个区间仍由sendfile发送
+     * @param ranges 不重叠、都在body_size()之内的区间，不能为空
+     */
+    void set_partial_content(const std::vector<ByteRange> &ranges);
+
+    /**
+     * @brief 改为416响应，Content-Range给出完整长度
+     */
+    void set_range_not_satisfiable();
     
+    /**
+     * @brief 响应来自微缓存，HttpServer直接发送序列化好的报文，不再使用状态码、首部和响应体
+     * 是否关闭连接和是否只发送响应头仍由本对象决定
+     */
+    void set_cached(const std::shared_ptr<const CachedResponse> &cached) {
+        cached_ = cached;
+    }
+
+    const std::shared_ptr<const CachedResponse> &cached() const {
+        return cached_;
+    }
+
     /**
      * @brief 将响应报文数据存放到buffer中
-     * 
+     * 流式响应只写入响应头，响应体由HttpServer按需生产
      * @param output 
      */
     void append_to_buffer(Buffer *output) const;
@@ -80,7 +308,18 @@ private:
     HttpStatusCode status_code_;                    // 存放状态码
     std::string status_message_;                    // 存放状态信息
     bool close_connection_;                         // 是否设置Connection字段为close
+    bool head_only_;                                // 只发送响应头
     std::string body_;                              // 存放响应体
+    BodyStream body_stream_;                        // 流式响应体
+    std::shared_ptr<StreamSignal> stream_signal_;   // 流式响应体的唤醒信号，取得过唤醒函数时才有
+    int64_t content_length_;                        // 流式或文件响应体的长度，-1表示未知
+    int file_fd_;                                   // 文件响应体
+    off_t file_offset_;
+    std::shared_ptr<void> file_holder_;
+    std::vector<FilePart> file_parts_;              // 多区间文件响应
+    std::string file_parts_tail_;
+    int64_t compress_min_size_;                     // 压缩阈值
+    std::shared_ptr<const CachedResponse> cached_;  // 微缓存中的报文
 };
 
 } // namespace http
@@ -0,0 +1,293 @@
+/**
+ * @brief http响应的增量解析，以及按Content-Length或chunked确定消息体边界
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/HttpResponseParser.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief 解析非负十进制整数，不接受空串、符号和溢出
+ */
+bool parse_length(const std::string &value, int64_t *length) {
+    if (value.empty()) {
+        return false;
+    }
+    int64_t result = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9' || result > (INT64_MAX - 9) / 10) {
+            return false;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *length = result;
+    return true;
+}
+
+} // namespace
+
+void HttpBodyReader::reset(Mode mode, int64_t length) {
+    mode_ = mode;
+    remaining_ = length;
+    body_bytes_ = 0;
+    line_.clear();
+    switch (mode) {
+        case k_none:
+            state_ = k_done;
+            break;
+        case k_length:
+            state_ = length > 0 ? k_data : k_done;
+            break;
+        case k_chunked:
+            state_ = k_size_line;
+            break;
+        case k_until_close:
+            state_ = k_data;
+            break;
+    }
+}
+
+size_t HttpBodyReader::feed(const char *data, size_t len, std::string *decoded) {
+    size_t consumed = 0;
+    while (consumed < len && state_ != k_done && state_ != k_error) {
+        const char *p = data + consumed;
+        size_t avail = len - consumed;
+        if (state_ == k_data) {
+            size_t n = avail;
+            if (mode_ != k_until_close) {
+                n = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(avail), remaining_));
+                remaining_ -= n;
+            }
+            if (decoded) {
+                decoded->append(p, n);
+            }
+            body_bytes_ += n;
+            consumed += n;
+            if (mode_ != k_until_close && remaining_ == 0) {
+                state_ = mode_ == k_chunked ? k_data_crlf : k_done;
+            }
+            continue;
+        }
+        // 其余状态都按行处理，一行可能分多次到达，先攒在line_中
+        const char *lf = static_cast<const char *>(memchr(p, '\n', avail));
+        size_t n = lf ? static_cast<size_t>(lf - p) + 1 : avail;
+        if (line_.size() + n > k_max_line_length) {
+            state_ = k_error;
+            return 0;
+        }
+        line_.append(p, n);
+        consumed += n;
+        if (!lf) {
+            break;
+        }
+        // 去掉行尾的CRLF，也接受单独的LF
+        line_.pop_back();
+        if (!line_.empty() && line_.back() == '\r') {
+            line_.pop_back();
+        }
+        if (state_ == k_size_line) {
+            if (!parse_size_line()) {
+                state_ = k_error;
+                return 0;
+            }
+        } else if (state_ == k_data_crlf) {
+            if (!line_.empty()) {
+                state_ = k_error;
+                return 0;
+            }
+            state_ = k_size_line;
+        } else if (state_ == k_trailer && line_.empty()) {
+            state_ = k_done;
+        }
+        line_.clear();
+    }
+    return consumed;
+}
+
+bool HttpBodyReader::parse_size_line() {
+    // 块大小后面可以跟";扩展"，忽略扩展
+    size_t end = line_.find(';');
+    if (end == std::string::npos) {
+        end = line_.size();
+    }
+    while (end > 0 && is_space(line_[end - 1])) {
+        --end;
+    }
+    if (end == 0 || end > 15) {
+        return false;
+    }
+    int64_t size = 0;
+    for (size_t i = 0; i < end; ++i) {
+        char c = line_[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        size = size * 16 + digit;
+    }
+    remaining_ = size;
+    state_ = size == 0 ? k_trailer : k_data;
+    return true;
+}
+
+void HttpResponseParser::reset() {
+    state_ = k_expect_status_line;
+    head_size_ = 0;
+    status_code_ = 0;
+    status_message_.clear();
+    http11_ = true;
+    headers_.clear();
+}
+
+bool HttpResponseParser::parse_head(net::Buffer *buf) {
+    while (state_ != k_got_head) {
+        const char *crlf = buf->find_CRLF();
+        if (!crlf) {
+            return head_size_ + buf->readable_bytes() <= k_max_head_size;
+        }
+        head_size_ += crlf + 2 - buf->peek();
+        if (head_size_ > k_max_head_size) {
+            return false;
+        }
+        if (state_ == k_expect_status_line) {
+            if (!process_status_line(buf->peek(), crlf)) {
+                return false;
+            }
+            state_ = k_expect_headers;
+        } else if (crlf == buf->peek()) {
+            // 空行，响应头结束
+            state_ = k_got_head;
+        } else {
+            const char *colon = std::find(buf->peek(), crlf, ':');
+            if (colon == crlf || colon == buf->peek()) {
+                return false;
+            }
+            const char *value = colon + 1;
+            while (value < crlf && is_space(*value)) {
+                ++value;
+            }
+            const char *value_end = crlf;
+            while (value_end > value && is_space(*(value_end - 1))) {
+                --value_end;
+            }
+            headers_.emplace_back(std::string(buf->peek(), colon), std::string(value, value_end));
+        }
+        buf->retrieve_until(crlf + 2);
+    }
+    return true;
+}
+
+/**
+ * @brief HTTP/1.x 三位状态码 原因短语
+ */
+bool HttpResponseParser::process_status_line(const char *begin, const char *end) {
+    if (end - begin < 12 || !std::equal(begin, begin + 7, "HTTP/1.") || begin[8] != ' ') {
+        return false;
+    }
+    if (begin[7] == '1') {
+        http11_ = true;
+    } else if (begin[7] == '0') {
+        http11_ = false;
+    } else {
+        return false;
+    }
+    int code = 0;
+    for (const char *p = begin + 9; p < begin + 12; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        code = code * 10 + (*p - '0');
+    }
+    if (code < 100) {
+        return false;
+    }
+    status_code_ = code;
+    const char *message = begin + 12;
+    if (message < end) {
+        if (*message != ' ') {
+            return false;
+        }
+        ++message;
+    }
+    status_message_.assign(message, end);
+    return true;
+}
+
+std::string HttpResponseParser::get_header(const char *field) const {
+    const std::string *value = find_header(headers_, field);
+    return value ? *value : std::string();
+}
+
+/**
+ * @brief 按RFC 7230第3.3.3节的顺序：没有消息体的响应、chunked、Content-Length，都没有时读到连接关闭
+ */
+bool HttpResponseParser::init_body(bool head_request, HttpBodyReader *body) const {
+    if (head_request || status_code_ < 200 || status_code_ == 204 || status_code_ == 304) {
+        body->reset(HttpBodyReader::k_none);
+        return true;
+    }
+    std::string transfer_encoding = get_header("Transfer-Encoding");
+    if (!transfer_encoding.empty()) {
+        if (!header_has_token(transfer_encoding, "chunked")) {
+            body->reset(HttpBodyReader::k_until_close);
+        } else {
+            body->reset(HttpBodyReader::k_chunked);
+        }
+        return true;
+    }
+    bool has_length = false;
+    int64_t length = 0;
+    for (const Header &header : headers_) {
+        if (strcasecmp(header.first.c_str(), "Content-Length") == 0) {
+            int64_t value;
+            // 多个Content-Length必须一致
+            if (!parse_length(header.second, &value) || (has_length && value != length)) {
+                return false;
+            }
+            has_length = true;
+            length = value;
+        }
+    }
+    if (has_length) {
+        body->reset(HttpBodyReader::k_length, length);
+    } else {
+        body->reset(HttpBodyReader::k_until_close);
+    }
+    return true;
+}
+
+bool HttpResponseParser::keep_alive() const {
+    std::string connection = get_header("Connection");
+    if (header_has_token(connection, "close")) {
+        return false;
+    }
+    return http11_ || header_has_token(connection, "keep-alive");
+}
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,178 @@
+/**
+ * @brief http响应的增量解析，以及按Content-Length或chunked确定消息体边界
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTPRESPONSEPARSER_H
+#define WEB_SERVER_HTTP_HTTPRESPONSEPARSER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/Copyable.h"
+#include "http/HttpHeaders.h"
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace http {
+
+/**
+ * @brief 确定一个消息体的边界
+ * 数据可以分任意多次到达，feed只消费属于本消息体的字节，之后的字节属于下一个消息；
+ * chunked消息体可以原样转发（decoded为空），也可以同时解出数据
+ */
+class HttpBodyReader : public Copyable {
+public:
+    enum Mode {
+        k_none,             // 没有消息体
+        k_length,           // Content-Length
+        k_chunked,          // Transfer-Encoding: chunked
+        k_until_close       // 直到连接关闭，只用于响应
+    };
+
+    HttpBodyReader() {
+        reset(k_none);
+    }
+
+    void reset(Mode mode, int64_t length = 0);
+
+    /**
+     * @brief 消费data中属于消息体的部分
+     * @param decoded 非空时追加消息体的数据，chunked时去掉分块格式
+     * @return size_t 消费的字节数，出错时返回0且error()为真
+     */
+    size_t feed(const char *data, size_t len, std::string *decoded = nullptr);
+
+    bool done() const {
+        return state_ == k_done;
+    }
+
+    bool error() const {
+        return state_ == k_error;
+    }
+
+    Mode mode() const {
+        return mode_;
+    }
+
+    /**
+     * @brief 已经消费的消息体数据字节数，不包括分块格式
+     */
+    int64_t body_bytes() const {
+        return body_bytes_;
+    }
+
+    /**
+     * @brief 块大小行和trailer的上限
+     */
+    static const size_t k_max_line_length = 8192;
+
+private:
+    enum State {
+        k_size_line,        // 块大小行，可以带扩展
+        k_data,
+        k_data_crlf,        // 块数据之后的CRLF
+        k_trailer,          // 最后一块之后的trailer，以空行结束
+        k_done,
+        k_error
+    };
+
+    bool parse_size_line();
+
+    Mode mode_;
+    State state_;
+    int64_t remaining_;
+    int64_t body_bytes_;
+    std::string line_;
+};
+
+/**
+ * @brief 解析响应行和响应首部，与HttpContext解析请求的方式相同，数据不完整时等待下一次调用
+ * 首部保留原始的顺序和重复的字段（例如多个Set-Cookie）
+ */
+class HttpResponseParser : public Copyable {
+public:
+    using Header = std::pair<std::string, std::string>;
+
+    HttpResponseParser() {
+        reset();
+    }
+
+    /**
+     * @brief 解析buf中的响应头，消费已解析的部分
+     * @return false 响应行或首部格式错误，或者响应头超过k_max_head_size
+     */
+    bool parse_head(net::Buffer *buf);
+
+    bool head_done() const {
+        return state_ == k_got_head;
+    }
+
+    void reset();
+
+    int status_code() const {
+        return status_code_;
+    }
+
+    const std::string &status_message() const {
+        return status_message_;
+    }
+
+    /**
+     * @brief HTTP/1.1为true，HTTP/1.0为false
+     */
+    bool http11() const {
+        return http11_;
+    }
+
+    const std::vector<Header> &headers() const {
+        return headers_;
+    }
+
+    /**
+     * @brief 查找首部，不区分大小写，多个同名首部时返回第一个
+     */
+    std::string get_header(const char *field) const;
+
+    /**
+     * @brief 按状态码和首部决定响应体的边界，设置到body中
+     * @param head_request 请求方法是HEAD，响应没有消息体
+     * @return false Content-Length无效
+     */
+    bool init_body(bool head_request, HttpBodyReader *body) const;
+
+    /**
+     * @brief 响应之后连接能否继续使用，HTTP/1.0需要Keep-Alive，HTTP/1.1不能有Connection: close
+     */
+    bool keep_alive() const;
+
+    static const size_t k_max_head_size = 64 * 1024;
+
+private:
+    enum State {
+        k_expect_status_line,
+        k_expect_headers,
+        k_got_head
+    };
+
+    bool process_status_line(const char *begin, const char *end);
+
+    State state_;
+    size_t head_size_;
+    int status_code_;
+    std::string status_message_;
+    bool http11_;
+    std::vector<Header> headers_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTPRESPONSEPARSER_H
@@ -8,11 +8,30 @@
 
 #include "http/HttpServer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <vector>
+
 #include "net/EventLoop.h"
+#include "base/CountDownLatch.h"
 #include "base/Logging.h"
+#include "base/BinaryLogging.h"
+#include "base/NumberFormat.h"
+#include "base/WorkStealingPool.h"
+#include "http/Compression.h"
+#include "http/Http2Connection.h"
+#include "http/HttpConditional.h"
+#include "http/HttpHeaders.h"
 #include "http/HttpRequest.h"
 #include "http/HttpContext.h"
 #include "http/HttpResponse.h"
+#include "http/HttpSession.h"
+#include "http/MicroCache.h"
+#include "http/ReverseProxy.h"
+#include "http/StreamSignal.h"
+#include "http/WebSocketConnection.h"
 
 namespace web_server {
 
@@ -28,23 +47,129 @@ void default_http_callback(const HttpRequest &, HttpResponse *resp) {
 
 } // namespace detail
 
+/**
+ * @brief 每个IO loop上的卸载状态
+ * 计算线程完成的响应先放入completions，只有队列由空变为非空时才向loop投递一次处理函数，
+ * 这样同一时间段内完成的响应在loop中一批处理
+ */
+struct HttpServer::LoopState {
+    struct Completion {
+        std::weak_ptr<TcpConnection> conn;
+        uint64_t seq;
+        uint32_t stream_id;                             // HTTP/2连接上的流，HTTP/1.1为0
+        HttpResponse response;
+        std::string cache_key;                          // 填充微缓存的请求的键，其余请求为空
+        bool cacheable;                                 // 回调没有改变连接是否关闭，结果可以缓存
+    };
+
+    explicit LoopState(EventLoop *owner) : loop(owner), has_paused(false) {}
+
+    EventLoop *loop;
+    MutexLock mutex;
+    std::vector<Completion> completions;                // 由mutex保护
+    std::deque<std::weak_ptr<TcpConnection>> paused;    // 只在loop线程中访问
+    std::atomic<bool> has_paused;
+    std::vector<std::unique_ptr<UpstreamPool>> proxy_pools; // 按路由下标，第一次使用时在loop线程中创建
+    std::unique_ptr<MicroCache> microcache;             // 只在loop线程中访问
+};
+
 HttpServer::HttpServer(EventLoop *loop,
                        const InetAddress &listen_addr,
                        const std::string &name,
                        TcpServer::Option option)
-    : server_(loop, listen_addr, name, option),
-      http_callback_(detail::default_http_callback) {
+    : http_callback_(detail::default_http_callback),
+      num_workers_(0),
+      max_pending_requests_(0),
+      pending_requests_(0),
+      server_(loop, listen_addr, name, option) {
     server_.set_connection_callback(
         std::bind(&HttpServer::on_connetion, this, _1));
     server_.set_message_callback(
         std::bind(&HttpServer::on_message, this, _1, _2, _3));
+    server_.set_thread_init_callback(
+        std::bind(&HttpServer::init_loop_state, this, _1));
+}
+
+HttpServer::~HttpServer() {
+    if (worker_pool_) {
+        worker_pool_->stop();
+    }
+    shutdown_proxy();
+}
+
+void HttpServer::set_worker_thread_num(int num_threads, size_t max_pending_requests) {
+    assert(num_threads >= 0);
+    assert(!worker_pool_);
+    num_workers_ = num_threads;
+    max_pending_requests_ = max_pending_requests;
+}
+
+void HttpServer::enable_compression(const CompressionOptions &options) {
+    compressor_.reset(new ResponseCompressor(options));
+}
+
+void HttpServer::enable_microcache(const MicroCacheOptions &options) {
+    microcache_options_.reset(new MicroCacheOptions(options));
+}
+
+void HttpServer::set_websocket_handler(const WebSocketHandler &handler, const WebSocketOptions &options) {
+    websocket_handler_.reset(new WebSocketHandler(handler));
+    websocket_options_.reset(new WebSocketOptions(options));
+}
+
+void HttpServer::add_proxy(const std::string &prefix, const InetAddress &upstream, const ProxyOptions &options) {
+    proxy_routes_.emplace_back(new ProxyRoute{prefix, upstream, options});
+}
+
+void HttpServer::add_proxy(const std::string &prefix, const InetAddress &upstream) {
+    add_proxy(prefix, upstream, ProxyOptions());
 }
 
 void HttpServer::start() {
     // LOG_WARN << "HttpServer[" << server_.name() << "] starts listening on " << server_.IP_port();
+    if (num_workers_ > 0 && !worker_pool_) {
+        worker_pool_.reset(new WorkStealingPool(server_.name() + "Worker"));
+        worker_pool_->start(num_workers_);
+    }
+    if (microcache_options_ && compressor_) {
+        // 压缩与否取决于Accept-Encoding，不同的编码不能共用条目
+        std::vector<std::string> &vary = microcache_options_->vary;
+        if (std::find(vary.begin(), vary.end(), "Accept-Encoding") == vary.end()) {
+            vary.push_back("Accept-Encoding");
+        }
+    }
     server_.start();
 }
 
+/**
+ * @brief 在每个IO线程启动时调用，线程池启动完成前所有loop都已登记
+ * @param loop
+ */
+void HttpServer::init_loop_state(EventLoop *loop) {
+    MutexLockGuard lock(loop_states_mutex_);
+    loop_states_[loop].reset(new LoopState(loop));
+    if (microcache_options_) {
+        loop_states_[loop]->microcache.reset(new MicroCache(*microcache_options_));
+    }
+}
+
+HttpServer::LoopState *HttpServer::loop_state(EventLoop *loop) {
+    auto it = loop_states_.find(loop);
+    assert(it != loop_states_.end());
+    return it->second.get();
+}
+
+/**
+ * @brief 请求可以使用微缓存时返回所在loop的缓存，并生成键
+ */
+MicroCache *HttpServer::microcache(EventLoop *loop, const HttpRequest &req, std::string *key) {
+    if (!microcache_options_) {
+        return nullptr;
+    }
+    MicroCache *cache = loop_state(loop)->microcache.get();
+    return cache->make_key(req, key) ? cache : nullptr;
+}
+
 /**
  * @brief 连接时回调
  * 
@@ -52,42 +177,814 @@ void HttpServer::start() {
  */
 void HttpServer::on_connetion(const TcpConnectionPtr &conn) {
     if (conn->connected()) {
-        conn->set_context(HttpContext());
+        conn->set_context(HttpSession());
+        conn->set_high_water_mark_callback(
+            std::bind(&HttpServer::on_high_water_mark, this, _1, _2), k_high_water_mark);
+        HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+        session->context()->set_limits(request_limits_);
+        // 建立连接之后迟迟不发请求的客户端同样受请求头时间限制
+        arm_header_timer(conn, session);
+    } else {
+        HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+        if (session) {
+            cancel_header_timer(conn, session);
+        }
+        if (session && session->websocket()) {
+            session->websocket()->on_disconnected();
+        }
+        if (session && session->proxy()) {
+            session->proxy()->on_client_closed();
+        }
+        if (session && session->streaming()) {
+            session->end_stream();
+        }
     }
 }
 
+/**
+ * @brief 一次读到的数据中可能包含多个流水线请求，循环解析直到没有完整请求
+ * 
+ * @param conn 
+ * @param buf 
+ * @param receive_time 
+ */
 void HttpServer::on_message(const TcpConnectionPtr &conn,
                             Buffer *buf,
                             Timestamp receive_time) {
-    HttpContext *context = boost::any_cast<HttpContext>(conn->get_mutable_context());
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    if (session->http2()) {
+        session->http2()->on_data(conn, buf, receive_time);
+        return;
+    }
+    if (session->proxy()) {
+        session->proxy()->on_client_data();
+        return;
+    }
+    if (session->closing()) {
+        // 不会再处理这个连接上的请求，丢弃之后的数据，输入缓冲不再增长
+        buf->retrieve_all();
+        return;
+    }
+    HttpContext *context = session->context();
+
+    while (conn->connected() && !session->closing()) {
+        // 以HTTP/2连接前言开头时按prior knowledge切换，前言不完整时等待更多数据
+        if (context->expect_request_line() && buf->readable_bytes() > 0 && *buf->peek() == 'P') {
+            size_t n = std::min(buf->readable_bytes(), http2::k_client_preface_length);
+            if (memcmp(buf->peek(), http2::k_client_preface, n) == 0) {
+                if (n == http2::k_client_preface_length) {
+                    start_http2(conn, session);
+                    session->http2()->start(conn);
+                    session->http2()->on_data(conn, buf, receive_time);
+                }
+                break;
+            }
+        }
+        if (!context->parse_request(buf, receive_time)) {
+            int status = HttpResponse::k_400_bad_request;
+            if (context->error() == HttpContext::k_request_line_too_long) {
+                status = HttpResponse::k_414_uri_too_long;
+            } else if (context->error() == HttpContext::k_header_too_large) {
+                status = HttpResponse::k_431_request_header_fields_too_large;
+            }
+            reject_request(conn, session, status);
+            break;
+        }
+        if (!context->got_all()) {
+            break;
+        }
+        cancel_header_timer(conn, session);
+        BLOG_TRACE("HttpServer[{}] {} {} {}", conn->name(), context->request().method_string(),
+                   context->request().path(), buf->readable_bytes());
+        if (upgrade_websocket(conn, session, context->request())) {
+            context->reset();
+            const std::shared_ptr<WebSocketConnection> &websocket = session->websocket();
+            if (websocket) {
+                // 握手请求之后已经到达的帧交给WebSocket；消息回调不能在自己执行期间被替换，
+                // 放到本轮事件处理之后，在这之前这个连接不会再有新的数据
+                websocket->on_data(conn, buf, receive_time);
+                conn->get_loop()->queue_in_loop([conn, websocket]() {
+                    conn->set_message_callback(std::bind(&WebSocketConnection::on_data, websocket, _1, _2, _3));
+                });
+            }
+            break;
+        }
+        if (upgrade_http2(conn, session, context->request())) {
+            context->reset();
+            session->http2()->on_data(conn, buf, receive_time);
+            break;
+        }
+        if (start_proxy(conn, session, context->request())) {
+            // 之后的数据是请求体，由代理转发
+            context->reset();
+            break;
+        }
+        if (worker_pool_) {
+            offload_request(conn, session, context->request());
+        } else if (session->streaming() || !session->backlog()->empty()) {
+            // 流式响应结束之前不能发送后续响应，请求先积压，并暂停读取
+            session->backlog()->push_back(context->request());
+            if (!session->paused()) {
+                session->set_paused(true);
+                conn->stop_read();
+            }
+        } else {
+            on_request(conn, session, context->request());
+        }
+        context->reset();
+    }
+    // 请求头还不完整时开始计时，从请求开始计算，之后陆续到达的数据不会延长期限
+    if (conn->connected() && !session->closing() && !session->http2() && !session->proxy() &&
+        !session->websocket() && (buf->readable_bytes() > 0 || !context->expect_request_line())) {
+        arm_header_timer(conn, session);
+    }
+}
 
-    if (!context->parse_request(buf, receive_time)) {
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+/**
+ * @brief 请求行或首部无效、超过限制或者超时，返回错误并关闭连接
+ * 已经读到的数据立即丢弃并释放缓冲，之后到达的数据也直接丢弃
+ */
+void HttpServer::reject_request(const TcpConnectionPtr &conn, HttpSession *session, int status) {
+    const char *status_line = "HTTP/1.1 400 Bad Request\r\n";
+    if (status == HttpResponse::k_408_request_timeout) {
+        status_line = "HTTP/1.1 408 Request Timeout\r\n";
+    } else if (status == HttpResponse::k_414_uri_too_long) {
+        status_line = "HTTP/1.1 414 URI Too Long\r\n";
+    } else if (status == HttpResponse::k_431_request_header_fields_too_large) {
+        status_line = "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+    }
+    LOG_DEBUG << "HttpServer::reject_request [" << conn->name() << "] " << status;
+    cancel_header_timer(conn, session);
+    session->set_closing();
+    session->context()->reset();
+    Buffer *input = conn->input_buffer();
+    input->retrieve_all();
+    input->shrink(0);
+    conn->send(std::string(status_line) + "Connection: close\r\nContent-Length: 0\r\n\r\n");
+    conn->shutdown();
+}
+
+void HttpServer::arm_header_timer(const TcpConnectionPtr &conn, HttpSession *session) {
+    double timeout = request_limits_.header_timeout;
+    if (timeout <= 0 || session->header_timer_armed()) {
+        return;
+    }
+    std::weak_ptr<TcpConnection> weak(conn);
+    session->set_header_timer(
+        conn->get_loop()->run_after(timeout, std::bind(&HttpServer::on_header_timeout, this, weak)));
+}
+
+void HttpServer::cancel_header_timer(const TcpConnectionPtr &conn, HttpSession *session) {
+    if (session->header_timer_armed()) {
+        conn->get_loop()->cancel(session->take_header_timer());
+    }
+}
+
+void HttpServer::on_header_timeout(const std::weak_ptr<TcpConnection> &weak) {
+    TcpConnectionPtr conn = weak.lock();
+    if (!conn || !conn->connected()) {
+        return;
+    }
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    session->take_header_timer();
+    if (session->closing() || session->http2() || session->proxy() || session->websocket()) {
+        return;
+    }
+    if (session->paused() || session->write_blocked()) {
+        // 是服务器自己暂停了读取，不能算作客户端发送太慢
+        arm_header_timer(conn, session);
+        return;
+    }
+    reject_request(conn, session, HttpResponse::k_408_request_timeout);
+}
+
+/**
+ * @brief 处理WebSocket升级请求，只在连接上没有未完成的响应时升级
+ * @return true 请求已经处理：握手成功，或者握手失败、已经发出错误响应并关闭连接
+ */
+bool HttpServer::upgrade_websocket(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req) {
+    if (!websocket_handler_ || !websocket::is_upgrade_request(req) ||
+        (websocket_handler_->accept && !websocket_handler_->accept(req)) ||
+        session->has_outstanding() || session->streaming() || !session->backlog()->empty()) {
+        return false;
+    }
+    Buffer response;
+    if (!websocket::handshake(req, &response)) {
+        session->set_closing();
+        conn->send(response.peek(), response.readable_bytes());
         conn->shutdown();
+        return true;
     }
+    conn->send(response.peek(), response.readable_bytes());
+    // WebSocket上多是小消息，不等待合并
+    conn->set_tcp_no_delay(true);
+    std::shared_ptr<WebSocketConnection> websocket =
+        std::make_shared<WebSocketConnection>(conn, websocket_handler_.get(), websocket_options_.get());
+    session->set_websocket(websocket);
+    websocket->start(req);
+    return true;
+}
 
-    if (context->got_all()) {
-        on_request(conn, context->request());
-        context->reset();
+void HttpServer::start_http2(const TcpConnectionPtr &conn, HttpSession *session) {
+    cancel_header_timer(conn, session);
+    session->set_http2(std::make_shared<Http2Connection>(
+        std::bind(&HttpServer::on_http2_request, this, _1, _2, _3)));
+    // HTTP/2的DATA按批发送，每批写完之后继续
+    conn->set_write_complete_callback(std::bind(&HttpServer::on_write_complete, this, _1));
+}
+
+/**
+ * @brief 处理"Upgrade: h2c"，只在连接上没有未完成的响应时升级，升级请求的响应通过HTTP/2在流1上发送
+ * @return false 不是升级请求或者不能升级，按HTTP/1.1处理
+ */
+bool HttpServer::upgrade_http2(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req) {
+    if (!header_has_token(req.get_header("Upgrade"), "h2c") ||
+        !header_has_token(req.get_header("Connection"), "Upgrade") ||
+        (req.method() != HttpRequest::k_get && req.method() != HttpRequest::k_head)) {
+        return false;
+    }
+    const std::string *settings = req.find_header("HTTP2-Settings");
+    if (!settings || session->has_outstanding() || session->streaming() ||
+        !session->backlog()->empty()) {
+        return false;
     }
+    start_http2(conn, session);
+    if (!session->http2()->start_upgrade(conn, *settings, req)) {
+        session->set_http2(std::shared_ptr<Http2Connection>());
+        conn->set_write_complete_callback(WriteCompleteCallback());
+        return false;
+    }
+    return true;
 }
 
-void HttpServer::on_request(const TcpConnectionPtr & conn,
-                            const HttpRequest &req) {
+/**
+ * @brief 请求匹配代理路由时交给ProxyExchange
+ * 连接上还有未发送的响应时先暂停读取，等它们发完再开始转发，保证响应顺序
+ * @return false 没有匹配的路由
+ */
+bool HttpServer::start_proxy(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req) {
+    size_t index = proxy_routes_.size();
+    for (size_t i = 0; i < proxy_routes_.size(); ++i) {
+        if (proxy_routes_[i]->match(req.path()) &&
+            (index == proxy_routes_.size() || proxy_routes_[i]->prefix.size() > proxy_routes_[index]->prefix.size())) {
+            index = i;
+        }
+    }
+    if (index == proxy_routes_.size()) {
+        return false;
+    }
+    LoopState *state = loop_state(conn->get_loop());
+    if (state->proxy_pools.empty()) {
+        state->proxy_pools.resize(proxy_routes_.size());
+    }
+    std::unique_ptr<UpstreamPool> &pool = state->proxy_pools[index];
+    if (!pool) {
+        pool.reset(new UpstreamPool(conn->get_loop(), proxy_routes_[index].get(),
+                                    server_.name() + "Upstream:" + proxy_routes_[index]->upstream.to_IP_port()));
+    }
+    session->set_proxy(std::make_shared<ProxyExchange>(
+        conn, req, pool.get(), std::bind(&HttpServer::finish_proxy, this, _1, _2)));
+    session->set_paused(true);
+    conn->stop_read();
+    resume_proxy(session);
+    return true;
+}
+
+/**
+ * @brief 连接上之前的响应都已发出时开始转发
+ */
+void HttpServer::resume_proxy(HttpSession *session) {
+    if (session->proxy() && !session->closing() && !session->has_outstanding() &&
+        !session->streaming() && session->backlog()->empty()) {
+        session->proxy()->start();
+    }
+}
+
+/**
+ * @brief 转发结束，恢复读取并解析之后已经到达的请求
+ */
+void HttpServer::finish_proxy(const TcpConnectionPtr &conn, bool close) {
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    session->set_proxy(std::shared_ptr<ProxyExchange>());
+    if (close) {
+        session->set_closing();
+        conn->shutdown();
+        return;
+    }
+    session->set_paused(false);
+    if (!session->write_blocked()) {
+        conn->start_read();
+    }
+    if (conn->input_buffer()->readable_bytes() > 0) {
+        on_message(conn, conn->input_buffer(), Timestamp::now());
+    }
+}
+
+/**
+ * @brief 在各自的loop线程中关闭上游连接池，之后客户端连接断开时交换不再访问连接池
+ * 析构时IO线程还在运行，base loop的状态在当前线程中处理
+ */
+void HttpServer::shutdown_proxy() {
+    if (proxy_routes_.empty()) {
+        return;
+    }
+    for (auto &item : loop_states_) {
+        LoopState *state = item.second.get();
+        auto shutdown = [state]() {
+            for (std::unique_ptr<UpstreamPool> &pool : state->proxy_pools) {
+                if (pool) {
+                    pool->shutdown();
+                }
+            }
+        };
+        if (state->loop->is_in_loop_thread()) {
+            shutdown();
+        } else {
+            CountDownLatch latch(1);
+            state->loop->run_in_loop([&shutdown, &latch]() {
+                shutdown();
+                latch.count_down();
+            });
+            latch.wait();
+        }
+    }
+}
+
+/**
+ * @brief HTTP/2连接上的一个请求
+ * 卸载模式下直接派发，不进入积压队列：每个连接同时处理的流已经被SETTINGS_MAX_CONCURRENT_STREAMS限制
+ */
+void HttpServer::on_http2_request(const TcpConnectionPtr &conn, uint32_t stream_id, const HttpRequest &req) {
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    if (worker_pool_) {
+        dispatch(conn, session, req, stream_id);
+        return;
+    }
+    HttpResponse response(false);
+    response.set_head_only(req.method() == HttpRequest::k_head);
+    handle_request(req, &response);
+    session->http2()->send_response(conn, stream_id, response);
+}
+
+bool HttpServer::should_close(const HttpRequest &req) {
     const std::string &connection = req.get_header("Connection");
-    bool close = connection == "close" ||
+    return connection == "close" ||
         (req.get_version() == HttpRequest::k_http10 && connection != "Keep-Alive");
-    HttpResponse response(close);
-    http_callback_(req, &response);
+}
+
+void HttpServer::on_request(const TcpConnectionPtr & conn,
+                            HttpSession *session,
+                            const HttpRequest &req) {
+    HttpResponse response(should_close(req));
+    response.set_head_only(req.method() == HttpRequest::k_head);
+    std::string key;
+    MicroCache *cache = microcache(conn->get_loop(), req, &key);
+    if (cache) {
+        response.set_cached(cache->get(key, Timestamp::now()));
+    }
+    if (!response.cached()) {
+        handle_request(req, &response);
+        // 回调在loop线程中同步执行，同一个loop上不会有并发的未命中；HEAD的回调可能没有生成响应体，不用来填充
+        if (cache && req.method() == HttpRequest::k_get && response.close_connection() == should_close(req)) {
+            response.set_cached(cache->put(key, response, Timestamp::now()));
+        }
+    }
+    send_response(conn, session, response);
+}
+
+/**
+ * @brief 执行回调，再按条件首部和Range改写响应，304、206和416都在这里产生，最后压缩
+ * 压缩与否在条件请求之前决定，ETag先换成压缩版本的，304不需要真正压缩；
+ * 卸载模式下在计算线程中执行
+ */
+void HttpServer::handle_request(const HttpRequest &req, HttpResponse *resp) const {
+    http_callback_(req, resp);
+    ContentCoding coding = compressor_ ? compressor_->prepare(req, resp) : k_identity;
+    evaluate_conditional(req, resp);
+    if (coding != k_identity && resp->status_code() == HttpResponse::k_200_ok) {
+        compressor_->encode(coding, req, resp);
+    }
+    // HTTP/1.0客户端不认识chunked，长度未知的流式响应（包括压缩后的）只能以关闭连接表示结束
+    if (req.get_version() == HttpRequest::k_http10 && resp->streaming() && resp->content_length() < 0) {
+        resp->set_close_connection(true);
+    }
+}
+
+void HttpServer::send_response(const TcpConnectionPtr &conn,
+                               HttpSession *session,
+                               const HttpResponse &response) {
+    if (response.cached()) {
+        send_cached(conn, response);
+        if (response.close_connection()) {
+            conn->shutdown();
+        }
+        return;
+    }
     Buffer buf;
     response.append_to_buffer(&buf);
-    conn->send(buf.to_string());
+    conn->send(buf.peek(), buf.readable_bytes());
 
+    // HEAD只有响应头
+    if (response.streaming() && !response.head_only()) {
+        // 响应体在每次写完成之后按批生产，直到结束才处理连接上的下一个响应
+        session->start_stream(response);
+        conn->set_write_complete_callback(std::bind(&HttpServer::on_write_complete, this, _1));
+        pump_stream(conn, session);
+        return;
+    }
+    if (response.has_file_body() && !response.head_only()) {
+        if (response.file_parts().empty()) {
+            conn->send_file(response.file_fd(), response.file_offset(),
+                            static_cast<size_t>(response.content_length()), response.file_holder());
+        } else {
+            // 多区间响应：分隔头和文件区间交替发送，TcpConnection保证按顺序写出
+            for (const HttpResponse::FilePart &part : response.file_parts()) {
+                conn->send(part.header.data(), part.header.size());
+                conn->send_file(response.file_fd(), part.offset, part.length, response.file_holder());
+            }
+            conn->send(response.file_parts_tail().data(), response.file_parts_tail().size());
+        }
+    }
     if (response.close_connection()) {
         conn->shutdown();
     }
 }
 
+/**
+ * @brief 发送微缓存中的报文，keep-alive的完整响应不需要任何改写
+ */
+void HttpServer::send_cached(const TcpConnectionPtr &conn, const HttpResponse &response) {
+    const CachedResponse &cached = *response.cached();
+    size_t len = response.head_only() ? cached.head_length : cached.data.size();
+    if (!response.close_connection()) {
+        conn->send(cached.data.data(), len);
+        return;
+    }
+    std::string data;
+    data.reserve(len);
+    data.append(cached.data, 0, cached.connection_offset);
+    data.append("Connection: close\r\n");
+    data.append(cached.data, cached.connection_end, len - cached.connection_end);
+    conn->send(data);
+}
+
+/**
+ * @brief 卸载模式下按请求顺序发送已完成的响应，遇到流式响应时停下
+ */
+void HttpServer::send_ready(const TcpConnectionPtr &conn, HttpSession *session) {
+    HttpResponse response(false);
+    while (!session->closing() && !session->streaming() && session->pop_ready(&response)) {
+        send_response(conn, session, response);
+        if (response.close_connection() && !response.streaming()) {
+            session->set_closing();
+        }
+    }
+    resume_proxy(session);
+}
+
+/**
+ * @brief 生产一批流式响应体并发送
+ * 一批数据只调用一次send，写完之后触发一次写完成回调，再生产下一批，
+ * 因此连接上待发送的流式数据不会超过一批
+ */
+void HttpServer::pump_stream(const TcpConnectionPtr &conn, HttpSession *session) {
+    if (!session->streaming() || session->write_blocked() || !conn->connected()) {
+        return;
+    }
+    Buffer batch;
+    Buffer piece;
+    bool more = true;
+    bool produced = true;
+    while (more && produced && batch.readable_bytes() < k_stream_batch_size) {
+        more = session->stream()(&piece);
+        size_t len = piece.readable_bytes();
+        produced = len > 0;
+        if (!produced) {
+            continue;
+        }
+        if (session->stream_chunked()) {
+            char size_line[32];
+            size_t n = number_format::format_hex(size_line, len);
+            size_line[n++] = '\r';
+            size_line[n++] = '\n';
+            batch.append(size_line, n);
+            batch.append(piece.peek(), len);
+            batch.append("\r\n", 2);
+        } else {
+            int64_t remaining = session->stream_remaining();
+            if (remaining >= 0) {
+                if (static_cast<int64_t>(len) > remaining) {
+                    LOG_ERROR << "HttpServer::pump_stream [" << conn->name()
+                              << "] body stream exceeds Content-Length by " << static_cast<int64_t>(len) - remaining;
+                    len = static_cast<size_t>(remaining);
+                    more = false;
+                }
+                session->set_stream_remaining(remaining - static_cast<int64_t>(len));
+            }
+            batch.append(piece.peek(), len);
+        }
+        piece.retrieve_all();
+    }
+
+    if (!more) {
+        if (session->stream_chunked()) {
+            batch.append("0\r\n\r\n", 5);
+        } else if (session->stream_remaining() > 0) {
+            // 声明的长度没有给够，对端无法判断响应边界，只能关闭连接
+            LOG_ERROR << "HttpServer::pump_stream [" << conn->name() << "] body stream ended "
+                      << session->stream_remaining() << " bytes short of Content-Length";
+            session->set_stream_remaining(0);
+            session->set_closing();
+        }
+    }
+    if (batch.readable_bytes() > 0) {
+        conn->send(batch.peek(), batch.readable_bytes());
+    }
+    if (!more) {
+        finish_stream(conn, session);
+    } else if (batch.readable_bytes() == 0) {
+        // 生产者暂时没有数据，没有写完成可以等，由生产者唤醒或者稍后重试
+        std::weak_ptr<TcpConnection> weak_conn(conn);
+        StreamSignal::schedule(conn->get_loop(), session->stream_signal(), [this, weak_conn]() {
+            TcpConnectionPtr guard = weak_conn.lock();
+            if (guard) {
+                on_write_complete(guard);
+            }
+        });
+    }
+}
+
+void HttpServer::finish_stream(const TcpConnectionPtr &conn, HttpSession *session) {
+    bool close = session->stream_close() || session->closing();
+    session->end_stream();
+    if (!session->write_blocked()) {
+        conn->set_write_complete_callback(WriteCompleteCallback());
+    }
+    if (close) {
+        session->set_closing();
+        conn->shutdown();
+        return;
+    }
+
+    if (worker_pool_) {
+        send_ready(conn, session);
+        return;
+    }
+    // 依次处理流式响应期间积压的请求，其中又有流式响应时等它结束再继续
+    std::deque<HttpRequest> *backlog = session->backlog();
+    while (!backlog->empty() && !session->streaming() && !session->closing() && conn->connected()) {
+        HttpRequest req;
+        req.swap(backlog->front());
+        backlog->pop_front();
+        on_request(conn, session, req);
+    }
+    if (session->proxy()) {
+        resume_proxy(session);
+        return;
+    }
+    if (backlog->empty() && session->paused() && !session->closing()) {
+        session->set_paused(false);
+        if (!session->write_blocked()) {
+            conn->start_read();
+        }
+    }
+}
+
+/**
+ * @brief 输出缓冲写完，解除高水位造成的暂停，继续生产流式响应
+ */
+void HttpServer::on_write_complete(const TcpConnectionPtr &conn) {
+    if (conn->disconnected()) {
+        return;
+    }
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    if (session->write_blocked()) {
+        session->set_write_blocked(false);
+        if (!session->paused() && !session->closing()) {
+            conn->start_read();
+        }
+        if (session->proxy()) {
+            session->proxy()->on_client_writable();
+        }
+    }
+    if (session->http2()) {
+        session->http2()->on_write_complete(conn);
+    } else if (session->streaming()) {
+        pump_stream(conn, session);
+    } else {
+        conn->set_write_complete_callback(WriteCompleteCallback());
+    }
+}
+
+/**
+ * @brief 对端读得慢，输出缓冲积压过多时暂停读取新请求，直到写完
+ */
+void HttpServer::on_high_water_mark(const TcpConnectionPtr &conn, size_t len) {
+    if (!conn->connected()) {
+        return;
+    }
+    LOG_DEBUG << "HttpServer::on_high_water_mark [" << conn->name() << "] " << len << " bytes pending";
+    HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+    session->set_write_blocked(true);
+    conn->stop_read();
+    if (session->proxy()) {
+        session->proxy()->on_client_blocked();
+    }
+    conn->set_write_complete_callback(std::bind(&HttpServer::on_write_complete, this, _1));
+    if (!conn->write_pending()) {
+        on_write_complete(conn);
+    }
+}
+
+/**
+ * @brief 卸载模式下处理一个解析完成的请求
+ * 线程池已满或者该连接已有积压请求时，请求进入积压队列并暂停读取该连接
+ * @param conn 
+ * @param session 
+ * @param req 
+ */
+void HttpServer::offload_request(const TcpConnectionPtr &conn,
+                                 HttpSession *session,
+                                 const HttpRequest &req) {
+    if (session->paused() || pending_requests_.load() >= max_pending_requests_) {
+        session->backlog()->push_back(req);
+        if (!session->paused()) {
+            LoopState *state = loop_state(conn->get_loop());
+            session->set_paused(true);
+            conn->stop_read();
+            state->paused.push_back(conn);
+            state->has_paused = true;
+        }
+        return;
+    }
+    dispatch(conn, session, req);
+}
+
+/**
+ * @brief 卸载模式下派发一个请求
+ * 微缓存命中时直接按顺序发送，同一个键上已经有请求在执行回调时等待它的结果，都不占用计算线程
+ */
+void HttpServer::dispatch(const TcpConnectionPtr &conn,
+                          HttpSession *session,
+                          const HttpRequest &req,
+                          uint32_t stream_id) {
+    LoopState *state = loop_state(conn->get_loop());
+    // HTTP/2的响应按流发送，不需要排序
+    uint64_t seq = stream_id == 0 ? session->next_sequence() : 0;
+    std::string key;
+    MicroCache *cache = stream_id == 0 ? microcache(conn->get_loop(), req, &key) : nullptr;
+    if (cache) {
+        HttpResponse response(should_close(req));
+        response.set_head_only(req.method() == HttpRequest::k_head);
+        response.set_cached(cache->get(key, Timestamp::now()));
+        if (response.cached()) {
+            session->add_ready(seq, response);
+            send_ready(conn, session);
+            return;
+        }
+        if (req.method() != HttpRequest::k_get) {
+            key.clear();
+        } else if (cache->wait_fill(key, MicroCache::Waiter{conn, seq, req})) {
+            return;
+        }
+    }
+    run_handler(state, conn, seq, stream_id, req, key);
+}
+
+/**
+ * @brief 把请求交给计算线程执行回调，cache_key非空时结果用来填充微缓存
+ */
+void HttpServer::run_handler(LoopState *state,
+                             const std::weak_ptr<TcpConnection> &weak_conn,
+                             uint64_t seq,
+                             uint32_t stream_id,
+                             const HttpRequest &req,
+                             const std::string &cache_key) {
+    pending_requests_.fetch_add(1);
+    worker_pool_->run(Task([this, state, weak_conn, seq, stream_id, req, cache_key]() {
+        LoopState::Completion completion = {weak_conn, seq, stream_id, HttpResponse(should_close(req)), cache_key, false};
+        completion.response.set_head_only(req.method() == HttpRequest::k_head);
+        handle_request(req, &completion.response);
+        completion.cacheable = completion.response.close_connection() == should_close(req);
+        bool was_empty = false;
+        {
+        MutexLockGuard lock(state->mutex);
+        was_empty = state->completions.empty();
+        state->completions.push_back(completion);
+        }
+        if (was_empty) {
+            state->loop->queue_in_loop(std::bind(&HttpServer::handle_completions, this, state));
+        }
+    }));
+}
+
+/**
+ * @brief 在loop线程中批量处理完成的响应，按每个连接的请求顺序发送
+ * 处理完之后线程池有了空位，恢复被暂停的连接
+ * @param state 
+ */
+void HttpServer::handle_completions(LoopState *state) {
+    state->loop->assert_in_loop_thread();
+    std::vector<LoopState::Completion> completions;
+    {
+    MutexLockGuard lock(state->mutex);
+    completions.swap(state->completions);
+    }
+    for (LoopState::Completion &completion : completions) {
+        pending_requests_.fetch_sub(1);
+        if (!completion.cache_key.empty()) {
+            // 发起填充的连接断开了也要唤醒等待者
+            finish_fill(state, &completion.response, completion.cache_key, completion.cacheable);
+        }
+        TcpConnectionPtr conn = completion.conn.lock();
+        if (!conn || conn->disconnected()) {
+            continue;
+        }
+        HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+        if (session->http2()) {
+            session->http2()->send_response(conn, completion.stream_id, completion.response);
+            continue;
+        }
+        if (session->closing()) {
+            continue;
+        }
+        session->add_ready(completion.seq, completion.response);
+        send_ready(conn, session);
+    }
+
+    resume_paused(state);
+    if (pending_requests_.load() < max_pending_requests_) {
+        for (auto &item : loop_states_) {
+            LoopState *other = item.second.get();
+            if (other != state && other->has_paused.load()) {
+                other->loop->queue_in_loop(std::bind(&HttpServer::resume_paused, this, other));
+            }
+        }
+    }
+}
+
+/**
+ * @brief 填充完成，结果放入缓存并发给等待者；结果不能缓存时等待者各自执行回调
+ */
+void HttpServer::finish_fill(LoopState *state, HttpResponse *response, const std::string &key, bool cacheable) {
+    MicroCache *cache = state->microcache.get();
+    MicroCache::EntryPtr entry;
+    if (cacheable) {
+        entry = cache->put(key, *response, Timestamp::now());
+        response->set_cached(entry);
+    }
+    for (const MicroCache::Waiter &waiter : cache->finish_fill(key)) {
+        TcpConnectionPtr conn = waiter.conn.lock();
+        if (!conn || conn->disconnected()) {
+            continue;
+        }
+        HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+        if (session->closing()) {
+            continue;
+        }
+        if (!entry) {
+            run_handler(state, waiter.conn, waiter.seq, 0, waiter.req, std::string());
+            continue;
+        }
+        HttpResponse ready(should_close(waiter.req));
+        ready.set_cached(entry);
+        session->add_ready(waiter.seq, ready);
+        send_ready(conn, session);
+    }
+}
+
+void HttpServer::resume_paused(LoopState *state) {
+    state->loop->assert_in_loop_thread();
+    while (!state->paused.empty() && pending_requests_.load() < max_pending_requests_) {
+        TcpConnectionPtr conn = state->paused.front().lock();
+        if (!conn || conn->disconnected()) {
+            state->paused.pop_front();
+            continue;
+        }
+        HttpSession *session = boost::any_cast<HttpSession>(conn->get_mutable_context());
+        std::deque<HttpRequest> *backlog = session->backlog();
+        while (!backlog->empty() && pending_requests_.load() < max_pending_requests_) {
+            // 命中微缓存的响应可能关闭连接，清空积压队列，先取出请求再派发
+            HttpRequest req;
+            req.swap(backlog->front());
+            backlog->pop_front();
+            dispatch(conn, session, req);
+        }
+        if (!backlog->empty()) {
+            break;
+        }
+        // 积压之后是被代理的请求时，由代理在转发结束后恢复读取
+        if (!session->proxy()) {
+            session->set_paused(false);
+            if (!session->write_blocked()) {
+                conn->start_read();
+            }
+        }
+        state->paused.pop_front();
+    }
+    state->has_paused = !state->paused.empty();
+}
+
 } // namespace http
 
-} // namespace web_server
\ No newline at end of file
+} // namespace web_server
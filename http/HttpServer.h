@@ -1,7 +1,7 @@
 /**
- * @brief 
+ * @brief
  * Copyright (c) 2021, David Shu. All rights reserved.
- * 
+ *
  * Use of this source code is governed by a GPL license
  * @author David Shu (a294562476@gmail.com)
  */
@@ -9,18 +9,35 @@
 #ifndef WEB_SERVER_HTTP_HTTPSERVER_H
 #define WEB_SERVER_HTTP_HTTPSERVER_H
 
+#include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include "base/Noncopyable.h"
+#include "base/Mutex.h"
+#include "http/HttpContext.h"
 #include "net/TcpServer.h"
 
 namespace web_server {
 
+class WorkStealingPool;
+
 namespace http {
 
 using namespace web_server::net;
 class HttpRequest;
 class HttpResponse;
+class HttpSession;
+class MicroCache;
+class ResponseCompressor;
+struct CompressionOptions;
+struct MicroCacheOptions;
+struct ProxyOptions;
+struct ProxyRoute;
+struct WebSocketHandler;
+struct WebSocketOptions;
 
 class HttpServer : private Noncopyable {
 public:
@@ -29,11 +46,19 @@ public:
                const InetAddress &listen_addr,
                const std::string &name,
                TcpServer::Option option = TcpServer::kNoReusePort);
-    
+    ~HttpServer();
+
     EventLoop *getloop() const {
         return server_.get_loop();
     }
 
+    /**
+     * @brief 设置请求回调
+     * HTTP/1.1和h2c（prior knowledge或Upgrade）的请求都交给同一个回调，
+     * HTTP/2连接上的多个流可以同时在处理中；
+     * 回调生成的GET和HEAD的200响应带有ETag或Last-Modified时，If-None-Match、If-Modified-Since、
+     * Range和If-Range由服务器统一处理，回调只需生成完整的响应
+     */
     void set_http_callback(const HttpCallback &cb) {
         http_callback_ = cb;
     }
@@ -42,21 +67,144 @@ public:
         server_.set_thread_num(num_threads);
     }
 
+    /**
+     * @brief 开启handler卸载模式，必须在start之前调用
+     * 解析完成的请求交给计算线程池执行http_callback，完成的响应批量投递回连接所属的loop，
+     * 同一连接上流水线请求的响应按请求顺序发送；
+     * 已派发但未完成的请求达到max_pending_requests时，暂停读取新请求的连接
+     * @param num_threads 计算线程数，为0表示关闭卸载模式
+     * @param max_pending_requests
+     */
+    void set_worker_thread_num(int num_threads, size_t max_pending_requests = 65536);
+
+    /**
+     * @brief 开启响应压缩，必须在start之前调用
+     * 按Accept-Encoding选择gzip或deflate，阈值可以用HttpResponse::set_compress_min_size按路由覆盖，
+     * 文件和带ETag的响应体的压缩结果会被缓存
+     */
+    void enable_compression(const CompressionOptions &options);
+
+    const ResponseCompressor *compressor() const {
+        return compressor_.get();
+    }
+
+    /**
+     * @brief 接受WebSocket升级，必须在start之前调用
+     * 握手成功后连接的消息回调换成WebSocket的帧解析，之后的消息和关闭都通过handler通知，
+     * 握手请求不会交给http回调；未设置时升级请求按普通请求处理
+     */
+    void set_websocket_handler(const WebSocketHandler &handler, const WebSocketOptions &options);
+
+    /**
+     * @brief 把路径以prefix开头的请求转发给upstream，必须在start之前调用
+     * 每个IO loop各自维护到上游的keep-alive连接池，请求体和响应体边读边转发；
+     * 多条路由匹配时取最长的前缀，转发的请求不再交给http回调；只代理HTTP/1.x连接上的请求
+     */
+    void add_proxy(const std::string &prefix, const InetAddress &upstream, const ProxyOptions &options);
+    void add_proxy(const std::string &prefix, const InetAddress &upstream);
+
+    /**
+     * @brief 设置请求行、首部的大小限制和接收请求头的时间限制，必须在start之前调用
+     * 超过限制时分别返回414、431和408并关闭连接，输入缓冲立即释放
+     */
+    void set_request_limits(const RequestLimits &limits) {
+        request_limits_ = limits;
+    }
+
+    /**
+     * @brief 开启响应微缓存，必须在start之前调用
+     * 每个IO loop各自缓存序列化好的200响应，命中时不再执行回调和序列化；
+     * 卸载模式下同一个键上并发的未命中只执行一次回调，其余请求等待它的结果。
+     * 只缓存HTTP/1.x连接上的GET和HEAD，回调可以用Cache-Control: no-store或private让响应不被缓存，
+     * 随Cookie等首部变化的响应必须这样标记，或者把首部加入MicroCacheOptions::vary
+     */
+    void enable_microcache(const MicroCacheOptions &options);
+
     void start();
 
+    /**
+     * @brief 见TcpServer::attach_connection，用于不经过内核socket测量HTTP协议栈，例如MemoryTransport
+     */
+    void attach_connection(std::unique_ptr<Transport> transport,
+                           const InetAddress &local_addr,
+                           const InetAddress &peer_addr) {
+        server_.attach_connection(std::move(transport), local_addr, peer_addr);
+    }
+
+    /**
+     * @brief 输出缓冲超过该值时暂停读取连接上的新请求，写完后恢复
+     */
+    static const size_t k_high_water_mark = 1024 * 1024;
+    /**
+     * @brief 流式响应每次写完成后最多生产的字节数，决定了每个连接上流式响应占用的内存
+     */
+    static const size_t k_stream_batch_size = 64 * 1024;
+
 private:
-    TcpServer server_;
+    struct LoopState;
+    using LoopStateMap = std::map<EventLoop *, std::unique_ptr<LoopState>>;
+
     HttpCallback http_callback_;
+    std::unique_ptr<ResponseCompressor> compressor_;
+    std::unique_ptr<WebSocketHandler> websocket_handler_;
+    std::unique_ptr<WebSocketOptions> websocket_options_;
+    std::unique_ptr<MicroCacheOptions> microcache_options_;
+    std::vector<std::unique_ptr<ProxyRoute>> proxy_routes_;
+    RequestLimits request_limits_;
+
+    // 卸载模式相关
+    int num_workers_;
+    size_t max_pending_requests_;
+    std::unique_ptr<WorkStealingPool> worker_pool_;
+    std::atomic<size_t> pending_requests_;
+    // 每个IO loop一份状态，start之后只读，不需要加锁
+    MutexLock loop_states_mutex_;
+    LoopStateMap loop_states_;
+    // 最后声明，最先析构：IO线程退出之前，它们队列中的回调用到的其余成员都还有效
+    TcpServer server_;
 
     void on_connetion(const TcpConnectionPtr &conn);
     void on_message(const TcpConnectionPtr &conn,
                     Buffer *buf,
                     Timestamp receive_time);
-    void on_request(const TcpConnectionPtr &, const HttpRequest &);
+    void on_request(const TcpConnectionPtr &, HttpSession *session, const HttpRequest &);
+    void reject_request(const TcpConnectionPtr &conn, HttpSession *session, int status);
+    void arm_header_timer(const TcpConnectionPtr &conn, HttpSession *session);
+    void cancel_header_timer(const TcpConnectionPtr &conn, HttpSession *session);
+    void on_header_timeout(const std::weak_ptr<TcpConnection> &weak);
+    bool upgrade_websocket(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req);
+    void start_http2(const TcpConnectionPtr &conn, HttpSession *session);
+    bool upgrade_http2(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req);
+    void on_http2_request(const TcpConnectionPtr &conn, uint32_t stream_id, const HttpRequest &req);
+    bool start_proxy(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req);
+    void resume_proxy(HttpSession *session);
+    void finish_proxy(const TcpConnectionPtr &conn, bool close);
+    void shutdown_proxy();
+    void on_write_complete(const TcpConnectionPtr &conn);
+    void on_high_water_mark(const TcpConnectionPtr &conn, size_t len);
+    void init_loop_state(EventLoop *loop);
+    LoopState *loop_state(EventLoop *loop);
+    MicroCache *microcache(EventLoop *loop, const HttpRequest &req, std::string *key);
+
+    static bool should_close(const HttpRequest &req);
+    void handle_request(const HttpRequest &req, HttpResponse *resp) const;
+    void send_response(const TcpConnectionPtr &conn, HttpSession *session, const HttpResponse &response);
+    void send_cached(const TcpConnectionPtr &conn, const HttpResponse &response);
+    void send_ready(const TcpConnectionPtr &conn, HttpSession *session);
+    void pump_stream(const TcpConnectionPtr &conn, HttpSession *session);
+    void finish_stream(const TcpConnectionPtr &conn, HttpSession *session);
+    void offload_request(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req);
+    void dispatch(const TcpConnectionPtr &conn, HttpSession *session, const HttpRequest &req,
+                  uint32_t stream_id = 0);
+    void run_handler(LoopState *state, const std::weak_ptr<TcpConnection> &weak_conn, uint64_t seq,
+                     uint32_t stream_id, const HttpRequest &req, const std::string &cache_key);
+    void handle_completions(LoopState *state);
+    void finish_fill(LoopState *state, HttpResponse *response, const std::string &key, bool cacheable);
+    void resume_paused(LoopState *state);
 };
 
 } // namespace http
 
 } // namespace web_server
 
-#endif // WEB_SERVER_HTTP_HTTPSERVER_H
\ No newline at end of file
+#endif // WEB_SERVER_HTTP_HTTPSERVER_H
@@ -0,0 +1,265 @@
+/**
+ * @brief
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_HTTPSESSION_H
+#define WEB_SERVER_HTTP_HTTPSESSION_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include "base/Copyable.h"
+#include "http/HttpContext.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/StreamSignal.h"
+#include "net/TimerID.h"
+
+namespace web_server {
+
+namespace http {
+
+class Http2Connection;
+class ProxyExchange;
+class WebSocketConnection;
+
+/**
+ * @brief 一个http连接上的全部状态，保存在TcpConnection的context中
+ * 除了请求解析器HttpContext之外，还负责在流水线请求被异步处理时保持响应顺序：
+ * 每个请求分配一个递增序号，处理完成的响应先按序号暂存，按顺序发送；
+ * 正在发送流式响应时，后续响应都要等它结束
+ */
+class HttpSession : public Copyable {
+public:
+    HttpSession()
+        : next_dispatch_seq_(0),
+          next_send_seq_(0),
+          paused_(false),
+          closing_(false),
+          stream_chunked_(false),
+          stream_close_(false),
+          stream_remaining_(-1),
+          write_blocked_(false),
+          header_timer_armed_(false) {}
+
+    HttpContext *context() {
+        return &context_;
+    }
+
+    /**
+     * @brief 为一个即将派发的请求分配序号
+     * @return uint64_t
+     */
+    uint64_t next_sequence() {
+        return next_dispatch_seq_++;
+    }
+
+    /**
+     * @brief 还有已派发但尚未发送响应的请求
+     * @return true
+     * @return false
+     */
+    bool has_outstanding() const {
+        return next_send_seq_ != next_dispatch_seq_;
+    }
+
+    /**
+     * @brief 暂存处理完成的响应
+     * @param seq
+     * @param response
+     */
+    void add_ready(uint64_t seq, const HttpResponse &response) {
+        ready_.insert(std::make_pair(seq, response));
+    }
+
+    /**
+     * @brief 取出下一个可以按顺序发送的响应
+     * @param response 传出参数
+     * @return true 取到了
+     * @return false 下一个序号的响应还未完成
+     */
+    bool pop_ready(HttpResponse *response) {
+        auto it = ready_.begin();
+        if (it == ready_.end() || it->first != next_send_seq_) {
+            return false;
+        }
+        *response = it->second;
+        ready_.erase(it);
+        ++next_send_seq_;
+        return true;
+    }
+
+    /**
+     * @brief 背压时已解析但还未派发的请求
+     */
+    std::deque<HttpRequest> *backlog() {
+        return &backlog_;
+    }
+
+    bool paused() const {
+        return paused_;
+    }
+
+    void set_paused(bool on) {
+        paused_ = on;
+    }
+
+    /**
+     * @brief 已经发送了Connection: close的响应，后续请求不再处理
+     */
+    bool closing() const {
+        return closing_;
+    }
+
+    void set_closing() {
+        closing_ = true;
+        ready_.clear();
+        backlog_.clear();
+    }
+
+    /**
+     * @brief 开始发送一个流式响应，响应头已经发出
+     * @param response
+     */
+    void start_stream(const HttpResponse &response) {
+        stream_ = response.body_stream();
+        stream_signal_ = response.stream_signal();
+        stream_chunked_ = response.chunked();
+        stream_close_ = response.close_connection();
+        stream_remaining_ = response.content_length();
+    }
+
+    void end_stream() {
+        stream_ = HttpResponse::BodyStream();
+        if (stream_signal_) {
+            stream_signal_->cancel();
+            stream_signal_.reset();
+        }
+        stream_remaining_ = -1;
+    }
+
+    bool streaming() const {
+        return static_cast<bool>(stream_);
+    }
+
+    HttpResponse::BodyStream &stream() {
+        return stream_;
+    }
+
+    const std::shared_ptr<StreamSignal> &stream_signal() const {
+        return stream_signal_;
+    }
+
+    bool stream_chunked() const {
+        return stream_chunked_;
+    }
+
+    bool stream_close() const {
+        return stream_close_;
+    }
+
+    /**
+     * @brief 长度已知的流式响应还剩多少字节，-1表示长度未知
+     */
+    int64_t stream_remaining() const {
+        return stream_remaining_;
+    }
+
+    void set_stream_remaining(int64_t remaining) {
+        stream_remaining_ = remaining;
+    }
+
+    /**
+     * @brief 输出缓冲超过高水位，等待写完之前不再读取新请求
+     */
+    bool write_blocked() const {
+        return write_blocked_;
+    }
+
+    void set_write_blocked(bool on) {
+        write_blocked_ = on;
+    }
+
+    /**
+     * @brief 等待完整请求头的定时器，连接建立或者读到不完整的请求时启动，请求头完整时取消
+     */
+    bool header_timer_armed() const {
+        return header_timer_armed_;
+    }
+
+    void set_header_timer(const net::TimerID &timer) {
+        header_timer_ = timer;
+        header_timer_armed_ = true;
+    }
+
+    net::TimerID take_header_timer() {
+        header_timer_armed_ = false;
+        return header_timer_;
+    }
+
+    /**
+     * @brief 连接已经切换到HTTP/2，之后的数据都交给它处理，以上HTTP/1.1的状态不再使用
+     */
+    Http2Connection *http2() const {
+        return http2_.get();
+    }
+
+    void set_http2(const std::shared_ptr<Http2Connection> &http2) {
+        http2_ = http2;
+    }
+
+    /**
+     * @brief 连接已经升级为WebSocket，消息回调已经换成它的帧解析，这里只用于通知连接断开
+     */
+    const std::shared_ptr<WebSocketConnection> &websocket() const {
+        return websocket_;
+    }
+
+    void set_websocket(const std::shared_ptr<WebSocketConnection> &websocket) {
+        websocket_ = websocket;
+    }
+
+    /**
+     * @brief 正在转发给上游的请求，期间连接上的数据都是它的请求体，后续请求等它结束再解析
+     */
+    const std::shared_ptr<ProxyExchange> &proxy() const {
+        return proxy_;
+    }
+
+    void set_proxy(const std::shared_ptr<ProxyExchange> &proxy) {
+        proxy_ = proxy;
+    }
+
+private:
+    HttpContext context_;
+    uint64_t next_dispatch_seq_;
+    uint64_t next_send_seq_;
+    std::map<uint64_t, HttpResponse> ready_;
+    std::deque<HttpRequest> backlog_;
+    bool paused_;
+    bool closing_;
+    // 流式响应相关
+    HttpResponse::BodyStream stream_;
+    std::shared_ptr<StreamSignal> stream_signal_;
+    bool stream_chunked_;
+    bool stream_close_;
+    int64_t stream_remaining_;
+    bool write_blocked_;
+    net::TimerID header_timer_;
+    bool header_timer_armed_;
+    std::shared_ptr<Http2Connection> http2_;
+    std::shared_ptr<WebSocketConnection> websocket_;
+    std::shared_ptr<ProxyExchange> proxy_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_HTTPSESSION_H
@@ -0,0 +1,201 @@
+/**
+ * @brief 动态响应的微缓存
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/MicroCache.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+
+#include "http/HttpResponse.h"
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+const char k_keep_alive[] = "Connection: Keep-Alive\r\n";
+
+/**
+ * @brief 依次取出逗号分隔的列表中的元素，去掉两边的空白
+ */
+std::vector<std::string> split_list(const std::string &value) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        size_t first = value.find_first_not_of(" \t", start);
+        size_t last = value.find_last_not_of(" \t", end == 0 ? 0 : end - 1);
+        if (first != std::string::npos && first < end && last != std::string::npos && last >= first) {
+            items.push_back(value.substr(first, last - first + 1));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+} // namespace
+
+MicroCache::MicroCache(const MicroCacheOptions &options)
+    : options_(options),
+      bytes_(0),
+      hits_(0),
+      misses_(0),
+      coalesced_(0) {
+}
+
+bool MicroCache::make_key(const HttpRequest &req, std::string *key) const {
+    if (req.method() != HttpRequest::k_get && req.method() != HttpRequest::k_head) {
+        return false;
+    }
+    // 带凭据的请求的响应是给特定用户的；条件请求和Range请求的结果由HttpServer按完整响应改写，不走缓存
+    static const std::string k_bypass[] = {
+        "Authorization", "If-None-Match", "If-Modified-Since", "If-Range", "Range"
+    };
+    for (const std::string &field : k_bypass) {
+        if (req.find_header(field)) {
+            return false;
+        }
+    }
+    if (options_.bypass_cookie && req.find_header("Cookie")) {
+        return false;
+    }
+    key->assign("GET ");
+    key->append(req.path());
+    key->append(req.query());
+    for (const std::string &field : options_.vary) {
+        // 首部值中不会出现换行，没有该首部和首部为空是同一个键
+        key->append("\n");
+        const std::string *value = req.find_header(field);
+        if (value) {
+            key->append(*value);
+        }
+    }
+    return true;
+}
+
+MicroCache::EntryPtr MicroCache::get(const std::string &key, Timestamp now) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++misses_;
+        return EntryPtr();
+    }
+    if (it->second->expires < now) {
+        erase(it->second);
+        ++misses_;
+        return EntryPtr();
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    ++hits_;
+    return it->second->value;
+}
+
+MicroCache::EntryPtr MicroCache::put(const std::string &key, const HttpResponse &resp, Timestamp now) {
+    if (!cacheable(resp)) {
+        return EntryPtr();
+    }
+    HttpResponse full(resp);
+    full.set_close_connection(false);
+    full.set_head_only(false);
+    Buffer buf;
+    full.append_to_buffer(&buf);
+    if (key.size() + buf.readable_bytes() > std::min(options_.max_entry_bytes, options_.max_bytes)) {
+        return EntryPtr();
+    }
+
+    std::shared_ptr<CachedResponse> entry = std::make_shared<CachedResponse>();
+    entry->data = buf.retrieve_all_as_string();
+    // 状态行之后先是Content-Length和Connection，然后才是回调设置的首部
+    entry->connection_offset = entry->data.find(k_keep_alive);
+    entry->connection_end = entry->connection_offset + sizeof k_keep_alive - 1;
+    entry->head_length = entry->data.find("\r\n\r\n") + 4;
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        erase(it->second);
+    }
+    lru_.push_front(Entry{key, entry, add_time(now, options_.ttl)});
+    index_[key] = lru_.begin();
+    bytes_ += key.size() + entry->data.size();
+    while (bytes_ > options_.max_bytes) {
+        erase(std::prev(lru_.end()));
+    }
+    return entry;
+}
+
+bool MicroCache::wait_fill(const std::string &key, const Waiter &waiter) {
+    auto it = fills_.find(key);
+    if (it == fills_.end()) {
+        fills_[key];
+        return false;
+    }
+    it->second.push_back(waiter);
+    ++coalesced_;
+    return true;
+}
+
+std::vector<MicroCache::Waiter> MicroCache::finish_fill(const std::string &key) {
+    std::vector<Waiter> waiters;
+    auto it = fills_.find(key);
+    if (it != fills_.end()) {
+        waiters.swap(it->second);
+        fills_.erase(it);
+    }
+    return waiters;
+}
+
+bool MicroCache::cacheable(const HttpResponse &resp) const {
+    if (resp.status_code() != HttpResponse::k_200_ok || resp.streaming() || resp.has_file_body()) {
+        return false;
+    }
+    const std::map<std::string, std::string> &headers = resp.headers();
+    if (headers.find("Set-Cookie") != headers.end()) {
+        return false;
+    }
+    auto it = headers.find("Cache-Control");
+    if (it != headers.end()) {
+        for (std::string directive : split_list(it->second)) {
+            std::transform(directive.begin(), directive.end(), directive.begin(), ::tolower);
+            if (directive == "no-store" || directive == "no-cache" || directive == "private" ||
+                directive.compare(0, 8, "private=") == 0 || directive.compare(0, 9, "no-cache=") == 0) {
+                return false;
+            }
+        }
+    }
+    // 响应随键以外的请求首部变化时，同一个键下会混入不同的版本
+    it = headers.find("Vary");
+    if (it != headers.end()) {
+        for (const std::string &field : split_list(it->second)) {
+            auto match = std::find_if(options_.vary.begin(), options_.vary.end(), [&field](const std::string &vary) {
+                return ::strcasecmp(vary.c_str(), field.c_str()) == 0;
+            });
+            if (match == options_.vary.end()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void MicroCache::erase(EntryList::iterator it) {
+    bytes_ -= it->key.size() + it->value->data.size();
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,153 @@
+/**
+ * @brief 动态响应的微缓存：每个IO loop一份，按字节数LRU淘汰，条目在TTL之后失效
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_MICROCACHE_H
+#define WEB_SERVER_HTTP_MICROCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "base/Timestamp.h"
+#include "http/HttpRequest.h"
+
+namespace web_server {
+
+namespace net {
+class TcpConnection;
+} // namespace net
+
+namespace http {
+
+class HttpResponse;
+
+struct MicroCacheOptions {
+    double ttl = 1.0;                           // 条目的有效期，秒
+    size_t max_bytes = 16 * 1024 * 1024;        // 每个IO loop上缓存的总字节数
+    size_t max_entry_bytes = 1024 * 1024;       // 序列化之后超过该大小的响应不缓存
+    std::vector<std::string> vary;              // 参与缓存键的请求首部，开启压缩时自动加上Accept-Encoding
+    bool bypass_cookie = true;                  // 带Cookie的请求不使用缓存，响应只取决于vary中的首部时可以关闭
+};
+
+/**
+ * @brief 序列化好的完整200响应，以keep-alive的形式保存
+ * 关闭连接的请求只替换Connection首部，HEAD请求只发送前head_length字节
+ */
+struct CachedResponse {
+    std::string data;
+    size_t connection_offset;                   // data中[connection_offset, connection_end)是Connection首部
+    size_t connection_end;
+    size_t head_length;                         // 响应头的长度，包括结尾的空行
+};
+
+/**
+ * @brief 一个IO loop上的响应缓存，只在所属loop线程中访问，不需要加锁
+ * 键由方法、路径、查询串和MicroCacheOptions::vary中的请求首部组成，HEAD和GET共用条目；
+ * 只有没有Authorization、Cookie、条件首部和Range的GET/HEAD请求使用缓存，首部名不区分大小写；
+ * 只有GET请求的响应会被放入缓存。
+ * 同一个键同时只有一个GET请求去执行回调（填充），其余的GET请求登记为等待者，填充完成后直接使用结果
+ */
+class MicroCache : private Noncopyable {
+public:
+    using EntryPtr = std::shared_ptr<const CachedResponse>;
+
+    /**
+     * @brief 等待填充结果的请求，填充失败时按原请求单独处理
+     */
+    struct Waiter {
+        std::weak_ptr<net::TcpConnection> conn;
+        uint64_t seq;
+        HttpRequest req;
+    };
+
+    explicit MicroCache(const MicroCacheOptions &options);
+
+    /**
+     * @brief 请求可以使用缓存时生成它的键
+     * @return false 请求不能使用缓存
+     */
+    bool make_key(const HttpRequest &req, std::string *key) const;
+
+    /**
+     * @brief 查找没有过期的条目，过期的条目顺便删除
+     */
+    EntryPtr get(const std::string &key, Timestamp now);
+
+    /**
+     * @brief 序列化响应并放入缓存，替换同一个键原有的条目
+     * 非200、流式、文件响应体、带Set-Cookie、Cache-Control为no-store/no-cache/private、
+     * Vary了键以外的首部或者太大的响应不缓存
+     * @return EntryPtr 放入的条目，不能缓存时为空
+     */
+    EntryPtr put(const std::string &key, const HttpResponse &resp, Timestamp now);
+
+    /**
+     * @brief 键上有填充正在进行时登记为等待者
+     * @return false 没有正在进行的填充，调用者成为填充者，之后必须调用finish_fill
+     */
+    bool wait_fill(const std::string &key, const Waiter &waiter);
+
+    /**
+     * @brief 填充结束，取出等待者
+     */
+    std::vector<Waiter> finish_fill(const std::string &key);
+
+    size_t bytes() const {
+        return bytes_;
+    }
+
+    size_t size() const {
+        return index_.size();
+    }
+
+    int64_t hits() const {
+        return hits_;
+    }
+
+    int64_t misses() const {
+        return misses_;
+    }
+
+    /**
+     * @brief 登记为等待者而没有执行回调的请求数
+     */
+    int64_t coalesced() const {
+        return coalesced_;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        EntryPtr value;
+        Timestamp expires;
+    };
+    using EntryList = std::list<Entry>;
+
+    bool cacheable(const HttpResponse &resp) const;
+    void erase(EntryList::iterator it);
+
+    const MicroCacheOptions options_;
+    EntryList lru_;                                                     // 最近使用的在前
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    std::unordered_map<std::string, std::vector<Waiter>> fills_;        // 正在进行的填充
+    size_t bytes_;
+    int64_t hits_;
+    int64_t misses_;
+    int64_t coalesced_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_MICROCACHE_H
@@ -0,0 +1,704 @@
+/**
+ * @brief 反向代理：把匹配路由的请求转发给上游http服务器，上游连接按IO loop分池复用
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/ReverseProxy.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+
+#include "base/Logging.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "net/EventLoop.h"
+#include "net/TcpConnection.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+/**
+ * @brief 逐跳首部只对一个连接有效，不能转发（RFC 7230第6.1节）
+ * Transfer-Encoding由转发时的分帧方式单独处理
+ */
+bool is_hop_by_hop(const std::string &field, const std::string &connection) {
+    static const char *const k_hop_by_hop[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Upgrade"
+    };
+    for (const char *name : k_hop_by_hop) {
+        if (strcasecmp(field.c_str(), name) == 0) {
+            return true;
+        }
+    }
+    // Connection中列出的首部也是逐跳的
+    return !connection.empty() && header_has_token(connection, field.c_str());
+}
+
+/**
+ * @brief 按Transfer-Encoding和Content-Length确定请求体的边界，都没有时没有请求体
+ */
+bool init_request_body(const HttpRequest &req, HttpBodyReader *body) {
+    std::string transfer_encoding = req.get_header("Transfer-Encoding");
+    if (!transfer_encoding.empty()) {
+        // 请求只能以chunked结尾，否则无法确定边界
+        if (!header_has_token(transfer_encoding, "chunked")) {
+            return false;
+        }
+        body->reset(HttpBodyReader::k_chunked);
+        return true;
+    }
+    std::string content_length = req.get_header("Content-Length");
+    if (content_length.empty()) {
+        body->reset(HttpBodyReader::k_none);
+        return true;
+    }
+    char *end = nullptr;
+    errno = 0;
+    long long length = strtoll(content_length.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || length < 0 || content_length[0] < '0' || content_length[0] > '9') {
+        return false;
+    }
+    body->reset(HttpBodyReader::k_length, static_cast<int64_t>(length));
+    return true;
+}
+
+} // namespace
+
+bool ProxyRoute::match(const std::string &path) const {
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    // "/api"匹配"/api"和"/api/users"，不匹配"/apix"
+    return path.size() == prefix.size() || prefix.empty() || prefix.back() == '/' || path[prefix.size()] == '/';
+}
+
+UpstreamPool::UpstreamPool(EventLoop *loop, const ProxyRoute *route, const std::string &name)
+    : loop_(loop),
+      route_(route),
+      name_(name),
+      next_id_(1),
+      connecting_(0),
+      shutdown_(false) {}
+
+UpstreamPool::~UpstreamPool() {
+    shutdown();
+}
+
+void UpstreamPool::acquire(const std::shared_ptr<ProxyExchange> &exchange) {
+    loop_->assert_in_loop_thread();
+    if (shutdown_) {
+        exchange->on_upstream_error(HttpResponse::k_502_bad_gateway);
+        return;
+    }
+    while (!idle_.empty()) {
+        ConnectionPtr upstream = idle_.back();
+        idle_.pop_back();
+        if (upstream->conn->connected()) {
+            upstream->exchange = exchange;
+            exchange->on_upstream(upstream);
+            return;
+        }
+        discard(upstream);
+    }
+    if (waiters_.size() >= route_->options.max_waiters) {
+        exchange->on_upstream_error(HttpResponse::k_503_service_unavailable);
+        return;
+    }
+    waiters_.push_back(exchange);
+    // 正在建立的连接足够分给等待者时不再新建
+    if (connecting_ < waiters_.size() && connections_.size() < route_->options.max_connections) {
+        open();
+    }
+}
+
+void UpstreamPool::release(const ConnectionPtr &upstream, bool reusable) {
+    loop_->assert_in_loop_thread();
+    upstream->exchange.reset();
+    if (!reusable || shutdown_ || !upstream->conn || !upstream->conn->connected()) {
+        discard(upstream);
+        return;
+    }
+    upstream->reused = true;
+    // 交换期间可能因为客户端背压暂停过读取，空闲时要继续读，才能发现上游关闭了连接
+    upstream->conn->start_read();
+    upstream->conn->set_write_complete_callback(net::WriteCompleteCallback());
+    offer(upstream);
+}
+
+void UpstreamPool::shutdown() {
+    if (shutdown_) {
+        return;
+    }
+    loop_->assert_in_loop_thread();
+    shutdown_ = true;
+    for (const std::weak_ptr<ProxyExchange> &weak : waiters_) {
+        std::shared_ptr<ProxyExchange> exchange = weak.lock();
+        if (exchange) {
+            exchange->abandon();
+        }
+    }
+    waiters_.clear();
+    idle_.clear();
+    std::set<ConnectionPtr> connections;
+    connections.swap(connections_);
+    for (const ConnectionPtr &upstream : connections) {
+        std::shared_ptr<ProxyExchange> exchange = upstream->exchange.lock();
+        if (exchange) {
+            exchange->abandon();
+        }
+        loop_->cancel(upstream->connect_timer);
+        net::release_tcp_client(&upstream->client);
+        if (upstream->conn) {
+            // loop可能马上退出，不能等force_close的回调，直接销毁连接
+            upstream->conn->connection_destroyed();
+        }
+    }
+}
+
+void UpstreamPool::open() {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%d", next_id_++);
+    ConnectionPtr upstream = std::make_shared<Connection>();
+    std::weak_ptr<Connection> weak(upstream);
+    upstream->client = std::make_shared<net::TcpClient>(loop_, route_->upstream, name_ + buf);
+    upstream->client->set_connection_callback(std::bind(&UpstreamPool::on_connection, this, weak, _1));
+    upstream->client->set_message_callback(std::bind(&UpstreamPool::on_message, this, weak, _1, _2));
+    upstream->client->set_connect_error_callback([this, weak](int) {
+        on_connect_error(weak, HttpResponse::k_502_bad_gateway);
+    });
+    upstream->connect_timer = loop_->run_after(route_->options.connect_timeout, [this, weak]() {
+        ConnectionPtr upstream = weak.lock();
+        if (upstream && !upstream->conn) {
+            LOG_WARN << "UpstreamPool[" << name_ << "] connect to "
+                     << route_->upstream.to_IP_port() << " timed out";
+            on_connect_error(weak, HttpResponse::k_504_gateway_timeout);
+        }
+    });
+    connections_.insert(upstream);
+    ++connecting_;
+    upstream->client->connect();
+}
+
+/**
+ * @brief 可用的连接先交给等待最久的交换，没有等待者时放入空闲列表
+ */
+void UpstreamPool::offer(const ConnectionPtr &upstream) {
+    while (!waiters_.empty()) {
+        std::shared_ptr<ProxyExchange> exchange = waiters_.front().lock();
+        waiters_.pop_front();
+        if (exchange && exchange->waiting()) {
+            upstream->exchange = exchange;
+            exchange->on_upstream(upstream);
+            return;
+        }
+    }
+    if (idle_.size() >= route_->options.max_idle) {
+        discard(upstream);
+        return;
+    }
+    idle_.push_back(upstream);
+}
+
+void UpstreamPool::discard(const ConnectionPtr &upstream) {
+    loop_->cancel(upstream->connect_timer);
+    connections_.erase(upstream);
+    auto it = std::find(idle_.begin(), idle_.end(), upstream);
+    if (it != idle_.end()) {
+        idle_.erase(it);
+    }
+    if (!upstream->conn) {
+        --connecting_;
+    }
+    net::release_tcp_client(&upstream->client);
+}
+
+void UpstreamPool::fail_waiters(int status) {
+    std::deque<std::weak_ptr<ProxyExchange>> waiters;
+    waiters.swap(waiters_);
+    for (const std::weak_ptr<ProxyExchange> &weak : waiters) {
+        std::shared_ptr<ProxyExchange> exchange = weak.lock();
+        if (exchange && exchange->waiting()) {
+            exchange->on_upstream_error(status);
+        }
+    }
+}
+
+void UpstreamPool::on_connection(const std::weak_ptr<Connection> &weak, const TcpConnectionPtr &conn) {
+    ConnectionPtr upstream = weak.lock();
+    if (!upstream || shutdown_) {
+        return;
+    }
+    if (conn->connected()) {
+        loop_->cancel(upstream->connect_timer);
+        --connecting_;
+        upstream->conn = conn;
+        conn->set_tcp_no_delay(true);
+        conn->set_high_water_mark_callback(std::bind(&UpstreamPool::on_high_water_mark, this, weak),
+                                           HttpServer::k_high_water_mark);
+        offer(upstream);
+        return;
+    }
+    // 上游关闭了连接，空闲的直接移除，正在使用的通知交换
+    connections_.erase(upstream);
+    auto it = std::find(idle_.begin(), idle_.end(), upstream);
+    if (it != idle_.end()) {
+        idle_.erase(it);
+    }
+    net::release_tcp_client(&upstream->client);
+    std::shared_ptr<ProxyExchange> exchange = upstream->exchange.lock();
+    upstream->exchange.reset();
+    if (exchange) {
+        exchange->on_upstream_closed();
+    }
+}
+
+void UpstreamPool::on_message(const std::weak_ptr<Connection> &weak, const TcpConnectionPtr &conn, Buffer *buf) {
+    ConnectionPtr upstream = weak.lock();
+    std::shared_ptr<ProxyExchange> exchange = upstream ? upstream->exchange.lock() : nullptr;
+    if (!exchange) {
+        // 空闲连接上不应该有数据，这个连接的状态已经无法确定
+        LOG_WARN << "UpstreamPool[" << name_ << "] unexpected " << buf->readable_bytes()
+                 << " bytes on idle connection " << conn->name();
+        buf->retrieve_all();
+        if (upstream) {
+            discard(upstream);
+        }
+        return;
+    }
+    exchange->on_upstream_message(buf);
+}
+
+void UpstreamPool::on_high_water_mark(const std::weak_ptr<Connection> &weak) {
+    ConnectionPtr upstream = weak.lock();
+    std::shared_ptr<ProxyExchange> exchange = upstream ? upstream->exchange.lock() : nullptr;
+    if (exchange) {
+        exchange->on_upstream_blocked();
+    }
+}
+
+/**
+ * @brief 连接失败时上游多半不可用，等待中的请求都立即失败，而不是排队等待重试
+ */
+void UpstreamPool::on_connect_error(const std::weak_ptr<Connection> &weak, int status) {
+    ConnectionPtr upstream = weak.lock();
+    if (!upstream || shutdown_ || connections_.erase(upstream) == 0) {
+        return;
+    }
+    LOG_WARN << "UpstreamPool[" << name_ << "] failed to connect to " << route_->upstream.to_IP_port();
+    loop_->cancel(upstream->connect_timer);
+    --connecting_;
+    net::release_tcp_client(&upstream->client);
+    fail_waiters(status);
+}
+
+ProxyExchange::ProxyExchange(const TcpConnectionPtr &client,
+                             const HttpRequest &req,
+                             UpstreamPool *pool,
+                             const FinishCallback &cb)
+    : client_(client),
+      loop_(client->get_loop()),
+      request_(req),
+      pool_(pool),
+      finish_callback_(cb),
+      state_(k_pending),
+      client_http11_(req.get_version() == HttpRequest::k_http11),
+      client_close_(false),
+      expect_continue_(false),
+      head_request_(req.method() == HttpRequest::k_head),
+      head_sent_(false),
+      response_started_(false),
+      dechunk_(false),
+      upstream_blocked_(false),
+      retried_(false) {
+    std::string connection = req.get_header("Connection");
+    client_close_ = header_has_token(connection, "close") ||
+        (!client_http11_ && !header_has_token(connection, "keep-alive"));
+}
+
+ProxyExchange::~ProxyExchange() {
+    assert(!upstream_);
+}
+
+void ProxyExchange::start() {
+    if (state_ != k_pending) {
+        return;
+    }
+    if (!init_request_body(request_, &request_body_)) {
+        fail(HttpResponse::k_400_bad_request, "Bad Request");
+        return;
+    }
+    expect_continue_ = request_body_.mode() != HttpBodyReader::k_none &&
+        header_has_token(request_.get_header("Expect"), "100-continue");
+    TcpConnectionPtr client = client_.lock();
+    if (!client) {
+        state_ = k_done;
+        return;
+    }
+    std::weak_ptr<ProxyExchange> weak(shared_from_this());
+    timer_ = loop_->run_after(pool_->route().options.response_timeout, [weak]() {
+        std::shared_ptr<ProxyExchange> self = weak.lock();
+        if (self) {
+            self->on_timeout();
+        }
+    });
+    state_ = k_waiting;
+    pool_->acquire(shared_from_this());
+}
+
+void ProxyExchange::on_upstream(const UpstreamPool::ConnectionPtr &upstream) {
+    state_ = k_forwarding;
+    upstream_ = upstream;
+    send_request_head();
+    if (expect_continue_) {
+        // Expect不转发，由代理直接让客户端发送请求体
+        TcpConnectionPtr client = client_.lock();
+        if (client) {
+            client->send("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        expect_continue_ = false;
+    }
+    forward_request_body();
+}
+
+/**
+ * @brief 请求行和首部按HTTP/1.1发往上游，请求体的分帧首部原样保留，
+ * 只有chunked请求体上多余的Content-Length被去掉
+ */
+void ProxyExchange::send_request_head() {
+    TcpConnectionPtr client = client_.lock();
+    std::string connection = request_.get_header("Connection");
+    Buffer head;
+    head.append(request_.method_string());
+    head.append(" ");
+    head.append(request_.path());
+    head.append(request_.query());
+    head.append(" HTTP/1.1\r\n");
+    bool has_host = false;
+    std::string forwarded_for;
+    for (const auto &header : request_.headers()) {
+        if (is_hop_by_hop(header.first, connection) || strcasecmp(header.first.c_str(), "Expect") == 0) {
+            continue;
+        }
+        // 同时带Transfer-Encoding时Content-Length无效，原样转发会让上游按另一种边界解析请求体
+        if (request_body_.mode() == HttpBodyReader::k_chunked &&
+            strcasecmp(header.first.c_str(), "Content-Length") == 0) {
+            continue;
+        }
+        if (strcasecmp(header.first.c_str(), "X-Forwarded-For") == 0) {
+            forwarded_for = header.second;
+            continue;
+        }
+        has_host = has_host || strcasecmp(header.first.c_str(), "Host") == 0;
+        head.append(header.first);
+        head.append(": ");
+        head.append(header.second);
+        head.append("\r\n");
+    }
+    if (!has_host) {
+        head.append("Host: " + pool_->route().upstream.to_IP_port() + "\r\n");
+    }
+    if (client) {
+        head.append("X-Forwarded-For: ");
+        if (!forwarded_for.empty()) {
+            head.append(forwarded_for + ", ");
+        }
+        head.append(client->peer_addr().to_IP());
+        head.append("\r\n");
+    }
+    head.append("\r\n");
+    upstream_->conn->send(head.peek(), head.readable_bytes());
+}
+
+/**
+ * @brief 把客户端输入缓冲中属于请求体的数据转发给上游，之后的数据属于下一个请求，留在缓冲中
+ */
+void ProxyExchange::forward_request_body() {
+    TcpConnectionPtr client = client_.lock();
+    if (!client || state_ != k_forwarding || request_body_.done()) {
+        return;
+    }
+    Buffer *buf = client->input_buffer();
+    if (buf->readable_bytes() > 0) {
+        size_t n = request_body_.feed(buf->peek(), buf->readable_bytes());
+        if (request_body_.error()) {
+            fail(HttpResponse::k_400_bad_request, "Bad Request");
+            return;
+        }
+        upstream_->conn->send(buf->peek(), n);
+        buf->retrieve(n);
+    }
+    if (request_body_.done()) {
+        // 请求发完之后不再读取客户端，流水线的后续请求等这个响应结束再解析
+        client->stop_read();
+    } else if (!upstream_blocked_) {
+        client->start_read();
+    }
+}
+
+void ProxyExchange::on_client_data() {
+    forward_request_body();
+}
+
+void ProxyExchange::on_upstream_blocked() {
+    TcpConnectionPtr client = client_.lock();
+    if (!client || state_ != k_forwarding) {
+        return;
+    }
+    upstream_blocked_ = true;
+    client->stop_read();
+    std::weak_ptr<ProxyExchange> weak(shared_from_this());
+    upstream_->conn->set_write_complete_callback([weak](const TcpConnectionPtr &conn) {
+        conn->set_write_complete_callback(net::WriteCompleteCallback());
+        std::shared_ptr<ProxyExchange> self = weak.lock();
+        if (self && self->upstream_blocked_) {
+            self->upstream_blocked_ = false;
+            self->forward_request_body();
+        }
+    });
+    if (!upstream_->conn->write_pending()) {
+        upstream_blocked_ = false;
+        upstream_->conn->set_write_complete_callback(net::WriteCompleteCallback());
+        forward_request_body();
+    }
+}
+
+void ProxyExchange::on_client_blocked() {
+    if (state_ == k_forwarding) {
+        upstream_->conn->stop_read();
+    }
+}
+
+void ProxyExchange::on_client_writable() {
+    if (state_ == k_forwarding) {
+        upstream_->conn->start_read();
+    }
+}
+
+void ProxyExchange::on_upstream_message(Buffer *buf) {
+    response_started_ = true;
+    while (!head_sent_) {
+        if (!response_.parse_head(buf)) {
+            fail(HttpResponse::k_502_bad_gateway, "Bad Gateway");
+            return;
+        }
+        if (!response_.head_done()) {
+            return;
+        }
+        // 1xx是中间响应，100 Continue已经由代理自己发过
+        if (response_.status_code() < 200) {
+            response_.reset();
+            continue;
+        }
+        if (!send_response_head()) {
+            return;
+        }
+    }
+    forward_response_body(buf);
+}
+
+/**
+ * @brief 改写并发送响应头，确定转发响应体的方式
+ * @return false 响应头无效，已经返回502
+ */
+bool ProxyExchange::send_response_head() {
+    if (!response_.init_body(head_request_, &response_body_)) {
+        fail(HttpResponse::k_502_bad_gateway, "Bad Gateway");
+        return false;
+    }
+    TcpConnectionPtr client = client_.lock();
+    if (!client) {
+        complete(false);
+        return false;
+    }
+    loop_->cancel(timer_);
+    if (response_body_.mode() == HttpBodyReader::k_until_close) {
+        client_close_ = true;
+    } else if (response_body_.mode() == HttpBodyReader::k_chunked && !client_http11_) {
+        dechunk_ = true;
+        client_close_ = true;
+    }
+    // 上游提前响应时请求体还没有读完，无法确定下一个请求从哪里开始
+    if (!request_body_.done()) {
+        client_close_ = true;
+    }
+
+    std::string connection = response_.get_header("Connection");
+    Buffer head;
+    char status[32];
+    int n = snprintf(status, sizeof status, "HTTP/1.1 %d ", response_.status_code());
+    head.append(status, static_cast<size_t>(n));
+    head.append(response_.status_message());
+    head.append("\r\n");
+    for (const HttpResponseParser::Header &header : response_.headers()) {
+        if (is_hop_by_hop(header.first, connection) ||
+            (dechunk_ && strcasecmp(header.first.c_str(), "Transfer-Encoding") == 0)) {
+            continue;
+        }
+        head.append(header.first);
+        head.append(": ");
+        head.append(header.second);
+        head.append("\r\n");
+    }
+    if (client_close_) {
+        head.append("Connection: close\r\n");
+    } else if (!client_http11_) {
+        head.append("Connection: Keep-Alive\r\n");
+    }
+    head.append("\r\n");
+    client->send(head.peek(), head.readable_bytes());
+    head_sent_ = true;
+    return true;
+}
+
+void ProxyExchange::forward_response_body(Buffer *buf) {
+    TcpConnectionPtr client = client_.lock();
+    if (!client) {
+        complete(false);
+        return;
+    }
+    if (buf->readable_bytes() > 0 && !response_body_.done()) {
+        size_t n = response_body_.feed(buf->peek(), buf->readable_bytes(), dechunk_ ? &decoded_ : nullptr);
+        if (response_body_.error()) {
+            LOG_WARN << "ProxyExchange [" << client->name() << "] invalid chunked response from upstream";
+            fail(HttpResponse::k_502_bad_gateway, "Bad Gateway");
+            return;
+        }
+        if (dechunk_) {
+            if (!decoded_.empty()) {
+                client->send(decoded_);
+                decoded_.clear();
+            }
+        } else {
+            client->send(buf->peek(), n);
+        }
+        buf->retrieve(n);
+    }
+    if (response_body_.done()) {
+        // 响应之后还有数据，上游连接的状态已经无法确定
+        bool reusable = buf->readable_bytes() == 0 && response_.keep_alive() && request_body_.done();
+        buf->retrieve_all();
+        complete(reusable);
+    }
+}
+
+void ProxyExchange::on_upstream_closed() {
+    if (state_ != k_forwarding) {
+        return;
+    }
+    UpstreamPool::ConnectionPtr upstream;
+    upstream.swap(upstream_);
+    if (head_sent_ && response_body_.mode() == HttpBodyReader::k_until_close) {
+        complete(false);
+        return;
+    }
+    // 复用的空闲连接可能刚被上游关闭，没有请求体、也没有收到响应时换一个连接重试一次
+    if (!response_started_ && upstream->reused && !retried_ &&
+        request_body_.mode() == HttpBodyReader::k_none) {
+        retried_ = true;
+        state_ = k_waiting;
+        pool_->acquire(shared_from_this());
+        return;
+    }
+    fail(HttpResponse::k_502_bad_gateway, "Bad Gateway");
+}
+
+void ProxyExchange::on_upstream_error(int status) {
+    if (state_ != k_waiting) {
+        return;
+    }
+    if (status == HttpResponse::k_504_gateway_timeout) {
+        fail(status, "Gateway Timeout");
+    } else if (status == HttpResponse::k_503_service_unavailable) {
+        fail(status, "Service Unavailable");
+    } else {
+        fail(HttpResponse::k_502_bad_gateway, "Bad Gateway");
+    }
+}
+
+void ProxyExchange::on_timeout() {
+    if ((state_ == k_waiting || state_ == k_forwarding) && !head_sent_) {
+        TcpConnectionPtr client = client_.lock();
+        LOG_WARN << "ProxyExchange [" << (client ? client->name() : std::string()) << "] upstream "
+                 << pool_->route().upstream.to_IP_port() << " response timed out";
+        fail(HttpResponse::k_504_gateway_timeout, "Gateway Timeout");
+    }
+}
+
+void ProxyExchange::on_client_closed() {
+    if (state_ == k_done) {
+        return;
+    }
+    state_ = k_done;
+    if (upstream_) {
+        // 响应没有转发完，上游连接上还有剩余的数据，不能复用
+        UpstreamPool::ConnectionPtr upstream;
+        upstream.swap(upstream_);
+        pool_->release(upstream, false);
+    }
+    loop_->cancel(timer_);
+}
+
+void ProxyExchange::abandon() {
+    state_ = k_done;
+    upstream_.reset();
+    pool_ = nullptr;
+}
+
+void ProxyExchange::complete(bool reusable) {
+    if (upstream_) {
+        UpstreamPool::ConnectionPtr upstream;
+        upstream.swap(upstream_);
+        pool_->release(upstream, reusable);
+    }
+    finish(client_close_ || !request_body_.done());
+}
+
+/**
+ * @brief 响应头还没有发出时返回错误响应，否则只能关闭客户端连接
+ */
+void ProxyExchange::fail(int status, const char *message) {
+    TcpConnectionPtr client = client_.lock();
+    if (client && !head_sent_) {
+        HttpResponse response(true);
+        response.set_status_code(static_cast<HttpResponse::HttpStatusCode>(status));
+        response.set_status_message(message);
+        response.set_content_type("text/plain");
+        response.set_body(std::string(message) + "\n");
+        Buffer buf;
+        response.append_to_buffer(&buf);
+        client->send(buf.peek(), buf.readable_bytes());
+        head_sent_ = true;
+    }
+    if (upstream_) {
+        UpstreamPool::ConnectionPtr upstream;
+        upstream.swap(upstream_);
+        pool_->release(upstream, false);
+    }
+    finish(true);
+}
+
+void ProxyExchange::finish(bool close) {
+    if (state_ == k_done) {
+        return;
+    }
+    state_ = k_done;
+    loop_->cancel(timer_);
+    TcpConnectionPtr client = client_.lock();
+    if (client) {
+        finish_callback_(client, close);
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
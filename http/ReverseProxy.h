@@ -0,0 +1,209 @@
+/**
+ * @brief 反向代理：把匹配路由的请求转发给上游http服务器，上游连接按IO loop分池复用
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_REVERSEPROXY_H
+#define WEB_SERVER_HTTP_REVERSEPROXY_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponseParser.h"
+#include "net/InetAddress.h"
+#include "net/TcpClient.h"
+#include "net/TimerID.h"
+
+namespace web_server {
+
+namespace http {
+
+using net::Buffer;
+using net::EventLoop;
+using net::InetAddress;
+using net::TcpConnectionPtr;
+
+struct ProxyOptions {
+    size_t max_connections = 64;            // 每个IO loop到该上游的连接数上限
+    size_t max_idle = 32;                   // 每个IO loop保留的空闲连接数上限
+    size_t max_waiters = 1024;              // 等待上游连接的请求数上限，超过时返回503
+    double connect_timeout = 3.0;           // 秒
+    double response_timeout = 30.0;         // 从开始转发到收到响应头，超时返回504
+};
+
+/**
+ * @brief 一条代理路由：路径以prefix开头（按路径段匹配）的请求转发给upstream
+ */
+struct ProxyRoute {
+    std::string prefix;
+    InetAddress upstream;
+    ProxyOptions options;
+
+    bool match(const std::string &path) const;
+};
+
+class ProxyExchange;
+
+/**
+ * @brief 一个IO loop上到一个上游的keep-alive连接池
+ * 只在所属loop线程中使用，连接从不跨线程；空闲连接后进先出，最近用过的连接最可能还活着；
+ * 没有空闲连接时，请求按到达顺序等待新建或归还的连接
+ */
+class UpstreamPool : private Noncopyable {
+public:
+    struct Connection {
+        std::shared_ptr<net::TcpClient> client;
+        TcpConnectionPtr conn;                  // 连接建立之前为空
+        std::weak_ptr<ProxyExchange> exchange;  // 正在使用该连接的交换
+        net::TimerID connect_timer;
+        bool reused = false;                    // 已经完成过至少一次交换
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    UpstreamPool(EventLoop *loop, const ProxyRoute *route, const std::string &name);
+    ~UpstreamPool();
+
+    /**
+     * @brief 为exchange取得一个连接，有空闲连接时立即调用exchange->on_upstream，否则排队
+     */
+    void acquire(const std::shared_ptr<ProxyExchange> &exchange);
+
+    /**
+     * @brief 交换结束后归还连接，reusable为false时关闭连接
+     */
+    void release(const ConnectionPtr &upstream, bool reusable);
+
+    /**
+     * @brief 关闭全部连接，等待中和进行中的交换不再回调连接池，在loop线程中调用
+     */
+    void shutdown();
+
+    const ProxyRoute &route() const {
+        return *route_;
+    }
+
+    size_t connection_count() const {
+        return connections_.size();
+    }
+
+    size_t idle_count() const {
+        return idle_.size();
+    }
+
+private:
+    void open();
+    void offer(const ConnectionPtr &upstream);
+    void discard(const ConnectionPtr &upstream);
+    void fail_waiters(int status);
+    void on_connection(const std::weak_ptr<Connection> &weak, const TcpConnectionPtr &conn);
+    void on_message(const std::weak_ptr<Connection> &weak, const TcpConnectionPtr &conn, Buffer *buf);
+    void on_high_water_mark(const std::weak_ptr<Connection> &weak);
+    void on_connect_error(const std::weak_ptr<Connection> &weak, int status);
+
+    EventLoop *loop_;
+    const ProxyRoute *route_;
+    const std::string name_;
+    int next_id_;
+    size_t connecting_;
+    bool shutdown_;
+    std::set<ConnectionPtr> connections_;
+    std::vector<ConnectionPtr> idle_;
+    std::deque<std::weak_ptr<ProxyExchange>> waiters_;
+};
+
+/**
+ * @brief 一个被代理的请求，从取得上游连接到响应转发结束
+ * 请求体和响应体边读边转发，一端输出缓冲积压时暂停读取另一端；
+ * 只改写必要的首部：去掉逐跳首部，追加X-Forwarded-For，按客户端的协议版本决定响应的分帧方式
+ */
+class ProxyExchange : private Noncopyable,
+                      public std::enable_shared_from_this<ProxyExchange> {
+public:
+    /**
+     * @brief 交换结束时回调，close为true时客户端连接不能继续使用
+     */
+    using FinishCallback = std::function<void(const TcpConnectionPtr &client, bool close)>;
+
+    ProxyExchange(const TcpConnectionPtr &client,
+                  const HttpRequest &req,
+                  UpstreamPool *pool,
+                  const FinishCallback &cb);
+    ~ProxyExchange();
+
+    /**
+     * @brief 客户端连接上之前的响应都发完之后开始，重复调用无效
+     */
+    void start();
+
+    // 以下由HttpServer在客户端连接的事件中调用
+    void on_client_data();
+    void on_client_closed();
+    void on_client_blocked();
+    void on_client_writable();
+
+    // 以下由UpstreamPool调用
+    bool waiting() const {
+        return state_ == k_waiting;
+    }
+    void on_upstream(const UpstreamPool::ConnectionPtr &upstream);
+    void on_upstream_message(Buffer *buf);
+    void on_upstream_closed();
+    void on_upstream_blocked();
+    void on_upstream_error(int status);
+    void abandon();
+
+private:
+    enum State {
+        k_pending,          // 等待客户端连接上之前的响应
+        k_waiting,          // 等待上游连接
+        k_forwarding,
+        k_done
+    };
+
+    void send_request_head();
+    void forward_request_body();
+    bool send_response_head();
+    void forward_response_body(Buffer *buf);
+    void complete(bool reusable);
+    void fail(int status, const char *message);
+    void finish(bool close);
+    void on_timeout();
+
+    std::weak_ptr<net::TcpConnection> client_;
+    EventLoop *loop_;
+    HttpRequest request_;
+    UpstreamPool *pool_;
+    FinishCallback finish_callback_;
+    State state_;
+    UpstreamPool::ConnectionPtr upstream_;
+    net::TimerID timer_;
+    HttpBodyReader request_body_;
+    HttpResponseParser response_;
+    HttpBodyReader response_body_;
+    bool client_http11_;
+    bool client_close_;         // 响应之后关闭客户端连接
+    bool expect_continue_;
+    bool head_request_;
+    bool head_sent_;            // 响应头已经发给客户端
+    bool response_started_;     // 收到过上游的数据
+    bool dechunk_;              // 给HTTP/1.0客户端去掉分块格式
+    bool upstream_blocked_;
+    bool retried_;
+    std::string decoded_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_REVERSEPROXY_H
@@ -0,0 +1,275 @@
+/**
+ * @brief 基于基数树的路由
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Router.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/Logging.h"
+#include "http/HttpResponse.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+// 与HttpRequest::Method的顺序一致
+const char *k_method_names[] = {"", "GET", "POST", "HEAD", "PUT", "DELETE"};
+
+size_t common_prefix(const std::string &a, boost::string_ref b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+} // namespace
+
+const int RouteParams::k_max_params;
+const uint32_t Router::k_no_node;
+const int32_t Router::k_no_handler;
+
+Router::Router() = default;
+
+Router::~Router() = default;
+
+void Router::add(HttpRequest::Method method, const std::string &pattern, const Handler &handler) {
+    if (method <= HttpRequest::k_invalid || method >= k_num_methods) {
+        LOG_FATAL << "Router::add - invalid method " << static_cast<int>(method) << " for " << pattern;
+    }
+    if (pattern.empty() || pattern[0] != '/') {
+        LOG_FATAL << "Router::add - pattern must begin with '/': " << pattern;
+    }
+    Tree *tree = &trees_[method];
+    if (tree->empty()) {
+        tree->emplace_back(k_static);
+    }
+
+    uint32_t node = 0;
+    int num_params = 0;
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+        if (c == ':' || c == '*') {
+            NodeKind kind = c == ':' ? k_param : k_wildcard;
+            size_t end = pattern.find('/', pos);
+            if (end == std::string::npos) {
+                end = pattern.size();
+            }
+            boost::string_ref name(pattern.data() + pos + 1, end - pos - 1);
+            if (pattern[pos - 1] != '/' || name.empty() ||
+                name.find(':') != boost::string_ref::npos || name.find('*') != boost::string_ref::npos) {
+                LOG_FATAL << "Router::add - malformed parameter in " << pattern;
+            }
+            if (kind == k_wildcard && end != pattern.size()) {
+                LOG_FATAL << "Router::add - wildcard must be the last segment: " << pattern;
+            }
+            if (++num_params > RouteParams::k_max_params) {
+                LOG_FATAL << "Router::add - too many parameters in " << pattern;
+            }
+            node = insert_param(tree, node, kind, name, pattern);
+            pos = end;
+        } else {
+            size_t end = pattern.find_first_of(":*", pos);
+            if (end == std::string::npos) {
+                end = pattern.size();
+            }
+            node = insert_static(tree, node, boost::string_ref(pattern.data() + pos, end - pos));
+            pos = end;
+        }
+    }
+
+    if ((*tree)[node].handler != k_no_handler) {
+        LOG_FATAL << "Router::add - duplicate route " << k_method_names[method] << " " << pattern;
+    }
+    (*tree)[node].handler = static_cast<int32_t>(handlers_.size());
+    handlers_.push_back(handler);
+}
+
+/**
+ * @brief 把静态文本插入parent的静态子树，返回文本末尾对应的节点
+ * 和已有节点只有部分公共前缀时把已有节点一分为二
+ * 树节点保存在vector中，push_back之后不能再使用之前取到的引用
+ */
+uint32_t Router::insert_static(Tree *tree, uint32_t parent, boost::string_ref text) {
+    uint32_t node = parent;
+    while (!text.empty()) {
+        size_t pos = (*tree)[node].indices.find(text[0]);
+        if (pos == std::string::npos) {
+            uint32_t child = static_cast<uint32_t>(tree->size());
+            (*tree)[node].indices.push_back(text[0]);
+            (*tree)[node].children.push_back(child);
+            tree->emplace_back(k_static);
+            tree->back().prefix = text.to_string();
+            return child;
+        }
+
+        uint32_t child = (*tree)[node].children[pos];
+        size_t common = common_prefix((*tree)[child].prefix, text);
+        if (common < (*tree)[child].prefix.size()) {
+            Node tail(k_static);
+            Node &split = (*tree)[child];
+            tail.prefix = split.prefix.substr(common);
+            tail.indices.swap(split.indices);
+            tail.children.swap(split.children);
+            tail.param_child = split.param_child;
+            tail.wildcard_child = split.wildcard_child;
+            tail.handler = split.handler;
+
+            split.prefix.resize(common);
+            split.indices.assign(1, tail.prefix[0]);
+            split.children.assign(1, static_cast<uint32_t>(tree->size()));
+            split.param_child = k_no_node;
+            split.wildcard_child = k_no_node;
+            split.handler = k_no_handler;
+            tree->push_back(std::move(tail));
+        }
+        text.remove_prefix(common);
+        node = child;
+    }
+    return node;
+}
+
+uint32_t Router::insert_param(Tree *tree, uint32_t parent, NodeKind kind,
+                              boost::string_ref name, const std::string &pattern) {
+    uint32_t existing = kind == k_param ? (*tree)[parent].param_child : (*tree)[parent].wildcard_child;
+    if (existing != k_no_node) {
+        if ((*tree)[existing].prefix != name) {
+            LOG_FATAL << "Router::add - parameter " << name.to_string() << " in " << pattern
+                      << " conflicts with existing " << (*tree)[existing].prefix;
+        }
+        return existing;
+    }
+    uint32_t child = static_cast<uint32_t>(tree->size());
+    if (kind == k_param) {
+        (*tree)[parent].param_child = child;
+    } else {
+        (*tree)[parent].wildcard_child = child;
+    }
+    tree->emplace_back(kind);
+    tree->back().prefix = name.to_string();
+    return child;
+}
+
+bool Router::match_node(const Tree &tree, uint32_t index, boost::string_ref path,
+                        RouteParams *params, int32_t *handler) const {
+    const Node &node = tree[index];
+    bool pushed = false;
+    switch (node.kind) {
+        case k_static:
+            if (path.size() < node.prefix.size() ||
+                memcmp(path.data(), node.prefix.data(), node.prefix.size()) != 0) {
+                return false;
+            }
+            path.remove_prefix(node.prefix.size());
+            break;
+        case k_param: {
+            size_t end = path.find('/');
+            if (end == boost::string_ref::npos) {
+                end = path.size();
+            }
+            if (end == 0) {
+                return false;
+            }
+            params->push(node.prefix, path.substr(0, end));
+            pushed = true;
+            path.remove_prefix(end);
+            break;
+        }
+        case k_wildcard:
+            params->push(node.prefix, path);
+            *handler = node.handler;
+            return true;
+    }
+
+    if (path.empty()) {
+        if (node.handler != k_no_handler) {
+            *handler = node.handler;
+            return true;
+        }
+    } else {
+        size_t pos = node.indices.find(path[0]);
+        if (pos != std::string::npos && match_node(tree, node.children[pos], path, params, handler)) {
+            return true;
+        }
+        if (node.param_child != k_no_node && match_node(tree, node.param_child, path, params, handler)) {
+            return true;
+        }
+    }
+    if (node.wildcard_child != k_no_node && match_node(tree, node.wildcard_child, path, params, handler)) {
+        return true;
+    }
+    if (pushed) {
+        params->pop();
+    }
+    return false;
+}
+
+int32_t Router::match_tree(HttpRequest::Method method, boost::string_ref path, RouteParams *params) const {
+    params->clear();
+    if (method <= HttpRequest::k_invalid || method >= k_num_methods || trees_[method].empty()) {
+        return k_no_handler;
+    }
+    int32_t handler = k_no_handler;
+    match_node(trees_[method], 0, path, params, &handler);
+    return handler;
+}
+
+const Router::Handler *Router::match(HttpRequest::Method method, boost::string_ref path,
+                                     RouteParams *params) const {
+    int32_t handler = match_tree(method, path, params);
+    if (handler == k_no_handler && method == HttpRequest::k_head) {
+        handler = match_tree(HttpRequest::k_get, path, params);
+    }
+    return handler == k_no_handler ? nullptr : &handlers_[handler];
+}
+
+void Router::dispatch(const HttpRequest &req, HttpResponse *resp) const {
+    RouteParams params;
+    boost::string_ref path(req.path());
+    const Handler *handler = match(req.method(), path, &params);
+    if (handler) {
+        (*handler)(req, params, resp);
+        return;
+    }
+
+    // 只在未命中时才检查其他方法，不影响正常请求的开销
+    std::string allow;
+    for (int m = HttpRequest::k_get; m < k_num_methods; ++m) {
+        HttpRequest::Method method = static_cast<HttpRequest::Method>(m);
+        if (method != req.method() && match(method, path, &params)) {
+            if (!allow.empty()) {
+                allow += ", ";
+            }
+            allow += k_method_names[m];
+        }
+    }
+    if (!allow.empty()) {
+        resp->set_status_code(HttpResponse::k_405_method_not_allowed);
+        resp->set_status_message("Method Not Allowed");
+        resp->add_header("Allow", allow);
+        return;
+    }
+
+    params.clear();
+    if (not_found_) {
+        not_found_(req, params, resp);
+    } else {
+        resp->set_status_code(HttpResponse::k_404_not_found);
+        resp->set_status_message("Not Found");
+        resp->set_close_connection(true);
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,199 @@
+/**
+ * @brief 基于基数树的路由
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_ROUTER_H
+#define WEB_SERVER_HTTP_ROUTER_H
+
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "http/HttpRequest.h"
+
+namespace web_server {
+
+namespace http {
+
+class HttpResponse;
+
+/**
+ * @brief 一次匹配捕获到的路径参数
+ * 定长数组保存，不分配内存；name指向Router内部，value指向请求的path，
+ * 两者都只在Router和HttpRequest存活期间有效
+ */
+class RouteParams {
+public:
+    static const int k_max_params = 8;
+
+    struct Param {
+        boost::string_ref name;
+        boost::string_ref value;
+    };
+
+    RouteParams() : size_(0) {}
+
+    int size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const Param &operator[](int index) const {
+        return params_[index];
+    }
+
+    /**
+     * @brief 按名字查找参数，找不到时返回空串
+     */
+    boost::string_ref get(boost::string_ref name) const {
+        for (int i = 0; i < size_; ++i) {
+            if (params_[i].name == name) {
+                return params_[i].value;
+            }
+        }
+        return boost::string_ref();
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+private:
+    friend class Router;
+
+    void push(boost::string_ref name, boost::string_ref value) {
+        params_[size_].name = name;
+        params_[size_].value = value;
+        ++size_;
+    }
+
+    void pop() {
+        --size_;
+    }
+
+    Param params_[k_max_params];
+    int size_;
+};
+
+/**
+ * @brief http路由，启动时注册，之后只读
+ * 每种方法一棵基数树，树的节点平铺在vector中用下标互相引用；
+ * 匹配时按字节沿树前进，耗时只与路径长度有关，与路由数量无关，匹配过程不分配内存
+ *
+ * 路由模式由三种片段组成：
+ * - 静态片段，如/api/users
+ * - 参数片段:name，匹配一个不含'/'的非空段，如/users/:id/posts
+ * - 通配片段*name，匹配剩余的全部路径（可以为空），只能出现在模式末尾，如静态文件路由里跟在/static/后面的*filepath
+ * 同一位置上静态片段优先于参数片段，参数片段优先于通配片段，匹配失败时回溯尝试下一种。
+ * 模式非法、重复注册、同一位置参数名不一致属于程序错误，直接LOG_FATAL
+ *
+ * 注册完成后可以直接作为HttpServer的回调：
+ * server.set_http_callback([&router](const HttpRequest &req, HttpResponse *resp) {
+ *     router.dispatch(req, resp);
+ * });
+ * 开启卸载模式时dispatch在计算线程中并发调用，因此注册必须在server.start()之前完成
+ */
+class Router : private Noncopyable {
+public:
+    using Handler = std::function<void(const HttpRequest &, const RouteParams &, HttpResponse *)>;
+
+    Router();
+    ~Router();
+
+    void add(HttpRequest::Method method, const std::string &pattern, const Handler &handler);
+
+    void get(const std::string &pattern, const Handler &handler) {
+        add(HttpRequest::k_get, pattern, handler);
+    }
+
+    void post(const std::string &pattern, const Handler &handler) {
+        add(HttpRequest::k_post, pattern, handler);
+    }
+
+    void put(const std::string &pattern, const Handler &handler) {
+        add(HttpRequest::k_put, pattern, handler);
+    }
+
+    void del(const std::string &pattern, const Handler &handler) {
+        add(HttpRequest::k_delete, pattern, handler);
+    }
+
+    /**
+     * @brief 设置未匹配任何路由时的处理，默认返回404并关闭连接
+     */
+    void set_not_found(const Handler &handler) {
+        not_found_ = handler;
+    }
+
+    /**
+     * @brief 查找路由，HEAD没有单独注册时使用GET的路由
+     * @param method
+     * @param path 不含query的路径
+     * @param params 输出捕获的参数
+     * @return const Handler* 未找到时返回nullptr
+     */
+    const Handler *match(HttpRequest::Method method, boost::string_ref path, RouteParams *params) const;
+
+    /**
+     * @brief 查找并执行对应的handler
+     * 路径存在但方法不匹配时返回405并带上Allow，完全不匹配时交给not_found处理
+     */
+    void dispatch(const HttpRequest &req, HttpResponse *resp) const;
+
+    size_t route_count() const {
+        return handlers_.size();
+    }
+
+private:
+    static const int k_num_methods = HttpRequest::k_delete + 1;
+    static const uint32_t k_no_node = UINT32_MAX;
+    static const int32_t k_no_handler = -1;
+
+    enum NodeKind : uint8_t {k_static, k_param, k_wildcard};
+
+    struct Node {
+        std::string prefix;             // 静态节点为边上的字节，参数和通配节点为参数名
+        std::string indices;            // 各个静态子节点prefix的首字节，与children一一对应
+        std::vector<uint32_t> children;
+        uint32_t param_child;
+        uint32_t wildcard_child;
+        int32_t handler;
+        NodeKind kind;
+
+        explicit Node(NodeKind k)
+            : param_child(k_no_node),
+              wildcard_child(k_no_node),
+              handler(k_no_handler),
+              kind(k) {
+        }
+    };
+    using Tree = std::vector<Node>;
+
+    Tree trees_[k_num_methods];
+    std::vector<Handler> handlers_;
+    Handler not_found_;
+
+    uint32_t insert_static(Tree *tree, uint32_t parent, boost::string_ref text);
+    uint32_t insert_param(Tree *tree, uint32_t parent, NodeKind kind,
+                          boost::string_ref name, const std::string &pattern);
+    bool match_node(const Tree &tree, uint32_t index, boost::string_ref path,
+                    RouteParams *params, int32_t *handler) const;
+    int32_t match_tree(HttpRequest::Method method, boost::string_ref path, RouteParams *params) const;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_ROUTER_H
@@ -0,0 +1,269 @@
+/**
+ * @brief 静态文件服务
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/StaticFile.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#include "base/Logging.h"
+#include "base/NumberFormat.h"
+#include "http/FileCache.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/Router.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace {
+
+struct MimeEntry {
+    const char *extension;
+    const char *type;
+};
+
+const MimeEntry k_mime_types[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "application/javascript; charset=utf-8"},
+    {"mjs", "application/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"mp3", "audio/mpeg"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+};
+
+const char *k_default_mime_type = "application/octet-stream";
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief 百分号解码并规范化路径：去掉空段和.段，结果不以'/'开头
+ * 同一文件总是得到同一个路径，FileCache按路径缓存
+ * @return false 编码错误，或者包含'\0'、..段
+ */
+bool normalize_path(boost::string_ref path, std::string *out) {
+    std::string decoded;
+    decoded.reserve(path.size());
+    for (size_t i = 0; i < path.size(); ++i) {
+        char c = path[i];
+        if (c == '%') {
+            int high = i + 2 < path.size() ? hex_value(path[i + 1]) : -1;
+            int low = high >= 0 ? hex_value(path[i + 2]) : -1;
+            if (low < 0) {
+                return false;
+            }
+            c = static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+        if (c == '\0') {
+            return false;
+        }
+        decoded.push_back(c);
+    }
+
+    out->clear();
+    out->reserve(decoded.size());
+    for (size_t pos = 0; pos < decoded.size();) {
+        size_t end = decoded.find('/', pos);
+        if (end == std::string::npos) {
+            end = decoded.size();
+        }
+        size_t len = end - pos;
+        if (len == 2 && decoded.compare(pos, 2, "..") == 0) {
+            return false;
+        }
+        if (len > 0 && !(len == 1 && decoded[pos] == '.')) {
+            if (!out->empty()) {
+                out->push_back('/');
+            }
+            out->append(decoded, pos, len);
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+void set_error(HttpResponse *resp, HttpResponse::HttpStatusCode code, const char *message) {
+    resp->set_status_code(code);
+    resp->set_status_message(message);
+    resp->set_content_type("text/plain; charset=utf-8");
+    resp->set_body(std::string(message) + "\n");
+}
+
+} // namespace
+
+const char *mime_type(boost::string_ref path) {
+    size_t dot = path.rfind('.');
+    size_t slash = path.rfind('/');
+    if (dot == boost::string_ref::npos || (slash != boost::string_ref::npos && slash > dot)) {
+        return k_default_mime_type;
+    }
+    boost::string_ref extension = path.substr(dot + 1);
+    char lower[8];
+    if (extension.empty() || extension.size() > sizeof lower) {
+        return k_default_mime_type;
+    }
+    for (size_t i = 0; i < extension.size(); ++i) {
+        lower[i] = static_cast<char>(::tolower(static_cast<unsigned char>(extension[i])));
+    }
+    boost::string_ref key(lower, extension.size());
+    for (const MimeEntry &entry : k_mime_types) {
+        if (key == entry.extension) {
+            return entry.type;
+        }
+    }
+    return k_default_mime_type;
+}
+
+StaticFile::StaticFile(int fd, const struct stat &st, const char *content_type)
+    : fd_(fd),
+      size_(st.st_size),
+      mtime_(st.st_mtime),
+      content_type_(content_type) {
+    char buf[3 * number_format::k_max_hex_size + 8];
+    size_t len = 0;
+    buf[len++] = '"';
+    len += number_format::format_hex(buf + len, static_cast<uint64_t>(st.st_ino));
+    buf[len++] = '-';
+    len += number_format::format_hex(buf + len, static_cast<uint64_t>(st.st_size));
+    buf[len++] = '-';
+    len += number_format::format_hex(buf + len, static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                                                static_cast<uint64_t>(st.st_mtim.tv_nsec));
+    buf[len++] = '"';
+    etag_.assign(buf, len);
+
+    struct tm tm_time;
+    ::gmtime_r(&mtime_, &tm_time);
+    len = ::strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+    last_modified_.assign(buf, len);
+}
+
+StaticFile::~StaticFile() {
+    ::close(fd_);
+}
+
+std::shared_ptr<StaticFile> StaticFile::open(const std::string &path, int *saved_errno) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *saved_errno = errno;
+        return std::shared_ptr<StaticFile>();
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        *saved_errno = errno;
+        ::close(fd);
+        return std::shared_ptr<StaticFile>();
+    }
+    if (!S_ISREG(st.st_mode)) {
+        *saved_errno = S_ISDIR(st.st_mode) ? EISDIR : ENOENT;
+        ::close(fd);
+        return std::shared_ptr<StaticFile>();
+    }
+    return std::shared_ptr<StaticFile>(new StaticFile(fd, st, mime_type(path)));
+}
+
+StaticFileHandler::StaticFileHandler(const std::string &root,
+                                     FileCache *cache,
+                                     const std::string &index_file)
+    : root_(root),
+      cache_(cache),
+      index_file_(index_file) {
+    while (root_.size() > 1 && root_.back() == '/') {
+        root_.pop_back();
+    }
+}
+
+void StaticFileHandler::operator()(const HttpRequest &req, const RouteParams &params, HttpResponse *resp) const {
+    if (params.empty()) {
+        serve(req.path(), resp);
+    } else {
+        serve(params[params.size() - 1].value, resp);
+    }
+}
+
+std::shared_ptr<StaticFile> StaticFileHandler::open_file(const std::string &path, int *saved_errno) const {
+    return cache_ ? cache_->open(path, saved_errno) : StaticFile::open(path, saved_errno);
+}
+
+void StaticFileHandler::serve(boost::string_ref path, HttpResponse *resp) const {
+    std::string relative;
+    if (!normalize_path(path, &relative)) {
+        set_error(resp, HttpResponse::k_403_forbidden, "Forbidden");
+        return;
+    }
+    std::string full_path = root_;
+    if (!relative.empty()) {
+        if (full_path.back() != '/') {
+            full_path += '/';
+        }
+        full_path += relative;
+    }
+    int saved_errno = 0;
+    std::shared_ptr<StaticFile> file = open_file(full_path, &saved_errno);
+    if (!file && saved_errno == EISDIR && !index_file_.empty()) {
+        if (full_path.back() != '/') {
+            full_path += '/';
+        }
+        full_path += index_file_;
+        file = open_file(full_path, &saved_errno);
+    }
+    if (!file) {
+        if (saved_errno == EACCES) {
+            set_error(resp, HttpResponse::k_403_forbidden, "Forbidden");
+        } else {
+            if (saved_errno != ENOENT && saved_errno != ENOTDIR && saved_errno != EISDIR) {
+                LOG_ERROR << "StaticFileHandler::serve " << full_path << " " << strerror_tl(saved_errno);
+            }
+            set_error(resp, HttpResponse::k_404_not_found, "Not Found");
+        }
+        return;
+    }
+
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_content_type(file->content_type());
+    resp->add_header("ETag", file->etag());
+    resp->add_header("Last-Modified", file->last_modified());
+    resp->add_header("Accept-Ranges", "bytes");
+    resp->set_body_file(file->fd(), 0, static_cast<size_t>(file->size()), file);
+}
+
+} // namespace http
+
+} // namespace web_server
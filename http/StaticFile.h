@@ -0,0 +1,130 @@
+/**
+ * @brief 静态文件服务
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_STATICFILE_H
+#define WEB_SERVER_HTTP_STATICFILE_H
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+namespace http {
+
+class FileCache;
+class HttpRequest;
+class HttpResponse;
+class RouteParams;
+
+/**
+ * @brief 按扩展名返回Content-Type，未知的扩展名返回application/octet-stream
+ */
+const char *mime_type(boost::string_ref path);
+
+/**
+ * @brief 一个以只读方式打开的普通文件，析构时关闭fd
+ * 以shared_ptr的形式交给HttpResponse::set_body_file，保证sendfile完成之前fd有效
+ */
+class StaticFile : private Noncopyable {
+public:
+    /**
+     * @brief 打开path指向的普通文件
+     * @param path
+     * @param saved_errno 失败时的errno，不是普通文件时为EISDIR或ENOENT
+     * @return std::shared_ptr<StaticFile> 失败时返回空指针
+     */
+    static std::shared_ptr<StaticFile> open(const std::string &path, int *saved_errno);
+
+    ~StaticFile();
+
+    int fd() const {
+        return fd_;
+    }
+
+    off_t size() const {
+        return size_;
+    }
+
+    time_t mtime() const {
+        return mtime_;
+    }
+
+    const char *content_type() const {
+        return content_type_;
+    }
+
+    /**
+     * @brief 由inode、大小和修改时间生成的强校验ETag，带双引号
+     */
+    const std::string &etag() const {
+        return etag_;
+    }
+
+    /**
+     * @brief 修改时间，格式为IMF-fixdate，如Sun, 06 Nov 1994 08:49:37 GMT
+     */
+    const std::string &last_modified() const {
+        return last_modified_;
+    }
+
+private:
+    StaticFile(int fd, const struct stat &st, const char *content_type);
+
+    const int fd_;
+    const off_t size_;
+    const time_t mtime_;
+    const char *content_type_;
+    std::string etag_;
+    std::string last_modified_;
+};
+
+/**
+ * @brief 把root目录下的文件作为响应体，用sendfile发送
+ * 可以直接注册到以通配片段（如*filepath）结尾的路由上，例如/static/下的所有路径，
+ * 此时文件路径取最后一个路由参数，否则取请求的完整路径；
+ * 路径先做百分号解码，包含..段的请求返回403，目录返回其中的index_file，找不到文件返回404；
+ * HEAD请求由HttpServer省略响应体，Content-Length仍为文件大小；
+ * 响应带有ETag、Last-Modified和Accept-Ranges，条件请求和Range请求由HttpServer处理。
+ * 指定cache时打开的文件从FileCache中获取，命中时不再有open、fstat和close
+ */
+class StaticFileHandler {
+public:
+    explicit StaticFileHandler(const std::string &root,
+                               FileCache *cache = nullptr,
+                               const std::string &index_file = "index.html");
+
+    void operator()(const HttpRequest &req, const RouteParams &params, HttpResponse *resp) const;
+
+    /**
+     * @brief 发送root下的path
+     * @param path 相对于root的路径，开头的'/'可有可无
+     * @param resp
+     */
+    void serve(boost::string_ref path, HttpResponse *resp) const;
+
+private:
+    std::shared_ptr<StaticFile> open_file(const std::string &path, int *saved_errno) const;
+
+    std::string root_;
+    FileCache *cache_;
+    std::string index_file_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_STATICFILE_H
@@ -0,0 +1,57 @@
+/**
+ * @brief 流式响应体的唤醒信号
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/StreamSignal.h"
+
+#include "net/EventLoop.h"
+
+namespace web_server {
+
+namespace http {
+
+const double StreamSignal::k_retry_interval = 0.01;
+
+void StreamSignal::notify() {
+    MutexLockGuard lock(mutex_);
+    if (!wakeup_) {
+        notified_ = true;
+        return;
+    }
+    // 持锁投递，cancel返回之后不会再有投递，连接所在的loop可以放心析构
+    Functor wakeup;
+    wakeup.swap(wakeup_);
+    wakeup();
+}
+
+void StreamSignal::cancel() {
+    MutexLockGuard lock(mutex_);
+    wakeup_ = Functor();
+    notified_ = false;
+}
+
+void StreamSignal::schedule(net::EventLoop *loop, const std::shared_ptr<StreamSignal> &signal, const Functor &resume) {
+    if (!signal) {
+        loop->run_after(k_retry_interval, resume);
+        return;
+    }
+    {
+        MutexLockGuard lock(signal->mutex_);
+        if (!signal->notified_) {
+            signal->wakeup_ = [loop, resume]() {
+                loop->queue_in_loop(resume);
+            };
+            return;
+        }
+        signal->notified_ = false;
+    }
+    loop->queue_in_loop(resume);
+}
+
+} // namespace http
+
+} // namespace web_server
@@ -0,0 +1,63 @@
+/**
+ * @brief 流式响应体的唤醒信号：生产者暂时没有数据时响应暂停，数据就绪后由生产者唤醒
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_STREAMSIGNAL_H
+#define WEB_SERVER_HTTP_STREAMSIGNAL_H
+
+#include <functional>
+#include <memory>
+
+#include "base/Mutex.h"
+#include "base/Noncopyable.h"
+
+namespace web_server {
+
+namespace net {
+class EventLoop;
+} // namespace net
+
+namespace http {
+
+/**
+ * @brief 由生产者和发送它的连接共享
+ * 连接在生产者没有给出数据时登记唤醒回调，生产者在任意线程调用notify；
+ * notify先于登记到达时不会丢失，连接下一次等待时立即重试
+ */
+class StreamSignal : private Noncopyable {
+public:
+    using Functor = std::function<void()>;
+
+    /**
+     * @brief 没有登记唤醒函数的流式响应，隔这么久（秒）再向生产者要数据
+     */
+    static const double k_retry_interval;
+
+    void notify();
+
+    /**
+     * @brief 连接不再发送这个响应，丢弃已登记的回调，之后的notify没有作用
+     */
+    void cancel();
+
+    /**
+     * @brief 生产者暂时没有数据时安排下一次生产，resume总在loop线程中执行
+     * signal为空时隔k_retry_interval秒重试；否则等notify，已经通知过时在下一轮循环重试
+     */
+    static void schedule(net::EventLoop *loop, const std::shared_ptr<StreamSignal> &signal, const Functor &resume);
+
+private:
+    MutexLock mutex_;
+    bool notified_ = false;
+    Functor wakeup_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_STREAMSIGNAL_H
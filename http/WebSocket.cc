@@ -0,0 +1,247 @@
+/**
+ * @brief WebSocket握手和帧的编解码（RFC 6455）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/WebSocket.h"
+
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/Base64.h"
+#include "base/Sha1.h"
+#include "http/HttpHeaders.h"
+#include "http/HttpRequest.h"
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace http {
+
+namespace websocket {
+
+namespace {
+
+const char k_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+} // namespace
+
+size_t parse_frame_header(const char *data, size_t len, FrameHeader *header) {
+    if (len < 2) {
+        return 0;
+    }
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    header->fin = (p[0] & 0x80) != 0;
+    header->rsv = (p[0] >> 4) & 0x7;
+    header->opcode = p[0] & 0xf;
+    header->masked = (p[1] & 0x80) != 0;
+    uint64_t length = p[1] & 0x7f;
+    size_t n = 2;
+    if (length == 126) {
+        if (len < 4) {
+            return 0;
+        }
+        length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+        n = 4;
+    } else if (length == 127) {
+        if (len < 10) {
+            return 0;
+        }
+        length = 0;
+        for (int i = 0; i < 8; ++i) {
+            length = (length << 8) | p[2 + i];
+        }
+        n = 10;
+    }
+    if (header->masked) {
+        if (len < n + 4) {
+            return 0;
+        }
+        memcpy(header->mask, p + n, 4);
+        n += 4;
+    }
+    header->payload_length = length;
+    return n;
+}
+
+void append_frame(net::Buffer *output, Opcode opcode, const void *payload, size_t len, bool fin,
+                  const unsigned char *mask) {
+    char header[k_max_header_length];
+    size_t n = 2;
+    header[0] = static_cast<char>((fin ? 0x80 : 0) | opcode);
+    char mask_bit = mask ? static_cast<char>(0x80) : 0;
+    if (len < 126) {
+        header[1] = static_cast<char>(mask_bit | static_cast<char>(len));
+    } else if (len <= 0xffff) {
+        header[1] = static_cast<char>(mask_bit | 126);
+        header[2] = static_cast<char>(len >> 8);
+        header[3] = static_cast<char>(len);
+        n = 4;
+    } else {
+        header[1] = static_cast<char>(mask_bit | 127);
+        for (int i = 0; i < 8; ++i) {
+            header[2 + i] = static_cast<char>(static_cast<uint64_t>(len) >> (56 - 8 * i));
+        }
+        n = 10;
+    }
+    if (mask) {
+        memcpy(header + n, mask, 4);
+        n += 4;
+    }
+    output->append(header, n);
+    if (len == 0) {
+        return;
+    }
+    if (mask) {
+        std::string masked(len, '\0');
+        unmask(&masked[0], static_cast<const char *>(payload), len, mask, 0);
+        output->append(masked.data(), len);
+    } else {
+        output->append(static_cast<const char *>(payload), len);
+    }
+}
+
+void append_close_frame(net::Buffer *output, uint16_t code, boost::string_ref reason) {
+    if (code == k_no_status_received) {
+        append_frame(output, k_close, nullptr, 0);
+        return;
+    }
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code));
+    payload.append(reason.data(), std::min(reason.size(), k_max_control_payload - 2));
+    append_frame(output, k_close, payload.data(), payload.size());
+}
+
+Frame make_frame(Opcode opcode, boost::string_ref payload) {
+    net::Buffer buf;
+    append_frame(&buf, opcode, payload.data(), payload.size());
+    return std::make_shared<const std::string>(buf.peek(), buf.readable_bytes());
+}
+
+void unmask(char *dst, const char *src, size_t len, const unsigned char *mask, size_t phase) {
+    // 把掩码旋转到与phase对齐，之后按4的倍数成组处理时相位不变
+    unsigned char key[8];
+    for (int i = 0; i < 8; ++i) {
+        key[i] = mask[(phase + i) & 3];
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    uint32_t key32;
+    memcpy(&key32, key, 4);
+    const __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(block, key128));
+    }
+#endif
+    uint64_t key64;
+    memcpy(&key64, key, 8);
+    for (; i + 8 <= len; i += 8) {
+        uint64_t block;
+        memcpy(&block, src + i, 8);
+        block ^= key64;
+        memcpy(dst + i, &block, 8);
+    }
+    for (; i < len; ++i) {
+        dst[i] = static_cast<char>(src[i] ^ key[i & 3]);
+    }
+}
+
+bool valid_utf8(const char *data, size_t len) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = p + len;
+    while (p < end) {
+        // ASCII每次跳过8字节
+        if (end - p >= 8) {
+            uint64_t block;
+            memcpy(&block, p, 8);
+            if ((block & 0x8080808080808080ULL) == 0) {
+                p += 8;
+                continue;
+            }
+        }
+        unsigned char c = *p;
+        if (c < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t n;
+        uint32_t code_point;
+        uint32_t min;
+        if ((c & 0xe0) == 0xc0) {
+            n = 2;
+            code_point = c & 0x1f;
+            min = 0x80;
+        } else if ((c & 0xf0) == 0xe0) {
+            n = 3;
+            code_point = c & 0x0f;
+            min = 0x800;
+        } else if ((c & 0xf8) == 0xf0) {
+            n = 4;
+            code_point = c & 0x07;
+            min = 0x10000;
+        } else {
+            return false;
+        }
+        if (static_cast<size_t>(end - p) < n) {
+            return false;
+        }
+        for (size_t i = 1; i < n; ++i) {
+            if ((p[i] & 0xc0) != 0x80) {
+                return false;
+            }
+            code_point = (code_point << 6) | (p[i] & 0x3f);
+        }
+        if (code_point < min || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff)) {
+            return false;
+        }
+        p += n;
+    }
+    return true;
+}
+
+std::string accept_key(const std::string &key) {
+    std::string input = key + k_guid;
+    std::string digest = Sha1::digest(input.data(), input.size());
+    return base64::encode(digest.data(), digest.size());
+}
+
+bool is_upgrade_request(const HttpRequest &req) {
+    return header_has_token(req.get_header("Upgrade"), "websocket") &&
+           header_has_token(req.get_header("Connection"), "upgrade");
+}
+
+bool handshake(const HttpRequest &req, net::Buffer *output) {
+    if (req.get_header("Sec-WebSocket-Version") != "13") {
+        output->append("HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\n"
+                       "Content-Length: 0\r\nConnection: close\r\n\r\n");
+        return false;
+    }
+    std::string key = req.get_header("Sec-WebSocket-Key");
+    std::string nonce;
+    if (req.method() != HttpRequest::k_get || req.get_version() != HttpRequest::k_http11 ||
+        !base64::decode(key, &nonce) || nonce.size() != 16) {
+        output->append("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return false;
+    }
+    output->append("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: ");
+    output->append(accept_key(key));
+    output->append("\r\n\r\n");
+    return true;
+}
+
+} // namespace websocket
+
+} // namespace http
+
+} // namespace web_server
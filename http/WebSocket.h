@@ -0,0 +1,132 @@
+/**
+ * @brief WebSocket握手和帧的编解码（RFC 6455）
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_WEBSOCKET_H
+#define WEB_SERVER_HTTP_WEBSOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace web_server {
+
+namespace net {
+class Buffer;
+}
+
+namespace http {
+
+class HttpRequest;
+
+namespace websocket {
+
+enum Opcode : uint8_t {
+    k_continuation = 0x0,
+    k_text = 0x1,
+    k_binary = 0x2,
+    k_close = 0x8,
+    k_ping = 0x9,
+    k_pong = 0xa
+};
+
+/**
+ * @brief 关闭帧中的状态码（RFC 6455第7.4.1节）
+ */
+enum CloseCode : uint16_t {
+    k_normal_closure = 1000,
+    k_going_away = 1001,
+    k_protocol_error = 1002,
+    k_unsupported_data = 1003,
+    k_no_status_received = 1005,        // 不能出现在关闭帧中，表示对端的关闭帧没有状态码
+    k_abnormal_closure = 1006,          // 不能出现在关闭帧中，表示没有收到关闭帧连接就断开了
+    k_invalid_payload = 1007,
+    k_policy_violation = 1008,
+    k_message_too_big = 1009,
+    k_internal_error = 1011
+};
+
+const size_t k_max_header_length = 14;
+const size_t k_max_control_payload = 125;
+
+struct FrameHeader {
+    bool fin;
+    uint8_t rsv;                        // RSV1-3，没有协商扩展时必须为0
+    uint8_t opcode;
+    bool masked;
+    unsigned char mask[4];
+    uint64_t payload_length;
+};
+
+inline bool is_control(uint8_t opcode) {
+    return (opcode & 0x8) != 0;
+}
+
+/**
+ * @brief 解析帧头，不检查语义
+ * @return size_t 帧头的长度，数据不足一个完整帧头时返回0
+ */
+size_t parse_frame_header(const char *data, size_t len, FrameHeader *header);
+
+/**
+ * @brief 追加一个完整的帧，服务端发出的帧不加掩码，mask只在模拟客户端时使用
+ */
+void append_frame(net::Buffer *output, Opcode opcode, const void *payload, size_t len, bool fin = true,
+                  const unsigned char *mask = nullptr);
+
+/**
+ * @brief 追加关闭帧，code为k_no_status_received时负载为空
+ */
+void append_close_frame(net::Buffer *output, uint16_t code, boost::string_ref reason = boost::string_ref());
+
+/**
+ * @brief 编码好的帧，可以原样发给任意多个连接，不需要为每个连接重新编码
+ */
+using Frame = std::shared_ptr<const std::string>;
+
+Frame make_frame(Opcode opcode, boost::string_ref payload);
+
+/**
+ * @brief 用掩码异或src写入dst，dst可以等于src
+ * 按16字节（SSE2）或8字节一组处理，只有结尾不足一组的字节逐个处理
+ * @param phase 这段数据在帧负载中的偏移，负载分多次到达时用来对齐掩码
+ */
+void unmask(char *dst, const char *src, size_t len, const unsigned char *mask, size_t phase);
+
+/**
+ * @brief 检查文本消息是否是合法的UTF-8，拒绝过长编码、代理项和超过U+10FFFF的码点
+ */
+bool valid_utf8(const char *data, size_t len);
+
+/**
+ * @brief Sec-WebSocket-Accept = base64(SHA-1(key + GUID))
+ */
+std::string accept_key(const std::string &key);
+
+/**
+ * @brief 请求的Upgrade首部是websocket，Connection首部含有upgrade，都不区分大小写
+ */
+bool is_upgrade_request(const HttpRequest &req);
+
+/**
+ * @brief 检查升级请求并生成握手响应
+ * @param output 成功时是101响应；版本不是13时是带Sec-WebSocket-Version的426，其他错误是400，
+ * 失败的响应都要求关闭连接
+ * @return true 握手成功，之后连接上是WebSocket帧
+ */
+bool handshake(const HttpRequest &req, net::Buffer *output);
+
+} // namespace websocket
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_WEBSOCKET_H
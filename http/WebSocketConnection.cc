@@ -0,0 +1,345 @@
+/**
+ * @brief 一个WebSocket连接上的协议状态
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/WebSocketConnection.h"
+
+#include <algorithm>
+
+#include "base/Logging.h"
+#include "net/Buffer.h"
+#include "net/EventLoop.h"
+#include "net/TcpConnection.h"
+
+namespace web_server {
+
+namespace http {
+
+using namespace websocket;
+using net::Buffer;
+using net::TcpConnectionPtr;
+
+const double WebSocketConnection::k_close_timeout = 5.0;
+
+namespace {
+
+/**
+ * @brief 关闭帧中允许出现的状态码（RFC 6455第7.4节）
+ */
+bool valid_close_code(uint16_t code) {
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+}
+
+} // namespace
+
+WebSocketConnection::WebSocketConnection(const TcpConnectionPtr &conn,
+                                         const WebSocketHandler *handler,
+                                         const WebSocketOptions *options)
+    : conn_(conn),
+      loop_(conn->get_loop()),
+      handler_(handler),
+      options_(options),
+      in_frame_(false),
+      frame_remaining_(0),
+      frame_received_(0),
+      in_message_(false),
+      message_binary_(false),
+      failed_(false),
+      close_sent_(false),
+      close_received_(false),
+      close_code_(k_abnormal_closure),
+      disconnected_(false),
+      received_since_ping_(false),
+      awaiting_pong_(false) {}
+
+void WebSocketConnection::start(const HttpRequest &req) {
+    if (options_->ping_interval > 0) {
+        std::weak_ptr<WebSocketConnection> weak(shared_from_this());
+        ping_timer_ = loop_->run_every(options_->ping_interval, [weak]() {
+            WebSocketPtr self = weak.lock();
+            if (self) {
+                self->on_ping_timer();
+            }
+        });
+    }
+    if (handler_->on_open) {
+        handler_->on_open(shared_from_this(), req);
+    }
+}
+
+void WebSocketConnection::on_data(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    received_since_ping_ = true;
+    while (!failed_ && !close_received_) {
+        if (!in_frame_) {
+            size_t n = parse_frame_header(buf->peek(), buf->readable_bytes(), &header_);
+            if (n == 0) {
+                break;
+            }
+            buf->retrieve(n);
+            if (!begin_frame(conn)) {
+                break;
+            }
+        }
+        // 负载边到达边解掩码，frame_received_保证分多次到达时掩码对齐
+        size_t n = static_cast<size_t>(std::min<uint64_t>(buf->readable_bytes(), frame_remaining_));
+        if (n > 0) {
+            std::string *target = is_control(header_.opcode) ? &control_ : &message_;
+            size_t old_size = target->size();
+            target->append(buf->peek(), n);
+            unmask(&(*target)[old_size], &(*target)[old_size], n, header_.mask, frame_received_);
+            buf->retrieve(n);
+            frame_remaining_ -= n;
+            frame_received_ += n;
+        }
+        if (frame_remaining_ > 0) {
+            break;
+        }
+        in_frame_ = false;
+        end_frame(conn);
+    }
+    if (failed_ || close_received_) {
+        buf->retrieve_all();
+    }
+}
+
+/**
+ * @brief 检查帧头，控制帧和数据帧分别准备接收负载
+ * @return false 协议错误，连接已经关闭
+ */
+bool WebSocketConnection::begin_frame(const TcpConnectionPtr &conn) {
+    // 没有协商扩展，RSV必须为0；客户端发出的帧必须带掩码
+    if (header_.rsv != 0 || !header_.masked) {
+        fail(conn, k_protocol_error);
+        return false;
+    }
+    switch (header_.opcode) {
+        case k_continuation:
+            if (!in_message_) {
+                fail(conn, k_protocol_error);
+                return false;
+            }
+            break;
+        case k_text:
+        case k_binary:
+            if (in_message_) {
+                fail(conn, k_protocol_error);
+                return false;
+            }
+            break;
+        case k_close:
+        case k_ping:
+        case k_pong:
+            if (!header_.fin || header_.payload_length > k_max_control_payload) {
+                fail(conn, k_protocol_error);
+                return false;
+            }
+            break;
+        default:
+            fail(conn, k_protocol_error);
+            return false;
+    }
+    if (is_control(header_.opcode)) {
+        control_.clear();
+    } else {
+        if (header_.payload_length > options_->max_message_size - message_.size()) {
+            fail(conn, k_message_too_big);
+            return false;
+        }
+        if (header_.opcode != k_continuation) {
+            in_message_ = true;
+            message_binary_ = header_.opcode == k_binary;
+        }
+        message_.reserve(message_.size() + static_cast<size_t>(header_.payload_length));
+    }
+    in_frame_ = true;
+    frame_remaining_ = header_.payload_length;
+    frame_received_ = 0;
+    return true;
+}
+
+void WebSocketConnection::end_frame(const TcpConnectionPtr &conn) {
+    switch (header_.opcode) {
+        case k_close:
+            handle_close(conn);
+            return;
+        case k_ping:
+            if (!close_sent_) {
+                Buffer output;
+                append_frame(&output, k_pong, control_.data(), control_.size());
+                conn->send(output.peek(), output.readable_bytes());
+            }
+            return;
+        case k_pong:
+            awaiting_pong_ = false;
+            return;
+        default:
+            break;
+    }
+    if (!header_.fin) {
+        return;
+    }
+    in_message_ = false;
+    if (!message_binary_ && !valid_utf8(message_.data(), message_.size())) {
+        fail(conn, k_invalid_payload);
+        return;
+    }
+    if (handler_->on_message) {
+        handler_->on_message(shared_from_this(), message_, message_binary_);
+    }
+    if (message_.capacity() > k_retained_capacity) {
+        std::string().swap(message_);
+    } else {
+        message_.clear();
+    }
+}
+
+/**
+ * @brief 收到关闭帧，还没有发出关闭帧时回送同样的状态码，然后由服务端先断开TCP连接
+ */
+void WebSocketConnection::handle_close(const TcpConnectionPtr &conn) {
+    uint16_t code = k_no_status_received;
+    if (control_.size() == 1) {
+        fail(conn, k_protocol_error);
+        return;
+    }
+    if (control_.size() >= 2) {
+        code = static_cast<uint16_t>((static_cast<unsigned char>(control_[0]) << 8) |
+                                     static_cast<unsigned char>(control_[1]));
+        if (!valid_close_code(code)) {
+            fail(conn, k_protocol_error);
+            return;
+        }
+        if (!valid_utf8(control_.data() + 2, control_.size() - 2)) {
+            fail(conn, k_invalid_payload);
+            return;
+        }
+    }
+    close_received_ = true;
+    close_code_ = code;
+    if (!close_sent_) {
+        close_sent_ = true;
+        Buffer output;
+        append_close_frame(&output, code);
+        conn->send(output.peek(), output.readable_bytes());
+    }
+    conn->shutdown();
+}
+
+void WebSocketConnection::fail(const TcpConnectionPtr &conn, uint16_t code) {
+    LOG_DEBUG << "WebSocketConnection::fail [" << conn->name() << "] close code " << code;
+    failed_ = true;
+    if (!close_sent_) {
+        close_sent_ = true;
+        Buffer output;
+        append_close_frame(&output, code);
+        conn->send(output.peek(), output.readable_bytes());
+    }
+    conn->shutdown();
+    start_close_timer();
+}
+
+void WebSocketConnection::on_disconnected() {
+    if (disconnected_) {
+        return;
+    }
+    disconnected_ = true;
+    if (options_->ping_interval > 0) {
+        loop_->cancel(ping_timer_);
+    }
+    if (handler_->on_close) {
+        handler_->on_close(shared_from_this(), close_received_ ? close_code_ : static_cast<uint16_t>(k_abnormal_closure));
+    }
+}
+
+void WebSocketConnection::send(Opcode opcode, const void *data, size_t len) {
+    if (loop_->is_in_loop_thread()) {
+        Buffer output;
+        append_frame(&output, opcode, data, len);
+        send_in_loop(output.peek(), output.readable_bytes());
+    } else {
+        send(make_frame(opcode, boost::string_ref(static_cast<const char *>(data), len)));
+    }
+}
+
+void WebSocketConnection::send(const Frame &frame) {
+    if (loop_->is_in_loop_thread()) {
+        send_in_loop(frame->data(), frame->size());
+    } else {
+        // 帧由shared_ptr共享，跨线程广播时也不复制
+        WebSocketPtr self(shared_from_this());
+        loop_->run_in_loop([self, frame]() {
+            self->send_in_loop(frame->data(), frame->size());
+        });
+    }
+}
+
+void WebSocketConnection::send_in_loop(const char *data, size_t len) {
+    if (close_sent_) {
+        return;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (conn) {
+        conn->send(data, len);
+    }
+}
+
+void WebSocketConnection::close(uint16_t code, const std::string &reason) {
+    loop_->run_in_loop(std::bind(&WebSocketConnection::close_in_loop, shared_from_this(), code, reason));
+}
+
+void WebSocketConnection::close_in_loop(uint16_t code, const std::string &reason) {
+    TcpConnectionPtr conn = conn_.lock();
+    if (close_sent_ || !conn) {
+        return;
+    }
+    close_sent_ = true;
+    Buffer output;
+    append_close_frame(&output, code, reason);
+    conn->send(output.peek(), output.readable_bytes());
+    start_close_timer();
+}
+
+void WebSocketConnection::start_close_timer() {
+    std::weak_ptr<WebSocketConnection> weak(shared_from_this());
+    loop_->run_after(k_close_timeout, [weak]() {
+        WebSocketPtr self = weak.lock();
+        TcpConnectionPtr conn = self ? self->conn_.lock() : TcpConnectionPtr();
+        if (conn) {
+            conn->force_close();
+        }
+    });
+}
+
+/**
+ * @brief 上个周期收到过数据就不需要ping；发出ping之后整个周期没有收到任何数据，认为对端已经失去响应
+ */
+void WebSocketConnection::on_ping_timer() {
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || disconnected_) {
+        return;
+    }
+    if (received_since_ping_) {
+        received_since_ping_ = false;
+        awaiting_pong_ = false;
+        return;
+    }
+    if (awaiting_pong_) {
+        LOG_WARN << "WebSocketConnection [" << conn->name() << "] ping timeout";
+        conn->force_close();
+        return;
+    }
+    if (!close_sent_) {
+        Buffer output;
+        append_frame(&output, k_ping, nullptr, 0);
+        conn->send(output.peek(), output.readable_bytes());
+        awaiting_pong_ = true;
+    }
+}
+
+} // namespace http
+
+} // namespace web_server
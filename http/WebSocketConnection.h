@@ -0,0 +1,173 @@
+/**
+ * @brief 一个WebSocket连接上的协议状态
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_WEBSOCKETCONNECTION_H
+#define WEB_SERVER_HTTP_WEBSOCKETCONNECTION_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <boost/any.hpp>
+
+#include "base/Noncopyable.h"
+#include "base/Timestamp.h"
+#include "http/WebSocket.h"
+#include "net/Callbacks.h"
+#include "net/TimerID.h"
+
+namespace web_server {
+
+namespace net {
+class EventLoop;
+}
+
+namespace http {
+
+class HttpRequest;
+class WebSocketConnection;
+using WebSocketPtr = std::shared_ptr<WebSocketConnection>;
+
+struct WebSocketOptions {
+    size_t max_message_size = 16 * 1024 * 1024;    // 分片重组后的消息上限，超过时以1009关闭
+    double ping_interval = 30.0;                    // 空闲多少秒发送ping，连续两个周期没有收到任何数据视为断开，0表示关闭
+};
+
+/**
+ * @brief WebSocket的回调，都在连接所属的IO线程中调用
+ */
+struct WebSocketHandler {
+    /**
+     * @brief 是否接受这个升级请求，为空表示都接受；返回false时请求按普通http请求交给http回调
+     */
+    std::function<bool(const HttpRequest &)> accept;
+    std::function<void(const WebSocketPtr &, const HttpRequest &)> on_open;
+    /**
+     * @brief 收到一个完整的消息，分片的消息已经重组
+     */
+    std::function<void(const WebSocketPtr &, const std::string &, bool binary)> on_message;
+    /**
+     * @brief 连接断开，code是对端关闭帧中的状态码，没有收到关闭帧时为1006
+     */
+    std::function<void(const WebSocketPtr &, uint16_t code)> on_close;
+};
+
+/**
+ * @brief 握手完成之后的WebSocket连接
+ * HttpServer握手之后把TcpConnection的消息回调换成on_data，帧头和负载可以分多次到达，
+ * 负载边到达边解掩码并追加到消息中，不需要先缓存完整的帧；控制帧可以插在分片之间。
+ * 发送函数可以在任意线程调用；对象只持有TcpConnection的弱引用
+ */
+class WebSocketConnection : private Noncopyable,
+                            public std::enable_shared_from_this<WebSocketConnection> {
+public:
+    WebSocketConnection(const net::TcpConnectionPtr &conn,
+                        const WebSocketHandler *handler,
+                        const WebSocketOptions *options);
+
+    /**
+     * @brief 调用on_open并开始ping定时器
+     */
+    void start(const HttpRequest &req);
+
+    void on_data(const net::TcpConnectionPtr &conn, net::Buffer *buf, Timestamp receive_time);
+
+    /**
+     * @brief TCP连接已经断开，停止定时器并调用on_close
+     */
+    void on_disconnected();
+
+    void send_text(const std::string &message) {
+        send(websocket::k_text, message.data(), message.size());
+    }
+
+    void send_binary(const void *data, size_t len) {
+        send(websocket::k_binary, data, len);
+    }
+
+    void send(websocket::Opcode opcode, const void *data, size_t len);
+
+    /**
+     * @brief 发送make_frame预先编码好的帧，广播时同一个帧发给所有连接，只编码一次
+     */
+    void send(const websocket::Frame &frame);
+
+    /**
+     * @brief 发起关闭握手，之后不再发送数据，等对端的关闭帧到达后断开
+     */
+    void close(uint16_t code = websocket::k_normal_closure, const std::string &reason = std::string());
+
+    /**
+     * @brief 底层的连接，已经断开时为空
+     */
+    net::TcpConnectionPtr connection() const {
+        return conn_.lock();
+    }
+
+    /**
+     * @brief 留给使用者保存与连接相关的数据，只在IO线程中访问
+     */
+    boost::any *context() {
+        return &context_;
+    }
+
+private:
+    bool begin_frame(const net::TcpConnectionPtr &conn);
+    void end_frame(const net::TcpConnectionPtr &conn);
+    void handle_close(const net::TcpConnectionPtr &conn);
+    /**
+     * @brief 协议错误，发出关闭帧后关闭连接，之后收到的数据都被丢弃
+     */
+    void fail(const net::TcpConnectionPtr &conn, uint16_t code);
+    void send_in_loop(const char *data, size_t len);
+    void close_in_loop(uint16_t code, const std::string &reason);
+    /**
+     * @brief 发出关闭帧之后，对端在k_close_timeout秒内没有断开就强制关闭
+     */
+    void start_close_timer();
+    void on_ping_timer();
+
+    static const double k_close_timeout;
+    /**
+     * @brief 消息结束后保留的缓冲容量，更大的缓冲释放掉，避免一个大消息长期占用内存
+     */
+    static const size_t k_retained_capacity = 64 * 1024;
+
+    std::weak_ptr<net::TcpConnection> conn_;
+    net::EventLoop *loop_;
+    const WebSocketHandler *handler_;
+    const WebSocketOptions *options_;
+    // 正在接收的帧
+    bool in_frame_;
+    websocket::FrameHeader header_;
+    uint64_t frame_remaining_;
+    size_t frame_received_;
+    std::string control_;                           // 控制帧的负载
+    // 正在重组的消息
+    bool in_message_;
+    bool message_binary_;
+    std::string message_;
+    // 关闭握手
+    bool failed_;
+    bool close_sent_;
+    bool close_received_;
+    uint16_t close_code_;
+    bool disconnected_;
+    // 心跳
+    net::TimerID ping_timer_;
+    bool received_since_ping_;
+    bool awaiting_pong_;
+    boost::any context_;
+};
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_WEBSOCKETCONNECTION_H
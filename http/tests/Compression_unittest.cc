@@ -0,0 +1,319 @@
+/**
+ * @brief 响应压缩测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/Compression.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/Router.h"
+#include "http/StaticFile.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19530;
+
+std::string g_root;
+std::string g_text;
+const HttpServer *g_server = nullptr;
+
+/**
+ * @brief 解压gzip或zlib格式的数据
+ */
+std::string inflate_all(const std::string &data) {
+    z_stream stream;
+    memset(&stream, 0, sizeof stream);
+    int ret = ::inflateInit2(&stream, 15 + 32);
+    assert(ret == Z_OK);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    std::string output;
+    char buf[16384];
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(buf);
+        stream.avail_out = sizeof buf;
+        ret = ::inflate(&stream, Z_NO_FLUSH);
+        assert(ret == Z_OK || ret == Z_STREAM_END);
+        output.append(buf, sizeof buf - stream.avail_out);
+    } while (ret != Z_STREAM_END);
+    ::inflateEnd(&stream);
+    return output;
+}
+
+bool is_gzip(const std::string &data) {
+    return data.size() > 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+           static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+void test_negotiate() {
+    printf("test_negotiate\n");
+    assert(negotiate_coding("gzip, deflate, br") == k_gzip);
+    assert(negotiate_coding("deflate, gzip") == k_gzip);
+    assert(negotiate_coding("deflate") == k_deflate);
+    assert(negotiate_coding("gzip;q=0.5, deflate;q=0.8") == k_deflate);
+    assert(negotiate_coding("gzip;q=0, deflate") == k_deflate);
+    assert(negotiate_coding("GZIP ; q=1.0") == k_gzip);
+    assert(negotiate_coding("x-gzip") == k_gzip);
+    assert(negotiate_coding("*") == k_gzip);
+    assert(negotiate_coding("*;q=0.1, gzip;q=0") == k_deflate);
+    assert(negotiate_coding("br, identity") == k_identity);
+    assert(negotiate_coding("gzip;q=0, deflate;q=0") == k_identity);
+    assert(negotiate_coding("gzip;q=2") == k_identity);
+    assert(negotiate_coding("") == k_identity);
+
+    assert(is_compressible_type("text/html; charset=utf-8"));
+    assert(is_compressible_type("application/json"));
+    assert(is_compressible_type("application/javascript; charset=utf-8"));
+    assert(is_compressible_type("image/svg+xml"));
+    assert(!is_compressible_type("image/png"));
+    assert(!is_compressible_type("application/gzip"));
+    assert(!is_compressible_type(""));
+}
+
+void test_codec() {
+    printf("test_codec\n");
+    std::string gz = compress_all(k_gzip, 6, g_text.data(), g_text.size());
+    assert(is_gzip(gz));
+    assert(gz.size() < g_text.size() / 4);
+    assert(inflate_all(gz) == g_text);
+    std::string zl = compress_all(k_deflate, 6, g_text.data(), g_text.size());
+    assert(!is_gzip(zl));
+    assert(inflate_all(zl) == g_text);
+    assert(inflate_all(compress_all(k_gzip, 1, "", 0)).empty());
+
+    // 流式压缩：每次调用后输出的数据都可以立即解压出已输入的内容
+    Compressor compressor(k_gzip, 6);
+    Buffer output;
+    std::string all;
+    for (size_t i = 0; i < g_text.size(); i += 10000) {
+        size_t len = std::min<size_t>(10000, g_text.size() - i);
+        compressor.compress(g_text.data() + i, len, false, &output);
+        assert(output.readable_bytes() > 0);
+        all += output.retrieve_all_as_string();
+        compressor.compress(nullptr, 0, false, &output);
+        assert(output.readable_bytes() == 0);
+    }
+    compressor.compress(nullptr, 0, true, &output);
+    all += output.retrieve_all_as_string();
+    assert(inflate_all(all) == g_text);
+}
+
+void test_cache() {
+    printf("test_cache\n");
+    CompressionCache cache(100);
+    auto value = [](size_t n) {
+        return CompressionCache::Value(new std::string(n, 'x'));
+    };
+    cache.put("a", value(40));
+    cache.put("b", value(40));
+    assert(cache.get("a"));
+    cache.put("c", value(40));
+    // a最近用过，淘汰b
+    assert(!cache.get("b"));
+    assert(cache.get("a") && cache.get("c"));
+    assert(cache.bytes() == 82);
+    cache.put("d", value(200));
+    assert(!cache.get("d"));
+    assert(cache.hits() == 3 && cache.misses() == 2);
+}
+
+Response get(int fd, std::string *pending, const std::string &path, const std::string &headers) {
+    write_all(fd, "GET " + path + " HTTP/1.1\r\n" + headers + "\r\n");
+    return read_response(fd, pending);
+}
+
+void test_server() {
+    printf("test_server\n");
+    int fd = connect_server(k_port);
+    std::string pending;
+    const CompressionCache &cache = g_server->compressor()->cache();
+
+    Response r = get(fd, &pending, "/text", "Accept-Encoding: gzip, deflate\r\n");
+    assert(r.headers.find("HTTP/1.1 200") == 0);
+    assert(r.has("Content-Encoding: gzip"));
+    assert(r.has("Vary: Accept-Encoding"));
+    assert(r.has("ETag: \"v1-gzip\""));
+    assert(is_gzip(r.body) && inflate_all(r.body) == g_text);
+
+    // 同一个ETag只压缩一次
+    int64_t misses = cache.misses();
+    r = get(fd, &pending, "/text", "Accept-Encoding: gzip\r\n");
+    assert(inflate_all(r.body) == g_text);
+    assert(cache.misses() == misses);
+
+    r = get(fd, &pending, "/text", "Accept-Encoding: gzip;q=0, deflate\r\n");
+    assert(r.has("Content-Encoding: deflate") && r.has("ETag: \"v1-deflate\""));
+    assert(!is_gzip(r.body) && inflate_all(r.body) == g_text);
+
+    // 不接受压缩时原样发送，仍带Vary
+    r = get(fd, &pending, "/text", "");
+    assert(r.body == g_text && r.has("ETag: \"v1\"") && r.has("Vary: Accept-Encoding"));
+    assert(!r.has("Content-Encoding: gzip"));
+
+    // 压缩版本的ETag可以直接得到304，原始ETag不匹配
+    r = get(fd, &pending, "/text", "Accept-Encoding: gzip\r\nIf-None-Match: \"v1-gzip\"\r\n");
+    assert(r.headers.find("HTTP/1.1 304") == 0 && r.has("ETag: \"v1-gzip\""));
+    r = get(fd, &pending, "/text", "Accept-Encoding: gzip\r\nIf-None-Match: \"v1\"\r\n");
+    assert(r.headers.find("HTTP/1.1 200") == 0 && inflate_all(r.body) == g_text);
+
+    // Range请求不压缩
+    r = get(fd, &pending, "/text", "Accept-Encoding: gzip\r\nRange: bytes=0-9\r\n");
+    assert(r.headers.find("HTTP/1.1 206") == 0 && r.body == g_text.substr(0, 10));
+
+    // 低于阈值、不可压缩的类型不压缩，路由可以单独设置阈值
+    r = get(fd, &pending, "/small", "Accept-Encoding: gzip\r\n");
+    assert(r.body == "small body" && !r.has("Vary: Accept-Encoding"));
+    r = get(fd, &pending, "/small-compressed", "Accept-Encoding: gzip\r\n");
+    assert(r.has("Content-Encoding: gzip") && inflate_all(r.body) == "small body");
+    r = get(fd, &pending, "/never", "Accept-Encoding: gzip\r\n");
+    assert(r.body == g_text);
+    r = get(fd, &pending, "/static/image.png", "Accept-Encoding: gzip\r\n");
+    assert(r.body == g_text && !r.has("Content-Encoding: gzip"));
+
+    // 静态文件从fd读出压缩，之后命中缓存
+    misses = cache.misses();
+    r = get(fd, &pending, "/static/app.js", "Accept-Encoding: gzip\r\n");
+    assert(r.has("Content-Encoding: gzip") && inflate_all(r.body) == g_text);
+    assert(cache.misses() == misses + 1);
+    int64_t hits = cache.hits();
+    r = get(fd, &pending, "/static/app.js", "Accept-Encoding: gzip\r\n");
+    assert(inflate_all(r.body) == g_text);
+    assert(cache.hits() == hits + 1 && cache.misses() == misses + 1);
+
+    // HEAD的Content-Length是压缩后的长度
+    write_all(fd, "HEAD /static/app.js HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    Response head = read_response(fd, &pending, true);
+    assert(header_value(head.headers, "Content-Length") == std::to_string(r.body.size()));
+
+    // 流式响应边生产边压缩，改为chunked
+    r = get(fd, &pending, "/stream", "Accept-Encoding: gzip\r\n");
+    assert(r.has("Transfer-Encoding: chunked") && r.has("Content-Encoding: gzip"));
+    assert(inflate_all(r.body) == g_text);
+    r = get(fd, &pending, "/stream", "");
+    assert(r.body == g_text);
+    ::close(fd);
+
+    // http/1.0不认识chunked，压缩后的流式响应以关闭连接结束
+    fd = connect_server(k_port);
+    pending.clear();
+    write_all(fd, "GET /stream HTTP/1.0\r\nConnection: Keep-Alive\r\nAccept-Encoding: gzip\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.has("Content-Encoding: gzip") && r.has("Connection: close"));
+    assert(!r.has("Transfer-Encoding: chunked"));
+    assert(inflate_all(r.body) == g_text);
+    ::close(fd);
+}
+
+void write_file(const std::string &path, const std::string &content) {
+    FILE *fp = ::fopen(path.c_str(), "w");
+    assert(fp);
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+}
+
+void text_handler(HttpResponse *resp, const std::string &body) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_content_type("text/plain");
+    resp->set_body(body);
+}
+
+} // namespace
+
+int main() {
+    for (int i = 0; g_text.size() < 200000; ++i) {
+        g_text += "line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog\n";
+    }
+    test_negotiate();
+    test_codec();
+    test_cache();
+
+    char dir[] = "/tmp/compression_test_XXXXXX";
+    assert(::mkdtemp(dir));
+    g_root = dir;
+    write_file(g_root + "/app.js", g_text);
+    write_file(g_root + "/image.png", g_text);
+
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        Router router;
+        router.get("/text", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, g_text);
+            resp->add_header("ETag", "\"v1\"");
+        });
+        router.get("/small", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, "small body");
+        });
+        router.get("/small-compressed", with_compress_min_size(
+            [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+                text_handler(resp, "small body");
+            }, 0));
+        router.get("/never", with_compress_min_size(
+            [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+                text_handler(resp, g_text);
+            }, -1));
+        router.get("/stream", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, "");
+            std::shared_ptr<size_t> offset(new size_t(0));
+            resp->set_body_stream([offset](Buffer *output) {
+                size_t len = std::min<size_t>(7000, g_text.size() - *offset);
+                output->append(g_text.data() + *offset, len);
+                *offset += len;
+                return *offset < g_text.size();
+            });
+        });
+        router.get("/static/*filepath", StaticFileHandler(g_root));
+        HttpServer server(&loop, InetAddress(k_port), "compression");
+        server.set_http_callback([&router](const HttpRequest &req, HttpResponse *resp) {
+            router.dispatch(req, resp);
+        });
+        CompressionOptions options;
+        options.min_size = 100;
+        server.enable_compression(options);
+        // 压缩在计算线程中执行
+        server.set_worker_thread_num(2);
+        server.start();
+        g_server = &server;
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_server();
+
+    server_loop->quit();
+    server_thread.join();
+    std::string cmd = "rm -rf " + g_root;
+    int ret = ::system(cmd.c_str());
+    assert(ret == 0);
+    (void)ret;
+    printf("all tests passed\n");
+    return 0;
+}
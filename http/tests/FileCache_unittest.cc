@@ -0,0 +1,236 @@
+/**
+ * @brief file cache test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Thread.h"
+#include "http/FileCache.h"
+#include "http/StaticFile.h"
+#include "net/EventLoop.h"
+
+using web_server::Thread;
+using web_server::http::FileCache;
+using web_server::http::StaticFile;
+using web_server::net::EventLoop;
+
+namespace {
+
+std::string g_root;
+
+void write_file(const std::string &path, const std::string &content) {
+    FILE *fp = ::fopen(path.c_str(), "w");
+    assert(fp);
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+}
+
+std::string file_path(int i) {
+    return g_root + "/f" + std::to_string(i) + ".txt";
+}
+
+int count_open_fds() {
+    int count = 0;
+    DIR *dir = ::opendir("/proc/self/fd");
+    assert(dir);
+    while (::readdir(dir)) {
+        ++count;
+    }
+    ::closedir(dir);
+    return count;
+}
+
+/**
+ * @brief 运行一小段时间的loop，处理inotify事件
+ */
+void run_events(EventLoop *loop) {
+    loop->run_after(0.05, [loop] { loop->quit(); });
+    loop->loop();
+}
+
+std::shared_ptr<StaticFile> must_open(FileCache *cache, const std::string &path) {
+    int saved_errno = 0;
+    std::shared_ptr<StaticFile> file = cache->open(path, &saved_errno);
+    assert(file);
+    return file;
+}
+
+void test_hit_and_lru(EventLoop *loop) {
+    printf("test_hit_and_lru\n");
+    FileCache cache(loop, 4, 1);
+    std::shared_ptr<StaticFile> first = must_open(&cache, file_path(0));
+    assert(must_open(&cache, file_path(0)) == first);
+    assert(cache.hits() == 1 && cache.misses() == 1);
+    assert(first->size() == 2);
+    assert(std::string(first->content_type()) == "text/plain; charset=utf-8");
+    assert(first->etag().size() > 2 && first->etag().front() == '"' && first->etag().back() == '"');
+    assert(first->last_modified().size() == 29);
+    assert(first->last_modified().compare(25, 4, " GMT") == 0);
+
+    for (int i = 1; i < 4; ++i) {
+        must_open(&cache, file_path(i));
+    }
+    // f0最近用过，加入f4时淘汰f1
+    must_open(&cache, file_path(0));
+    must_open(&cache, file_path(4));
+    assert(cache.size() == 4);
+    int64_t misses = cache.misses();
+    must_open(&cache, file_path(0));
+    must_open(&cache, file_path(2));
+    assert(cache.misses() == misses);
+    must_open(&cache, file_path(1));
+    assert(cache.misses() == misses + 1);
+
+    int saved_errno = 0;
+    assert(!cache.open(g_root + "/missing", &saved_errno));
+    assert(saved_errno == ENOENT);
+    assert(!cache.open(g_root, &saved_errno));
+    assert(saved_errno == EISDIR);
+    assert(cache.size() == 4);
+}
+
+void test_fd_bound(EventLoop *loop) {
+    printf("test_fd_bound\n");
+    FileCache cache(loop, 8);
+    int before = count_open_fds();
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            must_open(&cache, file_path(i));
+        }
+    }
+    assert(cache.size() <= 8);
+    assert(count_open_fds() - before <= 8);
+}
+
+void test_invalidation(EventLoop *loop) {
+    printf("test_invalidation\n");
+    FileCache cache(loop, 16);
+    std::string path = file_path(7);
+    std::shared_ptr<StaticFile> old_file = must_open(&cache, path);
+    std::string old_etag = old_file->etag();
+
+    // 原地修改
+    write_file(path, "modified content");
+    run_events(loop);
+    std::shared_ptr<StaticFile> file = must_open(&cache, path);
+    assert(file != old_file);
+    assert(file->size() == 16);
+    assert(file->etag() != old_etag);
+    // 旧的响应仍然持有旧文件
+    assert(old_file->size() == 2);
+
+    // 原子替换
+    std::string tmp = g_root + "/tmp.txt";
+    write_file(tmp, "replaced");
+    assert(::rename(tmp.c_str(), path.c_str()) == 0);
+    run_events(loop);
+    file = must_open(&cache, path);
+    assert(file->size() == 8);
+
+    // 删除
+    ::unlink(path.c_str());
+    run_events(loop);
+    int saved_errno = 0;
+    assert(!cache.open(path, &saved_errno));
+    assert(saved_errno == ENOENT);
+    write_file(path, "f7");
+
+    // 子目录整体删除
+    std::string sub = g_root + "/sub";
+    ::mkdir(sub.c_str(), 0755);
+    write_file(sub + "/a.css", "a");
+    write_file(sub + "/b.css", "b");
+    must_open(&cache, sub + "/a.css");
+    must_open(&cache, sub + "/b.css");
+    size_t size = cache.size();
+    std::string cmd = "rm -rf " + sub;
+    assert(::system(cmd.c_str()) == 0);
+    run_events(loop);
+    assert(cache.size() == size - 2);
+    assert(!cache.open(sub + "/a.css", &saved_errno));
+}
+
+void test_threads(EventLoop *loop) {
+    printf("test_threads\n");
+    FileCache cache(loop, 8);
+    const int k_threads = 4;
+    const int k_lookups = 20000;
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < k_threads; ++t) {
+        threads.emplace_back(new Thread([&cache, t] {
+            for (int i = 0; i < k_lookups; ++i) {
+                int n = (i * 7 + t) % 12;
+                std::shared_ptr<StaticFile> file = must_open(&cache, file_path(n));
+                assert(file->size() == static_cast<off_t>(std::to_string(n).size() + 1));
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto &thr : threads) {
+        thr->join();
+    }
+    assert(cache.hits() + cache.misses() == k_threads * k_lookups);
+    assert(cache.size() <= 8);
+}
+
+/**
+ * @brief 一个线程反复改写文件并立即打开，loop线程同时处理inotify事件；
+ * 打开期间处理掉的失效不能让旧文件留在缓存中，全部事件处理完之后必须看到最后的内容
+ */
+void test_invalidate_while_opening(EventLoop *loop) {
+    printf("test_invalidate_while_opening\n");
+    FileCache cache(loop, 16);
+    std::string path = g_root + "/racy.txt";
+    const int k_rounds = 2000;
+    Thread writer([&cache, &path, loop] {
+        for (int i = 0; i < k_rounds; ++i) {
+            write_file(path, std::string(i % 7 + 1, 'x'));
+            must_open(&cache, path);
+        }
+        loop->quit();
+    });
+    writer.start();
+    loop->loop();
+    writer.join();
+    run_events(loop);
+    assert(must_open(&cache, path)->size() == static_cast<off_t>((k_rounds - 1) % 7 + 1));
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/file_cache_test_XXXXXX";
+    assert(::mkdtemp(dir));
+    g_root = dir;
+    for (int i = 0; i < 50; ++i) {
+        write_file(file_path(i), "f" + std::to_string(i));
+    }
+
+    EventLoop loop;
+    test_hit_and_lru(&loop);
+    test_fd_bound(&loop);
+    test_invalidation(&loop);
+    test_threads(&loop);
+    test_invalidate_while_opening(&loop);
+
+    std::string cmd = "rm -rf " + g_root;
+    int ret = ::system(cmd.c_str());
+    assert(ret == 0);
+    (void)ret;
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * @brief HPACK测试，用例取自RFC 7541附录C
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "http/Hpack.h"
+
+using std::string;
+using namespace web_server::http::hpack;
+
+namespace {
+
+string to_hex(const string &s) {
+    static const char k_digits[] = "0123456789abcdef";
+    string hex;
+    for (unsigned char c : s) {
+        hex.push_back(k_digits[c >> 4]);
+        hex.push_back(k_digits[c & 0xf]);
+    }
+    return hex;
+}
+
+string from_hex(const string &hex) {
+    string s;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        s.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return s;
+}
+
+string huffman(const string &s) {
+    string out;
+    huffman_encode(s, &out);
+    assert(out.size() == huffman_encoded_length(s));
+    return to_hex(out);
+}
+
+void test_huffman_table() {
+    printf("test_huffman_table\n");
+    // 规范码表必须是完整的前缀码：sum(2^-len) == 1
+    uint64_t kraft = 0;
+    for (int sym = 0; sym <= 256; ++sym) {
+        kraft += 1ULL << (30 - huffman_code(sym).bits);
+    }
+    assert(kraft == (1ULL << 30));
+    assert(huffman_code(0).code == 0x1ff8 && huffman_code(0).bits == 13);
+    assert(huffman_code(' ').code == 0x14 && huffman_code(' ').bits == 6);
+    assert(huffman_code('z').code == 0x7b && huffman_code('z').bits == 7);
+    assert(huffman_code(128).code == 0xfffe6 && huffman_code(128).bits == 20);
+    assert(huffman_code(255).code == 0x3ffffee && huffman_code(255).bits == 26);
+    assert(huffman_code(256).code == 0x3fffffff && huffman_code(256).bits == 30);
+}
+
+void test_huffman() {
+    printf("test_huffman\n");
+    assert(huffman("www.example.com") == "f1e3c2e5f23a6ba0ab90f4ff");
+    assert(huffman("no-cache") == "a8eb10649cbf");
+    assert(huffman("custom-key") == "25a849e95ba97d7f");
+    assert(huffman("custom-value") == "25a849e95bb8e8b4bf");
+    assert(huffman("302") == "6402");
+    assert(huffman("307") == "640eff");
+    assert(huffman("private") == "aec3771a4b");
+    assert(huffman("gzip") == "9bd9ab");
+    assert(huffman("Mon, 21 Oct 2013 20:13:21 GMT") == "d07abe941054d444a8200595040b8166e082a62d1bff");
+    assert(huffman("https://www.example.com") == "9d29ad171863c78f0b97c8e9ae82ae43d3");
+
+    string all;
+    for (int c = 0; c < 256; ++c) {
+        all.push_back(static_cast<char>(c));
+    }
+    string encoded;
+    huffman_encode(all, &encoded);
+    string decoded;
+    assert(huffman_decode(encoded, &decoded) && decoded == all);
+
+    // 填充超过7位、填充不全为1、显式的EOS都是错误
+    decoded.clear();
+    assert(!huffman_decode(from_hex("f1e3c2e5f23a6ba0ab90f4ffff"), &decoded));
+    decoded.clear();
+    assert(!huffman_decode(from_hex("64"), &decoded));
+    decoded.clear();
+    assert(!huffman_decode(from_hex("fffffffc"), &decoded));
+}
+
+void test_integer() {
+    printf("test_integer\n");
+    string out;
+    encode_integer(10, 5, 0, &out);
+    assert(to_hex(out) == "0a");
+    out.clear();
+    encode_integer(1337, 5, 0, &out);
+    assert(to_hex(out) == "1f9a0a");
+    out.clear();
+    encode_integer(42, 8, 0, &out);
+    assert(to_hex(out) == "2a");
+
+    boost::string_ref data("\x1f\x9a\x0a!", 4);
+    uint64_t value = 0;
+    assert(decode_integer(&data, 5, &value) && value == 1337 && data == "!");
+    data = boost::string_ref("\x1f\x9a", 2);
+    assert(!decode_integer(&data, 5, &value));
+    data = boost::string_ref("\x1f\xff\xff\xff\xff\xff\x01", 7);
+    assert(!decode_integer(&data, 5, &value));
+}
+
+void expect_headers(const HeaderList &headers, const HeaderList &expected) {
+    assert(headers == expected);
+}
+
+void test_decode_requests() {
+    printf("test_decode_requests\n");
+    // C.4 带Huffman编码的三个连续请求
+    Decoder decoder;
+    HeaderList headers;
+    assert(decoder.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), &headers));
+    expect_headers(headers, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"},
+                             {":authority", "www.example.com"}});
+    assert(decoder.table().size() == 57);
+
+    headers.clear();
+    assert(decoder.decode(from_hex("828684be5886a8eb10649cbf"), &headers));
+    expect_headers(headers, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"},
+                             {":authority", "www.example.com"}, {"cache-control", "no-cache"}});
+    assert(decoder.table().size() == 110);
+
+    headers.clear();
+    assert(decoder.decode(from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), &headers));
+    expect_headers(headers, {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                             {":authority", "www.example.com"}, {"custom-key", "custom-value"}});
+    assert(decoder.table().size() == 164 && decoder.table().count() == 3);
+
+    // C.2.2 不加入动态表的字面量，C.2.3 永不索引的字面量
+    Decoder plain;
+    headers.clear();
+    assert(plain.decode(from_hex("040c2f73616d706c652f70617468"), &headers));
+    expect_headers(headers, {{":path", "/sample/path"}});
+    headers.clear();
+    assert(plain.decode(from_hex("100870617373776f726406736563726574"), &headers));
+    expect_headers(headers, {{"password", "secret"}});
+    assert(plain.table().count() == 0);
+}
+
+void test_decode_responses_with_eviction() {
+    printf("test_decode_responses_with_eviction\n");
+    // C.6 表大小为256时的三个连续响应，第二、三个响应会淘汰旧条目
+    Decoder decoder(256);
+    HeaderList headers;
+    assert(decoder.decode(from_hex("488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff"
+                                   "6e919d29ad171863c78f0b97c8e9ae82ae43d3"),
+                          &headers));
+    assert(headers.size() == 4 && headers[0].second == "302" && headers[3].second == "https://www.example.com");
+    assert(decoder.table().size() == 222);
+
+    headers.clear();
+    assert(decoder.decode(from_hex("4883640effc1c0bf"), &headers));
+    assert(headers.size() == 4 && headers[0].second == "307" && headers[1].second == "private");
+    assert(decoder.table().size() == 222);
+
+    headers.clear();
+    assert(decoder.decode(from_hex("88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7"
+                                   "f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d"
+                                   "5007"),
+                          &headers));
+    assert(headers.size() == 6);
+    assert(headers[0] == Header(":status", "200"));
+    assert(headers[4] == Header("content-encoding", "gzip"));
+    assert(headers[5].first == "set-cookie" &&
+           headers[5].second == "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1");
+    assert(decoder.table().size() == 215 && decoder.table().count() == 3);
+}
+
+void test_decode_errors() {
+    printf("test_decode_errors\n");
+    HeaderList headers;
+    Decoder decoder;
+    // 索引0和越界索引
+    assert(!decoder.decode(from_hex("80"), &headers));
+    assert(!decoder.decode(from_hex("be"), &headers));
+    // 字符串长度超过剩余数据
+    assert(!decoder.decode(from_hex("0085f2b2"), &headers));
+    // 表大小更新超过SETTINGS_HEADER_TABLE_SIZE，或者出现在字段之后
+    assert(!decoder.decode(from_hex("3fe21f"), &headers));
+    assert(!decoder.decode(from_hex("823f00"), &headers));
+    Decoder sized;
+    assert(sized.decode(from_hex("20"), &headers) && sized.table().max_size() == 0);
+
+    Decoder limited(4096, 64);
+    headers.clear();
+    assert(!limited.decode(from_hex("0008") + string(8, 'a') + from_hex("1e") + string(30, 'b'), &headers));
+}
+
+void test_round_trip() {
+    printf("test_round_trip\n");
+    Encoder encoder;
+    Decoder decoder;
+    HeaderList response = {{":status", "200"}, {"content-type", "text/html; charset=utf-8"},
+                           {"content-length", "1234"}, {"server", "web_server"},
+                           {"authorization", "Basic Zm9vOmJhcg=="}, {"x-empty", ""}};
+    string first;
+    encoder.encode(response, &first);
+    HeaderList decoded;
+    assert(decoder.decode(first, &decoded) && decoded == response);
+
+    // 第二次发送时，加入过动态表的字段都编码为一个字节的索引
+    response[2].second = "99";
+    string second;
+    encoder.encode(response, &second);
+    assert(second.size() < first.size() / 2);
+    decoded.clear();
+    assert(decoder.decode(second, &decoded) && decoded == response);
+    assert(encoder.table().size() == decoder.table().size());
+
+    // 对端缩小表后先发送表大小更新，之后两边的表仍然一致
+    encoder.set_max_table_size(64);
+    string third;
+    encoder.encode(response, &third);
+    assert(static_cast<unsigned char>(third[0]) == 0x3f);
+    decoded.clear();
+    assert(decoder.decode(third, &decoded) && decoded == response);
+    assert(decoder.table().max_size() == 64 && encoder.table().size() == decoder.table().size());
+}
+
+} // namespace
+
+int main() {
+    test_huffman_table();
+    test_huffman();
+    test_integer();
+    test_decode_requests();
+    test_decode_responses_with_eviction();
+    test_decode_errors();
+    test_round_trip();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,535 @@
+/**
+ * @brief h2c测试：prior knowledge和Upgrade两种方式、多路复用、流量控制和协议错误
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/Hpack.h"
+#include "http/Http2Frame.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/Router.h"
+#include "http/StaticFile.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::http2;
+
+namespace {
+
+const uint16_t k_port = 19531;
+const uint16_t k_offload_port = 19532;
+
+std::string g_root;
+std::string g_text;
+
+struct Response {
+    std::string status;
+    hpack::HeaderList headers;
+    std::string body;
+    bool ended = false;
+    uint32_t rst_error = k_no_error;
+
+    std::string header(const std::string &name) const {
+        for (const hpack::Header &h : headers) {
+            if (h.first == name) {
+                return h.second;
+            }
+        }
+        return std::string();
+    }
+};
+
+/**
+ * @brief 测试用的阻塞式HTTP/2客户端，收到DATA后立即补回窗口
+ */
+class Client {
+public:
+    explicit Client(uint16_t port) : goaway_error_(-1) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int ret = ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+        assert(ret == 0);
+        (void)ret;
+    }
+
+    ~Client() {
+        ::close(fd_);
+    }
+
+    void write_raw(const std::string &data) {
+        ssize_t n = ::write(fd_, data.data(), data.size());
+        assert(n == static_cast<ssize_t>(data.size()));
+        (void)n;
+    }
+
+    void send(Buffer *buf) {
+        write_raw(buf->retrieve_all_as_string());
+    }
+
+    void start(const std::vector<Setting> &settings = std::vector<Setting>()) {
+        Buffer buf;
+        buf.append(k_client_preface, k_client_preface_length);
+        append_settings(&buf, settings);
+        send(&buf);
+    }
+
+    void request(uint32_t stream_id, const std::string &method, const std::string &path,
+                 const hpack::HeaderList &extra = hpack::HeaderList()) {
+        std::string block;
+        encoder_.encode(":method", method, &block);
+        encoder_.encode(":scheme", "http", &block);
+        encoder_.encode(":path", path, &block);
+        encoder_.encode(":authority", "localhost", &block);
+        encoder_.encode(extra, &block);
+        Buffer buf;
+        // 故意用很小的帧长把头部块拆成HEADERS和CONTINUATION
+        append_header_block(&buf, stream_id, block, true, path == "/continuation" ? 8 : k_default_max_frame_size);
+        send(&buf);
+        responses_[stream_id];
+    }
+
+    /**
+     * @brief 读一帧并处理，返回帧头供调用者检查
+     */
+    FrameHeader read_frame(std::string *payload) {
+        while (pending_.size() < k_frame_header_length) {
+            read_more();
+        }
+        FrameHeader header;
+        parse_frame_header(pending_.data(), &header);
+        while (pending_.size() < k_frame_header_length + header.length) {
+            read_more();
+        }
+        payload->assign(pending_, k_frame_header_length, header.length);
+        pending_.erase(0, k_frame_header_length + header.length);
+        handle(header, *payload);
+        return header;
+    }
+
+    /**
+     * @brief 读到所有已发请求的流都结束
+     */
+    void wait_all() {
+        std::string payload;
+        while (!all_ended()) {
+            read_frame(&payload);
+        }
+    }
+
+    /**
+     * @brief 读到连接关闭，返回收到的GOAWAY错误码
+     */
+    int wait_goaway() {
+        std::string payload;
+        while (goaway_error_ < 0) {
+            read_frame(&payload);
+        }
+        char c;
+        while (::read(fd_, &c, 1) > 0) {
+        }
+        return goaway_error_;
+    }
+
+    std::map<uint32_t, Response> &responses() {
+        return responses_;
+    }
+
+    int fd() const {
+        return fd_;
+    }
+
+    std::string &pending() {
+        return pending_;
+    }
+
+private:
+    void read_more() {
+        char buf[65536];
+        ssize_t n = ::read(fd_, buf, sizeof buf);
+        assert(n > 0);
+        pending_.append(buf, n);
+    }
+
+    bool all_ended() const {
+        for (const auto &item : responses_) {
+            if (!item.second.ended) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void handle(const FrameHeader &header, const std::string &payload) {
+        Buffer out;
+        switch (header.type) {
+            case k_settings:
+                if (!(header.flags & k_flag_ack)) {
+                    append_settings_ack(&out);
+                }
+                break;
+            case k_headers:
+            case k_continuation: {
+                block_ += payload;
+                if (header.flags & k_flag_end_stream) {
+                    end_stream_ = true;
+                }
+                if (header.flags & k_flag_end_headers) {
+                    Response &r = responses_[header.stream_id];
+                    bool ok = decoder_.decode(block_, &r.headers);
+                    assert(ok);
+                    (void)ok;
+                    r.status = r.header(":status");
+                    r.ended = end_stream_;
+                    block_.clear();
+                    end_stream_ = false;
+                }
+                break;
+            }
+            case k_data: {
+                Response &r = responses_[header.stream_id];
+                assert(!r.ended && !r.status.empty());
+                r.body += payload;
+                r.ended = header.flags & k_flag_end_stream;
+                if (header.length > 0) {
+                    append_window_update(&out, 0, header.length);
+                    if (!r.ended) {
+                        append_window_update(&out, header.stream_id, header.length);
+                    }
+                }
+                break;
+            }
+            case k_rst_stream:
+                responses_[header.stream_id].rst_error = read_uint32(payload.data());
+                responses_[header.stream_id].ended = true;
+                break;
+            case k_goaway:
+                goaway_error_ = static_cast<int>(read_uint32(payload.data() + 4));
+                break;
+            default:
+                break;
+        }
+        if (out.readable_bytes() > 0) {
+            send(&out);
+        }
+    }
+
+    int fd_;
+    std::string pending_;
+    hpack::Encoder encoder_;
+    hpack::Decoder decoder_;
+    std::string block_;
+    bool end_stream_ = false;
+    std::map<uint32_t, Response> responses_;
+    int goaway_error_;
+};
+
+void test_multiplexing(uint16_t port) {
+    printf("test_multiplexing %d\n", port);
+    Client client(port);
+    client.start();
+    // 大于默认窗口的响应体必须等客户端的WINDOW_UPDATE，各个流交替发送
+    const uint32_t n = 60;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t id = 2 * i + 1;
+        switch (i % 4) {
+            case 0:
+                client.request(id, "GET", "/text");
+                break;
+            case 1:
+                client.request(id, "GET", "/hello/" + std::to_string(i));
+                break;
+            case 2:
+                client.request(id, "GET", "/stream");
+                break;
+            default:
+                client.request(id, "GET", "/static/file.txt");
+                break;
+        }
+    }
+    client.wait_all();
+    for (uint32_t i = 0; i < n; ++i) {
+        const Response &r = client.responses()[2 * i + 1];
+        assert(r.status == "200" && r.rst_error == k_no_error);
+        if (i % 4 == 1) {
+            assert(r.body == "hello " + std::to_string(i));
+        } else {
+            assert(r.body == g_text);
+        }
+        if (i % 4 != 2) {
+            assert(r.header("content-length") == std::to_string(r.body.size()));
+        }
+        assert(r.header("connection").empty());
+    }
+}
+
+void test_requests() {
+    printf("test_requests\n");
+    Client client(k_port);
+    client.start({{k_settings_initial_window_size, 1 << 20}, {k_settings_max_frame_size, 1 << 16}});
+    // 请求首部按HTTP/1.1的写法交给回调，:authority变成Host
+    client.request(1, "GET", "/echo?x=1", {{"accept-language", "zh"}, {"cookie", "a=1"}, {"cookie", "b=2"}});
+    client.request(3, "HEAD", "/text");
+    client.request(5, "PATCH", "/text");
+    client.request(7, "GET", "/missing");
+    client.request(9, "GET", "/continuation");
+    client.request(11, "GET", "/text", {{"range", "bytes=0-9"}});
+    client.request(13, "GET", "/static/file.txt", {{"if-none-match", "*"}});
+    client.wait_all();
+    std::map<uint32_t, Response> &r = client.responses();
+    assert(r[1].body == "/echo ?x=1 localhost zh a=1; b=2 2");
+    assert(r[3].status == "200" && r[3].body.empty());
+    assert(r[3].header("content-length") == std::to_string(g_text.size()));
+    assert(r[5].status == "400");
+    assert(r[7].status == "404");
+    assert(r[9].status == "404");
+    assert(r[11].status == "206" && r[11].body == g_text.substr(0, 10));
+    assert(r[11].header("content-range") == "bytes 0-9/" + std::to_string(g_text.size()));
+    assert(r[13].status == "304" && r[13].body.empty() && r[13].header("content-length").empty());
+
+    // PING原样返回，不受前面的流影响
+    Buffer buf;
+    append_frame_header(&buf, 8, k_ping, 0, 0);
+    buf.append("12345678", 8);
+    client.send(&buf);
+    std::string payload;
+    FrameHeader header;
+    do {
+        header = client.read_frame(&payload);
+    } while (header.type != k_ping);
+    assert((header.flags & k_flag_ack) && payload == "12345678");
+}
+
+void test_flow_control() {
+    printf("test_flow_control\n");
+    Client client(k_port);
+    // 流窗口为0时只能收到响应头，窗口打开后才有DATA
+    client.start({{k_settings_initial_window_size, 0}});
+    client.request(1, "GET", "/text");
+    std::string payload;
+    FrameHeader header;
+    do {
+        header = client.read_frame(&payload);
+    } while (header.type != k_headers);
+    assert(header.stream_id == 1 && !(header.flags & k_flag_end_stream));
+
+    Buffer buf;
+    append_window_update(&buf, 1, 100);
+    client.send(&buf);
+    header = client.read_frame(&payload);
+    assert(header.type == k_data && header.length == 100);
+    assert(payload == g_text.substr(0, 100));
+
+    // 调大初始窗口对已有的流按差值生效
+    append_settings(&buf, {{k_settings_initial_window_size, 1 << 20}});
+    client.send(&buf);
+    client.wait_all();
+    assert(client.responses()[1].body == g_text);
+}
+
+void upgrade(const std::string &request) {
+    Client client(k_port);
+    client.write_raw(request);
+    std::string &pending = client.pending();
+    char buf[4096];
+    while (pending.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = ::read(client.fd(), buf, sizeof buf);
+        assert(n > 0);
+        pending.append(buf, n);
+    }
+    assert(pending.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    assert(pending.find("Upgrade: h2c\r\n") != std::string::npos);
+    pending.erase(0, pending.find("\r\n\r\n") + 4);
+
+    client.start();
+    client.responses()[1];
+    client.request(3, "GET", "/hello/second");
+    client.wait_all();
+    assert(client.responses()[1].body == "hello upgrade");
+    assert(client.responses()[3].body == "hello second");
+}
+
+void test_upgrade() {
+    printf("test_upgrade\n");
+    // HTTP2-Settings: SETTINGS_MAX_CONCURRENT_STREAMS = 100
+    upgrade("GET /hello/upgrade HTTP/1.1\r\nHost: localhost\r\nConnection: Upgrade, HTTP2-Settings\r\n"
+            "Upgrade: h2c\r\nHTTP2-Settings: AAMAAABk\r\n\r\n");
+    // 首部名称和token都不区分大小写
+    upgrade("GET /hello/upgrade HTTP/1.1\r\nhost: localhost\r\nconnection: keep-alive, upgrade, http2-settings\r\n"
+            "upgrade: H2C\r\nhttp2-settings: AAMAAABk\r\n\r\n");
+
+    // 普通的HTTP/1.1请求不受影响
+    char buf[4096];
+    Client plain(k_port);
+    plain.write_raw("GET /hello/h1 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::string response;
+    while (response.find("hello h1") == std::string::npos) {
+        ssize_t n = ::read(plain.fd(), buf, sizeof buf);
+        assert(n > 0);
+        response.append(buf, n);
+    }
+    assert(response.find("HTTP/1.1 200") == 0);
+}
+
+void test_errors() {
+    printf("test_errors\n");
+    {
+        // 前言之后第一帧不是SETTINGS
+        Client client(k_port);
+        Buffer buf;
+        buf.append(k_client_preface, k_client_preface_length);
+        append_window_update(&buf, 0, 100);
+        client.send(&buf);
+        assert(client.wait_goaway() == k_protocol_error);
+    }
+    {
+        // 无法解码的头部块
+        Client client(k_port);
+        client.start();
+        Buffer buf;
+        append_frame_header(&buf, 1, k_headers, k_flag_end_headers | k_flag_end_stream, 1);
+        buf.append("\xff", 1);
+        client.send(&buf);
+        assert(client.wait_goaway() == k_compression_error);
+    }
+    {
+        // 连接窗口溢出
+        Client client(k_port);
+        client.start();
+        Buffer buf;
+        append_window_update(&buf, 0, k_max_window_size);
+        client.send(&buf);
+        assert(client.wait_goaway() == k_flow_control_error);
+    }
+    {
+        // 流标识必须递增，流级别的错误只重置该流
+        Client client(k_port);
+        client.start();
+        client.request(5, "GET", "/hello/a");
+        client.wait_all();
+        Buffer buf;
+        append_frame_header(&buf, 5, k_priority, 0, 7);
+        buf.append("\0\0\0\0\0", 5);
+        append_frame_header(&buf, 4, k_priority, 0, 9);
+        buf.append("\0\0\0\0", 4);
+        client.send(&buf);
+        std::string payload;
+        FrameHeader header;
+        do {
+            header = client.read_frame(&payload);
+        } while (header.type != k_rst_stream);
+        assert(header.stream_id == 9 && read_uint32(payload.data()) == k_frame_size_error);
+        client.request(3, "GET", "/hello/b");
+        assert(client.wait_goaway() == k_stream_closed);
+    }
+}
+
+void write_file(const std::string &path, const std::string &content) {
+    FILE *fp = ::fopen(path.c_str(), "w");
+    assert(fp);
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+}
+
+void text_handler(HttpResponse *resp, const std::string &body) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_content_type("text/plain");
+    resp->set_body(body);
+}
+
+} // namespace
+
+int main() {
+    for (int i = 0; g_text.size() < 200000; ++i) {
+        g_text += "line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog\n";
+    }
+    char dir[] = "/tmp/http2_test_XXXXXX";
+    assert(::mkdtemp(dir));
+    g_root = dir;
+    write_file(g_root + "/file.txt", g_text);
+
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        Router router;
+        router.get("/text", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, g_text);
+            resp->add_header("ETag", "\"v1\"");
+        });
+        router.get("/hello/:name", [](const HttpRequest &, const RouteParams &params, HttpResponse *resp) {
+            text_handler(resp, "hello " + params.get("name").to_string());
+        });
+        router.get("/echo", [](const HttpRequest &req, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, req.path() + " " + req.query() + " " + req.get_header("Host") + " " +
+                               req.get_header("Accept-Language") + " " + req.get_header("Cookie") + " " +
+                               std::to_string(static_cast<int>(req.get_version() == HttpRequest::k_http2) + 1));
+        });
+        router.get("/stream", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            text_handler(resp, "");
+            std::shared_ptr<size_t> offset(new size_t(0));
+            resp->set_body_stream([offset](Buffer *output) {
+                size_t len = std::min<size_t>(7000, g_text.size() - *offset);
+                output->append(g_text.data() + *offset, len);
+                *offset += len;
+                return *offset < g_text.size();
+            });
+        });
+        router.get("/static/*filepath", StaticFileHandler(g_root));
+        auto callback = [&router](const HttpRequest &req, HttpResponse *resp) {
+            router.dispatch(req, resp);
+        };
+        HttpServer server(&loop, InetAddress(k_port), "http2");
+        server.set_http_callback(callback);
+        server.start();
+        // 卸载模式下的响应从计算线程回到IO线程后按流发送
+        HttpServer offload_server(&loop, InetAddress(k_offload_port), "http2-offload");
+        offload_server.set_http_callback(callback);
+        offload_server.set_worker_thread_num(2);
+        offload_server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_multiplexing(k_port);
+    test_multiplexing(k_offload_port);
+    test_requests();
+    test_flow_control();
+    test_upgrade();
+    test_errors();
+
+    server_loop->quit();
+    server_thread.join();
+    std::string cmd = "rm -rf " + g_root;
+    int ret = ::system(cmd.c_str());
+    assert(ret == 0);
+    (void)ret;
+    printf("all tests passed\n");
+    return 0;
+}
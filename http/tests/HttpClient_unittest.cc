@@ -0,0 +1,387 @@
+/**
+ * @brief HttpClient的响应分帧、keep-alive复用、流水线、超时与断开重试测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/HttpClient.h"
+#include "http/HttpContext.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponseParser.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpServer.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+
+namespace {
+
+const uint16_t k_port = 19542;
+const uint16_t k_down_port = 19543;
+
+std::atomic<int> g_connections(0);
+
+std::string pattern(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    return data;
+}
+
+/**
+ * @brief 手写的服务端，按路径返回不同分帧方式的响应
+ * /len/<n>和/chunked/<n>返回n字节，/close/<n>返回n字节后关闭连接，/bye带Connection: close，
+ * /count返回该连接上的请求序号，/hold暂不响应，直到/release到达时按顺序响应，
+ * /echo回显请求体，/silent从不响应，/bad返回无效的响应行
+ */
+struct ServerSession {
+    HttpContext context;
+    HttpBodyReader body_reader;
+    std::string body;
+    bool in_body = false;
+    int requests = 0;
+    std::vector<std::string> held;
+};
+
+std::string ok_response(const std::string &body) {
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void respond(const TcpConnectionPtr &conn, ServerSession *session, const HttpRequest &req) {
+    const std::string &path = req.path();
+    if (path.compare(0, 5, "/len/") == 0) {
+        std::string body = pattern(strtoul(path.c_str() + 5, nullptr, 10));
+        if (req.method() == HttpRequest::k_head) {
+            conn->send("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n");
+        } else {
+            conn->send(ok_response(body));
+        }
+    } else if (path.compare(0, 9, "/chunked/") == 0) {
+        std::string data = pattern(strtoul(path.c_str() + 9, nullptr, 10));
+        std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (size_t offset = 0; offset < data.size(); offset += 1000) {
+            size_t n = std::min<size_t>(1000, data.size() - offset);
+            char size_line[32];
+            snprintf(size_line, sizeof size_line, "%zx\r\n", n);
+            response += size_line + data.substr(offset, n) + "\r\n";
+        }
+        response += "0\r\n\r\n";
+        conn->send(response);
+    } else if (path.compare(0, 7, "/close/") == 0) {
+        conn->send("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + pattern(strtoul(path.c_str() + 7, nullptr, 10)));
+        conn->shutdown();
+    } else if (path == "/bye") {
+        conn->send("HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 3\r\n\r\nbye");
+        conn->shutdown();
+    } else if (path == "/count") {
+        conn->send(ok_response(std::to_string(session->requests)));
+    } else if (path.compare(0, 6, "/hold/") == 0) {
+        session->held.push_back(path.substr(6));
+    } else if (path == "/release") {
+        for (const std::string &body : session->held) {
+            conn->send(ok_response(body));
+        }
+        session->held.clear();
+        conn->send(ok_response("released"));
+    } else if (path == "/echo") {
+        conn->send(ok_response(session->body));
+    } else if (path == "/bad") {
+        conn->send("NOT-HTTP\r\n\r\n");
+    } else if (path != "/silent") {
+        conn->send("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+}
+
+void server_message(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receive_time) {
+    ServerSession *session = boost::any_cast<ServerSession>(conn->get_mutable_context());
+    while (buf->readable_bytes() > 0) {
+        if (!session->in_body) {
+            bool ok = session->context.parse_request(buf, receive_time);
+            assert(ok);
+            (void)ok;
+            if (!session->context.got_all()) {
+                return;
+            }
+            const std::string &length = session->context.request().get_header("Content-Length");
+            session->body_reader.reset(length.empty() ? HttpBodyReader::k_none : HttpBodyReader::k_length,
+                                       atoll(length.c_str()));
+            session->in_body = true;
+        }
+        size_t n = session->body_reader.feed(buf->peek(), buf->readable_bytes(), &session->body);
+        buf->retrieve(n);
+        if (!session->body_reader.done()) {
+            return;
+        }
+        ++session->requests;
+        respond(conn, session, session->context.request());
+        session->context.reset();
+        session->body.clear();
+        session->in_body = false;
+    }
+}
+
+void server_connection(const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+        ++g_connections;
+        conn->set_context(ServerSession());
+    }
+}
+
+void run_sync(EventLoop *loop, const std::function<void()> &f) {
+    CountDownLatch latch(1);
+    loop->run_in_loop([&]() {
+        f();
+        latch.count_down();
+    });
+    latch.wait();
+}
+
+/**
+ * @brief 在测试线程中提交请求并等待回调
+ */
+HttpClientResponse fetch(HttpClient *client, const HttpClientRequest &req) {
+    CountDownLatch latch(1);
+    HttpClientResponse result;
+    client->request(req, [&](const HttpClientResponse &response) {
+        assert(client->get_loop()->is_in_loop_thread());
+        result = response;
+        latch.count_down();
+    });
+    latch.wait();
+    return result;
+}
+
+HttpClientResponse fetch(HttpClient *client, const std::string &path, const std::string &method = "GET") {
+    HttpClientRequest req;
+    req.method = method;
+    req.path = path;
+    return fetch(client, req);
+}
+
+HttpClient *create_client(EventLoop *loop, uint16_t port, const HttpClientOptions &options = HttpClientOptions()) {
+    HttpClient *client = nullptr;
+    run_sync(loop, [&]() {
+        client = new HttpClient(loop, InetAddress("127.0.0.1", port), "client", options);
+    });
+    return client;
+}
+
+void destroy_client(HttpClient *client) {
+    run_sync(client->get_loop(), [client]() {
+        delete client;
+    });
+}
+
+void test_framing_and_keep_alive(EventLoop *loop) {
+    printf("test_framing_and_keep_alive\n");
+    int connections = g_connections.load();
+    HttpClient *client = create_client(loop, k_port);
+    HttpClientResponse response = fetch(client, "/len/1000");
+    assert(response.error == HttpClientResponse::k_ok);
+    assert(response.status_code == 200 && response.status_message == "OK");
+    assert(response.body == pattern(1000));
+    assert(response.get_header("content-length") == "1000");
+
+    response = fetch(client, "/chunked/25000");
+    assert(response.error == HttpClientResponse::k_ok && response.body == pattern(25000));
+
+    // HEAD的响应有Content-Length但没有响应体
+    response = fetch(client, "/len/50", "HEAD");
+    assert(response.error == HttpClientResponse::k_ok && response.body.empty());
+
+    HttpClientRequest req;
+    req.method = "POST";
+    req.path = "/echo";
+    req.body = pattern(70000);
+    response = fetch(client, req);
+    assert(response.error == HttpClientResponse::k_ok && response.body == req.body);
+
+    response = fetch(client, "/missing");
+    assert(response.error == HttpClientResponse::k_ok && response.status_code == 404);
+
+    // 以上请求都在同一个连接上
+    response = fetch(client, "/count");
+    assert(response.body == "6");
+    assert(g_connections.load() == connections + 1);
+    destroy_client(client);
+}
+
+void test_pipelining(EventLoop *loop) {
+    printf("test_pipelining\n");
+    HttpClientOptions options;
+    options.max_pipeline = 4;
+    HttpClient *client = create_client(loop, k_port, options);
+    CountDownLatch latch(4);
+    std::vector<std::string> order;
+    auto record = [&](const HttpClientResponse &response) {
+        assert(response.error == HttpClientResponse::k_ok);
+        order.push_back(response.body);
+        latch.count_down();
+    };
+    // 不流水线时/hold的响应要等/release，会一直等下去
+    run_sync(loop, [&]() {
+        client->get("/hold/1", record);
+        client->get("/hold/2", record);
+        client->get("/hold/3", record);
+        client->get("/release", record);
+        assert(client->pending() == 4);
+    });
+    latch.wait();
+    assert(order.size() == 4);
+    assert(order[0] == "1" && order[1] == "2" && order[2] == "3" && order[3] == "released");
+
+    // 非幂等请求不放进流水线：POST要等/hold的响应，/hold因此超时，POST在新连接上发出
+    HttpClient *strict = create_client(loop, k_port, options);
+    CountDownLatch strict_latch(2);
+    std::vector<HttpClientResponse::Error> errors;
+    run_sync(loop, [&]() {
+        auto collect = [&](const HttpClientResponse &response) {
+            errors.push_back(response.error);
+            strict_latch.count_down();
+        };
+        HttpClientRequest hold;
+        hold.path = "/hold/x";
+        hold.timeout = 0.2;
+        strict->request(hold, collect);
+        HttpClientRequest post;
+        post.method = "POST";
+        post.path = "/release";
+        strict->request(post, collect);
+    });
+    strict_latch.wait();
+    assert(errors.size() == 2);
+    assert(errors[0] == HttpClientResponse::k_timeout && errors[1] == HttpClientResponse::k_ok);
+    destroy_client(strict);
+    destroy_client(client);
+}
+
+void test_connection_close(EventLoop *loop) {
+    printf("test_connection_close\n");
+    HttpClient *client = create_client(loop, k_port);
+    int connections = g_connections.load();
+    HttpClientResponse response = fetch(client, "/bye");
+    assert(response.error == HttpClientResponse::k_ok && response.body == "bye");
+    response = fetch(client, "/count");
+    assert(response.error == HttpClientResponse::k_ok && response.body == "1");
+    assert(g_connections.load() == connections + 2);
+
+    // 没有长度的响应读到连接关闭为止
+    response = fetch(client, "/close/300000");
+    assert(response.error == HttpClientResponse::k_ok && response.body == pattern(300000));
+
+    // 流水线上Connection: close之后的请求在新连接上重发
+    HttpClientOptions options;
+    options.max_pipeline = 3;
+    HttpClient *pipelined = create_client(loop, k_port, options);
+    CountDownLatch latch(3);
+    std::vector<std::string> bodies;
+    run_sync(loop, [&]() {
+        auto record = [&](const HttpClientResponse &response) {
+            assert(response.error == HttpClientResponse::k_ok);
+            bodies.push_back(response.body);
+            latch.count_down();
+        };
+        pipelined->get("/bye", record);
+        pipelined->get("/count", record);
+        pipelined->get("/count", record);
+    });
+    latch.wait();
+    assert(bodies.size() == 3 && bodies[0] == "bye" && bodies[1] == "1" && bodies[2] == "2");
+    destroy_client(pipelined);
+    destroy_client(client);
+}
+
+void test_errors(EventLoop *loop) {
+    printf("test_errors\n");
+    HttpClientOptions options;
+    options.request_timeout = 0.2;
+    HttpClient *client = create_client(loop, k_port, options);
+    HttpClientResponse response = fetch(client, "/silent");
+    assert(response.error == HttpClientResponse::k_timeout);
+    // 超时的连接被放弃，之后的请求使用新连接
+    response = fetch(client, "/count");
+    assert(response.error == HttpClientResponse::k_ok && response.body == "1");
+
+    response = fetch(client, "/bad");
+    assert(response.error == HttpClientResponse::k_bad_response);
+    response = fetch(client, "/len/10");
+    assert(response.error == HttpClientResponse::k_ok && response.body == pattern(10));
+    destroy_client(client);
+
+    HttpClientOptions small;
+    small.max_body_size = 1000;
+    client = create_client(loop, k_port, small);
+    response = fetch(client, "/chunked/5000");
+    assert(response.error == HttpClientResponse::k_bad_response);
+    destroy_client(client);
+
+    client = create_client(loop, k_down_port);
+    response = fetch(client, "/");
+    assert(response.error == HttpClientResponse::k_connect_failed);
+    destroy_client(client);
+}
+
+/**
+ * @brief 析构时未完成的请求不再回调
+ */
+void test_destroy_pending(EventLoop *loop) {
+    printf("test_destroy_pending\n");
+    HttpClient *client = create_client(loop, k_port);
+    std::atomic<int> called(0);
+    run_sync(loop, [&]() {
+        client->get("/silent", [&](const HttpClientResponse &) { ++called; });
+        client->get("/len/1", [&](const HttpClientResponse &) { ++called; });
+    });
+    ::usleep(100 * 1000);
+    destroy_client(client);
+    ::usleep(100 * 1000);
+    assert(called.load() == 0);
+}
+
+} // namespace
+
+int main() {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(k_port), "server");
+        server.set_connection_callback(server_connection);
+        server.set_message_callback(server_message);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    EventLoopThread client_thread;
+    EventLoop *loop = client_thread.start_loop();
+    test_framing_and_keep_alive(loop);
+    test_pipelining(loop);
+    test_connection_close(loop);
+    test_errors(loop);
+    test_destroy_pending(loop);
+
+    server_loop->quit();
+    server_thread.join();
+    printf("all tests passed\n");
+    return 0;
+}
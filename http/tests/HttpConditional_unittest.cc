@@ -0,0 +1,231 @@
+/**
+ * @brief 条件请求与Range请求测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "http/HttpConditional.h"
+#include "http/HttpContext.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "net/Buffer.h"
+
+using std::string;
+using web_server::Timestamp;
+using web_server::net::Buffer;
+using namespace web_server::http;
+
+namespace {
+
+const char *k_etag = "\"1a-2b-3c\"";
+const char *k_last_modified = "Sun, 06 Nov 1994 08:49:37 GMT";
+const string k_body = "0123456789abcdefghij";
+
+/**
+ * @brief 解析一个只有请求行和首部的请求
+ */
+HttpRequest make_request(const string &method, const string &headers) {
+    HttpContext context;
+    Buffer input;
+    input.append(method + " /file HTTP/1.1\r\n" + headers + "\r\n");
+    bool ok = context.parse_request(&input, Timestamp::now());
+    assert(ok && context.got_all());
+    (void)ok;
+    return context.request();
+}
+
+HttpResponse make_response() {
+    HttpResponse resp(false);
+    resp.set_status_code(HttpResponse::k_200_ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("text/plain");
+    resp.add_header("ETag", k_etag);
+    resp.add_header("Last-Modified", k_last_modified);
+    resp.set_body(k_body);
+    return resp;
+}
+
+string evaluate(const string &method, const string &headers) {
+    HttpRequest req = make_request(method, headers);
+    HttpResponse resp = make_response();
+    resp.set_head_only(req.method() == HttpRequest::k_head);
+    evaluate_conditional(req, &resp);
+    Buffer output;
+    resp.append_to_buffer(&output);
+    return output.retrieve_all_as_string();
+}
+
+bool contains(const string &s, const string &part) {
+    return s.find(part) != string::npos;
+}
+
+void test_parse_range() {
+    printf("test_parse_range\n");
+    std::vector<ByteRange> ranges;
+    assert(parse_range("bytes=0-9", 100, &ranges) == k_range_satisfiable);
+    assert(ranges.size() == 1 && ranges[0].offset == 0 && ranges[0].length == 10);
+    assert(parse_range("bytes=90-", 100, &ranges) == k_range_satisfiable);
+    assert(ranges[0].offset == 90 && ranges[0].length == 10);
+    assert(parse_range("bytes=-30", 100, &ranges) == k_range_satisfiable);
+    assert(ranges[0].offset == 70 && ranges[0].length == 30);
+    assert(parse_range("bytes=-300", 100, &ranges) == k_range_satisfiable);
+    assert(ranges[0].offset == 0 && ranges[0].length == 100);
+    assert(parse_range("bytes=50-1000", 100, &ranges) == k_range_satisfiable);
+    assert(ranges[0].offset == 50 && ranges[0].length == 50);
+    assert(parse_range("Bytes= 0-0 , 99-99", 100, &ranges) == k_range_satisfiable);
+    assert(ranges.size() == 2 && ranges[1].offset == 99 && ranges[1].length == 1);
+
+    // 顺序保持，重叠时排序合并
+    assert(parse_range("bytes=50-59,0-9", 100, &ranges) == k_range_satisfiable);
+    assert(ranges.size() == 2 && ranges[0].offset == 50);
+    assert(parse_range("bytes=50-59,0-9,5-20,21-30", 100, &ranges) == k_range_satisfiable);
+    assert(ranges.size() == 2 && ranges[0].offset == 0 && ranges[0].length == 31);
+    assert(ranges[1].offset == 50 && ranges[1].length == 10);
+
+    // 不可满足的区间被丢掉，全部不可满足时为416
+    assert(parse_range("bytes=200-300,0-1", 100, &ranges) == k_range_satisfiable);
+    assert(ranges.size() == 1 && ranges[0].offset == 0);
+    assert(parse_range("bytes=100-", 100, &ranges) == k_range_unsatisfiable);
+    assert(parse_range("bytes=-0", 100, &ranges) == k_range_unsatisfiable);
+    assert(parse_range("bytes=0-", 0, &ranges) == k_range_unsatisfiable);
+
+    // 语法错误按没有Range处理
+    assert(parse_range("items=0-9", 100, &ranges) == k_range_ignored);
+    assert(parse_range("bytes=9-0", 100, &ranges) == k_range_ignored);
+    assert(parse_range("bytes=a-b", 100, &ranges) == k_range_ignored);
+    assert(parse_range("bytes=5", 100, &ranges) == k_range_ignored);
+    assert(parse_range("bytes=", 100, &ranges) == k_range_ignored);
+    assert(parse_range("bytes=0-99999999999999999999", 100, &ranges) == k_range_ignored);
+    string many = "bytes=0-0";
+    for (size_t i = 1; i <= k_max_ranges; ++i) {
+        many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+    }
+    assert(parse_range(many, 100, &ranges) == k_range_ignored);
+}
+
+void test_etag_and_date() {
+    printf("test_etag_and_date\n");
+    assert(etag_matches("\"a\"", "\"a\""));
+    assert(etag_matches("\"x\", W/\"a\"", "\"a\""));
+    assert(etag_matches("\"a\"", "W/\"a\""));
+    assert(etag_matches(" * ", "\"a\""));
+    assert(!etag_matches("\"b\", \"c\"", "\"a\""));
+    assert(!etag_matches("\"a", "\"a\""));
+    assert(!etag_matches("\"a\"", ""));
+
+    time_t t = 0;
+    assert(parse_http_date(k_last_modified, &t));
+    assert(t == 784111777);
+    assert(!parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", &t));
+    assert(!parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT junk", &t));
+}
+
+void test_not_modified() {
+    printf("test_not_modified\n");
+    string out = evaluate("GET", string("If-None-Match: \"zz\", ") + k_etag + "\r\n");
+    assert(out.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+    assert(contains(out, string("ETag: ") + k_etag));
+    assert(!contains(out, "Content-Length"));
+    assert(!contains(out, "Content-Type"));
+    assert(out.size() >= 4 && out.compare(out.size() - 4, 4, "\r\n\r\n") == 0);
+
+    out = evaluate("HEAD", "If-None-Match: *\r\n");
+    assert(out.find("HTTP/1.1 304") == 0);
+
+    // If-None-Match不匹配时忽略If-Modified-Since
+    out = evaluate("GET", string("If-None-Match: \"zz\"\r\nIf-Modified-Since: ") + k_last_modified + "\r\n");
+    assert(out.find("HTTP/1.1 200") == 0 && contains(out, k_body));
+
+    out = evaluate("GET", string("If-Modified-Since: ") + k_last_modified + "\r\n");
+    assert(out.find("HTTP/1.1 304") == 0);
+    out = evaluate("GET", "If-Modified-Since: Mon, 07 Nov 1994 00:00:00 GMT\r\n");
+    assert(out.find("HTTP/1.1 304") == 0);
+    out = evaluate("GET", "If-Modified-Since: Sat, 05 Nov 1994 00:00:00 GMT\r\n");
+    assert(out.find("HTTP/1.1 200") == 0);
+    out = evaluate("GET", "If-Modified-Since: yesterday\r\n");
+    assert(out.find("HTTP/1.1 200") == 0);
+
+    // 非GET/HEAD和非200响应不处理
+    out = evaluate("POST", string("If-None-Match: ") + k_etag + "\r\n");
+    assert(out.find("HTTP/1.1 200") == 0);
+    HttpRequest req = make_request("GET", string("If-None-Match: ") + k_etag + "\r\n");
+    HttpResponse resp = make_response();
+    resp.set_status_code(HttpResponse::k_404_not_found);
+    evaluate_conditional(req, &resp);
+    assert(resp.status_code() == HttpResponse::k_404_not_found);
+}
+
+void test_ranges() {
+    printf("test_ranges\n");
+    string out = evaluate("GET", "Range: bytes=2-5\r\n");
+    assert(out.find("HTTP/1.1 206 Partial Content\r\n") == 0);
+    assert(contains(out, "Content-Length: 4\r\n"));
+    assert(contains(out, "Content-Range: bytes 2-5/20\r\n"));
+    assert(out.compare(out.size() - 8, 8, "\r\n\r\n2345") == 0);
+
+    out = evaluate("GET", "Range: bytes=0-1,-2\r\n");
+    assert(out.find("HTTP/1.1 206") == 0);
+    size_t pos = out.find("multipart/byteranges; boundary=");
+    assert(pos != string::npos);
+    string boundary = out.substr(pos + 31, out.find("\r\n", pos) - pos - 31);
+    string body = out.substr(out.find("\r\n\r\n") + 4);
+    string expected = "--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-1/20\r\n\r\n01"
+                      "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 18-19/20\r\n\r\nij"
+                      "\r\n--" + boundary + "--\r\n";
+    assert(body == expected);
+    assert(contains(out, "Content-Length: " + std::to_string(expected.size()) + "\r\n"));
+
+    out = evaluate("GET", "Range: bytes=20-\r\n");
+    assert(out.find("HTTP/1.1 416 Range Not Satisfiable\r\n") == 0);
+    assert(contains(out, "Content-Range: bytes */20\r\n"));
+    assert(contains(out, "Content-Length: 0\r\n"));
+
+    // 语法错误、HEAD请求和失效的If-Range都发送完整响应
+    assert(evaluate("GET", "Range: bytes=5-2\r\n").find("HTTP/1.1 200") == 0);
+    assert(evaluate("HEAD", "Range: bytes=0-1\r\n").find("HTTP/1.1 200") == 0);
+    assert(evaluate("GET", "Range: bytes=0-1\r\nIf-Range: \"old\"\r\n").find("HTTP/1.1 200") == 0);
+    assert(evaluate("GET", string("Range: bytes=0-1\r\nIf-Range: W/") + k_etag + "\r\n").find("HTTP/1.1 200") == 0);
+    assert(evaluate("GET", string("Range: bytes=0-1\r\nIf-Range: ") + k_etag + "\r\n").find("HTTP/1.1 206") == 0);
+    assert(evaluate("GET", string("Range: bytes=0-1\r\nIf-Range: ") + k_last_modified + "\r\n")
+               .find("HTTP/1.1 206") == 0);
+
+    // 文件响应体只调整偏移，多区间时记录每一段
+    HttpRequest req = make_request("GET", "Range: bytes=10-19,0-4\r\n");
+    HttpResponse resp = make_response();
+    resp.set_body_file(3, 100, 20, std::shared_ptr<void>());
+    evaluate_conditional(req, &resp);
+    assert(resp.status_code() == HttpResponse::k_206_partial_content);
+    assert(resp.file_parts().size() == 2);
+    assert(resp.file_parts()[0].offset == 110 && resp.file_parts()[0].length == 10);
+    assert(resp.file_parts()[1].offset == 100 && resp.file_parts()[1].length == 5);
+    int64_t total = static_cast<int64_t>(resp.file_parts_tail().size()) + 15;
+    for (const HttpResponse::FilePart &part : resp.file_parts()) {
+        total += static_cast<int64_t>(part.header.size());
+    }
+    assert(resp.content_length() == total);
+
+    req = make_request("GET", "Range: bytes=-5\r\n");
+    resp = make_response();
+    resp.set_body_file(3, 100, 20, std::shared_ptr<void>());
+    evaluate_conditional(req, &resp);
+    assert(resp.file_parts().empty());
+    assert(resp.file_offset() == 115 && resp.content_length() == 5);
+}
+
+} // namespace
+
+int main() {
+    test_parse_range();
+    test_etag_and_date();
+    test_not_modified();
+    test_ranges();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -79,5 +79,70 @@ int main() {
         assert(request.get_header("User-Agent") == string(""));
         assert(request.get_header("Accept-Encoding") == string(""));
     }
+
+    // 首部名称不区分大小写，没有该首部和首部为空可以区分
+    {
+        HttpContext context;
+        Buffer input;
+        input.append("GET / HTTP/1.1\r\n"
+                     "host: code-david.cn\r\n"
+                     "CONNECTION: keep-alive, Upgrade\r\n"
+                     "Accept:\r\n"
+                     "\r\n");
+        assert(context.parse_request(&input, Timestamp::now()));
+        assert(context.got_all());
+        const HttpRequest &request = context.request();
+        assert(request.get_header("Host") == string("code-david.cn"));
+        assert(request.find_header("Accept") != nullptr);
+        assert(request.find_header("Accept")->empty());
+        assert(request.find_header("Cookie") == nullptr);
+        assert(web_server::http::header_has_token(request.get_header("Connection"), "upgrade"));
+        assert(!web_server::http::header_has_token(request.get_header("Connection"), "close"));
+    }
+
+    // test limits
+    {
+        web_server::http::RequestLimits limits;
+        limits.max_request_line = 32;
+        limits.max_header_count = 2;
+        limits.max_header_bytes = 64;
+
+        // 没有CRLF的请求行超过上限时不等待它结束
+        HttpContext context;
+        context.set_limits(limits);
+        Buffer input;
+        input.append("GET /" + string(40, 'a'));
+        assert(!context.parse_request(&input, Timestamp::now()));
+        assert(context.error() == HttpContext::k_request_line_too_long);
+
+        context.reset();
+        input.retrieve_all();
+        input.append("GET /short HTTP/1.1\r\nA: 1\r\nB: 2\r\n\r\n");
+        assert(context.parse_request(&input, Timestamp::now()));
+        assert(context.got_all());
+        assert(context.error() == HttpContext::k_no_error);
+
+        // reset之后限制仍然有效
+        context.reset();
+        input.append("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n");
+        assert(!context.parse_request(&input, Timestamp::now()));
+        assert(context.error() == HttpContext::k_header_too_large);
+
+        // 首部分多次到达，未完成的首部行也计入字节数
+        context.reset();
+        input.retrieve_all();
+        input.append("GET / HTTP/1.1\r\nA: " + string(30, 'x') + "\r\n");
+        assert(context.parse_request(&input, Timestamp::now()));
+        assert(!context.got_all());
+        input.append("B: " + string(30, 'y'));
+        assert(!context.parse_request(&input, Timestamp::now()));
+        assert(context.error() == HttpContext::k_header_too_large);
+
+        context.reset();
+        input.retrieve_all();
+        input.append("BAD\r\n\r\n");
+        assert(!context.parse_request(&input, Timestamp::now()));
+        assert(context.error() == HttpContext::k_bad_request);
+    }
     printf("test finish successful\n");
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+/**
+ * @brief 请求行、首部大小和请求头接收时间限制的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "http/HttpContext.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19544;
+const double k_header_timeout = 0.3;
+
+void handler(const HttpRequest &req, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body(req.path());
+}
+
+bool starts_with(const std::string &data, const char *prefix) {
+    return data.compare(0, strlen(prefix), prefix) == 0;
+}
+
+void test_request_line() {
+    printf("test_request_line\n");
+    // 没有CRLF的超长请求行，不必等到它结束
+    int fd = connect_server(k_port);
+    write_some(fd, "GET /" + std::string(2000, 'a'));
+    std::string response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 414 URI Too Long\r\n"));
+    assert(response.find("Connection: close") != std::string::npos);
+    ::close(fd);
+
+    fd = connect_server(k_port);
+    write_some(fd, "GET /ok HTTP/1.1\r\n\r\nGET /" + std::string(2000, 'a') + " HTTP/1.1\r\n\r\n");
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 200 OK\r\n"));
+    assert(response.find("HTTP/1.1 414 URI Too Long\r\n") != std::string::npos);
+    ::close(fd);
+
+    fd = connect_server(k_port);
+    write_some(fd, "BAD\r\n\r\n");
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 400 Bad Request\r\n"));
+    ::close(fd);
+}
+
+void test_headers() {
+    printf("test_headers\n");
+    std::string request = "GET / HTTP/1.1\r\n";
+    for (int i = 0; i < 11; ++i) {
+        request += "X-Header-" + std::to_string(i) + ": 1\r\n";
+    }
+    int fd = connect_server(k_port);
+    write_some(fd, request + "\r\n");
+    std::string response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 431 Request Header Fields Too Large\r\n"));
+    ::close(fd);
+
+    // 一个没有结束的超长首部
+    fd = connect_server(k_port);
+    write_some(fd, "GET / HTTP/1.1\r\nX-Large: " + std::string(8000, 'b'));
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 431 Request Header Fields Too Large\r\n"));
+    ::close(fd);
+
+    // 限制以内的请求正常处理
+    request = "GET /within HTTP/1.1\r\n";
+    for (int i = 0; i < 9; ++i) {
+        request += "X-Header-" + std::to_string(i) + ": 1\r\n";
+    }
+    fd = connect_server(k_port);
+    write_some(fd, request + "Connection: close\r\n\r\n");
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 200 OK\r\n"));
+    assert(response.find("/within") != std::string::npos);
+    ::close(fd);
+}
+
+void test_header_timeout() {
+    printf("test_header_timeout\n");
+    // 连接之后什么都不发
+    Timestamp start = Timestamp::now();
+    int fd = connect_server(k_port);
+    std::string response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 408 Request Timeout\r\n"));
+    assert(time_difference(Timestamp::now(), start) >= k_header_timeout * 0.9);
+    ::close(fd);
+
+    // 慢慢发送的请求头，期限从请求开始计算，不会因为数据陆续到达而延长
+    fd = connect_server(k_port);
+    start = Timestamp::now();
+    for (int i = 0; i < 10; ++i) {
+        write_some(fd, i == 0 ? "GET / HTTP/1.1\r\n" : "X: y\r\n");
+        ::usleep(50 * 1000);
+    }
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 408 Request Timeout\r\n"));
+    assert(time_difference(Timestamp::now(), start) < 3 * k_header_timeout + 0.5);
+    ::close(fd);
+
+    // keep-alive连接在请求之间空闲不受限制
+    fd = connect_server(k_port);
+    write_some(fd, "GET /first HTTP/1.1\r\n\r\n");
+    std::string pending;
+    Response first = read_response(fd, &pending);
+    assert(starts_with(first.headers, "HTTP/1.1 200 OK\r\n"));
+    ::usleep(static_cast<useconds_t>(k_header_timeout * 2 * 1000 * 1000));
+    write_some(fd, "GET /second HTTP/1.1\r\nConnection: close\r\n\r\n");
+    response = read_until_close(fd);
+    assert(starts_with(response, "HTTP/1.1 200 OK\r\n"));
+    assert(response.find("/second") != std::string::npos);
+    ::close(fd);
+}
+
+void run_server(int num_threads) {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "limits");
+        server.set_http_callback(handler);
+        server.set_thread_num(num_threads);
+        RequestLimits limits;
+        limits.max_request_line = 1024;
+        limits.max_header_count = 10;
+        limits.max_header_bytes = 4096;
+        limits.header_timeout = k_header_timeout;
+        server.set_request_limits(limits);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_request_line();
+    test_headers();
+    test_header_timeout();
+
+    server_loop->quit();
+    server_thread.join();
+}
+
+} // namespace
+
+int main() {
+    printf("server in base loop\n");
+    run_server(0);
+    printf("server in io threads\n");
+    run_server(2);
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @brief 卸载模式下流水线请求的响应顺序与背压测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ * 
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19527;
+const int k_requests = 40;
+
+/**
+ * @brief 路径为 /<n>，序号越小处理越慢，让完成顺序与请求顺序相反
+ */
+void slow_handler(const HttpRequest &req, HttpResponse *resp) {
+    int n = atoi(req.path().c_str() + 1);
+    usleep((k_requests - n) * 200);
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body(req.path());
+}
+
+void run_client(int num_connections) {
+    std::vector<int> fds;
+    for (int c = 0; c < num_connections; ++c) {
+        int fd = connect_server(k_port);
+        std::string requests;
+        for (int i = 0; i < k_requests; ++i) {
+            requests += "GET /" + std::to_string(i) + " HTTP/1.1\r\nHost: test\r\n\r\n";
+        }
+        // 所有请求一次性写出，形成流水线
+        write_all(fd, requests);
+        fds.push_back(fd);
+    }
+    for (int fd : fds) {
+        std::string pending;
+        for (int i = 0; i < k_requests; ++i) {
+            std::string body = read_response(fd, &pending).body;
+            assert(body == "/" + std::to_string(i));
+        }
+        ::close(fd);
+    }
+}
+
+void test_offload(int num_workers, size_t max_pending) {
+    printf("test offload workers=%d max_pending=%zu\n", num_workers, max_pending);
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "offload");
+        server.set_http_callback(slow_handler);
+        server.set_thread_num(2);
+        server.set_worker_thread_num(num_workers, max_pending);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    run_client(3);
+
+    server_loop->quit();
+    server_thread.join();
+}
+
+} // namespace
+
+int main() {
+    test_offload(4, 65536);
+    // 线程池只允许2个在途请求，其余请求都要经过暂停读取和恢复
+    test_offload(4, 2);
+    printf("test finish successful\n");
+}
@@ -0,0 +1,81 @@
+/**
+ * @brief 有IO线程和计算线程、连接还在传输流式响应时析构HttpServer的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19552;
+const int k_clients = 8;
+
+/**
+ * @brief 无限长的流式响应，客户端不读，连接一直处于写阻塞状态，IO线程中不断有写完成回调排队
+ */
+void endless_handler(const HttpRequest &, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body_stream([](Buffer *output) {
+        output->append(std::string(4096, 'x'));
+        return true;
+    });
+}
+
+/**
+ * @brief TcpServer最后析构：IO线程先退出，它们排队的回调用到的HttpServer成员这时都还有效
+ */
+void test_destroy_busy_server(int workers) {
+    printf("test_destroy_busy_server workers=%d\n", workers);
+    std::vector<int> fds;
+    {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "shutdown");
+        server.set_http_callback(endless_handler);
+        server.set_thread_num(2);
+        if (workers > 0) {
+            server.set_worker_thread_num(workers);
+        }
+        server.start();
+        for (int i = 0; i < k_clients; ++i) {
+            int fd = connect_server(k_port);
+            write_all(fd, "GET /stream HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+                          "GET /next HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+            fds.push_back(fd);
+        }
+        loop.run_after(0.2, [&loop]() {
+            loop.quit();
+        });
+        loop.loop();
+    }
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_destroy_busy_server(0);
+    test_destroy_busy_server(2);
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * @brief 流式响应的编码、顺序与内存上限测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19528;
+const size_t k_piece_size = 4096;
+const int k_large_pieces = 8192;    // 32MB
+
+std::atomic<int64_t> g_produced(0);
+
+// /wait和/poll的生产者在g_ready之前一直没有数据
+std::atomic<bool> g_ready(false);
+std::atomic<int> g_polls(0);
+MutexLock g_resume_mutex;
+std::function<void()> g_resume;
+
+char piece_byte(int index) {
+    return static_cast<char>('a' + index % 26);
+}
+
+/**
+ * @brief 第i块为k_piece_size个相同字节，便于检查顺序
+ */
+HttpResponse::BodyStream make_stream(int pieces) {
+    std::shared_ptr<int> next(new int(0));
+    return [next, pieces](Buffer *output) {
+        std::string piece(k_piece_size, piece_byte(*next));
+        output->append(piece);
+        g_produced += static_cast<int64_t>(piece.size());
+        return ++*next < pieces;
+    };
+}
+
+/**
+ * @brief g_ready之前返回true且不追加数据，之后给出"done"并结束
+ */
+HttpResponse::BodyStream make_waiting_stream() {
+    return [](Buffer *output) {
+        ++g_polls;
+        if (!g_ready.load()) {
+            return true;
+        }
+        output->append("done");
+        return false;
+    };
+}
+
+/**
+ * @brief /stream/<n>为chunked，/sized/<n>带Content-Length，
+ * /wait取得唤醒函数后等待，/poll没有唤醒函数，其余为普通响应
+ */
+void stream_handler(const HttpRequest &req, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    const std::string &path = req.path();
+    if (path.compare(0, 8, "/stream/") == 0) {
+        resp->set_body_stream(make_stream(atoi(path.c_str() + 8)));
+    } else if (path.compare(0, 7, "/sized/") == 0) {
+        int pieces = atoi(path.c_str() + 7);
+        resp->set_body_stream(make_stream(pieces), static_cast<int64_t>(pieces) * k_piece_size);
+    } else if (path == "/wait") {
+        resp->set_body_stream(make_waiting_stream());
+        MutexLockGuard lock(g_resume_mutex);
+        g_resume = resp->stream_resumer();
+    } else if (path == "/poll") {
+        resp->set_body_stream(make_waiting_stream());
+    } else {
+        resp->set_body(path);
+    }
+}
+
+void check_stream_body(const std::string &body, int pieces) {
+    assert(body.size() == static_cast<size_t>(pieces) * k_piece_size);
+    for (int i = 0; i < pieces; ++i) {
+        assert(body[i * k_piece_size] == piece_byte(i));
+        assert(body[(i + 1) * k_piece_size - 1] == piece_byte(i));
+    }
+}
+
+/**
+ * @brief 客户端不读取时，服务端生产的数据受限于socket缓冲加一批数据，不随响应大小增长
+ */
+void test_bounded_chunked() {
+    printf("test_bounded_chunked\n");
+    g_produced = 0;
+    int fd = connect_server(k_port, 64 * 1024);
+    write_all(fd, "GET /stream/" + std::to_string(k_large_pieces) + " HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "GET /after HTTP/1.1\r\nHost: test\r\n\r\n");
+    ::usleep(300 * 1000);
+    int64_t produced = g_produced.load();
+    printf("produced %lld bytes while client is not reading\n", static_cast<long long>(produced));
+    assert(produced < 8 * 1024 * 1024);
+
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 200 OK") == 0);
+    assert(r.headers.find("Content-Length") == std::string::npos);
+    check_stream_body(r.body, k_large_pieces);
+    // 流水线上的下一个请求在流式响应结束后才响应
+    r = read_response(fd, &pending);
+    assert(r.body == "/after");
+    ::close(fd);
+}
+
+void test_sized_and_pipelined() {
+    printf("test_sized_and_pipelined\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /sized/300 HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "GET /one HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "GET /stream/3 HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "GET /two HTTP/1.1\r\nHost: test\r\n\r\n");
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.has("Content-Length: 1228800"));
+    assert(r.headers.find("Transfer-Encoding") == std::string::npos);
+    check_stream_body(r.body, 300);
+    r = read_response(fd, &pending);
+    assert(r.body == "/one");
+    r = read_response(fd, &pending);
+    check_stream_body(r.body, 3);
+    r = read_response(fd, &pending);
+    assert(r.body == "/two");
+    ::close(fd);
+}
+
+/**
+ * @brief http/1.0不支持chunked，长度未知时以关闭连接结束
+ */
+void test_close_delimited() {
+    printf("test_close_delimited\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /stream/5 HTTP/1.0\r\n\r\n");
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.has("Connection: close"));
+    assert(r.headers.find("Transfer-Encoding") == std::string::npos);
+    check_stream_body(r.body, 5);
+    ::close(fd);
+}
+
+/**
+ * @brief 显式带Keep-Alive的http/1.0请求同样不能使用chunked
+ */
+void test_http10_keep_alive() {
+    printf("test_http10_keep_alive\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /stream/5 HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.has("Connection: close"));
+    assert(r.headers.find("Transfer-Encoding") == std::string::npos);
+    check_stream_body(r.body, 5);
+    ::close(fd);
+}
+
+/**
+ * @brief 取得唤醒函数的生产者没有数据时响应暂停，不再反复调用，唤醒之后继续
+ */
+void test_resume() {
+    printf("test_resume\n");
+    g_ready = false;
+    g_polls = 0;
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /wait HTTP/1.1\r\nHost: test\r\n\r\nGET /after HTTP/1.1\r\nHost: test\r\n\r\n");
+    ::usleep(200 * 1000);
+    int polls = g_polls.load();
+    printf("%d polls while waiting\n", polls);
+    assert(polls >= 1 && polls <= 2);
+    g_ready = true;
+    std::function<void()> resume;
+    {
+        MutexLockGuard lock(g_resume_mutex);
+        resume.swap(g_resume);
+    }
+    assert(resume);
+    resume();
+
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.body == "done" && r.has("Transfer-Encoding: chunked"));
+    r = read_response(fd, &pending);
+    assert(r.body == "/after");
+    // 响应结束之后再唤醒没有作用
+    resume();
+    ::close(fd);
+}
+
+/**
+ * @brief 没有唤醒函数的生产者没有数据时按间隔重试，而不是每轮循环都调用
+ */
+void test_poll_backoff() {
+    printf("test_poll_backoff\n");
+    g_ready = false;
+    g_polls = 0;
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /poll HTTP/1.1\r\nHost: test\r\n\r\n");
+    ::usleep(200 * 1000);
+    int polls = g_polls.load();
+    printf("%d polls while waiting\n", polls);
+    assert(polls >= 2 && polls < 100);
+    g_ready = true;
+
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.body == "done");
+    ::close(fd);
+}
+
+void run_server(int num_workers, void (*client)()) {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "stream");
+        server.set_http_callback(stream_handler);
+        server.set_thread_num(1);
+        server.set_worker_thread_num(num_workers);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    client();
+
+    server_loop->quit();
+    server_thread.join();
+}
+
+void run_all_clients() {
+    test_bounded_chunked();
+    test_sized_and_pipelined();
+    test_close_delimited();
+    test_http10_keep_alive();
+    test_resume();
+    test_poll_backoff();
+}
+
+} // namespace
+
+int main() {
+    printf("io thread handlers\n");
+    run_server(0, run_all_clients);
+    printf("offloaded handlers\n");
+    run_server(2, run_all_clients);
+    printf("all tests passed\n");
+    return 0;
+}
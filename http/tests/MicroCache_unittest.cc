@@ -0,0 +1,388 @@
+/**
+ * @brief 响应微缓存的键、淘汰、可缓存规则以及HttpServer中命中和合并未命中的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "http/MicroCache.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19545;
+const double k_ttl = 0.3;
+
+HttpRequest make_request(const char *method, const std::string &path, const std::string &query = std::string()) {
+    HttpRequest req;
+    bool ok = req.set_method(method, method + strlen(method));
+    assert(ok);
+    (void)ok;
+    req.set_path(path.data(), path.data() + path.size());
+    req.set_query(query.data(), query.data() + query.size());
+    return req;
+}
+
+HttpResponse make_response(const std::string &body) {
+    HttpResponse resp(false);
+    resp.set_status_code(HttpResponse::k_200_ok);
+    resp.set_status_message("OK");
+    resp.set_body(body);
+    return resp;
+}
+
+void test_key() {
+    printf("test_key\n");
+    MicroCacheOptions options;
+    options.vary.push_back("Accept-Language");
+    MicroCache cache(options);
+    std::string get_key;
+    std::string head_key;
+    std::string key;
+    assert(cache.make_key(make_request("GET", "/a", "?x=1"), &get_key));
+    assert(cache.make_key(make_request("HEAD", "/a", "?x=1"), &head_key));
+    assert(get_key == head_key);
+    assert(cache.make_key(make_request("GET", "/a", "?x=2"), &key) && key != get_key);
+    assert(cache.make_key(make_request("GET", "/b", "?x=1"), &key) && key != get_key);
+
+    HttpRequest req = make_request("GET", "/a", "?x=1");
+    req.add_header("Accept-Language", "en");
+    assert(cache.make_key(req, &key) && key != get_key);
+    // 不在vary中的首部不影响键
+    req = make_request("GET", "/a", "?x=1");
+    req.add_header("User-Agent", "test");
+    assert(cache.make_key(req, &key) && key == get_key);
+    // 首部名不区分大小写
+    std::string en_key;
+    req = make_request("GET", "/a", "?x=1");
+    req.add_header("Accept-Language", "en");
+    assert(cache.make_key(req, &en_key));
+    req = make_request("GET", "/a", "?x=1");
+    req.add_header("accept-language", "en");
+    assert(cache.make_key(req, &key) && key == en_key);
+
+    assert(!cache.make_key(make_request("POST", "/a"), &key));
+    const char *const bypass[] = {"Authorization", "If-None-Match", "If-Modified-Since", "Range"};
+    for (const char *field : bypass) {
+        req = make_request("GET", "/a");
+        req.add_header(field, "x");
+        assert(!cache.make_key(req, &key));
+    }
+    const char *const lowercase[] = {"authorization", "if-none-match", "if-range", "RANGE"};
+    for (const char *field : lowercase) {
+        req = make_request("GET", "/a");
+        req.add_header(field, "x");
+        assert(!cache.make_key(req, &key));
+    }
+
+    // 默认不缓存带Cookie的请求，可以关闭
+    req = make_request("GET", "/a");
+    req.add_header("cookie", "session=1");
+    assert(!cache.make_key(req, &key));
+    options.bypass_cookie = false;
+    MicroCache cookie_cache(options);
+    std::string plain_key;
+    assert(cookie_cache.make_key(make_request("GET", "/a"), &plain_key));
+    assert(cookie_cache.make_key(req, &key) && key == plain_key);
+}
+
+void test_get_put() {
+    printf("test_get_put\n");
+    MicroCacheOptions options;
+    options.ttl = 1.0;
+    MicroCache cache(options);
+    Timestamp now = Timestamp::now();
+    assert(!cache.get("k", now));
+    HttpResponse resp = make_response("hello");
+    resp.add_header("X-Test", "1");
+    MicroCache::EntryPtr entry = cache.put("k", resp, now);
+    assert(entry);
+    assert(cache.get("k", now) == entry);
+    assert(cache.hits() == 1 && cache.misses() == 1);
+
+    // 保存的是keep-alive形式的完整报文
+    Buffer buf;
+    resp.append_to_buffer(&buf);
+    assert(entry->data == buf.retrieve_all_as_string());
+    assert(entry->data.compare(entry->connection_offset, entry->connection_end - entry->connection_offset,
+                               "Connection: Keep-Alive\r\n") == 0);
+    assert(entry->data.substr(entry->head_length) == "hello");
+
+    // 放入同一个键时替换
+    MicroCache::EntryPtr replaced = cache.put("k", make_response("world"), now);
+    assert(cache.get("k", now) == replaced);
+    assert(cache.size() == 1);
+    assert(cache.bytes() == 1 + replaced->data.size());
+
+    // 过期
+    assert(cache.get("k", add_time(now, 0.9)));
+    assert(!cache.get("k", add_time(now, 1.1)));
+    assert(cache.size() == 0 && cache.bytes() == 0);
+}
+
+void test_lru() {
+    printf("test_lru\n");
+    MicroCacheOptions options;
+    MicroCache::EntryPtr probe = MicroCache(options).put("a", make_response(std::string(100, 'x')), Timestamp::now());
+    size_t entry_bytes = 1 + probe->data.size();
+    options.max_bytes = entry_bytes * 3;
+    MicroCache cache(options);
+    Timestamp now = Timestamp::now();
+    cache.put("a", make_response(std::string(100, 'x')), now);
+    cache.put("b", make_response(std::string(100, 'x')), now);
+    cache.put("c", make_response(std::string(100, 'x')), now);
+    assert(cache.size() == 3);
+    // a最近被使用，淘汰的是b
+    assert(cache.get("a", now));
+    cache.put("d", make_response(std::string(100, 'x')), now);
+    assert(cache.size() == 3 && cache.bytes() <= options.max_bytes);
+    assert(cache.get("a", now));
+    assert(!cache.get("b", now));
+    assert(cache.get("c", now));
+    assert(cache.get("d", now));
+
+    // 超过单个条目上限的不缓存
+    options.max_entry_bytes = 64;
+    MicroCache small(options);
+    assert(!small.put("a", make_response(std::string(100, 'x')), now));
+    assert(small.size() == 0);
+}
+
+void test_cacheable() {
+    printf("test_cacheable\n");
+    MicroCacheOptions options;
+    options.vary.push_back("Accept-Encoding");
+    MicroCache cache(options);
+    Timestamp now = Timestamp::now();
+
+    HttpResponse resp = make_response("x");
+    resp.set_status_code(HttpResponse::k_404_not_found);
+    assert(!cache.put("k", resp, now));
+
+    resp = make_response("x");
+    resp.add_header("Set-Cookie", "id=1");
+    assert(!cache.put("k", resp, now));
+
+    const char *const uncacheable[] = {"no-store", "private", "No-Cache", "max-age=10, private"};
+    for (const char *value : uncacheable) {
+        resp = make_response("x");
+        resp.add_header("Cache-Control", value);
+        assert(!cache.put("k", resp, now));
+    }
+    resp = make_response("x");
+    resp.add_header("Cache-Control", "public, max-age=10");
+    assert(cache.put("k", resp, now));
+
+    resp = make_response("x");
+    resp.add_header("Vary", "Cookie");
+    assert(!cache.put("k", resp, now));
+    resp = make_response("x");
+    resp.add_header("Vary", "accept-encoding");
+    assert(cache.put("k", resp, now));
+
+    resp = make_response("x");
+    resp.set_body_stream([](Buffer *) { return false; });
+    assert(!cache.put("k", resp, now));
+}
+
+void test_fill() {
+    printf("test_fill\n");
+    MicroCache cache{MicroCacheOptions()};
+    MicroCache::Waiter waiter;
+    waiter.seq = 1;
+    assert(!cache.wait_fill("k", waiter));
+    waiter.seq = 2;
+    assert(cache.wait_fill("k", waiter));
+    waiter.seq = 3;
+    assert(cache.wait_fill("k", waiter));
+    assert(!cache.wait_fill("other", waiter));
+    std::vector<MicroCache::Waiter> waiters = cache.finish_fill("k");
+    assert(waiters.size() == 2 && waiters[0].seq == 2 && waiters[1].seq == 3);
+    assert(cache.coalesced() == 2);
+    // 填充结束之后的请求重新成为填充者
+    assert(!cache.wait_fill("k", waiter));
+}
+
+std::atomic<int> g_calls(0);
+std::atomic<int> g_cookie_calls(0);
+std::atomic<int> g_handler_delay_ms(0);     // 回调在计算线程中读取
+
+void handler(const HttpRequest &req, HttpResponse *resp) {
+    if (g_handler_delay_ms.load() > 0) {
+        ::usleep(static_cast<useconds_t>(g_handler_delay_ms.load() * 1000));
+    }
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    if (req.path() == "/cookie") {
+        ++g_cookie_calls;
+        resp->add_header("Set-Cookie", "id=1");
+        resp->set_body("cookie");
+        return;
+    }
+    int calls = ++g_calls;
+    resp->set_body(req.path() + req.query() + "#" + std::to_string(calls));
+}
+
+/**
+ * @brief 发送以Connection: close结尾的请求，返回全部响应
+ */
+std::string round_trip(const std::string &requests) {
+    int fd = connect_server(k_port);
+    write_all(fd, requests);
+    std::string response = read_until_close(fd);
+    ::close(fd);
+    return response;
+}
+
+std::string get(const std::string &target, bool close = true) {
+    return "GET " + target + " HTTP/1.1\r\n" + (close ? "Connection: close\r\n" : "") + "\r\n";
+}
+
+size_t count(const std::string &data, const std::string &pattern) {
+    size_t n = 0;
+    for (size_t pos = data.find(pattern); pos != std::string::npos; pos = data.find(pattern, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+void test_hits() {
+    printf("test_hits\n");
+    int calls = g_calls.load();
+    // 同一个连接上的流水线请求，第二个命中第一个填充的条目
+    std::string response = round_trip(get("/a?x=1", false) + get("/a?x=1"));
+    assert(count(response, "HTTP/1.1 200 OK\r\n") == 2);
+    std::string body = "/a?x=1#" + std::to_string(calls + 1);
+    assert(count(response, body) == 2);
+    assert(response.find("Connection: Keep-Alive\r\n") != std::string::npos);
+    assert(response.find("Connection: close\r\n") != std::string::npos);
+    assert(g_calls.load() == calls + 1);
+
+    // 命中之后改写Connection的报文仍然完整
+    response = round_trip(get("/a?x=1"));
+    assert(response.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    assert(response.find("Content-Length: " + std::to_string(body.size()) + "\r\n") != std::string::npos);
+    assert(response.size() >= body.size() && response.compare(response.size() - body.size(), body.size(), body) == 0);
+
+    // HEAD命中时只有响应头
+    response = round_trip("HEAD /a?x=1 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(response.find("Content-Length: " + std::to_string(body.size()) + "\r\n") != std::string::npos);
+    assert(response.size() >= 4 && response.compare(response.size() - 4, 4, "\r\n\r\n") == 0);
+
+    // 不同的查询串是不同的键
+    response = round_trip(get("/a?x=2"));
+    assert(response.find("/a?x=2#" + std::to_string(calls + 2)) != std::string::npos);
+    assert(g_calls.load() == calls + 2);
+
+    // 过期之后重新执行回调
+    ::usleep(static_cast<useconds_t>(k_ttl * 1.5 * 1000 * 1000));
+    response = round_trip(get("/a?x=1"));
+    assert(response.find("/a?x=1#" + std::to_string(calls + 3)) != std::string::npos);
+
+    // 带Set-Cookie的响应不缓存
+    int cookie_calls = g_cookie_calls.load();
+    round_trip(get("/cookie", false) + get("/cookie"));
+    assert(g_cookie_calls.load() == cookie_calls + 2);
+}
+
+/**
+ * @brief 多个连接同时请求同一个键，卸载模式下只执行一次回调
+ */
+void test_coalesce() {
+    printf("test_coalesce\n");
+    const int k_clients = 8;
+    g_handler_delay_ms = 200;
+    int calls = g_calls.load();
+    int fds[k_clients];
+    for (int i = 0; i < k_clients; ++i) {
+        fds[i] = connect_server(k_port);
+        write_all(fds[i], get("/slow"));
+    }
+    std::string first;
+    for (int i = 0; i < k_clients; ++i) {
+        std::string response = read_until_close(fds[i]);
+        ::close(fds[i]);
+        assert(response.find("/slow#" + std::to_string(calls + 1)) != std::string::npos);
+    }
+    assert(g_calls.load() == calls + 1);
+
+    // 不能缓存的结果让等待者各自执行回调
+    int cookie_calls = g_cookie_calls.load();
+    for (int i = 0; i < k_clients; ++i) {
+        fds[i] = connect_server(k_port);
+        write_all(fds[i], get("/cookie"));
+    }
+    for (int i = 0; i < k_clients; ++i) {
+        std::string response = read_until_close(fds[i]);
+        ::close(fds[i]);
+        assert(response.find("cookie") != std::string::npos);
+    }
+    assert(g_cookie_calls.load() == cookie_calls + k_clients);
+    g_handler_delay_ms = 0;
+}
+
+void run_server(int num_workers) {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        HttpServer server(&loop, InetAddress(k_port), "microcache");
+        server.set_http_callback(handler);
+        server.set_worker_thread_num(num_workers);
+        MicroCacheOptions options;
+        options.ttl = k_ttl;
+        server.enable_microcache(options);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_hits();
+    if (num_workers > 0) {
+        test_coalesce();
+    }
+
+    server_loop->quit();
+    server_thread.join();
+}
+
+} // namespace
+
+int main() {
+    test_key();
+    test_get_put();
+    test_lru();
+    test_cacheable();
+    test_fill();
+    printf("server in io loop\n");
+    run_server(0);
+    printf("server with workers\n");
+    run_server(4);
+    printf("all tests passed\n");
+    return 0;
+}
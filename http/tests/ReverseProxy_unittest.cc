@@ -0,0 +1,446 @@
+/**
+ * @brief 反向代理的转发、连接复用、背压与错误处理测试，上游是在本进程中启动的服务器
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/HttpContext.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpResponseParser.h"
+#include "http/HttpServer.h"
+#include "http/ReverseProxy.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+#include "net/TcpServer.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_proxy_port = 19535;
+const uint16_t k_web_port = 19536;
+const uint16_t k_echo_port = 19537;
+const uint16_t k_down_port = 19538;
+const uint16_t k_silent_port = 19539;
+
+std::atomic<int> g_echo_connections(0);
+
+char pattern_byte(size_t i) {
+    return static_cast<char>('a' + i % 26);
+}
+
+std::string pattern(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = pattern_byte(i);
+    }
+    return data;
+}
+
+/**
+ * @brief 手写的上游：能读请求体，按路径返回不同分帧方式的响应
+ * /echo回显请求体，/headers返回收到的请求首部，/chunked/<n>以chunked返回n字节，/close/<n>返回n字节后关闭连接
+ */
+struct EchoSession {
+    HttpContext context;
+    HttpBodyReader body_reader;
+    std::string body;
+    bool in_body = false;
+};
+
+void echo_respond(const TcpConnectionPtr &conn, const HttpRequest &req, const std::string &body) {
+    const std::string &path = req.path();
+    if (path == "/api/echo") {
+        conn->send("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+    } else if (path == "/api/headers") {
+        std::string dump;
+        for (const auto &header : req.headers()) {
+            dump += header.first + ": " + header.second + "\n";
+        }
+        conn->send("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(dump.size()) + "\r\n\r\n" + dump);
+    } else if (path.compare(0, 13, "/api/chunked/") == 0) {
+        std::string data = pattern(strtoul(path.c_str() + 13, nullptr, 10));
+        std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n"
+                               "Keep-Alive: timeout=5\r\nX-Backend: echo\r\n\r\n";
+        const size_t k_chunk = 10000;
+        for (size_t offset = 0; offset < data.size(); offset += k_chunk) {
+            size_t n = std::min(k_chunk, data.size() - offset);
+            char size_line[32];
+            snprintf(size_line, sizeof size_line, "%zx;ext=1\r\n", n);
+            response += size_line + data.substr(offset, n) + "\r\n";
+        }
+        response += "0\r\nX-Trailer: 1\r\n\r\n";
+        conn->send(response);
+    } else if (path.compare(0, 11, "/api/close/") == 0) {
+        conn->send("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + pattern(strtoul(path.c_str() + 11, nullptr, 10)));
+        conn->shutdown();
+    } else {
+        conn->send("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+}
+
+void echo_message(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receive_time) {
+    EchoSession *session = boost::any_cast<EchoSession>(conn->get_mutable_context());
+    while (buf->readable_bytes() > 0) {
+        if (!session->in_body) {
+            bool ok = session->context.parse_request(buf, receive_time);
+            assert(ok);
+            (void)ok;
+            if (!session->context.got_all()) {
+                return;
+            }
+            const HttpRequest &req = session->context.request();
+            if (req.get_header("Transfer-Encoding") == "chunked") {
+                session->body_reader.reset(HttpBodyReader::k_chunked);
+            } else {
+                const std::string &length = req.get_header("Content-Length");
+                session->body_reader.reset(length.empty() ? HttpBodyReader::k_none : HttpBodyReader::k_length,
+                                           atoll(length.c_str()));
+            }
+            session->in_body = true;
+        }
+        size_t n = session->body_reader.feed(buf->peek(), buf->readable_bytes(), &session->body);
+        assert(!session->body_reader.error());
+        buf->retrieve(n);
+        if (!session->body_reader.done()) {
+            return;
+        }
+        echo_respond(conn, session->context.request(), session->body);
+        session->context.reset();
+        session->body.clear();
+        session->in_body = false;
+    }
+}
+
+void echo_connection(const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+        ++g_echo_connections;
+        conn->set_context(EchoSession());
+    }
+}
+
+void web_handler(const HttpRequest &req, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body("web:" + req.path());
+}
+
+void local_handler(const HttpRequest &req, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_body("local:" + req.path());
+}
+
+int connect_proxy() {
+    return connect_server(k_proxy_port);
+}
+
+bool closed_by_peer(int fd) {
+    char c;
+    return ::read(fd, &c, 1) == 0;
+}
+
+/**
+ * @brief 多个客户端连接上的顺序请求共用同一个上游连接
+ */
+void test_keep_alive_reuse(int num_loops) {
+    printf("test_keep_alive_reuse\n");
+    int before = g_echo_connections.load();
+    for (int c = 0; c < 3; ++c) {
+        int fd = connect_proxy();
+        std::string pending;
+        for (int i = 0; i < 10; ++i) {
+            std::string body = "hello " + std::to_string(i);
+            write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: " +
+                          std::to_string(body.size()) + "\r\n\r\n" + body);
+            Response r = read_response(fd, &pending);
+            assert(r.body == body);
+            assert(r.headers.find("HTTP/1.1 200 OK") == 0);
+        }
+        ::close(fd);
+    }
+    printf("upstream connections opened: %d\n", g_echo_connections.load() - before);
+    // 每个IO loop各有一个连接池
+    assert(g_echo_connections.load() - before <= num_loops);
+}
+
+void test_large_bodies() {
+    printf("test_large_bodies\n");
+    int fd = connect_proxy();
+    std::string pending;
+    // Content-Length请求体
+    std::string body = pattern(8 * 1024 * 1024);
+    write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: " +
+                  std::to_string(body.size()) + "\r\n\r\n" + body);
+    Response r = read_response(fd, &pending);
+    assert(r.body == body);
+
+    // chunked请求体，块分多次写出
+    write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n");
+    std::string expected;
+    for (int i = 0; i < 50; ++i) {
+        std::string chunk = pattern(1000 + i * 997);
+        char size_line[32];
+        snprintf(size_line, sizeof size_line, "%zx\r\n", chunk.size());
+        write_all(fd, size_line + chunk + "\r\n");
+        expected += chunk;
+    }
+    write_all(fd, "0\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.body == expected);
+
+    // 大的chunked响应，客户端先不读，上游和代理之间由背压限制
+    write_all(fd, "GET /api/chunked/20000000 HTTP/1.1\r\nHost: test\r\n\r\n");
+    ::usleep(200 * 1000);
+    r = read_response(fd, &pending);
+    assert(r.body == pattern(20000000));
+    assert(r.has("Transfer-Encoding: chunked"));
+    assert(r.headers.find("Keep-Alive") == std::string::npos);
+    assert(r.headers.find("Connection") == std::string::npos);
+    assert(r.has("X-Backend: echo"));
+
+    // 之后连接仍然可用
+    write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 2\r\n\r\nok");
+    r = read_response(fd, &pending);
+    assert(r.body == "ok");
+    ::close(fd);
+}
+
+/**
+ * @brief HTTP/1.0客户端收到去掉分块格式的响应，以关闭连接结束；读到关闭为止的响应同样关闭客户端
+ */
+void test_framing_conversion() {
+    printf("test_framing_conversion\n");
+    int fd = connect_proxy();
+    std::string pending;
+    write_all(fd, "GET /api/chunked/100000 HTTP/1.0\r\n\r\n");
+    Response r = read_response(fd, &pending);
+    assert(r.body == pattern(100000));
+    assert(r.headers.find("Transfer-Encoding") == std::string::npos);
+    assert(r.has("Connection: close"));
+    ::close(fd);
+
+    fd = connect_proxy();
+    pending.clear();
+    write_all(fd, "GET /api/close/300000 HTTP/1.1\r\nHost: test\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.body == pattern(300000));
+    assert(r.has("Connection: close"));
+    ::close(fd);
+}
+
+void test_header_rewrite() {
+    printf("test_header_rewrite\n");
+    int fd = connect_proxy();
+    std::string pending;
+    write_all(fd, "GET /api/headers?x=1 HTTP/1.1\r\nHost: example.com\r\nConnection: keep-alive, X-Hop\r\n"
+                  "X-Hop: 1\r\nKeep-Alive: 300\r\nX-Forwarded-For: 10.0.0.1\r\nX-Custom: kept\r\n\r\n");
+    std::string seen = read_response(fd, &pending).body;
+    printf("%s", seen.c_str());
+    assert(seen.find("Host: example.com\n") != std::string::npos);
+    assert(seen.find("X-Custom: kept\n") != std::string::npos);
+    assert(seen.find("X-Forwarded-For: 10.0.0.1, 127.0.0.1\n") != std::string::npos);
+    assert(seen.find("X-Hop") == std::string::npos);
+    assert(seen.find("Keep-Alive") == std::string::npos);
+    assert(seen.find("Connection") == std::string::npos);
+
+    // Transfer-Encoding和Content-Length同时出现时以chunked为准，Content-Length不转发给上游
+    write_all(fd, "POST /api/headers HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n"
+                  "Transfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n");
+    seen = read_response(fd, &pending).body;
+    assert(seen.find("Transfer-Encoding: chunked\n") != std::string::npos);
+    assert(seen.find("Content-Length") == std::string::npos);
+    // 请求体按chunked结束，连接上的下一个请求不受影响
+    write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 2\r\n\r\nok");
+    Response r = read_response(fd, &pending);
+    assert(r.body == "ok");
+    ::close(fd);
+}
+
+/**
+ * @brief 代理和本地路由在同一个连接上流水线，响应按请求顺序返回
+ */
+void test_pipelined_mix() {
+    printf("test_pipelined_mix\n");
+    int fd = connect_proxy();
+    std::string pending;
+    write_all(fd, "GET /one HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nproxy"
+                  "GET /web/page HTTP/1.1\r\nHost: test\r\n\r\n"
+                  "GET /two HTTP/1.1\r\nHost: test\r\n\r\n");
+    const char *expected[] = {"local:/one", "proxy", "web:/web/page", "local:/two"};
+    for (const char *body : expected) {
+        Response r = read_response(fd, &pending);
+        assert(r.body == body);
+    }
+    ::close(fd);
+}
+
+void test_upstream_errors() {
+    printf("test_upstream_errors\n");
+    int fd = connect_proxy();
+    std::string pending;
+    write_all(fd, "GET /down/x HTTP/1.1\r\nHost: test\r\n\r\n");
+    Response r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 502 Bad Gateway") == 0);
+    assert(closed_by_peer(fd));
+    ::close(fd);
+
+    fd = connect_proxy();
+    pending.clear();
+    write_all(fd, "GET /silent HTTP/1.1\r\nHost: test\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 504 Gateway Timeout") == 0);
+    ::close(fd);
+
+    // "/apix"不匹配"/api"
+    fd = connect_proxy();
+    pending.clear();
+    write_all(fd, "GET /apix HTTP/1.1\r\nHost: test\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.body == "local:/apix");
+    ::close(fd);
+}
+
+/**
+ * @brief 客户端在响应中途断开，上游连接被丢弃，不影响之后的请求
+ */
+void test_client_abort() {
+    printf("test_client_abort\n");
+    int fd = connect_proxy();
+    write_all(fd, "GET /api/chunked/20000000 HTTP/1.1\r\nHost: test\r\n\r\n");
+    std::string pending;
+    while (pending.size() < 100000 && read_more(fd, &pending)) {
+    }
+    ::close(fd);
+    ::usleep(100 * 1000);
+
+    fd = connect_proxy();
+    pending.clear();
+    write_all(fd, "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nafter");
+    Response r = read_response(fd, &pending);
+    assert(r.body == "after");
+    ::close(fd);
+}
+
+void run_server(int num_threads) {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        TcpServer echo(&loop, InetAddress(k_echo_port), "echo");
+        echo.set_connection_callback(echo_connection);
+        echo.set_message_callback(echo_message);
+        echo.start();
+        // 只接受连接、从不响应的上游
+        TcpServer silent(&loop, InetAddress(k_silent_port), "silent");
+        silent.start();
+        HttpServer web(&loop, InetAddress(k_web_port), "web");
+        web.set_http_callback(web_handler);
+        web.start();
+
+        HttpServer proxy(&loop, InetAddress(k_proxy_port), "proxy");
+        proxy.set_http_callback(local_handler);
+        proxy.set_thread_num(num_threads);
+        proxy.add_proxy("/api", InetAddress("127.0.0.1", k_echo_port));
+        proxy.add_proxy("/web", InetAddress("127.0.0.1", k_web_port));
+        proxy.add_proxy("/down", InetAddress("127.0.0.1", k_down_port));
+        ProxyOptions silent_options;
+        silent_options.response_timeout = 0.3;
+        proxy.add_proxy("/silent", InetAddress("127.0.0.1", k_silent_port), silent_options);
+        proxy.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_keep_alive_reuse(num_threads > 0 ? num_threads : 1);
+    test_large_bodies();
+    test_framing_conversion();
+    test_header_rewrite();
+    test_pipelined_mix();
+    test_upstream_errors();
+    test_client_abort();
+
+    server_loop->quit();
+    server_thread.join();
+}
+
+void test_body_reader() {
+    printf("test_body_reader\n");
+    // 分块格式按字节逐个喂入
+    std::string chunked = "5;name=value\r\nhello\r\n6\r\n world\r\n0\r\nTrailer: x\r\n\r\nNEXT";
+    HttpBodyReader reader;
+    reader.reset(HttpBodyReader::k_chunked);
+    std::string decoded;
+    size_t consumed = 0;
+    for (size_t i = 0; i < chunked.size() && !reader.done(); ++i) {
+        consumed += reader.feed(chunked.data() + i, 1, &decoded);
+    }
+    assert(reader.done());
+    assert(decoded == "hello world");
+    assert(chunked.substr(consumed) == "NEXT");
+
+    reader.reset(HttpBodyReader::k_chunked);
+    assert(reader.feed("zz\r\n", 4) == 0);
+    assert(reader.error());
+
+    reader.reset(HttpBodyReader::k_length, 3);
+    assert(reader.feed("abcdef", 6) == 3);
+    assert(reader.done());
+
+    HttpResponseParser parser;
+    Buffer buf;
+    buf.append("HTTP/1.0 200 OK\r\nContent-Length: 4\r\n");
+    assert(parser.parse_head(&buf));
+    assert(!parser.head_done());
+    buf.append("connection: Keep-Alive\r\n\r\nbody");
+    assert(parser.parse_head(&buf));
+    assert(parser.head_done());
+    assert(!parser.http11());
+    assert(parser.keep_alive());
+    assert(parser.init_body(false, &reader));
+    assert(reader.mode() == HttpBodyReader::k_length);
+    assert(buf.retrieve_all_as_string() == "body");
+    assert(parser.init_body(true, &reader));
+    assert(reader.mode() == HttpBodyReader::k_none);
+
+    parser.reset();
+    buf.append("HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n");
+    assert(parser.parse_head(&buf));
+    assert(parser.status_code() == 204);
+    assert(!parser.keep_alive());
+    parser.reset();
+    buf.append("HTTP/1.1 2x0 Bad\r\n\r\n");
+    assert(!parser.parse_head(&buf));
+}
+
+} // namespace
+
+int main() {
+    test_body_reader();
+    printf("proxy in base loop\n");
+    run_server(0);
+    printf("proxy in io threads\n");
+    run_server(2);
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @brief router test
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "http/Router.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "http/HttpResponse.h"
+
+using web_server::http::HttpRequest;
+using web_server::http::HttpResponse;
+using web_server::http::RouteParams;
+using web_server::http::Router;
+
+// 统计匹配过程中的内存分配
+size_t g_allocations = 0;
+
+void *operator new(size_t size) {
+    ++g_allocations;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+std::string g_hit;
+
+Router::Handler named(const std::string &name) {
+    return [name](const HttpRequest &, const RouteParams &params, HttpResponse *) {
+        g_hit = name;
+        for (int i = 0; i < params.size(); ++i) {
+            g_hit += " " + params[i].name.to_string() + "=" + params[i].value.to_string();
+        }
+    };
+}
+
+/**
+ * @brief 返回命中的路由名和捕获的参数，未命中返回空串
+ */
+std::string route(const Router &router, HttpRequest::Method method, const std::string &path) {
+    RouteParams params;
+    const Router::Handler *handler = router.match(method, path, &params);
+    if (!handler) {
+        return "";
+    }
+    HttpRequest req;
+    g_hit.clear();
+    (*handler)(req, params, nullptr);
+    return g_hit;
+}
+
+void test_match() {
+    printf("test_match\n");
+    Router router;
+    router.get("/", named("root"));
+    router.get("/hello", named("hello"));
+    router.get("/help", named("help"));
+    router.get("/he", named("he"));
+    router.get("/users/:id", named("user"));
+    router.get("/users/:id/posts/:post", named("post"));
+    router.get("/users/me", named("me"));
+    router.get("/static/*filepath", named("static"));
+    router.get("/files/:name/*rest", named("files"));
+    router.post("/users/:id", named("update"));
+
+    assert(route(router, HttpRequest::k_get, "/") == "root");
+    assert(route(router, HttpRequest::k_get, "/hello") == "hello");
+    assert(route(router, HttpRequest::k_get, "/help") == "help");
+    assert(route(router, HttpRequest::k_get, "/he") == "he");
+    assert(route(router, HttpRequest::k_get, "/hel") == "");
+    assert(route(router, HttpRequest::k_get, "/hello/") == "");
+    assert(route(router, HttpRequest::k_get, "/users/42") == "user id=42");
+    assert(route(router, HttpRequest::k_get, "/users/me") == "me");
+    assert(route(router, HttpRequest::k_get, "/users/mex") == "user id=mex");
+    assert(route(router, HttpRequest::k_get, "/users/") == "");
+    assert(route(router, HttpRequest::k_get, "/users/42/posts/7") == "post id=42 post=7");
+    assert(route(router, HttpRequest::k_get, "/users/42/posts/") == "");
+    // 静态段me优先，剩余路径不匹配时回溯到参数段
+    assert(route(router, HttpRequest::k_get, "/users/me/posts/1") == "post id=me post=1");
+    assert(route(router, HttpRequest::k_get, "/static/css/a.css") == "static filepath=css/a.css");
+    assert(route(router, HttpRequest::k_get, "/static/") == "static filepath=");
+    assert(route(router, HttpRequest::k_get, "/files/x/a/b") == "files name=x rest=a/b");
+
+    // 每种方法各自一棵树，HEAD没有注册时使用GET
+    assert(route(router, HttpRequest::k_post, "/users/5") == "update id=5");
+    assert(route(router, HttpRequest::k_post, "/hello") == "");
+    assert(route(router, HttpRequest::k_head, "/hello") == "hello");
+    assert(route(router, HttpRequest::k_delete, "/users/5") == "");
+    assert(router.route_count() == 10);
+}
+
+void test_dispatch() {
+    printf("test_dispatch\n");
+    Router router;
+    router.get("/items/:id", [](const HttpRequest &, const RouteParams &params, HttpResponse *resp) {
+        resp->set_status_code(HttpResponse::k_200_ok);
+        resp->set_status_message("OK");
+        resp->set_body("item " + params.get("id").to_string());
+    });
+    router.put("/items/:id", named("put"));
+
+    HttpRequest req;
+    const char get[] = "GET";
+    req.set_method(get, get + 3);
+    const char path[] = "/items/9";
+    req.set_path(path, path + sizeof path - 1);
+    web_server::net::Buffer output;
+    {
+        HttpResponse resp(false);
+        router.dispatch(req, &resp);
+        resp.append_to_buffer(&output);
+        std::string text = output.retrieve_all_as_string();
+        assert(text.find("HTTP/1.1 200 OK\r\n") == 0);
+        assert(text.find("item 9") != std::string::npos);
+    }
+
+    HttpRequest del;
+    const char method[] = "DELETE";
+    del.set_method(method, method + 6);
+    del.set_path(path, path + sizeof path - 1);
+    {
+        HttpResponse resp(false);
+        router.dispatch(del, &resp);
+        resp.append_to_buffer(&output);
+        std::string text = output.retrieve_all_as_string();
+        assert(text.find("HTTP/1.1 405 Method Not Allowed\r\n") == 0);
+        assert(text.find("Allow: GET, HEAD, PUT\r\n") != std::string::npos);
+    }
+
+    const char missing[] = "/nothing";
+    req.set_path(missing, missing + sizeof missing - 1);
+    {
+        HttpResponse resp(false);
+        router.dispatch(req, &resp);
+        assert(resp.close_connection());
+        resp.append_to_buffer(&output);
+        assert(output.retrieve_all_as_string().find("HTTP/1.1 404 Not Found\r\n") == 0);
+    }
+}
+
+/**
+ * @brief 大量路由时匹配不分配内存，参数指向原始路径
+ */
+void test_many_routes() {
+    printf("test_many_routes\n");
+    Router router;
+    const int k_resources = 200;
+    for (int i = 0; i < k_resources; ++i) {
+        std::string base = "/api/v1/resource" + std::to_string(i);
+        router.get(base, named("list" + std::to_string(i)));
+        router.get(base + "/:id", named("get" + std::to_string(i)));
+        router.del(base + "/:id", named("del" + std::to_string(i)));
+        router.get(base + "/:id/children/*rest", named("children" + std::to_string(i)));
+    }
+    assert(router.route_count() == 4 * k_resources);
+    assert(route(router, HttpRequest::k_get, "/api/v1/resource137") == "list137");
+    assert(route(router, HttpRequest::k_get, "/api/v1/resource13") == "list13");
+    assert(route(router, HttpRequest::k_get, "/api/v1/resource1999") == "");
+    assert(route(router, HttpRequest::k_delete, "/api/v1/resource77/abc") == "del77 id=abc");
+    assert(route(router, HttpRequest::k_get, "/api/v1/resource5/x/children/a/b") == "children5 id=x rest=a/b");
+
+    std::string path = "/api/v1/resource199/12345/children/deep/path";
+    RouteParams params;
+    size_t before = g_allocations;
+    for (int i = 0; i < 1000; ++i) {
+        const Router::Handler *handler = router.match(HttpRequest::k_get, path, &params);
+        assert(handler);
+    }
+    assert(g_allocations == before);
+    assert(params.size() == 2);
+    assert(params.get("id") == "12345");
+    assert(params.get("id").data() == path.data() + 20);
+    assert(params.get("rest") == "deep/path");
+    assert(params.get("none").empty());
+}
+
+int main() {
+    test_match();
+    test_dispatch();
+    test_many_routes();
+    printf("all tests passed\n");
+    return 0;
+}
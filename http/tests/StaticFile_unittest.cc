@@ -0,0 +1,246 @@
+/**
+ * @brief sendfile静态文件服务测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "http/FileCache.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/Router.h"
+#include "http/StaticFile.h"
+#include "http/tests/TestClient.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+using namespace web_server::http::test_client;
+
+namespace {
+
+const uint16_t k_port = 19529;
+
+std::string g_root;
+std::string g_big;
+
+void write_file(const std::string &path, const std::string &content) {
+    FILE *fp = ::fopen(path.c_str(), "w");
+    assert(fp);
+    size_t n = ::fwrite(content.data(), 1, content.size(), fp);
+    assert(n == content.size());
+    (void)n;
+    ::fclose(fp);
+}
+
+void make_root() {
+    char dir[] = "/tmp/static_file_test_XXXXXX";
+    assert(::mkdtemp(dir));
+    g_root = dir;
+    g_big.resize(16 * 1024 * 1024 + 123);
+    for (size_t i = 0; i < g_big.size(); ++i) {
+        g_big[i] = static_cast<char>('A' + (i * 7 + i / 4096) % 26);
+    }
+    write_file(g_root + "/big.bin", g_big);
+    write_file(g_root + "/style.CSS", "body {}\n");
+    ::mkdir((g_root + "/docs").c_str(), 0755);
+    write_file(g_root + "/docs/index.html", "<h1>index</h1>");
+    write_file(g_root + "/secret", "secret");
+}
+
+void remove_root() {
+    std::string cmd = "rm -rf " + g_root;
+    int ret = ::system(cmd.c_str());
+    assert(ret == 0);
+    (void)ret;
+}
+
+/**
+ * @brief 流水线上的大文件和小文件交替，客户端先不读，服务端sendfile必然遇到EAGAIN
+ */
+void test_pipelined_files() {
+    printf("test_pipelined_files\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /static/big.bin HTTP/1.1\r\n\r\n"
+                      "GET /static/style.CSS HTTP/1.1\r\n\r\n"
+                      "HEAD /static/big.bin HTTP/1.1\r\n\r\n"
+                      "GET /static/big.bin HTTP/1.1\r\n\r\n"
+                      "GET /hello HTTP/1.1\r\n\r\n");
+    ::usleep(200 * 1000);
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 200 OK") == 0);
+    assert(r.headers.find("Content-Type: application/octet-stream") != std::string::npos);
+    assert(r.body == g_big);
+    assert(r.headers.find("ETag: \"") != std::string::npos);
+    assert(r.headers.find(" GMT\r\n") != std::string::npos);
+
+    r = read_response(fd, &pending);
+    assert(r.headers.find("Content-Type: text/css; charset=utf-8") != std::string::npos);
+    assert(r.body == "body {}\n");
+
+    r = read_response(fd, &pending, true);
+    assert(r.headers.find("Content-Length: " + std::to_string(g_big.size())) != std::string::npos);
+
+    r = read_response(fd, &pending);
+    assert(r.body == g_big);
+
+    r = read_response(fd, &pending);
+    assert(r.body == "hello");
+    ::close(fd);
+}
+
+void test_errors_and_index() {
+    printf("test_errors_and_index\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /static/docs HTTP/1.1\r\n\r\n"
+                      "GET /static/missing.txt HTTP/1.1\r\n\r\n"
+                      "GET /static/docs/%2e%2e/secret HTTP/1.1\r\n\r\n"
+                      "GET /static/%73ecret HTTP/1.1\r\n\r\n"
+                      "HEAD /hello HTTP/1.1\r\n\r\n"
+                      "GET /hello HTTP/1.1\r\n\r\n");
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.headers.find("text/html") != std::string::npos);
+    assert(r.body == "<h1>index</h1>");
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 404 Not Found") == 0);
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 403 Forbidden") == 0);
+    r = read_response(fd, &pending);
+    assert(r.body == "secret");
+    // 普通响应的HEAD同样省略响应体
+    r = read_response(fd, &pending, true);
+    assert(r.headers.find("Content-Length: 5") != std::string::npos);
+    r = read_response(fd, &pending);
+    assert(r.body == "hello");
+    ::close(fd);
+}
+
+/**
+ * @brief 304不带响应体，206的各个区间由sendfile发送，和后续的流水线响应不会错位
+ */
+void test_conditional_and_ranges() {
+    printf("test_conditional_and_ranges\n");
+    int fd = connect_server(k_port);
+    write_all(fd, "GET /static/big.bin HTTP/1.1\r\nRange: bytes=0-0\r\n\r\n");
+    std::string pending;
+    Response r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 206") == 0);
+    assert(r.body == g_big.substr(0, 1));
+    std::string etag = header_value(r.headers, "ETag");
+    std::string last_modified = header_value(r.headers, "Last-Modified");
+    assert(!etag.empty() && !last_modified.empty());
+    assert(header_value(r.headers, "Accept-Ranges") == "bytes");
+
+    size_t size = g_big.size();
+    write_all(fd, "GET /static/big.bin HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n"
+                      "GET /static/big.bin HTTP/1.1\r\nIf-Modified-Since: " + last_modified + "\r\n\r\n"
+                      "GET /static/big.bin HTTP/1.1\r\nRange: bytes=1000-1999999\r\n\r\n"
+                      "GET /static/big.bin HTTP/1.1\r\nRange: bytes=-10,100-109,5000000-6999999\r\n"
+                      "If-Range: " + etag + "\r\n\r\n"
+                      "GET /static/big.bin HTTP/1.1\r\nRange: bytes=" + std::to_string(size) + "-\r\n\r\n"
+                      "GET /static/style.CSS HTTP/1.1\r\nRange: bytes=0-3\r\nIf-Range: \"stale\"\r\n\r\n"
+                      "GET /hello HTTP/1.1\r\n\r\n");
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 304 Not Modified") == 0);
+    assert(r.body.empty());
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 304 Not Modified") == 0);
+
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 206") == 0);
+    assert(header_value(r.headers, "Content-Range") == "bytes 1000-1999999/" + std::to_string(size));
+    assert(r.body == g_big.substr(1000, 1999000));
+
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 206") == 0);
+    std::string content_type = header_value(r.headers, "Content-Type");
+    assert(content_type.find("multipart/byteranges; boundary=") == 0);
+    std::string boundary = content_type.substr(31);
+    std::string total = "/" + std::to_string(size) + "\r\n\r\n";
+    std::string expected =
+        "--" + boundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes " +
+        std::to_string(size - 10) + "-" + std::to_string(size - 1) + total + g_big.substr(size - 10) +
+        "\r\n--" + boundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 100-109" +
+        total + g_big.substr(100, 10) +
+        "\r\n--" + boundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 5000000-6999999" +
+        total + g_big.substr(5000000, 2000000) + "\r\n--" + boundary + "--\r\n";
+    assert(r.body == expected);
+
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 416") == 0);
+    assert(header_value(r.headers, "Content-Range") == "bytes */" + std::to_string(size));
+
+    r = read_response(fd, &pending);
+    assert(r.headers.find("HTTP/1.1 200") == 0);
+    assert(r.body == "body {}\n");
+
+    r = read_response(fd, &pending);
+    assert(r.body == "hello");
+    ::close(fd);
+}
+
+void test_mime_type() {
+    printf("test_mime_type\n");
+    assert(std::string(mime_type("a/b/index.HTML")) == "text/html; charset=utf-8");
+    assert(std::string(mime_type("app.js")) == "application/javascript; charset=utf-8");
+    assert(std::string(mime_type("x.woff2")) == "font/woff2");
+    assert(std::string(mime_type("dir.d/file")) == "application/octet-stream");
+    assert(std::string(mime_type("archive.tar.gz")) == "application/gzip");
+    assert(std::string(mime_type("noext")) == "application/octet-stream");
+}
+
+} // namespace
+
+int main() {
+    test_mime_type();
+    make_root();
+
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        FileCache cache(&loop, 16);
+        Router router;
+        router.get("/static/*filepath", StaticFileHandler(g_root, &cache));
+        router.get("/hello", [](const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+            resp->set_status_code(HttpResponse::k_200_ok);
+            resp->set_status_message("OK");
+            resp->set_body("hello");
+        });
+        HttpServer server(&loop, InetAddress(k_port), "static");
+        server.set_http_callback([&router](const HttpRequest &req, HttpResponse *resp) {
+            router.dispatch(req, resp);
+        });
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_pipelined_files();
+    test_errors_and_index();
+    test_conditional_and_ranges();
+
+    server_loop->quit();
+    server_thread.join();
+    remove_root();
+    printf("all tests passed\n");
+    return 0;
+}
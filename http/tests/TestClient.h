@@ -0,0 +1,201 @@
+/**
+ * @brief http测试共用的阻塞式客户端：连接、写请求、按各种分帧方式读取响应
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_HTTP_TESTS_TESTCLIENT_H
+#define WEB_SERVER_HTTP_TESTS_TESTCLIENT_H
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace web_server {
+
+namespace http {
+
+namespace test_client {
+
+// 服务端没有按时响应或关闭连接时读取超时返回，测试失败而不是卡住
+const int k_read_timeout_seconds = 5;
+
+/**
+ * @brief 连接本机的port
+ * @param rcvbuf 大于0时设置接收缓冲大小，用来制造写阻塞
+ */
+inline int connect_server(uint16_t port, int rcvbuf = 0) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval timeout = {k_read_timeout_seconds, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    if (rcvbuf > 0) {
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    }
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+    return fd;
+}
+
+inline void write_all(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        assert(n > 0);
+        written += static_cast<size_t>(n);
+    }
+}
+
+/**
+ * @brief 服务端可能在数据写完之前就关闭了连接，之后的写入失败是预期的
+ */
+inline void write_some(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+/**
+ * @brief 再读一些数据追加到pending
+ * @return false 连接关闭、出错或者读取超时
+ */
+inline bool read_more(int fd, std::string *pending) {
+    char buf[65536];
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n <= 0) {
+        return false;
+    }
+    pending->append(buf, n);
+    return true;
+}
+
+/**
+ * @brief 读到连接关闭为止
+ * @return std::string 读取超时时返回空串；连接被重置时之前读到的数据仍然有效
+ */
+inline std::string read_until_close(int fd) {
+    std::string data;
+    char buf[65536];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n == 0) {
+            return data;
+        }
+        if (n < 0) {
+            return errno == ECONNRESET ? data : std::string();
+        }
+        data.append(buf, n);
+    }
+}
+
+struct Response {
+    std::string headers;                // 状态行和首部，每行以CRLF结尾，不含最后的空行
+    std::string body;
+
+    bool has(const std::string &line) const {
+        return headers.find(line + "\r\n") != std::string::npos;
+    }
+};
+
+/**
+ * @brief 首部field的值，没有该首部时返回空串
+ */
+inline std::string header_value(const std::string &headers, const std::string &field) {
+    size_t pos = headers.find(field + ": ");
+    if (pos == std::string::npos) {
+        return std::string();
+    }
+    pos += field.size() + 2;
+    return headers.substr(pos, headers.find("\r\n", pos) - pos);
+}
+
+/**
+ * @brief 从pending和fd中读取一个响应，pending中留下属于之后响应的数据
+ * 响应体按chunked、Content-Length的顺序确定边界，都没有时读到连接关闭；head为true或者304时没有响应体
+ */
+inline Response read_response(int fd, std::string *pending, bool head = false) {
+    Response response;
+    size_t header_end;
+    while ((header_end = pending->find("\r\n\r\n")) == std::string::npos) {
+        bool ok = read_more(fd, pending);
+        assert(ok);
+        (void)ok;
+    }
+    response.headers = pending->substr(0, header_end + 2);
+    pending->erase(0, header_end + 4);
+    if (head || response.headers.find(" 304 ") != std::string::npos) {
+        return response;
+    }
+    if (response.has("Transfer-Encoding: chunked")) {
+        while (true) {
+            size_t line_end;
+            while ((line_end = pending->find("\r\n")) == std::string::npos) {
+                bool ok = read_more(fd, pending);
+                assert(ok);
+                (void)ok;
+            }
+            size_t size = strtoul(pending->c_str(), nullptr, 16);
+            if (size == 0) {
+                // 最后一块之后可能有trailer，一直跳到空行
+                size_t trailer_end;
+                while ((trailer_end = pending->find("\r\n\r\n", line_end)) == std::string::npos) {
+                    bool ok = read_more(fd, pending);
+                    assert(ok);
+                    (void)ok;
+                }
+                pending->erase(0, trailer_end + 4);
+                return response;
+            }
+            while (pending->size() < line_end + 2 + size + 2) {
+                bool ok = read_more(fd, pending);
+                assert(ok);
+                (void)ok;
+            }
+            response.body.append(*pending, line_end + 2, size);
+            assert(pending->compare(line_end + 2 + size, 2, "\r\n") == 0);
+            pending->erase(0, line_end + 2 + size + 2);
+        }
+    }
+    std::string length = header_value(response.headers, "Content-Length");
+    if (length.empty()) {
+        while (read_more(fd, pending)) {
+        }
+        response.body.swap(*pending);
+        return response;
+    }
+    size_t size = strtoul(length.c_str(), nullptr, 10);
+    while (pending->size() < size) {
+        bool ok = read_more(fd, pending);
+        assert(ok);
+        (void)ok;
+    }
+    response.body = pending->substr(0, size);
+    pending->erase(0, size);
+    return response;
+}
+
+} // namespace test_client
+
+} // namespace http
+
+} // namespace web_server
+
+#endif // WEB_SERVER_HTTP_TESTS_TESTCLIENT_H
@@ -0,0 +1,499 @@
+/**
+ * @brief WebSocket测试：帧编解码、握手、分片重组、心跳、广播和关闭
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/CountDownLatch.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpServer.h"
+#include "http/WebSocket.h"
+#include "http/WebSocketConnection.h"
+#include "net/Buffer.h"
+#include "net/EventLoop.h"
+
+using namespace web_server;
+using namespace web_server::net;
+using namespace web_server::http;
+
+namespace {
+
+const uint16_t k_port = 19533;
+const uint16_t k_ping_port = 19534;
+const unsigned char k_mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+MutexLock g_mutex;
+std::vector<uint16_t> g_close_codes;
+
+void test_codec() {
+    printf("test_codec\n");
+    // RFC 6455第1.3节
+    assert(websocket::accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    // 各种长度和相位下与逐字节异或的结果一致
+    std::string data;
+    for (int i = 0; i < 300; ++i) {
+        data.push_back(static_cast<char>(i * 7 + 3));
+    }
+    for (size_t len = 0; len <= 67; ++len) {
+        for (size_t phase = 0; phase < 4; ++phase) {
+            std::string out(len, '\0');
+            websocket::unmask(&out[0], data.data() + 1, len, k_mask, phase);
+            for (size_t i = 0; i < len; ++i) {
+                assert(out[i] == static_cast<char>(data[1 + i] ^ k_mask[(phase + i) & 3]));
+            }
+        }
+    }
+    // 原地解掩码两次还原
+    std::string copy = data;
+    websocket::unmask(&copy[0], &copy[0], copy.size(), k_mask, 1);
+    websocket::unmask(&copy[0], &copy[0], copy.size(), k_mask, 1);
+    assert(copy == data);
+
+    // 三种长度编码
+    size_t lengths[] = {0, 125, 126, 65535, 65536};
+    for (size_t len : lengths) {
+        std::string payload(len, 'x');
+        Buffer buf;
+        websocket::append_frame(&buf, websocket::k_binary, payload.data(), len, false, k_mask);
+        websocket::FrameHeader header;
+        size_t n = websocket::parse_frame_header(buf.peek(), buf.readable_bytes(), &header);
+        assert(n == (len < 126 ? 2 : len <= 65535 ? 4 : 10) + 4u);
+        assert(!header.fin && header.opcode == websocket::k_binary && header.masked);
+        assert(header.payload_length == len && memcmp(header.mask, k_mask, 4) == 0);
+        assert(buf.readable_bytes() == n + len);
+        // 帧头不完整
+        assert(websocket::parse_frame_header(buf.peek(), n - 1, &header) == 0);
+    }
+    websocket::Frame frame = websocket::make_frame(websocket::k_text, "Hello");
+    assert(*frame == std::string("\x81\x05Hello", 7));
+
+    assert(websocket::valid_utf8("", 0));
+    std::string good = "plain ascii text, long enough for the word path \xce\xba\xe1\xbd\xb9\xf0\x9f\x98\x80";
+    assert(websocket::valid_utf8(good.data(), good.size()));
+    const char *bad[] = {"\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xce", "\x80", "\xff"};
+    for (const char *s : bad) {
+        assert(!websocket::valid_utf8(s, strlen(s)));
+    }
+}
+
+/**
+ * @brief 阻塞式的WebSocket客户端
+ */
+class Client {
+public:
+    explicit Client(uint16_t port) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int ret = ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+        assert(ret == 0);
+        (void)ret;
+    }
+
+    ~Client() {
+        close();
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    /**
+     * @brief 发送握手请求，返回响应头
+     */
+    std::string handshake(const std::string &extra = std::string(), const std::string &version = "13") {
+        write_raw("GET /chat HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\n"
+                  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: " + version + "\r\n\r\n" +
+                  extra);
+        while (pending_.find("\r\n\r\n") == std::string::npos) {
+            if (!read_more()) {
+                break;
+            }
+        }
+        size_t end = pending_.find("\r\n\r\n") + 4;
+        std::string head = pending_.substr(0, end);
+        pending_.erase(0, end);
+        return head;
+    }
+
+    void write_raw(const std::string &data) {
+        ssize_t n = ::write(fd_, data.data(), data.size());
+        assert(n == static_cast<ssize_t>(data.size()));
+        (void)n;
+    }
+
+    void send(websocket::Opcode opcode, const std::string &payload, bool fin = true) {
+        Buffer buf;
+        websocket::append_frame(&buf, opcode, payload.data(), payload.size(), fin, k_mask);
+        write_raw(buf.retrieve_all_as_string());
+    }
+
+    /**
+     * @brief 读一帧，返回false表示连接已经关闭
+     */
+    bool read_frame(uint8_t *opcode, std::string *payload) {
+        websocket::FrameHeader header;
+        size_t n;
+        while ((n = websocket::parse_frame_header(pending_.data(), pending_.size(), &header)) == 0) {
+            if (!read_more()) {
+                return false;
+            }
+        }
+        assert(!header.masked && header.fin);
+        while (pending_.size() < n + header.payload_length) {
+            bool ok = read_more();
+            assert(ok);
+            (void)ok;
+        }
+        *opcode = header.opcode;
+        payload->assign(pending_, n, header.payload_length);
+        pending_.erase(0, n + header.payload_length);
+        return true;
+    }
+
+    /**
+     * @brief 读到一个关闭帧，返回其中的状态码，然后确认服务端断开了连接
+     */
+    uint16_t read_close() {
+        uint8_t opcode;
+        std::string payload;
+        bool ok = read_frame(&opcode, &payload);
+        assert(ok && opcode == websocket::k_close && payload.size() >= 2);
+        (void)ok;
+        char c;
+        assert(pending_.empty() && ::read(fd_, &c, 1) == 0);
+        return static_cast<uint16_t>((static_cast<unsigned char>(payload[0]) << 8) |
+                                     static_cast<unsigned char>(payload[1]));
+    }
+
+    std::string &pending() {
+        return pending_;
+    }
+
+    bool read_more() {
+        char buf[65536];
+        ssize_t n = ::read(fd_, buf, sizeof buf);
+        if (n <= 0) {
+            return false;
+        }
+        pending_.append(buf, n);
+        return true;
+    }
+
+private:
+    int fd_;
+    std::string pending_;
+};
+
+std::string expect_message(Client *client, uint8_t expected_opcode) {
+    uint8_t opcode;
+    std::string payload;
+    bool ok = client->read_frame(&opcode, &payload);
+    assert(ok && opcode == expected_opcode);
+    (void)ok;
+    return payload;
+}
+
+size_t close_count() {
+    MutexLockGuard lock(g_mutex);
+    return g_close_codes.size();
+}
+
+/**
+ * @brief 等待服务端的on_close被调用expected_count次，返回最后一次的状态码
+ */
+uint16_t last_close_code(size_t expected_count) {
+    for (int i = 0; i < 200; ++i) {
+        {
+        MutexLockGuard lock(g_mutex);
+        if (g_close_codes.size() >= expected_count) {
+            return g_close_codes.back();
+        }
+        }
+        ::usleep(10 * 1000);
+    }
+    assert(false);
+    return 0;
+}
+
+void test_handshake() {
+    printf("test_handshake\n");
+    Client client(k_port);
+    std::string head = client.handshake();
+    assert(head.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    assert(head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    assert(expect_message(&client, websocket::k_text) == "welcome /chat");
+
+    Client old_version(k_port);
+    head = old_version.handshake("", "8");
+    assert(head.find("HTTP/1.1 426 ") == 0 && head.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos);
+
+    // 不是升级请求，或者accept拒绝的路径，仍然由http回调处理
+    Client plain(k_port);
+    plain.write_raw("GET /chat HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    plain.write_raw("GET /other HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n");
+    while (plain.pending().find("plain http", plain.pending().find("plain http") + 1) == std::string::npos) {
+        bool ok = plain.read_more();
+        assert(ok);
+        (void)ok;
+    }
+    assert(plain.pending().find("HTTP/1.1 200 OK\r\n") == 0);
+
+    size_t closed = close_count();
+    client.send(websocket::k_close, "");
+    uint8_t opcode;
+    std::string payload;
+    bool ok = client.read_frame(&opcode, &payload);
+    assert(ok && opcode == websocket::k_close && payload.empty());
+    (void)ok;
+    client.close();
+    assert(last_close_code(closed + 1) == websocket::k_no_status_received);
+}
+
+void test_messages() {
+    printf("test_messages\n");
+    Client client(k_port);
+    // 握手请求之后紧跟的帧和握手一起到达
+    Buffer first;
+    websocket::append_frame(&first, websocket::k_text, "early", 5, true, k_mask);
+    client.handshake(first.retrieve_all_as_string());
+    expect_message(&client, websocket::k_text);
+    assert(expect_message(&client, websocket::k_text) == "echo:early");
+
+    // 分片的二进制消息，分片之间插入ping
+    std::string big;
+    for (int i = 0; i < 200000; ++i) {
+        big.push_back(static_cast<char>(i % 251));
+    }
+    client.send(websocket::k_binary, big.substr(0, 70000), false);
+    client.send(websocket::k_ping, "are you there");
+    client.send(websocket::k_continuation, big.substr(70000, 1), false);
+    client.send(websocket::k_continuation, big.substr(70001), true);
+    assert(expect_message(&client, websocket::k_pong) == "are you there");
+    assert(expect_message(&client, websocket::k_binary) == big);
+
+    // 逐字节到达的帧，掩码相位要跨越多次读取保持对齐
+    Buffer buf;
+    std::string text = "\xe4\xbd\xa0\xe5\xa5\xbd, fragmented byte by byte";
+    websocket::append_frame(&buf, websocket::k_text, text.data(), text.size(), true, k_mask);
+    std::string raw = buf.retrieve_all_as_string();
+    for (char c : raw) {
+        client.write_raw(std::string(1, c));
+        ::usleep(500);
+    }
+    assert(expect_message(&client, websocket::k_text) == "echo:" + text);
+
+    // 空消息
+    client.send(websocket::k_text, "");
+    assert(expect_message(&client, websocket::k_text) == "echo:");
+
+    // 正常关闭：服务端回送同样的状态码并断开
+    size_t closed = close_count();
+    client.send(websocket::k_close, std::string("\x03\xe8" "bye", 5));
+    assert(client.read_close() == websocket::k_normal_closure);
+    client.close();
+    assert(last_close_code(closed + 1) == websocket::k_normal_closure);
+}
+
+void test_broadcast() {
+    printf("test_broadcast\n");
+    std::vector<std::unique_ptr<Client>> clients;
+    for (int i = 0; i < 5; ++i) {
+        clients.emplace_back(new Client(k_port));
+        clients.back()->handshake();
+        expect_message(clients.back().get(), websocket::k_text);
+    }
+    clients[2]->send(websocket::k_text, "broadcast:news");
+    for (auto &client : clients) {
+        assert(expect_message(client.get(), websocket::k_text) == "news");
+    }
+    // 服务端发起关闭，客户端不回送关闭帧，之后所有连接断开
+    size_t closed = close_count();
+    clients[0]->send(websocket::k_text, "close");
+    assert(clients[0]->read_close() == websocket::k_going_away);
+    clients.clear();
+    assert(last_close_code(closed + 5) == websocket::k_abnormal_closure);
+}
+
+void test_protocol_errors() {
+    printf("test_protocol_errors\n");
+    size_t closed = close_count();
+    {
+        // 客户端的帧没有掩码
+        Client client(k_port);
+        client.handshake();
+        expect_message(&client, websocket::k_text);
+        Buffer buf;
+        websocket::append_frame(&buf, websocket::k_text, "x", 1);
+        client.write_raw(buf.retrieve_all_as_string());
+        assert(client.read_close() == websocket::k_protocol_error);
+    }
+    {
+        // 文本消息不是UTF-8，分片拆开了一个多字节字符也应当能通过
+        Client client(k_port);
+        client.handshake();
+        expect_message(&client, websocket::k_text);
+        client.send(websocket::k_text, "\xe4\xbd", false);
+        client.send(websocket::k_continuation, "\xa0", true);
+        assert(expect_message(&client, websocket::k_text) == "echo:\xe4\xbd\xa0");
+        client.send(websocket::k_text, "\xff\xfe");
+        assert(client.read_close() == websocket::k_invalid_payload);
+    }
+    {
+        // 消息超过上限
+        Client client(k_port);
+        client.handshake();
+        expect_message(&client, websocket::k_text);
+        client.send(websocket::k_binary, std::string(600 * 1024, 'a'), false);
+        client.send(websocket::k_continuation, std::string(600 * 1024, 'b'), true);
+        assert(client.read_close() == websocket::k_message_too_big);
+    }
+    {
+        // 没有开始消息的续帧，以及过长的控制帧
+        Client client(k_port);
+        client.handshake();
+        expect_message(&client, websocket::k_text);
+        client.send(websocket::k_continuation, "x");
+        assert(client.read_close() == websocket::k_protocol_error);
+
+        Client control(k_port);
+        control.handshake();
+        expect_message(&control, websocket::k_text);
+        control.send(websocket::k_ping, std::string(126, 'p'));
+        assert(control.read_close() == websocket::k_protocol_error);
+    }
+    // 没有收到对端的关闭帧，on_close得到1006
+    for (size_t i = 1; i <= 5; ++i) {
+        assert(last_close_code(closed + i) == websocket::k_abnormal_closure);
+    }
+}
+
+void test_keepalive() {
+    printf("test_keepalive\n");
+    size_t closed = close_count();
+    // 空闲的连接收到ping，回复pong后连接保持
+    Client alive(k_ping_port);
+    alive.handshake();
+    expect_message(&alive, websocket::k_text);
+    for (int i = 0; i < 3; ++i) {
+        std::string payload = expect_message(&alive, websocket::k_ping);
+        alive.send(websocket::k_pong, payload);
+    }
+    alive.send(websocket::k_text, "still here");
+    uint8_t opcode;
+    std::string payload;
+    do {
+        bool ok = alive.read_frame(&opcode, &payload);
+        assert(ok);
+        (void)ok;
+    } while (opcode == websocket::k_ping);
+    assert(payload == "echo:still here");
+
+    // 不回复pong的连接被断开
+    Client dead(k_ping_port);
+    dead.handshake();
+    expect_message(&dead, websocket::k_text);
+    while (dead.read_frame(&opcode, &payload)) {
+        assert(opcode == websocket::k_ping);
+    }
+    assert(last_close_code(closed + 1) == websocket::k_abnormal_closure);
+}
+
+} // namespace
+
+int main() {
+    test_codec();
+
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        std::set<WebSocketPtr> connections;
+        WebSocketHandler handler;
+        handler.accept = [](const HttpRequest &req) {
+            return req.path() == "/chat";
+        };
+        handler.on_open = [&connections](const WebSocketPtr &ws, const HttpRequest &req) {
+            connections.insert(ws);
+            ws->send_text("welcome " + req.path());
+        };
+        handler.on_message = [&connections](const WebSocketPtr &ws, const std::string &message, bool binary) {
+            if (binary) {
+                ws->send_binary(message.data(), message.size());
+            } else if (message.compare(0, 10, "broadcast:") == 0) {
+                websocket::Frame frame = websocket::make_frame(websocket::k_text, message.substr(10));
+                for (const WebSocketPtr &other : connections) {
+                    other->send(frame);
+                }
+            } else if (message == "close") {
+                ws->close(websocket::k_going_away, "server shutting down");
+            } else {
+                ws->send_text("echo:" + message);
+            }
+        };
+        handler.on_close = [&connections](const WebSocketPtr &ws, uint16_t code) {
+            connections.erase(ws);
+            MutexLockGuard lock(g_mutex);
+            g_close_codes.push_back(code);
+        };
+        auto callback = [](const HttpRequest &, HttpResponse *resp) {
+            resp->set_status_code(HttpResponse::k_200_ok);
+            resp->set_status_message("OK");
+            resp->set_body("plain http");
+        };
+
+        WebSocketOptions options;
+        options.max_message_size = 1024 * 1024;
+        options.ping_interval = 0;
+        HttpServer server(&loop, InetAddress(k_port), "websocket");
+        server.set_http_callback(callback);
+        server.set_websocket_handler(handler, options);
+        server.start();
+
+        WebSocketOptions ping_options;
+        ping_options.ping_interval = 0.1;
+        HttpServer ping_server(&loop, InetAddress(k_ping_port), "websocket-ping");
+        ping_server.set_http_callback(callback);
+        ping_server.set_websocket_handler(handler, ping_options);
+        ping_server.start();
+
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    test_handshake();
+    test_messages();
+    test_broadcast();
+    test_protocol_errors();
+    test_keepalive();
+
+    server_loop->quit();
+    server_thread.join();
+    printf("all tests passed\n");
+    return 0;
+}
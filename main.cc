@@ -6,12 +6,13 @@
  * @author David Shu (a294562476@gmail.com)
  */
 
-#include <map>
-#include <iostream>
-
+#include "http/Compression.h"
+#include "http/FileCache.h"
 #include "http/HttpServer.h"
 #include "http/HttpRequest.h"
 #include "http/HttpResponse.h"
+#include "http/Router.h"
+#include "http/StaticFile.h"
 #include "base/Logging.h"
 #include "net/EventLoop.h"
 
@@ -19,45 +20,55 @@ using namespace web_server;
 using namespace web_server::net;
 using namespace web_server::http;
 
-void on_request(const HttpRequest &req, HttpResponse *resp) {
-    // 为了性能评测，先不进行状态回显
-    // std::cout << "Headers " << req.method_string() << " " << req.path() << std::endl;
-    // const std::map<std::string, std::string> &headers = req.headers();
-    // for (const auto &header : headers) {
-    //     std::cout << header.first << ": " << header.second << std::endl;
-    // }
+void on_index(const HttpRequest &, const RouteParams &, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_content_type("text/html");
+    resp->add_header("Server", "web_server");
+    std::string now = Timestamp::now().to_formatted_string();
+    resp->set_body("<html><head><title>This is title</title></head>"
+                   "<body><h1>Hello</h1>Now is " + now +
+                   "</body></html>");
+}
 
-    if (req.path() == "/") {
-        resp->set_status_code(HttpResponse::k_200_ok);
-        resp->set_status_message("OK");
-        resp->set_content_type("text/html");
-        resp->add_header("Server", "web_server");
-        std::string now = Timestamp::now().to_formatted_string();
-        resp->set_body("<html><head><title>This is title</title></head>"
-                       "<body><h1>Hello</h1>Now is " + now +
-                       "</body></html>");
-    } else if (req.path() == "/hello") {
-        resp->set_status_code(HttpResponse::k_200_ok);
-        resp->set_status_message("OK");
-        resp->set_content_type("text/plain");
-        resp->set_body("hello, world!\n");
-    } else {
-        resp->set_status_code(HttpResponse::k_404_not_found);
-        resp->set_status_message("Not Found");
-        resp->set_close_connection(true);
-    }
+void on_hello(const HttpRequest &, const RouteParams &params, HttpResponse *resp) {
+    resp->set_status_code(HttpResponse::k_200_ok);
+    resp->set_status_message("OK");
+    resp->set_content_type("text/plain");
+    boost::string_ref name = params.get("name");
+    resp->set_body(name.empty() ? std::string("hello, world!\n") : "hello, " + name.to_string() + "!\n");
 }
 
 int main(int argc, char *argv[]) {
     int num_threads = 0;
+    int num_workers = 0;
     if (argc > 1) {
         Logger::set_log_level(Logger::TRACE);
         num_threads = atoi(argv[1]);
     }
+    // 第二个参数为计算线程数，大于0时handler在计算线程池中执行
+    if (argc > 2) {
+        num_workers = atoi(argv[2]);
+    }
     EventLoop loop;
+    // 打开的静态文件在所有IO线程和计算线程之间共享
+    FileCache file_cache(&loop);
     HttpServer server(&loop, InetAddress(8047), "http_server");
-    server.set_http_callback(on_request);
+    // 路由在start之前注册完成，之后只读，可以在多个IO线程和计算线程中并发匹配
+    Router router;
+    router.get("/", on_index);
+    router.get("/hello", on_hello);
+    router.get("/hello/:name", on_hello);
+    // 第三个参数为静态文件根目录，通过/static/访问
+    if (argc > 3) {
+        router.get("/static/*filepath", StaticFileHandler(argv[3], &file_cache));
+    }
+    server.set_http_callback([&router](const HttpRequest &req, HttpResponse *resp) {
+        router.dispatch(req, resp);
+    });
+    server.enable_compression(CompressionOptions());
     server.set_thread_num(num_threads);
+    server.set_worker_thread_num(num_workers);
     server.start();
     loop.loop();
 }
\ No newline at end of file
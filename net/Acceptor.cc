@@ -54,7 +54,7 @@ void Acceptor::listen() {
     listening_ = true;
     accept_socket_.listen();
     accept_channel_.enable_reading();
-    // LOG_TRACE << "acceptor channel fd set";
+    LOG_TRACE << "acceptor channel fd set";
 }
 
 /**
@@ -73,9 +73,8 @@ void Acceptor:: handle_read() {
         } else {
             ::close(connd);
         }
-    } else {
-        // LOG_SYSERR << "in Acceptor::handle_read";
     }
+    // 失败的原因已经由Socket::accept按errno区分并输出
 }
 
 } // namespace net
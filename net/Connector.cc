@@ -56,7 +56,8 @@ void Connector::restart() {
 
 void Connector::stop() {
     connect_ = false;
-    loop_->queue_in_loop(std::bind(&Connector::stop_in_loop, this));
+    // 持有自身，TcpClient可能在stop之后立即析构
+    loop_->queue_in_loop(std::bind(&Connector::stop_in_loop, shared_from_this()));
 }
 
 void Connector::start_in_loop() {
@@ -74,7 +75,7 @@ void Connector::stop_in_loop() {
     if (state_ == kConnecting) {
         set_state(kDisconnected);
         int sockfd = remove_and_reset_channel();
-        retry(sockfd);
+        retry(sockfd, 0);
     }
 }
 
@@ -99,7 +100,7 @@ void Connector::connect() {
     case EADDRNOTAVAIL:
     case ECONNREFUSED:
     case ENETUNREACH:
-        retry(sockfd);
+        retry(sockfd, saved_errno);
         break;
     
     case EACCES:
@@ -111,11 +112,17 @@ void Connector::connect() {
     case ENOTSOCK:
         // LOG_SYSERR << "connect error in Connector::startInLoop " << saved_errno;
         ::close(sockfd);
+        if (error_callback_) {
+            error_callback_(saved_errno);
+        }
         break;
 
     default:
         // LOG_SYSERR << "Unexpected error in Connector::startInLoop " << saved_errno;
         ::close(sockfd);
+        if (error_callback_) {
+            error_callback_(saved_errno);
+        }
         break;
     }
 }
@@ -136,10 +143,10 @@ void Connector::handle_write() {
         int err = sockets::get_socket_error(sockfd);
         if (err) {
             // LOG_WARN << "Connector::handle_write - SO_ERROR = " << err << " " << strerror_tl(err);
-            retry(sockfd);
+            retry(sockfd, err);
         } else if (sockets::is_self_connect(sockfd)) {
             // LOG_WARN << "Connector::handle_write - Self connect";
-            retry(sockfd);
+            retry(sockfd, ECONNREFUSED);
         } else {
             set_state(kConnected);
             if (connect_) {
@@ -159,14 +166,17 @@ void Connector::handle_error() {
         int sockfd = remove_and_reset_channel();
         int err = sockets::get_socket_error(sockfd);
         // LOG_TRACE << "SO_ERROR = " << err << " " << strerror_tl(err);
-        retry(sockfd);
+        retry(sockfd, err);
     }
 }
 
-void Connector::retry(int sockfd) {
+void Connector::retry(int sockfd, int saved_errno) {
     ::close(sockfd);
     set_state(kDisconnected);
-    if (connect_) {
+    if (connect_ && error_callback_) {
+        connect_ = false;
+        error_callback_(saved_errno);
+    } else if (connect_) {
         // LOG_INFO << "Connector::retry - Retry connecting to " << server_addr_.to_IP_port() << " in " << retry_delay_ms_ << " milliseconds. ";
         loop_->run_after(retry_delay_ms_ / 1000.0,
                          std::bind(&Connector::start_in_loop, shared_from_this()));
@@ -180,7 +190,8 @@ int Connector::remove_and_reset_channel() {
     channel_->disable_all();
     channel_->remove();
     int sockfd = channel_->fd();
-    loop_->queue_in_loop(std::bind(&Connector::reset_channel, this));
+    // 连接建立后TcpClient可能在本轮事件处理中析构，持有自身直到channel_释放
+    loop_->queue_in_loop(std::bind(&Connector::reset_channel, shared_from_this()));
     return sockfd;
 }
 
@@ -26,12 +26,21 @@ class Connector : private Noncopyable,
                   public std::enable_shared_from_this<Connector> {
 public:
     using NewConnectionCallback = std::function<void(int sockfd)>;
+    using ErrorCallback = std::function<void(int saved_errno)>;
     Connector(EventLoop *loop, const InetAddress &server_addr);
     ~Connector();
 
     void set_new_connection_callback(const NewConnectionCallback &cb) {
         new_connection_callback_ = cb;
     }
+
+    /**
+     * @brief 连接失败时回调，设置之后不再自动重试，由使用者决定是否重新start
+     * @param cb 参数是失败原因的errno
+     */
+    void set_error_callback(const ErrorCallback &cb) {
+        error_callback_ = cb;
+    }
     // call in any thread
     void start();
 
@@ -54,6 +63,7 @@ private:
     States state_;
     std::unique_ptr<Channel> channel_;
     NewConnectionCallback new_connection_callback_;
+    ErrorCallback error_callback_;
     int retry_delay_ms_;
 
     void set_state(States s) {
@@ -66,7 +76,7 @@ private:
     void connecting(int sockfd);
     void handle_write();
     void handle_error();
-    void retry(int sockfd);
+    void retry(int sockfd, int saved_errno);
     int remove_and_reset_channel();
     void reset_channel();
 };
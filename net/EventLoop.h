@@ -36,8 +36,13 @@ class TimerQueue;
 class EventLoop : private Noncopyable {
 public:
     using Functor = std::function<void()>;
+    using PollerFactory = std::function<Poller *(EventLoop *)>;
 
     EventLoop();
+    /**
+     * @brief 使用factory创建的Poller代替默认的epoll，例如配合MemoryTransport使用的MemoryPoller
+     */
+    explicit EventLoop(const PollerFactory &poller_factory);
     ~EventLoop();
 
     void loop();
@@ -0,0 +1,221 @@
+/**
+ * @brief 进程内的内存传输
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "net/MemoryTransport.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+
+#include "base/Atomic.h"
+#include "base/Mutex.h"
+#include "net/Buffer.h"
+#include "net/EventLoop.h"
+
+namespace web_server {
+
+namespace net {
+
+/**
+ * @brief 一个方向上的数据，两端分别在各自的loop线程中访问，所有成员由mutex保护
+ */
+struct MemoryTransport::Pipe {
+    explicit Pipe(size_t capacity_arg)
+        : capacity(capacity_arg) {}
+
+    // 注册的loop在其他线程时唤醒它，持有mutex调用，保证loop不会在此期间注销
+    static void notify(EventLoop *loop) {
+        if (loop && !loop->is_in_loop_thread()) {
+            loop->wakeup();
+        }
+    }
+
+    MutexLock mutex;
+    Buffer data;
+    const size_t capacity;
+    bool write_closed = false;
+    bool read_closed = false;
+    EventLoop *reader_loop = nullptr;
+    EventLoop *writer_loop = nullptr;
+};
+
+namespace {
+
+AtomicInt32 g_next_fd;
+
+MutexLock &registry_mutex() {
+    static MutexLock mutex;
+    return mutex;
+}
+
+std::map<int, MemoryTransport *> &registry() {
+    static std::map<int, MemoryTransport *> transports;
+    return transports;
+}
+
+} // namespace
+
+MemoryTransport::Pair MemoryTransport::create_pair(size_t capacity) {
+    std::shared_ptr<Pipe> forward(new Pipe(capacity));
+    std::shared_ptr<Pipe> backward(new Pipe(capacity));
+    Pair pair(std::unique_ptr<MemoryTransport>(new MemoryTransport(backward, forward)),
+              std::unique_ptr<MemoryTransport>(new MemoryTransport(forward, backward)));
+    MutexLockGuard lock(registry_mutex());
+    registry()[pair.first->fd()] = pair.first.get();
+    registry()[pair.second->fd()] = pair.second.get();
+    return pair;
+}
+
+MemoryTransport *MemoryTransport::find(int fd) {
+    MutexLockGuard lock(registry_mutex());
+    auto it = registry().find(fd);
+    return it == registry().end() ? nullptr : it->second;
+}
+
+MemoryTransport::MemoryTransport(std::shared_ptr<Pipe> in, std::shared_ptr<Pipe> out)
+    : fd_(k_first_fd + g_next_fd.get_add(1)),
+      in_(std::move(in)),
+      out_(std::move(out)) {}
+
+/**
+ * @brief 相当于关闭socket：对端再写得到EPIPE，再读得到剩余数据后EOF
+ */
+MemoryTransport::~MemoryTransport() {
+    {
+        MutexLockGuard lock(registry_mutex());
+        registry().erase(fd_);
+    }
+    {
+        MutexLockGuard lock(in_->mutex);
+        in_->read_closed = true;
+        in_->reader_loop = nullptr;
+        in_->data.retrieve_all();
+        Pipe::notify(in_->writer_loop);
+    }
+    {
+        MutexLockGuard lock(out_->mutex);
+        out_->write_closed = true;
+        out_->writer_loop = nullptr;
+        Pipe::notify(out_->reader_loop);
+    }
+}
+
+ssize_t MemoryTransport::read(Buffer *buf, int *saved_errno) {
+    MutexLockGuard lock(in_->mutex);
+    size_t n = in_->data.readable_bytes();
+    if (n == 0) {
+        if (in_->write_closed) {
+            return 0;
+        }
+        *saved_errno = EAGAIN;
+        return -1;
+    }
+    bool was_full = n >= in_->capacity;
+    buf->append(in_->data.peek(), n);
+    in_->data.retrieve_all();
+    // 只有从满变为不满时写端才可能在等待
+    if (was_full) {
+        Pipe::notify(in_->writer_loop);
+    }
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t MemoryTransport::write(const void *data, size_t len) {
+    MutexLockGuard lock(out_->mutex);
+    if (out_->read_closed || out_->write_closed) {
+        errno = EPIPE;
+        return -1;
+    }
+    size_t used = out_->data.readable_bytes();
+    size_t n = std::min(len, out_->capacity - used);
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    out_->data.append(data, n);
+    // 缓冲区原来不空时读端还没有读完，一定会再次检查就绪状态
+    if (used == 0) {
+        Pipe::notify(out_->reader_loop);
+    }
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t MemoryTransport::send_file(int in_fd, off_t *offset, size_t count) {
+    MutexLockGuard lock(out_->mutex);
+    if (out_->read_closed || out_->write_closed) {
+        errno = EPIPE;
+        return -1;
+    }
+    size_t used = out_->data.readable_bytes();
+    size_t n = std::min(count, out_->capacity - used);
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    out_->data.ensure_writable_bytes(n);
+    ssize_t nread = ::pread(in_fd, out_->data.begin_write(), n, *offset);
+    if (nread > 0) {
+        out_->data.has_written(static_cast<size_t>(nread));
+        *offset += nread;
+        if (used == 0) {
+            Pipe::notify(out_->reader_loop);
+        }
+    }
+    return nread;
+}
+
+void MemoryTransport::shutdown_write() {
+    MutexLockGuard lock(out_->mutex);
+    out_->write_closed = true;
+    Pipe::notify(out_->reader_loop);
+}
+
+bool MemoryTransport::get_tcp_info_string(char *buf, int len) const {
+    snprintf(buf, len, "memory transport fd=%d", fd_);
+    return false;
+}
+
+bool MemoryTransport::readable() const {
+    MutexLockGuard lock(in_->mutex);
+    return in_->data.readable_bytes() > 0 || in_->write_closed;
+}
+
+bool MemoryTransport::writable() const {
+    MutexLockGuard lock(out_->mutex);
+    return out_->read_closed || out_->data.readable_bytes() < out_->capacity;
+}
+
+bool MemoryTransport::peer_closed() const {
+    // 两端可能在不同线程同时检查，不能嵌套加锁
+    {
+        MutexLockGuard lock(in_->mutex);
+        if (!in_->write_closed || in_->data.readable_bytes() > 0) {
+            return false;
+        }
+    }
+    MutexLockGuard lock(out_->mutex);
+    return out_->read_closed;
+}
+
+void MemoryTransport::set_loop(EventLoop *loop) {
+    {
+        MutexLockGuard lock(in_->mutex);
+        in_->reader_loop = loop;
+    }
+    {
+        MutexLockGuard lock(out_->mutex);
+        out_->writer_loop = loop;
+    }
+}
+
+} // namespace net
+
+} // namespace web_server
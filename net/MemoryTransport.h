@@ -0,0 +1,91 @@
+/**
+ * @brief 进程内的内存传输，用来在没有内核socket的情况下测量HTTP协议栈本身的开销
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_NET_MEMORYTRANSPORT_H
+#define WEB_SERVER_NET_MEMORYTRANSPORT_H
+
+#include <memory>
+#include <utility>
+
+#include "net/Transport.h"
+
+namespace web_server {
+
+namespace net {
+
+class EventLoop;
+
+/**
+ * @brief 一对MemoryTransport组成一条双向的内存连接，每个方向是一个有容量上限的缓冲区
+ * fd()返回的是不对应任何内核对象的假描述符，只能注册到MemoryPoller；
+ * 读写的返回值和errno与非阻塞socket一致：缓冲区满或空时EAGAIN，对端关闭读后写返回EPIPE，对端关闭写后读返回0
+ */
+class MemoryTransport : public Transport {
+public:
+    using Pair = std::pair<std::unique_ptr<MemoryTransport>, std::unique_ptr<MemoryTransport>>;
+
+    static const size_t k_default_capacity = 64 * 1024;
+
+    static Pair create_pair(size_t capacity = k_default_capacity);
+
+    /**
+     * @brief 判断fd是否属于内存传输，假描述符从k_first_fd开始分配，不会和内核描述符重叠
+     */
+    static bool is_memory_fd(int fd) {
+        return fd >= k_first_fd;
+    }
+
+    /**
+     * @brief 根据假描述符找到对应的端点，没有时返回nullptr
+     */
+    static MemoryTransport *find(int fd);
+
+    ~MemoryTransport() override;
+
+    int fd() const override {
+        return fd_;
+    }
+
+    ssize_t read(Buffer *buf, int *saved_errno) override;
+    ssize_t write(const void *data, size_t len) override;
+    ssize_t send_file(int in_fd, off_t *offset, size_t count) override;
+    void shutdown_write() override;
+    int get_error() const override {
+        return 0;
+    }
+    void set_tcp_no_delay(bool) override {}
+    bool get_tcp_info_string(char *buf, int len) const override;
+
+    // 以下由MemoryPoller调用，判断就绪状态
+    bool readable() const;
+    bool writable() const;
+    // 对端已经销毁且没有剩余数据，相当于POLLHUP
+    bool peer_closed() const;
+
+    /**
+     * @brief 设置注册了该端点的loop，对端在其他线程写入数据或腾出空间时唤醒它；nullptr表示注销
+     */
+    void set_loop(EventLoop *loop);
+
+private:
+    struct Pipe;
+
+    static const int k_first_fd = 1 << 30;
+
+    MemoryTransport(std::shared_ptr<Pipe> in, std::shared_ptr<Pipe> out);
+
+    const int fd_;
+    std::shared_ptr<Pipe> in_;      // 对端写、本端读
+    std::shared_ptr<Pipe> out_;     // 本端写、对端读
+};
+
+} // namespace net
+
+} // namespace web_server
+
+#endif // WEB_SERVER_NET_MEMORYTRANSPORT_H
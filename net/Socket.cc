@@ -85,30 +85,33 @@ int Socket::accept(InetAddress *peeraddr) {
         return connfd;
     } else {
         int saved_errno = errno;
-        // LOG_SYSERR << "Socket::accept";
         switch (saved_errno) {
+            // 对端在accept之前断开、被信号打断等情况是正常的，不输出日志
             case EAGAIN:
             case ECONNABORTED:
             case EINTR:
             case EPROTO:
             case EPERM:
+                break;
+            // 描述符或内存耗尽，监听socket一直可读，每次读事件都会重试，限频输出
             case EMFILE:
-                errno = saved_errno;
+            case ENFILE:
+            case ENOBUFS:
+            case ENOMEM:
+                LOG_SYSERR_EVERY_T(1) << "Socket::accept";
                 break;
             case EBADF:
             case EFAULT:
             case EINVAL:
-            case ENFILE:
-            case ENOBUFS:
-            case ENOMEM:
             case ENOTSOCK:
             case EOPNOTSUPP:
-                // LOG_FATAL << "unexpected error of ::accept " << saved_errno;
+                LOG_SYSERR_EVERY_T(1) << "unexpected error of Socket::accept";
                 break;
             default:
-                // LOG_FATAL << "unknown error of ::accept " << saved_errno;
+                LOG_SYSERR_EVERY_T(1) << "unknown error of Socket::accept";
                 break;
         }
+        errno = saved_errno;
     }
     return -1;
 }
@@ -25,6 +25,8 @@ void remove_connection(EventLoop *loop, const TcpConnectionPtr &conn) {
     loop->queue_in_loop(std::bind(&TcpConnection::connection_destroyed, conn));
 }
 
+void ignore_connection(const TcpConnectionPtr &) {}
+
 } // namespace detail
 
 TcpClient::TcpClient(EventLoop *loop, const InetAddress &server_addr,
@@ -58,6 +60,10 @@ TcpClient::~TcpClient() {
     }
 }
 
+void TcpClient::set_connect_error_callback(const Connector::ErrorCallback &cb) {
+    connector_->set_error_callback(cb);
+}
+
 void TcpClient::connect() {
     // LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to " << connector_->server_address().to_IP_port();
     connect_ = true;
@@ -117,6 +123,27 @@ void TcpClient::remove_connection(const TcpConnectionPtr &conn) {
     }
 }
 
+void release_tcp_client(std::shared_ptr<TcpClient> *client) {
+    std::shared_ptr<TcpClient> released;
+    released.swap(*client);
+    if (!released) {
+        return;
+    }
+    EventLoop *loop = released->get_loop();
+    loop->assert_in_loop_thread();
+    released->stop();
+    TcpConnectionPtr conn = released->connection();
+    // 已经断开的连接不会再有回调，不必替换
+    if (conn && !conn->disconnected()) {
+        conn->set_connection_callback(detail::ignore_connection);
+        conn->set_message_callback(default_message_callback);
+        conn->set_write_complete_callback(WriteCompleteCallback());
+        conn->force_close();
+    }
+    // 排在force_close之后，关闭回调remove_connection执行时TcpClient还在
+    loop->queue_in_loop([released]() {});
+}
+
 } // namespace net
 
 } // namespace web_server
\ No newline at end of file
@@ -10,13 +10,13 @@
 #define WEB_SERVER_NET_TCPCLIENT_H
 
 #include "base/Mutex.h"
+#include "net/Connector.h"
 #include "net/TcpConnection.h"
 
 namespace web_server {
 
 namespace net {
 
-class Connector;
 using ConnectorPtr = std::shared_ptr<Connector>;
 
 class TcpClient : private Noncopyable {
@@ -58,6 +58,11 @@ public:
         write_complete_callback_ = cb;
     }
 
+    /**
+     * @brief 连接失败时回调，设置之后不再自动重试，必须在connect之前设置
+     */
+    void set_connect_error_callback(const Connector::ErrorCallback &cb);
+
 private:
     EventLoop *loop_;
     ConnectorPtr connector_;
@@ -75,6 +80,14 @@ private:
     void remove_connection(const TcpConnectionPtr &conn);
 };
 
+/**
+ * @brief 放弃并释放client，可以在它自己的回调中调用，只能在它的loop线程调用
+ * 之后不会再有连接和消息回调；停止连接，已建立的连接被强制关闭，
+ * TcpClient推迟到本轮事件处理之后销毁，*client被置空。
+ * 在消息回调中调用时该回调被替换，返回后不能再访问它绑定的参数
+ */
+void release_tcp_client(std::shared_ptr<TcpClient> *client);
+
 } // namespace net
 
 } // namespace web_server
@@ -0,0 +1,286 @@
+/**
+ * @brief 到同一个服务端的多连接客户端，每个IO loop各自持有一组连接
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "net/TcpClientPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpClient.h"
+
+namespace web_server {
+
+namespace net {
+
+/**
+ * @brief 一个loop中的连接，所有成员只在该loop线程中访问
+ * 每个槽位对应一个TcpClient，重连时换成新的TcpClient，旧的在本轮事件处理之后销毁
+ */
+class TcpClientPool::LoopPool : private Noncopyable {
+public:
+    LoopPool(TcpClientPool *owner, EventLoop *loop, size_t index)
+        : owner_(owner),
+          loop_(loop),
+          index_(index),
+          next_(0),
+          next_conn_ID_(1),
+          stopped_(false),
+          slots_(owner->options_.connections_per_loop) {}
+
+    EventLoop *loop() const {
+        return loop_;
+    }
+
+    void start() {
+        loop_->assert_in_loop_thread();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].retry_delay = owner_->options_.reconnect_delay;
+            connect(i);
+        }
+    }
+
+    /**
+     * @brief 从上次选中的下一个槽位开始找未完成请求最少的连接，计数相同时轮流使用
+     */
+    TcpConnectionPtr acquire() {
+        loop_->assert_in_loop_thread();
+        size_t best = slots_.size();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            size_t index = (next_ + i) % slots_.size();
+            const Slot &slot = slots_[index];
+            if (slot.conn && slot.conn->connected() &&
+                (best == slots_.size() || slot.outstanding < slots_[best].outstanding)) {
+                best = index;
+            }
+        }
+        if (best == slots_.size()) {
+            return TcpConnectionPtr();
+        }
+        next_ = best + 1;
+        ++slots_[best].outstanding;
+        return slots_[best].conn;
+    }
+
+    void release(const TcpConnectionPtr &conn, bool healthy) {
+        loop_->assert_in_loop_thread();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            Slot &slot = slots_[i];
+            if (slot.conn != conn) {
+                continue;
+            }
+            if (slot.outstanding > 0) {
+                --slot.outstanding;
+            }
+            if (healthy) {
+                slot.failures = 0;
+            } else if (++slot.failures >= owner_->options_.max_failures) {
+                LOG_WARN << "TcpClientPool[" << owner_->name_ << "] evicting " << conn->name()
+                         << " after " << slot.failures << " failures";
+                // 淘汰的连接立即重连，不需要退避
+                slot.retry_delay = 0;
+                conn->force_close();
+            }
+            return;
+        }
+    }
+
+    /**
+     * @brief loop线程即将退出，直接销毁连接，不等待关闭回调
+     */
+    void shutdown() {
+        loop_->assert_in_loop_thread();
+        stopped_ = true;
+        for (Slot &slot : slots_) {
+            loop_->cancel(slot.retry_timer);
+            if (slot.conn) {
+                if (slot.conn->connected()) {
+                    --owner_->connected_;
+                }
+                // 使用者仍然会收到断开通知
+                slot.conn->set_connection_callback(owner_->connection_callback_);
+                slot.conn->connection_destroyed();
+                slot.conn.reset();
+            } else if (slot.client) {
+                slot.client->stop();
+            }
+            slot.client.reset();
+        }
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<TcpClient> client;
+        TcpConnectionPtr conn;
+        size_t outstanding = 0;
+        int failures = 0;
+        double retry_delay = 0;
+        TimerID retry_timer;
+    };
+
+    void connect(size_t index) {
+        Slot &slot = slots_[index];
+        char buf[48];
+        snprintf(buf, sizeof buf, "-%zu-%zu#%d", index_, index, next_conn_ID_++);
+        std::shared_ptr<TcpClient> client = std::make_shared<TcpClient>(loop_, owner_->server_addr_,
+                                                                        owner_->name_ + buf);
+        client->set_connection_callback(std::bind(&LoopPool::on_connection, this, index, _1));
+        client->set_message_callback(owner_->message_callback_);
+        client->set_write_complete_callback(owner_->write_complete_callback_);
+        client->set_connect_error_callback([this, index](int) {
+            if (!stopped_) {
+                schedule_reconnect(index);
+            }
+        });
+        release_tcp_client(&slot.client);
+        slot.client = client;
+        slot.client->connect();
+    }
+
+    void schedule_reconnect(size_t index) {
+        Slot &slot = slots_[index];
+        double delay = slot.retry_delay;
+        slot.retry_delay = std::min(std::max(delay * 2, owner_->options_.reconnect_delay),
+                                    owner_->options_.max_reconnect_delay);
+        slot.retry_timer = loop_->run_after(delay, [this, index]() {
+            if (!stopped_) {
+                connect(index);
+            }
+        });
+    }
+
+    void on_connection(size_t index, const TcpConnectionPtr &conn) {
+        Slot &slot = slots_[index];
+        if (stopped_) {
+            return;
+        }
+        if (conn->connected()) {
+            slot.conn = conn;
+            slot.outstanding = 0;
+            slot.failures = 0;
+            slot.retry_delay = owner_->options_.reconnect_delay;
+            ++owner_->connected_;
+        } else {
+            slot.conn.reset();
+            slot.outstanding = 0;
+            --owner_->connected_;
+        }
+        if (owner_->connection_callback_) {
+            owner_->connection_callback_(conn);
+        }
+        if (!conn->connected()) {
+            schedule_reconnect(index);
+        }
+    }
+
+    TcpClientPool *owner_;
+    EventLoop *loop_;
+    const size_t index_;
+    size_t next_;
+    int next_conn_ID_;
+    bool stopped_;
+    std::vector<Slot> slots_;
+};
+
+TcpClientPool::TcpClientPool(EventLoop *base_loop,
+                             const InetAddress &server_addr,
+                             const std::string &name,
+                             const TcpClientPoolOptions &options)
+    : base_loop_(base_loop),
+      server_addr_(server_addr),
+      name_(name),
+      options_(options),
+      connection_callback_(default_connection_callback),
+      message_callback_(default_message_callback),
+      connected_(0),
+      thread_pool_(new EventLoopThreadPool(base_loop, name)) {
+    assert(options_.connections_per_loop > 0);
+}
+
+TcpClientPool::~TcpClientPool() {
+    base_loop_->assert_in_loop_thread();
+    shutdown();
+}
+
+void TcpClientPool::set_thread_num(int num_threads) {
+    assert(!thread_pool_->is_started());
+    thread_pool_->set_thread_num(num_threads);
+}
+
+void TcpClientPool::start() {
+    base_loop_->assert_in_loop_thread();
+    assert(!thread_pool_->is_started());
+    thread_pool_->start();
+    std::vector<EventLoop *> loops = thread_pool_->get_all_loops();
+    for (size_t i = 0; i < loops.size(); ++i) {
+        loop_pools_.emplace_back(new LoopPool(this, loops[i], i));
+    }
+    for (const std::unique_ptr<LoopPool> &pool : loop_pools_) {
+        pool->loop()->run_in_loop(std::bind(&LoopPool::start, pool.get()));
+    }
+}
+
+TcpClientPool::LoopPool *TcpClientPool::loop_pool(EventLoop *loop) const {
+    for (const std::unique_ptr<LoopPool> &pool : loop_pools_) {
+        if (pool->loop() == loop) {
+            return pool.get();
+        }
+    }
+    return nullptr;
+}
+
+TcpConnectionPtr TcpClientPool::acquire() {
+    LoopPool *pool = loop_pool(EventLoop::get_event_loop_of_current_thread());
+    assert(pool);
+    return pool->acquire();
+}
+
+void TcpClientPool::release(const TcpConnectionPtr &conn, bool healthy) {
+    LoopPool *pool = loop_pool(conn->get_loop());
+    assert(pool);
+    pool->release(conn, healthy);
+}
+
+EventLoop *TcpClientPool::get_next_loop() {
+    return thread_pool_->get_next_loop();
+}
+
+std::vector<EventLoop *> TcpClientPool::get_all_loops() const {
+    std::vector<EventLoop *> loops;
+    for (const std::unique_ptr<LoopPool> &pool : loop_pools_) {
+        loops.push_back(pool->loop());
+    }
+    return loops;
+}
+
+/**
+ * @brief 在各自的loop线程中关闭连接，IO线程此时还在运行
+ */
+void TcpClientPool::shutdown() {
+    for (const std::unique_ptr<LoopPool> &pool : loop_pools_) {
+        if (pool->loop()->is_in_loop_thread()) {
+            pool->shutdown();
+        } else {
+            CountDownLatch latch(1);
+            LoopPool *p = pool.get();
+            pool->loop()->run_in_loop([p, &latch]() {
+                p->shutdown();
+                latch.count_down();
+            });
+            latch.wait();
+        }
+    }
+}
+
+} // namespace net
+
+} // namespace web_server
@@ -0,0 +1,128 @@
+/**
+ * @brief 到同一个服务端的多连接客户端，每个IO loop各自持有一组连接
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_NET_TCPCLIENTPOOL_H
+#define WEB_SERVER_NET_TCPCLIENTPOOL_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/Noncopyable.h"
+#include "net/Callbacks.h"
+#include "net/InetAddress.h"
+
+namespace web_server {
+
+namespace net {
+
+class EventLoop;
+class EventLoopThreadPool;
+
+struct TcpClientPoolOptions {
+    size_t connections_per_loop = 4;    // 每个loop保持的连接数
+    int max_failures = 3;               // 连续失败达到该次数时淘汰连接并重新建立
+    double reconnect_delay = 0.5;       // 连接断开或失败后首次重连的延迟，秒，之后每次翻倍
+    double max_reconnect_delay = 30.0;
+};
+
+/**
+ * @brief TcpClient只管理一个连接，高扇出时所有请求挤在一条TCP流和一把锁上；
+ * TcpClientPool在EventLoopThreadPool的每个loop中各建立N个连接，连接只在所属loop中使用：
+ * acquire在调用线程所属的loop中挑选未完成请求最少的连接，不需要加锁；
+ * release时报告请求是否成功，连续失败的连接被淘汰，断开的连接按退避时间重连
+ */
+class TcpClientPool : private Noncopyable {
+public:
+    TcpClientPool(EventLoop *base_loop,
+                  const InetAddress &server_addr,
+                  const std::string &name,
+                  const TcpClientPoolOptions &options = TcpClientPoolOptions());
+    ~TcpClientPool();
+
+    /**
+     * @brief IO线程数，为0时所有连接都在base loop中，必须在start之前调用
+     */
+    void set_thread_num(int num_threads);
+
+    // 回调在连接所属的loop线程中执行，必须在start之前设置
+    void set_connection_callback(const ConnectionCallback &cb) {
+        connection_callback_ = cb;
+    }
+
+    void set_message_callback(const MessageCallback &cb) {
+        message_callback_ = cb;
+    }
+
+    void set_write_complete_callback(const WriteCompleteCallback &cb) {
+        write_complete_callback_ = cb;
+    }
+
+    /**
+     * @brief 启动IO线程，并在每个loop中立即建立全部连接，第一个请求不需要等待握手
+     * 在base loop线程中调用
+     */
+    void start();
+
+    /**
+     * @brief 取得调用线程所属loop中未完成请求最少的连接，该连接的计数加一
+     * 只能在池中某个loop的线程中调用
+     * @return TcpConnectionPtr 该loop当前没有可用连接时为空
+     */
+    TcpConnectionPtr acquire();
+
+    /**
+     * @brief 一个请求结束，在连接所属的loop线程中调用
+     * @param healthy 请求是否成功，连续失败max_failures次的连接被关闭并重新建立
+     */
+    void release(const TcpConnectionPtr &conn, bool healthy = true);
+
+    /**
+     * @brief 按轮转选择一个loop，用于把请求分派到各个IO线程，在base loop线程中调用
+     */
+    EventLoop *get_next_loop();
+
+    std::vector<EventLoop *> get_all_loops() const;
+
+    /**
+     * @brief 全部loop中已建立的连接数
+     */
+    size_t connected_count() const {
+        return connected_.load();
+    }
+
+    const std::string &name() const {
+        return name_;
+    }
+
+private:
+    class LoopPool;
+
+    LoopPool *loop_pool(EventLoop *loop) const;
+    void shutdown();
+
+    EventLoop *base_loop_;
+    const InetAddress server_addr_;
+    const std::string name_;
+    const TcpClientPoolOptions options_;
+    ConnectionCallback connection_callback_;
+    MessageCallback message_callback_;
+    WriteCompleteCallback write_complete_callback_;
+    std::atomic<size_t> connected_;
+    // start之后不再改变，每个LoopPool只在自己的loop线程中访问
+    std::vector<std::unique_ptr<LoopPool>> loop_pools_;
+    // 最后声明，最先析构：IO线程退出时队列中的回调用到的LoopPool都还有效
+    std::unique_ptr<EventLoopThreadPool> thread_pool_;
+};
+
+} // namespace net
+
+} // namespace web_server
+
+#endif // WEB_SERVER_NET_TCPCLIENTPOOL_H
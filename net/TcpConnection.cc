@@ -12,16 +12,17 @@
 #include <cerrno>
 
 #include "base/Logging.h"
-#include "net/Socket.h"
+#include "base/BinaryLogging.h"
 #include "net/Channel.h"
 #include "net/EventLoop.h"
+#include "net/Transport.h"
 
 namespace web_server {
 
 namespace net {
 
 void default_connection_callback(const TcpConnectionPtr &conn) {
-    // LOG_TRACE << conn->local_addr().to_IP_port() << " -> " << conn->peer_addr().to_IP_port() << " is " << (conn->connected() ? "UP" : "DOWN");
+    LOG_TRACE << conn->local_addr().to_IP_port() << " -> " << conn->peer_addr().to_IP_port() << " is " << (conn->connected() ? "UP" : "DOWN");
 }
 
 void default_message_callback(const TcpConnectionPtr &,
@@ -34,12 +35,20 @@ TcpConnection::TcpConnection(EventLoop *loop,
                              const std::string &name,
                              int sockfd,
                              const InetAddress &local_addr,
-                             const InetAddress &peer_addr) 
+                             const InetAddress &peer_addr)
+    : TcpConnection(loop, name, std::unique_ptr<Transport>(new SocketTransport(sockfd)), local_addr, peer_addr) {}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                             const std::string &name,
+                             std::unique_ptr<Transport> transport,
+                             const InetAddress &local_addr,
+                             const InetAddress &peer_addr)
     : loop_(loop),
       name_(name),
       state_(kConnecting),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      reading_(true),
+      transport_(std::move(transport)),
+      channel_(new Channel(loop, transport_->fd())),
       local_addr_(local_addr),
       peer_addr_(peer_addr),
       high_water_mark_(64 * 1024 * 1024) {
@@ -47,36 +56,54 @@ TcpConnection::TcpConnection(EventLoop *loop,
     channel_->set_write_callback(std::bind(&TcpConnection::handle_write, this));
     channel_->set_close_callback(std::bind(&TcpConnection::handle_close, this));
     channel_->set_error_callback(std::bind(&TcpConnection::handle_error, this));
-    // LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this << " fd=" << sockfd;
-    socket_->set_keep_alive(true);
+    BLOG_DEBUG("TcpConnection::ctor[{}] at {} fd={}", name_, this, channel_->fd());
 }
 
 TcpConnection::~TcpConnection() {
-    // LOG_DEBUG << "TcpConnection::dtor[" <<  name_ << "] at " << this << " fd=" << channel_->fd() << " state=" << state_to_string();
+    BLOG_DEBUG("TcpConnection::dtor[{}] at {} fd={} state={}", name_, this, channel_->fd(), state_to_string());
     assert(state_ == kDisconnected);
 }
 
 std::string TcpConnection::get_tcp_info_string() const {
     char buf[1024];
     buf[0] = '\0';
-    socket_->get_tcp_info_string(buf, sizeof buf);
+    transport_->get_tcp_info_string(buf, sizeof buf);
     return buf;
 }
 
 void TcpConnection::send(const std::string &message) {
     if (state_ == kConnected) {
         if (loop_->is_in_loop_thread()) {
-            send_in_loop(message);
+            send_in_loop(message.data(), message.size());
+        } else {
+            TcpConnectionPtr self(shared_from_this());
+            loop_->run_in_loop([self, message]() {
+                self->send_in_loop(message.data(), message.size());
+            });
+        }
+    }
+}
+
+void TcpConnection::send_file(int fd, off_t offset, size_t length, const std::shared_ptr<void> &holder) {
+    if (state_ == kConnected) {
+        if (loop_->is_in_loop_thread()) {
+            send_file_in_loop(fd, offset, length, holder);
         } else {
-            loop_->run_in_loop(std::bind(&TcpConnection::send_in_loop, this, message));
+            loop_->run_in_loop(std::bind(&TcpConnection::send_file_in_loop,
+                                         shared_from_this(), fd, offset, length, holder));
         }
     }
 }
 
+/**
+ * @brief 在loop线程中直接写出或追加到输出缓冲，不产生中间的string拷贝
+ */
 void TcpConnection::send(const void *message, size_t len) {
-    const char *cStr = static_cast<const char*>(message);
-    std::string str(cStr, len);
-    send(str);
+    if (state_ == kConnected && loop_->is_in_loop_thread()) {
+        send_in_loop(message, len);
+    } else {
+        send(std::string(static_cast<const char *>(message), len));
+    }
 }
 
 void TcpConnection::shutdown() {
@@ -86,8 +113,41 @@ void TcpConnection::shutdown() {
     }
 }
 
+void TcpConnection::start_read() {
+    loop_->run_in_loop(std::bind(&TcpConnection::start_read_in_loop, shared_from_this()));
+}
+
+void TcpConnection::stop_read() {
+    loop_->run_in_loop(std::bind(&TcpConnection::stop_read_in_loop, shared_from_this()));
+}
+
+void TcpConnection::start_read_in_loop() {
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected) {
+        return;
+    }
+    if (!reading_ || !channel_->is_reading()) {
+        channel_->enable_reading();
+        reading_ = true;
+    }
+}
+
+/**
+ * @brief 停止关注读事件后，内核接收缓冲区写满时对端会被TCP流控阻塞
+ */
+void TcpConnection::stop_read_in_loop() {
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected) {
+        return;
+    }
+    if (reading_ || channel_->is_reading()) {
+        channel_->disable_reading();
+        reading_ = false;
+    }
+}
+
 void TcpConnection::set_tcp_no_delay(bool on) {
-    socket_->set_tcp_no_delay(on);
+    transport_->set_tcp_no_delay(on);
 }
 
 void TcpConnection::connection_established() {
@@ -102,7 +162,8 @@ void TcpConnection::connection_established() {
 
 void TcpConnection::connection_destroyed() {
     loop_->assert_in_loop_thread();
-    if (state_ == kConnected) {
+    // 服务器析构时连接可能还在kDisconnecting，等待输出写完
+    if (state_ == kConnected || state_ == kDisconnecting) {
         set_state(kDisconnected);
         channel_->disable_all();
         connection_callback_(shared_from_this());
@@ -113,14 +174,14 @@ void TcpConnection::connection_destroyed() {
 void TcpConnection::handle_read(Timestamp receive_time) {
     loop_->assert_in_loop_thread();
     int saved_errno = 0;
-    ssize_t n = input_buffer_.read_fd(channel_->fd(), &saved_errno);
+    ssize_t n = transport_->read(&input_buffer_, &saved_errno);
     if (n > 0) {
         message_callback_(shared_from_this(), &input_buffer_, receive_time);
     } else if (n == 0) {
         handle_close();
     } else {
         errno = saved_errno;
-        // LOG_SYSERR << "TcpConnection::handle_read";
+        LOG_SYSERR << "TcpConnection::handle_read";
         handle_error();
     }
 }
@@ -128,89 +189,198 @@ void TcpConnection::handle_read(Timestamp receive_time) {
 void TcpConnection::handle_write() {
     loop_->assert_in_loop_thread();
     if (channel_->is_writing()) {
-        ssize_t n = ::write(channel_->fd(),
-                            output_buffer_.peek(),
-                            output_buffer_.readable_bytes());
-        if (n > 0) {
-            output_buffer_.retrieve(static_cast<size_t>(n));
-            if (output_buffer_.readable_bytes() == 0) {
-                channel_->disable_writing();
-                if (write_complete_callback_) {
-                    loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
+        if (flush_output()) {
+            channel_->disable_writing();
+            if (write_complete_callback_) {
+                loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
+            }
+            if (state_ == kDisconnecting) {
+                shutdown_in_loop();
+            }
+        }
+    } else {
+        LOG_TRACE << "Connection fd = " << channel_->fd() << " is down, no more writing";
+    }
+}
+
+/**
+ * @brief 依次写出output_buffer_和各个文件片段，直到全部写完或socket写满
+ * @return true 全部写完
+ * @return false 还有数据没有写出，继续等待可写事件
+ */
+bool TcpConnection::flush_output() {
+    while (true) {
+        if (output_buffer_.readable_bytes() > 0) {
+            ssize_t n = transport_->write(output_buffer_.peek(), output_buffer_.readable_bytes());
+            if (n < 0) {
+                if (errno != EWOULDBLOCK) {
+                    LOG_SYSERR << "TcpConnection::handle_write";
                 }
-                if (state_ == kDisconnecting) {
-                    shutdown_in_loop();
+                return false;
+            }
+            output_buffer_.retrieve(static_cast<size_t>(n));
+            if (output_buffer_.readable_bytes() > 0) {
+                return false;
+            }
+        }
+        if (file_segments_.empty()) {
+            return true;
+        }
+
+        FileSegment &file = file_segments_.front();
+        while (file.remaining > 0) {
+            ssize_t n = transport_->send_file(file.fd, &file.offset, file.remaining);
+            if (n < 0 && errno == EAGAIN) {
+                return false;
+            }
+            if (n <= 0) {
+                // 文件读错误或者被截断，响应已经无法完整发出，只能断开连接
+                if (n < 0) {
+                    LOG_SYSERR << "TcpConnection::sendfile [" << name_ << "]";
+                } else {
+                    LOG_ERROR << "TcpConnection::sendfile [" << name_ << "] file truncated, "
+                              << file.remaining << " bytes missing";
                 }
+                file_segments_.clear();
+                output_buffer_.retrieve_all();
+                loop_->queue_in_loop(std::bind(&TcpConnection::force_close_in_loop, shared_from_this()));
+                return false;
             }
-        } else {
-            // LOG_SYSERR << "TcpConnection::handle_write";
+            file.remaining -= static_cast<size_t>(n);
         }
-    } else {
-        // LOG_TRACE << "Connection fd = " << channel_->fd() << " is down, no more writing";
+        output_buffer_.swap(file.trailer);
+        file_segments_.pop_front();
+    }
+}
+
+size_t TcpConnection::buffered_bytes() const {
+    size_t bytes = output_buffer_.readable_bytes();
+    for (const FileSegment &file : file_segments_) {
+        bytes += file.trailer.readable_bytes();
+    }
+    return bytes;
+}
+
+void TcpConnection::force_close() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        set_state(kDisconnecting);
+        loop_->queue_in_loop(std::bind(&TcpConnection::force_close_in_loop, shared_from_this()));
+    }
+}
+
+void TcpConnection::force_close_in_loop() {
+    loop_->assert_in_loop_thread();
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        handle_close();
     }
 }
 
 void TcpConnection::handle_close() {
     loop_->assert_in_loop_thread();
-    // LOG_TRACE << "fd = " << channel_->fd() << " state = " << state_to_string();
+    BLOG_TRACE("fd = {} state = {}", channel_->fd(), state_to_string());
     assert(state_ == kConnected || state_ == kDisconnecting);
     set_state(kDisconnected);
     channel_->disable_all();
     // 使用shared_ptr来管理this指针，避免this指向的对象生命周期提前结束
-    close_callback_(shared_from_this());
+    TcpConnectionPtr guard(shared_from_this());
+    // 先通知使用者连接断开，再由TcpServer/TcpClient移除连接
+    connection_callback_(guard);
+    close_callback_(guard);
 }
 
 void TcpConnection::handle_error(){
-    int err = sockets::get_socket_error(channel_->fd());
-    // LOG_ERROR << "TcpConnection::handle_error [" << name_ << "] - SO_ERROR = " << err << " " << strerror_tl(err);
+    int err = transport_->get_error();
+    LOG_EVERY_T(ERROR, 1) << "TcpConnection::handle_error [" << name_ << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
-void TcpConnection::send_in_loop(const std::string &message){
+void TcpConnection::send_in_loop(const void *message, size_t len) {
     loop_->assert_in_loop_thread();
+    const char *data = static_cast<const char *>(message);
     ssize_t n = 0;
-    size_t remain = message.size();
+    size_t remain = len;
     if (state_ == kDisconnected) {
-        // LOG_WARN << "disconnected, give up writing";
+        LOG_WARN << "disconnected, give up writing";
         return;
     }
     // 若channel没有关注写事件，输出缓冲区没有数据可读，尝试直接对该文件描述符进行写操作
     if (!channel_->is_writing() && output_buffer_.readable_bytes() == 0) {
-        n = ::write(channel_->fd(), message.data(), message.size());
+        n = transport_->write(data, len);
         if (n >= 0) {
-            remain = message.size() - n;
+            remain = len - n;
             if (remain == 0 && write_complete_callback_) {
                 loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
             }
         } else {
             n = 0;
             if (errno != EWOULDBLOCK) {
-                // LOG_SYSERR << "TcpConnection::send_in_loop";
+                LOG_SYSERR << "TcpConnection::send_in_loop";
             }
         }
     }
 
-    assert(remain <= message.size());
+    assert(remain <= len);
     // 若一次性没有写完，则将剩余数据放到输出buffer中，然后让channel监听写事件，负责将剩余数据写出
-    // 在handle_write中完成剩余工作
+    // 在handle_write中完成剩余工作；有文件片段在等待时，数据排在最后一个片段之后
     if (remain > 0) {
-        size_t old_len = output_buffer_.readable_bytes();
+        size_t old_len = buffered_bytes();
         if (old_len + remain >= high_water_mark_
             && old_len < high_water_mark_
             && high_water_mark_callback_) {
             loop_->queue_in_loop(std::bind(high_water_mark_callback_, shared_from_this(), old_len + remain));
         }
-        output_buffer_.append(message.data() + n, remain);
+        Buffer *output = file_segments_.empty() ? &output_buffer_ : &file_segments_.back().trailer;
+        output->append(data + n, remain);
         if (!channel_->is_writing()) {
             channel_->enable_writing();
         }
     }
-    
+}
+
+void TcpConnection::send_file_in_loop(int fd, off_t offset, size_t length, const std::shared_ptr<void> &holder) {
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up sending file";
+        return;
+    }
+    if (length == 0) {
+        return;
+    }
+    // 前面没有待发送的数据时直接sendfile，写不完的部分排队
+    if (!channel_->is_writing() && output_buffer_.readable_bytes() == 0 && file_segments_.empty()) {
+        while (length > 0) {
+            ssize_t n = transport_->send_file(fd, &offset, length);
+            if (n <= 0) {
+                if (n < 0 && errno == EAGAIN) {
+                    break;
+                }
+                LOG_SYSERR << "TcpConnection::send_file_in_loop [" << name_ << "] " << length << " bytes unsent";
+                loop_->queue_in_loop(std::bind(&TcpConnection::force_close_in_loop, shared_from_this()));
+                return;
+            }
+            length -= static_cast<size_t>(n);
+        }
+        if (length == 0) {
+            if (write_complete_callback_) {
+                loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
+            }
+            return;
+        }
+    }
+    FileSegment file;
+    file.fd = fd;
+    file.offset = offset;
+    file.remaining = length;
+    file.holder = holder;
+    file_segments_.push_back(std::move(file));
+    if (!channel_->is_writing()) {
+        channel_->enable_writing();
+    }
 }
 
 void TcpConnection::shutdown_in_loop() {
     loop_->assert_in_loop_thread();
     if (!channel_->is_writing()) {
-        socket_->shutdown_write();
+        transport_->shutdown_write();
     }
 }
 
@@ -9,6 +9,9 @@
 #ifndef WEB_SERVER_NET_TCPCONNECTION_H
 #define WEB_SERVER_NET_TCPCONNECTION_H
 
+#include <sys/types.h>
+
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -28,7 +31,7 @@ namespace net {
 
 class Channel;
 class EventLoop;
-class Socket;
+class Transport;
 
 /**
  * @brief 表示一个已建立的tcp连接
@@ -43,6 +46,14 @@ public:
                   int sockfd,
                   const InetAddress &local_addr,
                   const InetAddress &peer_addr);
+    /**
+     * @brief 使用指定的传输收发数据，transport的fd必须能被loop的Poller识别
+     */
+    TcpConnection(EventLoop *loop,
+                  const std::string &name,
+                  std::unique_ptr<Transport> transport,
+                  const InetAddress &local_addr,
+                  const InetAddress &peer_addr);
     ~TcpConnection();
 
     EventLoop *get_loop() const {
@@ -70,10 +81,45 @@ public:
         return &context_;
     }
     std::string get_tcp_info_string() const;
-    
+    /**
+     * @brief 已经读到但消息回调还没有取走的数据，只能在loop线程中访问
+     * 用于在消息回调之外继续消费，例如等待上游连接期间暂存的请求体
+     */
+    Buffer *input_buffer() {
+        return &input_buffer_;
+    }
+
     void send(const void *message, size_t len);
     void send(const std::string &message);
+    /**
+     * @brief 用sendfile发送文件中[offset, offset + length)的内容，数据不经过用户态
+     * 与send的数据按调用顺序发送；发送完成或连接销毁之前fd必须保持打开，
+     * holder在这之后才释放，可以用它管理fd的生命周期
+     * @param fd
+     * @param offset
+     * @param length
+     * @param holder
+     */
+    void send_file(int fd, off_t offset, size_t length,
+                   const std::shared_ptr<void> &holder = std::shared_ptr<void>());
     void shutdown();
+    /**
+     * @brief 不等待输出缓冲写完，直接关闭连接，用于对端失去响应的情况
+     */
+    void force_close();
+    // 暂停/恢复从连接读取数据，用于背压控制
+    void start_read();
+    void stop_read();
+    bool is_reading() const {
+        return reading_;
+    }
+    /**
+     * @brief 输出缓冲或文件片段中还有数据等待发送，只能在loop线程中访问
+     * 高水位回调排队执行，执行时数据可能已经写完，写完成回调不会再来
+     */
+    bool write_pending() const {
+        return output_buffer_.readable_bytes() > 0 || !file_segments_.empty();
+    }
     void connection_established();
     void connection_destroyed();
     // 设置禁用Nagle算法
@@ -104,8 +150,14 @@ private:
     void handle_close();
     void handle_error();
     
-    void send_in_loop(const std::string &message);
+    void send_in_loop(const void *message, size_t len);
+    void send_file_in_loop(int fd, off_t offset, size_t length, const std::shared_ptr<void> &holder);
+    bool flush_output();
+    size_t buffered_bytes() const;
+    void force_close_in_loop();
     void shutdown_in_loop();
+    void start_read_in_loop();
+    void stop_read_in_loop();
 
     void set_state(StateE s) {
         state_ = s;
@@ -116,7 +168,8 @@ private:
     EventLoop *loop_;
     const std::string name_;
     StateE state_;                                      // 存储该连接状态
-    std::unique_ptr<Socket> socket_;                    // 管理socket
+    bool reading_;                                      // 是否在关注读事件
+    std::unique_ptr<Transport> transport_;              // 收发数据，默认是socket
     std::unique_ptr<Channel> channel_;                  // 需要使用Channel管理socket触发回调
     const InetAddress local_addr_;
     const InetAddress peer_addr_;
@@ -128,6 +181,19 @@ private:
     size_t high_water_mark_;
     Buffer input_buffer_;                               // 输入数据缓冲，负责接收数据
     Buffer output_buffer_;                              // 输出数据缓冲，负责发送数据
+
+    /**
+     * @brief 等待sendfile的文件片段，排在output_buffer_之后；
+     * 片段之后send的数据存放在该片段的trailer中，片段发送完成后移入output_buffer_
+     */
+    struct FileSegment {
+        int fd;
+        off_t offset;
+        size_t remaining;
+        std::shared_ptr<void> holder;
+        Buffer trailer;
+    };
+    std::deque<FileSegment> file_segments_;
     boost::any context_;
 };
 
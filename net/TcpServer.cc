@@ -67,6 +67,21 @@ void TcpServer::start() {
 // 有新连接到来后的处理方式
 void TcpServer::new_connection(int sockfd, const InetAddress &peer_addr) {
     loop_->assert_in_loop_thread();
+    InetAddress local_addr(InetAddress::get_local_addr(sockfd));
+    establish_connection(std::unique_ptr<Transport>(new SocketTransport(sockfd)), local_addr, peer_addr);
+}
+
+void TcpServer::attach_connection(std::unique_ptr<Transport> transport,
+                                  const InetAddress &local_addr,
+                                  const InetAddress &peer_addr) {
+    loop_->assert_in_loop_thread();
+    assert(started_.get() == 1);
+    establish_connection(std::move(transport), local_addr, peer_addr);
+}
+
+void TcpServer::establish_connection(std::unique_ptr<Transport> transport,
+                                     const InetAddress &local_addr,
+                                     const InetAddress &peer_addr) {
     // 从线程池中取一个io线程
     EventLoop *IO_loop = thread_pool_->get_next_loop();
     char buf[64];
@@ -76,9 +91,8 @@ void TcpServer::new_connection(int sockfd, const InetAddress &peer_addr) {
 
     // LOG_INFO << "TcpServer::new_connection [" << name_ << "] - new connection [" << conn_name << "] from " << peer_addr.to_IP_port();
 
-    InetAddress local_addr(InetAddress::get_local_addr(sockfd));
     // 根据已有的信息创建一个tcpconnection对象，该对象由线程池中的IO线程进行管理
-    TcpConnectionPtr conn(new TcpConnection(IO_loop, conn_name, sockfd, local_addr, peer_addr));
+    TcpConnectionPtr conn(new TcpConnection(IO_loop, conn_name, std::move(transport), local_addr, peer_addr));
     connections_[conn_name] = conn;
     conn->set_connection_callback(connection_callback_);
     conn->set_message_callback(message_callback_);
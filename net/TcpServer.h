@@ -20,6 +20,7 @@
 #include "net/Callbacks.h"
 #include "net/InetAddress.h"
 #include "net/TcpConnection.h"
+#include "net/Transport.h"
 
 namespace web_server {
 
@@ -71,6 +72,15 @@ public:
     
     void start();
 
+    /**
+     * @brief 把不经过accept建立的连接交给服务器，和accept到的连接一样分配IO loop、设置回调；
+     * 必须在start之后、base loop线程中调用，transport的fd必须能被分配到的IO loop的Poller识别，
+     * 例如MemoryTransport要求线程数为0且base loop使用MemoryPoller
+     */
+    void attach_connection(std::unique_ptr<Transport> transport,
+                           const InetAddress &local_addr,
+                           const InetAddress &peer_addr);
+
     void set_connection_callback(const ConnectionCallback &cb) {
         connection_callback_ = cb;
     }
@@ -104,6 +114,9 @@ private:
     ConnectionMap connections_;
 
     void new_connection(int sockfd, const InetAddress &peer_addr);
+    void establish_connection(std::unique_ptr<Transport> transport,
+                              const InetAddress &local_addr,
+                              const InetAddress &peer_addr);
     void remove_connection(const TcpConnectionPtr &conn);
     void remove_connection_in_loop(const TcpConnectionPtr &conn);
 };
@@ -0,0 +1,55 @@
+/**
+ * @brief socket传输
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "net/Transport.h"
+
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include "net/Buffer.h"
+
+namespace web_server {
+
+namespace net {
+
+SocketTransport::SocketTransport(int sockfd)
+    : socket_(sockfd) {
+    socket_.set_keep_alive(true);
+}
+
+ssize_t SocketTransport::read(Buffer *buf, int *saved_errno) {
+    return buf->read_fd(socket_.fd(), saved_errno);
+}
+
+ssize_t SocketTransport::write(const void *data, size_t len) {
+    return ::write(socket_.fd(), data, len);
+}
+
+ssize_t SocketTransport::send_file(int in_fd, off_t *offset, size_t count) {
+    return ::sendfile(socket_.fd(), in_fd, offset, count);
+}
+
+void SocketTransport::shutdown_write() {
+    socket_.shutdown_write();
+}
+
+int SocketTransport::get_error() const {
+    return sockets::get_socket_error(socket_.fd());
+}
+
+void SocketTransport::set_tcp_no_delay(bool on) {
+    socket_.set_tcp_no_delay(on);
+}
+
+bool SocketTransport::get_tcp_info_string(char *buf, int len) const {
+    return socket_.get_tcp_info_string(buf, len);
+}
+
+} // namespace net
+
+} // namespace web_server
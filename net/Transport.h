@@ -0,0 +1,84 @@
+/**
+ * @brief TcpConnection下层的字节流接口，默认实现是非阻塞socket
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_NET_TRANSPORT_H
+#define WEB_SERVER_NET_TRANSPORT_H
+
+#include <sys/types.h>
+
+#include "base/Noncopyable.h"
+#include "net/Socket.h"
+
+namespace web_server {
+
+namespace net {
+
+class Buffer;
+
+/**
+ * @brief 连接收发数据的方式，读写的返回值和errno与read/write系统调用相同；
+ * fd()注册到所属loop的Poller，不是socket的实现（如MemoryTransport）需要能识别它的Poller
+ */
+class Transport : private Noncopyable {
+public:
+    virtual ~Transport() = default;
+
+    virtual int fd() const = 0;
+
+    /**
+     * @brief 把可读的数据追加到buf，返回读到的字节数，0表示对端关闭，-1时错误码存入saved_errno
+     */
+    virtual ssize_t read(Buffer *buf, int *saved_errno) = 0;
+
+    virtual ssize_t write(const void *data, size_t len) = 0;
+
+    /**
+     * @brief 发送文件in_fd中从*offset开始的最多count字节，并前移*offset
+     */
+    virtual ssize_t send_file(int in_fd, off_t *offset, size_t count) = 0;
+
+    virtual void shutdown_write() = 0;
+
+    /**
+     * @brief 连接上待处理的错误，相当于SO_ERROR
+     */
+    virtual int get_error() const = 0;
+
+    virtual void set_tcp_no_delay(bool on) = 0;
+
+    virtual bool get_tcp_info_string(char *buf, int len) const = 0;
+};
+
+/**
+ * @brief 基于已连接socket的传输，析构时关闭socket
+ */
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(int sockfd);
+
+    int fd() const override {
+        return socket_.fd();
+    }
+
+    ssize_t read(Buffer *buf, int *saved_errno) override;
+    ssize_t write(const void *data, size_t len) override;
+    ssize_t send_file(int in_fd, off_t *offset, size_t count) override;
+    void shutdown_write() override;
+    int get_error() const override;
+    void set_tcp_no_delay(bool on) override;
+    bool get_tcp_info_string(char *buf, int len) const override;
+
+private:
+    Socket socket_;
+};
+
+} // namespace net
+
+} // namespace web_server
+
+#endif // WEB_SERVER_NET_TRANSPORT_H
@@ -0,0 +1,136 @@
+/**
+ * @brief 能同时等待MemoryTransport和内核描述符的Poller
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include "net/poller/MemoryPoller.h"
+
+#include <poll.h>
+
+#include <cassert>
+
+#include "base/Logging.h"
+#include "net/Channel.h"
+#include "net/MemoryTransport.h"
+#include "net/poller/EPollPoller.h"
+
+namespace web_server {
+
+namespace net {
+
+namespace {
+
+const int k_new = -1;       // 与EPollPoller相同，channel的index表示是否已经注册
+const int k_added = 1;
+
+} // namespace
+
+MemoryPoller::MemoryPoller(EventLoop *loop)
+    : Poller(loop),
+      loop_(loop),
+      real_(new EPollPoller(loop)),
+      busy_polls_(0) {}
+
+MemoryPoller::~MemoryPoller() = default;
+
+EventLoop::PollerFactory MemoryPoller::factory() {
+    return [](EventLoop *loop) -> Poller * {
+        return new MemoryPoller(loop);
+    };
+}
+
+Timestamp MemoryPoller::poll(int timeout_ms, ChannelLists *active_channels) {
+    fill_ready_channels(active_channels);
+    if (active_channels->empty()) {
+        busy_polls_ = 0;
+        Timestamp now(real_->poll(timeout_ms, active_channels));
+        // 可能是其他线程的对端写入数据后唤醒了loop，本轮就处理
+        fill_ready_channels(active_channels);
+        return now;
+    }
+    if (++busy_polls_ >= k_real_poll_interval) {
+        busy_polls_ = 0;
+        real_->poll(0, active_channels);
+    }
+    return Timestamp::now();
+}
+
+/**
+ * @brief 水平触发：只要缓冲区里有数据或者有空间就一直报告，没有关注任何事件的channel不报告
+ */
+void MemoryPoller::fill_ready_channels(ChannelLists *active_channels) const {
+    for (const auto &entry : endpoints_) {
+        Channel *channel = channels_.find(entry.first)->second;
+        if (channel->is_nonevent()) {
+            continue;
+        }
+        const MemoryTransport *endpoint = entry.second;
+        int revents = 0;
+        if (channel->is_reading() && endpoint->readable()) {
+            revents |= POLLIN;
+        }
+        if (channel->is_writing() && endpoint->writable()) {
+            revents |= POLLOUT;
+        }
+        if (endpoint->peer_closed()) {
+            revents |= POLLHUP;
+        }
+        if (revents) {
+            channel->set_revents(revents);
+            active_channels->push_back(channel);
+        }
+    }
+}
+
+void MemoryPoller::update_channel(Channel *channel) {
+    Poller::assert_in_loop_thread();
+    int fd = channel->fd();
+    if (!MemoryTransport::is_memory_fd(fd)) {
+        real_->update_channel(channel);
+        return;
+    }
+    LOG_TRACE << "memory fd = " << fd << " events = " << channel->events();
+    if (channel->index() == k_new) {
+        assert(channels_.find(fd) == channels_.end());
+        MemoryTransport *endpoint = MemoryTransport::find(fd);
+        assert(endpoint != nullptr);
+        endpoint->set_loop(loop_);
+        channels_[fd] = channel;
+        endpoints_[fd] = endpoint;
+        channel->set_index(k_added);
+    } else {
+        assert(channels_.find(fd) != channels_.end());
+        assert(channels_[fd] == channel);
+    }
+}
+
+void MemoryPoller::remove_channel(Channel *channel) {
+    Poller::assert_in_loop_thread();
+    int fd = channel->fd();
+    if (!MemoryTransport::is_memory_fd(fd)) {
+        real_->remove_channel(channel);
+        return;
+    }
+    LOG_TRACE << "memory fd = " << fd;
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+    assert(channel->is_nonevent());
+    endpoints_[fd]->set_loop(nullptr);
+    channels_.erase(fd);
+    endpoints_.erase(fd);
+    channel->set_index(k_new);
+}
+
+bool MemoryPoller::has_channel(Channel *channel) const {
+    if (!MemoryTransport::is_memory_fd(channel->fd())) {
+        return real_->has_channel(channel);
+    }
+    return Poller::has_channel(channel);
+}
+
+} // namespace net
+
+} // namespace web_server
@@ -0,0 +1,57 @@
+/**
+ * @brief 能同时等待MemoryTransport和内核描述符的Poller
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#ifndef WEB_SERVER_NET_POLLER_MEMORYPOLLER_H
+#define WEB_SERVER_NET_POLLER_MEMORYPOLLER_H
+
+#include "net/Poller.h"
+
+#include <memory>
+
+namespace web_server {
+
+namespace net {
+
+class MemoryTransport;
+
+/**
+ * @brief 内存连接的channel由自己按水平触发检查就绪状态，其他描述符（loop的eventfd、timerfd等）交给内部的epoll
+ * 有内存连接就绪时不阻塞，每k_real_poll_interval轮才用0超时检查一次epoll，避免每轮都多一次系统调用；
+ * 没有就绪的内存连接时阻塞在epoll上，其他线程的对端通过EventLoop::wakeup唤醒
+ * 用法：EventLoop loop(MemoryPoller::factory());
+ */
+class MemoryPoller : public Poller {
+public:
+    explicit MemoryPoller(EventLoop *loop);
+    ~MemoryPoller() override;
+
+    Timestamp poll(int timeout_ms, ChannelLists *active_channels) override;
+    void update_channel(Channel *channel) override;
+    void remove_channel(Channel *channel) override;
+    bool has_channel(Channel *channel) const override;
+
+    static EventLoop::PollerFactory factory();
+
+private:
+    using EndpointMap = std::map<int, MemoryTransport *>;
+
+    static const int k_real_poll_interval = 64;
+
+    void fill_ready_channels(ChannelLists *active_channels) const;
+
+    EventLoop *loop_;
+    std::unique_ptr<Poller> real_;      // 内核描述符
+    EndpointMap endpoints_;             // 与channels_中的fd一一对应
+    int busy_polls_;                    // 连续因内存连接就绪而没有阻塞的轮数
+};
+
+} // namespace net
+
+} // namespace web_server
+
+#endif // WEB_SERVER_NET_POLLER_MEMORYPOLLER_H
@@ -0,0 +1,214 @@
+/**
+ * @brief MemoryTransport的读写语义，以及通过MemoryPoller在同一线程和跨线程驱动TcpConnection的测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "net/Buffer.h"
+#include "net/EventLoop.h"
+#include "net/MemoryTransport.h"
+#include "net/TcpConnection.h"
+#include "net/TcpServer.h"
+#include "net/poller/MemoryPoller.h"
+
+using namespace web_server;
+using namespace web_server::net;
+
+namespace {
+
+const uint16_t k_port = 19549;
+const uint16_t k_thread_port = 19550;
+
+void test_pair() {
+    printf("test_pair\n");
+    MemoryTransport::Pair pair = MemoryTransport::create_pair(8);
+    MemoryTransport *a = pair.first.get();
+    MemoryTransport *b = pair.second.get();
+    assert(MemoryTransport::is_memory_fd(a->fd()) && MemoryTransport::is_memory_fd(b->fd()));
+    assert(a->fd() != b->fd());
+    assert(MemoryTransport::find(a->fd()) == a && MemoryTransport::find(b->fd()) == b);
+    assert(!MemoryTransport::is_memory_fd(0));
+
+    Buffer buf;
+    int saved_errno = 0;
+    assert(!b->readable() && b->writable());
+    assert(b->read(&buf, &saved_errno) == -1 && saved_errno == EAGAIN);
+    assert(a->write("hello", 5) == 5);
+    assert(b->readable());
+    assert(b->read(&buf, &saved_errno) == 5);
+    assert(buf.retrieve_all_as_string() == "hello");
+
+    // 容量是8字节，写满后EAGAIN，读走后恢复可写
+    assert(a->write("0123456789", 10) == 8);
+    assert(!a->writable());
+    errno = 0;
+    assert(a->write("x", 1) == -1 && errno == EAGAIN);
+    assert(b->read(&buf, &saved_errno) == 8);
+    assert(buf.retrieve_all_as_string() == "01234567");
+    assert(a->writable());
+
+    // 关闭写端后读到EOF，另一个方向不受影响
+    a->shutdown_write();
+    assert(b->readable());
+    assert(b->read(&buf, &saved_errno) == 0);
+    assert(b->write("ok", 2) == 2);
+    assert(a->read(&buf, &saved_errno) == 2);
+    buf.retrieve_all();
+    assert(!a->peer_closed());
+
+    // 一端销毁后，另一端写得到EPIPE、读得到EOF
+    int b_fd = b->fd();
+    pair.second.reset();
+    assert(MemoryTransport::find(b_fd) == nullptr);
+    assert(a->peer_closed() && a->readable() && a->writable());
+    errno = 0;
+    assert(a->write("x", 1) == -1 && errno == EPIPE);
+    assert(a->read(&buf, &saved_errno) == 0);
+}
+
+void echo_message(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    conn->send(buf->retrieve_all_as_string());
+}
+
+/**
+ * @brief 客户端一侧也是TcpConnection，收到完整的回显后发送下一份
+ */
+class EchoClient {
+public:
+    EchoClient(EventLoop *loop, std::unique_ptr<Transport> transport, const std::string &message, int rounds)
+        : loop_(loop),
+          message_(message),
+          rounds_(rounds),
+          completed_(0),
+          conn_(new TcpConnection(loop, "client", std::move(transport), InetAddress(0), InetAddress(0))) {
+        conn_->set_connection_callback(std::bind(&EchoClient::on_connection, this, _1));
+        conn_->set_message_callback(std::bind(&EchoClient::on_message, this, _1, _2, _3));
+        conn_->set_close_callback([this](const TcpConnectionPtr &conn) {
+            closed_ = true;
+            loop_->queue_in_loop(std::bind(&TcpConnection::connection_destroyed, conn));
+            loop_->quit();
+        });
+        loop->run_in_loop(std::bind(&TcpConnection::connection_established, conn_));
+    }
+
+    int completed() const {
+        return completed_;
+    }
+
+    bool closed() const {
+        return closed_;
+    }
+
+private:
+    void on_connection(const TcpConnectionPtr &conn) {
+        if (conn->connected()) {
+            conn->send(message_);
+        }
+    }
+
+    // 每收到一份完整的回显就发下一份，全部完成后关闭写端，等服务端关闭连接
+    void on_message(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        while (buf->readable_bytes() >= message_.size()) {
+            assert(buf->retrieve_as_string(message_.size()) == message_);
+            if (++completed_ < rounds_) {
+                conn->send(message_);
+            } else {
+                conn->shutdown();
+            }
+        }
+    }
+
+    EventLoop *loop_;
+    const std::string message_;
+    const int rounds_;
+    int completed_;
+    bool closed_ = false;
+    TcpConnectionPtr conn_;
+};
+
+std::string make_message(size_t size) {
+    std::string message(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        message[i] = static_cast<char>('a' + i % 26);
+    }
+    return message;
+}
+
+void test_same_loop() {
+    printf("test_same_loop\n");
+    EventLoop loop(MemoryPoller::factory());
+    TcpServer server(&loop, InetAddress(k_port), "memory");
+    server.set_message_callback(echo_message);
+    server.start();
+
+    // 1MB的消息远大于4KB的容量，两个方向都要经过输出缓冲和写事件
+    MemoryTransport::Pair pair = MemoryTransport::create_pair(4096);
+    server.attach_connection(std::move(pair.second), InetAddress(k_port), InetAddress(0));
+    EchoClient client(&loop, std::move(pair.first), make_message(1024 * 1024), 3);
+    // 内存连接一直就绪时定时器（timerfd）也要能触发
+    bool timer_fired = false;
+    loop.run_after(0.001, [&timer_fired]() {
+        timer_fired = true;
+    });
+    loop.run_after(10, []() {
+        assert(false && "echo over memory transport timed out");
+    });
+    loop.loop();
+    assert(client.completed() == 3 && client.closed());
+    assert(timer_fired);
+}
+
+void test_cross_thread() {
+    printf("test_cross_thread\n");
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    TcpServer *server = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop(MemoryPoller::factory());
+        TcpServer echo_server(&loop, InetAddress(k_thread_port), "memory");
+        echo_server.set_message_callback(echo_message);
+        echo_server.start();
+        server_loop = &loop;
+        server = &echo_server;
+        started.count_down();
+        loop.loop();
+    }, "memory_server");
+    server_thread.start();
+    started.wait();
+
+    // 小消息一来一回，每次都要唤醒另一个线程阻塞中的loop
+    EventLoop loop(MemoryPoller::factory());
+    MemoryTransport::Pair pair = MemoryTransport::create_pair();
+    // std::function要求可复制，unique_ptr在服务端线程中重新接管
+    MemoryTransport *server_side = pair.second.release();
+    server_loop->run_in_loop([server, server_side]() {
+        server->attach_connection(std::unique_ptr<Transport>(server_side), InetAddress(k_thread_port), InetAddress(0));
+    });
+    EchoClient client(&loop, std::move(pair.first), "ping", 1000);
+    loop.run_after(10, []() {
+        assert(false && "cross thread echo timed out");
+    });
+    loop.loop();
+    assert(client.completed() == 1000 && client.closed());
+    server_loop->quit();
+    server_thread.join();
+}
+
+} // namespace
+
+int main() {
+    test_pair();
+    test_same_loop();
+    test_cross_thread();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @brief 退出loop和析构TcpServer时的清理测试：quit之前投递的回调、kDisconnecting状态的连接
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "net/EventLoop.h"
+#include "net/TcpConnection.h"
+#include "net/TcpServer.h"
+
+using namespace web_server;
+using namespace web_server::net;
+
+namespace {
+
+const uint16_t k_port = 19551;
+
+/**
+ * @brief 回调里先quit再投递的任务也要在loop返回之前执行
+ */
+void test_drain_after_quit() {
+    printf("test_drain_after_quit\n");
+    EventLoop loop;
+    bool ran = false;
+    // 在定时器回调中投递：loop线程自己投递的任务不会唤醒poll
+    loop.run_after(0.01, [&loop, &ran]() {
+        loop.quit();
+        loop.queue_in_loop([&ran]() {
+            ran = true;
+        });
+    });
+    loop.loop();
+    assert(ran);
+}
+
+/**
+ * @brief 服务端发送大量数据后shutdown，客户端不读，连接停在kDisconnecting；
+ * 此时析构TcpServer，连接要正常变为断开并且只通知一次
+ */
+void test_destroy_disconnecting() {
+    printf("test_destroy_disconnecting\n");
+    EventLoop loop;
+    int connected = 0;
+    int disconnected = 0;
+    TcpConnectionPtr server_conn;
+    std::unique_ptr<TcpServer> server(new TcpServer(&loop, InetAddress(k_port), "shutdown"));
+    server->set_connection_callback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected()) {
+            ++connected;
+            server_conn = conn;
+            conn->send(std::string(16 * 1024 * 1024, 'x'));
+            conn->shutdown();
+        } else {
+            ++disconnected;
+        }
+    });
+    server->start();
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(k_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int ret = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+    assert(ret == 0);
+    (void)ret;
+
+    loop.run_after(0.2, [&loop]() {
+        loop.quit();
+    });
+    loop.loop();
+    assert(connected == 1 && disconnected == 0);
+    assert(server_conn && !server_conn->connected() && !server_conn->disconnected());
+
+    server.reset();
+    assert(disconnected == 1);
+    assert(server_conn->disconnected());
+    server_conn.reset();
+    ::close(fd);
+}
+
+} // namespace
+
+int main() {
+    test_drain_after_quit();
+    test_destroy_disconnecting();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * @brief TcpClientPool的预热、最少未完成请求选择、淘汰重连测试
+ * Copyright (c) 2021, David Shu. All rights reserved.
+ *
+ * Use of this source code is governed by a GPL license
+ * @author David Shu (a294562476@gmail.com)
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <functional>
+#include <map>
+
+#include "base/CountDownLatch.h"
+#include "base/Thread.h"
+#include "net/Buffer.h"
+#include "net/EventLoop.h"
+#include "net/TcpClientPool.h"
+#include "net/TcpConnection.h"
+#include "net/TcpServer.h"
+
+using namespace web_server;
+using namespace web_server::net;
+
+namespace {
+
+const uint16_t k_port = 19540;
+const uint16_t k_down_port = 19541;
+
+std::atomic<int> g_accepted(0);
+std::atomic<int> g_echoed(0);
+
+void server_connection(const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+        ++g_accepted;
+    }
+}
+
+void server_message(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    conn->send(buf->retrieve_all_as_string());
+}
+
+void client_message(const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+    g_echoed += static_cast<int>(buf->readable_bytes());
+    buf->retrieve_all();
+}
+
+/**
+ * @brief 在loop线程中执行f并等待完成
+ */
+void run_sync(EventLoop *loop, const std::function<void()> &f) {
+    CountDownLatch latch(1);
+    loop->run_in_loop([&]() {
+        f();
+        latch.count_down();
+    });
+    latch.wait();
+}
+
+bool wait_until(const std::function<bool()> &condition) {
+    for (int i = 0; i < 500 && !condition(); ++i) {
+        ::usleep(10 * 1000);
+    }
+    return condition();
+}
+
+void test_pool(EventLoop *base_loop) {
+    TcpClientPoolOptions options;
+    options.connections_per_loop = 3;
+    TcpClientPool pool(base_loop, InetAddress("127.0.0.1", k_port), "pool", options);
+    pool.set_thread_num(2);
+    pool.set_message_callback(client_message);
+    pool.start();
+
+    printf("test_warm_up\n");
+    bool ok = wait_until([&]() { return pool.connected_count() == 6; });
+    assert(ok);
+    assert(wait_until([]() { return g_accepted.load() == 6; }));
+
+    printf("test_least_outstanding\n");
+    for (EventLoop *loop : pool.get_all_loops()) {
+        run_sync(loop, [&]() {
+            std::map<TcpConnection *, int> counts;
+            std::vector<TcpConnectionPtr> acquired;
+            for (int i = 0; i < 6; ++i) {
+                TcpConnectionPtr conn = pool.acquire();
+                assert(conn && conn->get_loop() == loop);
+                ++counts[conn.get()];
+                acquired.push_back(conn);
+            }
+            // 3个连接各分到2个请求
+            assert(counts.size() == 3);
+            for (const auto &item : counts) {
+                assert(item.second == 2);
+            }
+            // 完成请求最多的连接最先被选中
+            TcpConnectionPtr first = acquired[0];
+            pool.release(first);
+            pool.release(first);
+            assert(pool.acquire() == first);
+            pool.release(first);
+            for (size_t i = 1; i < acquired.size(); ++i) {
+                if (acquired[i] != first) {
+                    pool.release(acquired[i]);
+                }
+            }
+        });
+    }
+
+    printf("test_echo\n");
+    EventLoop *loop = pool.get_all_loops()[0];
+    run_sync(loop, [&]() {
+        TcpConnectionPtr conn = pool.acquire();
+        conn->send("ping");
+        pool.release(conn);
+    });
+    assert(wait_until([]() { return g_echoed.load() == 4; }));
+
+    printf("test_eviction\n");
+    run_sync(loop, [&]() {
+        TcpConnectionPtr conn = pool.acquire();
+        pool.release(conn, false);
+        pool.release(conn, false);
+        assert(conn->connected());
+        pool.release(conn, false);
+    });
+    // 淘汰的连接立即重连
+    assert(wait_until([]() { return g_accepted.load() == 7; }));
+    assert(wait_until([&]() { return pool.connected_count() == 6; }));
+}
+
+void test_unreachable(EventLoop *base_loop) {
+    printf("test_unreachable\n");
+    TcpClientPoolOptions options;
+    options.connections_per_loop = 2;
+    options.reconnect_delay = 0.05;
+    options.max_reconnect_delay = 0.1;
+    TcpClientPool pool(base_loop, InetAddress("127.0.0.1", k_down_port), "down", options);
+    pool.set_thread_num(1);
+    pool.start();
+    ::usleep(300 * 1000);
+    assert(pool.connected_count() == 0);
+    run_sync(pool.get_all_loops()[0], [&]() {
+        assert(!pool.acquire());
+    });
+}
+
+} // namespace
+
+int main() {
+    CountDownLatch started(1);
+    EventLoop *server_loop = nullptr;
+    Thread server_thread([&]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(k_port), "echo");
+        server.set_connection_callback(server_connection);
+        server.set_message_callback(server_message);
+        server.start();
+        server_loop = &loop;
+        started.count_down();
+        loop.loop();
+    }, "server");
+    server_thread.start();
+    started.wait();
+
+    EventLoop base_loop;
+    test_pool(&base_loop);
+    test_unreachable(&base_loop);
+
+    server_loop->quit();
+    server_thread.join();
+    printf("all tests passed\n");
+    return 0;
+}